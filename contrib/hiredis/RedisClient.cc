@@ -0,0 +1,387 @@
+#include "RedisClient.h"
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace muduo;
+using namespace muduo::net;
+using namespace hiredis;
+
+namespace
+{
+
+const int kMaxDepth = 16;
+const size_t kInitialCallbacks = 64;
+
+// *end is not read
+bool parseInteger(const char* begin, const char* end, int64_t* value)
+{
+  const char* p = begin;
+  bool negative = false;
+  if (p < end && *p == '-')
+  {
+    negative = true;
+    ++p;
+  }
+  if (p == end || end - p > 18)
+  {
+    return false;
+  }
+  int64_t v = 0;
+  for (; p < end; ++p)
+  {
+    if (*p < '0' || *p > '9')
+    {
+      return false;
+    }
+    v = v * 10 + (*p - '0');
+  }
+  *value = negative ? -v : v;
+  return true;
+}
+
+void appendHeader(Buffer* buf, char prefix, size_t n)
+{
+  char tmp[32];
+  char* end = tmp + sizeof tmp;
+  char* p = end;
+  *--p = '\n';
+  *--p = '\r';
+  do
+  {
+    *--p = static_cast<char>('0' + n % 10);
+    n /= 10;
+  } while (n != 0);
+  *--p = prefix;
+  buf->append(p, end - p);
+}
+
+}  // namespace
+
+string RedisReply::toString() const
+{
+  static const char* const types[] = {
+      "STRING", "ARRAY", "INTEGER", "NIL", "STATUS", "ERROR" };
+  string result(types[type]);
+  if (type == kString || type == kStatus || type == kError)
+  {
+    result += " \"";
+    result.append(str.data(), str.size());
+    result += '"';
+  }
+  else if (type == kInteger)
+  {
+    char buf[32];
+    snprintf(buf, sizeof buf, " %lld", static_cast<long long>(integer));
+    result += buf;
+  }
+  else if (type == kArray)
+  {
+    result += " [";
+    for (size_t i = 0; i < elements; ++i)
+    {
+      result += i > 0 ? ", " : "";
+      result += element[i].toString();
+    }
+    result += ']';
+  }
+  return result;
+}
+
+RespParser::Result RespParser::parse(const char* data, size_t size, size_t* len)
+{
+  replies_.resize(1);
+  firstElement_.resize(1);
+  const char* p = data;
+  Result result = parseReply(&p, data + size, 0, 0);
+  if (result == kComplete)
+  {
+    // replies_ won't grow from now on
+    for (size_t i = 0; i < replies_.size(); ++i)
+    {
+      RedisReply& reply = replies_[i];
+      reply.element = reply.type == RedisReply::kArray && reply.elements > 0
+          ? &replies_[firstElement_[i]] : NULL;
+    }
+    *len = p - data;
+  }
+  return result;
+}
+
+RespParser::Result RespParser::parseReply(const char** p, const char* end,
+                                          size_t index, int depth)
+{
+  if (depth > kMaxDepth)
+  {
+    return kError;
+  }
+  const char* begin = *p;
+  if (begin == end)
+  {
+    return kIncomplete;
+  }
+  const char* cr = static_cast<const char*>(::memchr(begin, '\r', end - begin));
+  if (cr == NULL || cr + 1 == end)
+  {
+    return kIncomplete;
+  }
+  if (cr[1] != '\n')
+  {
+    return kError;
+  }
+  const char* line = begin + 1;
+  const char* next = cr + 2;
+
+  // replies_ may be reallocated by arrays, so it is indexed every time.
+  RedisReply reply;
+  reply.integer = 0;
+  reply.elements = 0;
+  reply.element = NULL;
+  int64_t n = 0;
+  switch (*begin)
+  {
+    case '+':
+    case '-':
+      reply.type = *begin == '+' ? RedisReply::kStatus : RedisReply::kError;
+      reply.str.set(line, static_cast<int>(cr - line));
+      break;
+    case ':':
+      reply.type = RedisReply::kInteger;
+      if (!parseInteger(line, cr, &reply.integer))
+      {
+        return kError;
+      }
+      break;
+    case '$':
+      if (!parseInteger(line, cr, &n))
+      {
+        return kError;
+      }
+      if (n < 0)
+      {
+        reply.type = RedisReply::kNil;
+        break;
+      }
+      if (end - next < n + 2)
+      {
+        return kIncomplete;
+      }
+      if (next[n] != '\r' || next[n+1] != '\n')
+      {
+        return kError;
+      }
+      reply.type = RedisReply::kString;
+      reply.str.set(next, static_cast<int>(n));
+      next += n + 2;
+      break;
+    case '*':
+      if (!parseInteger(line, cr, &n))
+      {
+        return kError;
+      }
+      if (n < 0)
+      {
+        reply.type = RedisReply::kNil;
+        break;
+      }
+      // each element takes 3 bytes at least
+      if (end - next < n * 3)
+      {
+        return kIncomplete;
+      }
+      {
+      reply.type = RedisReply::kArray;
+      reply.elements = static_cast<size_t>(n);
+      const size_t first = replies_.size();
+      replies_[index] = reply;
+      firstElement_[index] = first;
+      replies_.resize(first + reply.elements);
+      firstElement_.resize(first + reply.elements);
+      *p = next;
+      for (size_t i = 0; i < reply.elements; ++i)
+      {
+        Result result = parseReply(p, end, first + i, depth + 1);
+        if (result != kComplete)
+        {
+          return result;
+        }
+      }
+      }
+      return kComplete;
+    default:
+      return kError;
+  }
+  replies_[index] = reply;
+  *p = next;
+  return kComplete;
+}
+
+RedisClient::RedisClient(EventLoop* loop,
+                         const InetAddress& serverAddr,
+                         const string& name)
+  : loop_(loop),
+    client_(loop, serverAddr, name),
+    flushQueued_(false),
+    callbacks_(kInitialCallbacks),
+    head_(0),
+    count_(0)
+{
+  client_.setConnectionCallback(
+      std::bind(&RedisClient::onConnection, this, _1));
+  client_.setMessageCallback(
+      std::bind(&RedisClient::onMessage, this, _1, _2, _3));
+}
+
+RedisClient::~RedisClient()
+{
+  LOG_DEBUG << this << " " << count_ << " commands pending";
+}
+
+void RedisClient::connect()
+{
+  client_.connect();
+}
+
+void RedisClient::disconnect()
+{
+  client_.disconnect();
+}
+
+void RedisClient::command(const ReplyCallback& cb, std::initializer_list<StringPiece> args)
+{
+  addCommand(cb, args.begin(), args.size());
+}
+
+void RedisClient::command(const ReplyCallback& cb, const std::vector<StringPiece>& args)
+{
+  addCommand(cb, args.data(), args.size());
+}
+
+void RedisClient::formatCommand(Buffer* buf, const StringPiece* args, size_t argc)
+{
+  appendHeader(buf, '*', argc);
+  for (size_t i = 0; i < argc; ++i)
+  {
+    appendHeader(buf, '$', args[i].size());
+    buf->append(args[i].data(), args[i].size());
+    buf->append("\r\n", 2);
+  }
+}
+
+void RedisClient::addCommand(const ReplyCallback& cb, const StringPiece* args, size_t argc)
+{
+  loop_->assertInLoopThread();
+  formatCommand(&output_, args, argc);
+  pushCallback(cb);
+  if (!flushQueued_ && connected())
+  {
+    // runs after the events of this iteration, commands issued by
+    // them go in one write.
+    flushQueued_ = true;
+    loop_->queueInLoop(std::bind(&RedisClient::flush, this));
+  }
+}
+
+void RedisClient::flush()
+{
+  flushQueued_ = false;
+  if (connected() && output_.readableBytes() > 0)
+  {
+    conn_->send(&output_);
+  }
+}
+
+void RedisClient::pushCallback(const ReplyCallback& cb)
+{
+  if (count_ == callbacks_.size())
+  {
+    std::vector<ReplyCallback> bigger(callbacks_.size() * 2);
+    for (size_t i = 0; i < count_; ++i)
+    {
+      bigger[i].swap(callbacks_[(head_ + i) % callbacks_.size()]);
+    }
+    callbacks_.swap(bigger);
+    head_ = 0;
+  }
+  callbacks_[(head_ + count_) % callbacks_.size()] = cb;
+  ++count_;
+}
+
+void RedisClient::onConnection(const TcpConnectionPtr& conn)
+{
+  LOG_INFO << "RedisClient " << conn->peerAddress().toIpPort() << " is "
+           << (conn->connected() ? "UP" : "DOWN");
+  if (conn->connected())
+  {
+    conn->setTcpNoDelay(true);
+    conn_ = conn;
+    flush();
+  }
+  else
+  {
+    conn_.reset();
+    output_.retrieveAll();
+    failAll();
+  }
+  if (connectionCb_)
+  {
+    connectionCb_(this, conn->connected());
+  }
+}
+
+void RedisClient::onMessage(const TcpConnectionPtr& conn,
+                            Buffer* buf,
+                            Timestamp)
+{
+  while (count_ > 0)
+  {
+    size_t len = 0;
+    RespParser::Result result = parser_.parse(buf->peek(), buf->readableBytes(), &len);
+    if (result == RespParser::kIncomplete)
+    {
+      return;
+    }
+    if (result == RespParser::kError)
+    {
+      LOG_ERROR << "RedisClient::onMessage - invalid reply from "
+                << conn->peerAddress().toIpPort();
+      conn->forceClose();
+      return;
+    }
+    ReplyCallback cb;
+    cb.swap(callbacks_[head_]);
+    head_ = (head_ + 1) % callbacks_.size();
+    --count_;
+    if (cb)
+    {
+      cb(this, &parser_.reply());
+    }
+    buf->retrieve(len);
+  }
+  if (buf->readableBytes() > 0)
+  {
+    LOG_ERROR << "RedisClient::onMessage - unexpected reply from "
+              << conn->peerAddress().toIpPort();
+    conn->forceClose();
+  }
+}
+
+void RedisClient::failAll()
+{
+  // callbacks may issue commands for the next connection
+  size_t n = count_;
+  while (n-- > 0)
+  {
+    ReplyCallback cb;
+    cb.swap(callbacks_[head_]);
+    head_ = (head_ + 1) % callbacks_.size();
+    --count_;
+    if (cb)
+    {
+      cb(this, NULL);
+    }
+  }
+}
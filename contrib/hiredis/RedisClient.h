@@ -0,0 +1,125 @@
+#ifndef MUDUO_CONTRIB_HIREDIS_REDISCLIENT_H
+#define MUDUO_CONTRIB_HIREDIS_REDISCLIENT_H
+
+#include <muduo/base/StringPiece.h>
+#include <muduo/base/Types.h>
+#include <muduo/net/Buffer.h>
+#include <muduo/net/TcpClient.h>
+
+#include <initializer_list>
+#include <vector>
+
+namespace hiredis
+{
+
+// A RESP reply, pointing into the input buffer of RedisClient,
+// valid only during the reply callback.
+struct RedisReply
+{
+  enum Type
+  {
+    kString,   // bulk string
+    kArray,
+    kInteger,
+    kNil,
+    kStatus,   // simple string, eg. OK
+    kError,
+  };
+
+  Type type;
+  int64_t integer;         // kInteger
+  muduo::StringPiece str;  // kString, kStatus and kError
+  size_t elements;         // kArray
+  const RedisReply* element;
+
+  muduo::string toString() const;
+};
+
+// Parses RESP2 replies in place, without copying strings.
+class RespParser : muduo::noncopyable
+{
+ public:
+  enum Result
+  {
+    kComplete,
+    kIncomplete,
+    kError,
+  };
+
+  // parses the reply at the beginning of data, *len is set to its
+  // length if complete.  reply() is valid until the next parse().
+  Result parse(const char* data, size_t size, size_t* len);
+
+  const RedisReply& reply() const { return replies_[0]; }
+
+ private:
+  Result parseReply(const char** p, const char* end, size_t index, int depth);
+
+  // replies_[0] is the top level one, and elements of arrays follow,
+  // reused by later replies.
+  std::vector<RedisReply> replies_;
+  std::vector<size_t> firstElement_;
+};
+
+// Redis client talking RESP over a TcpConnection, in place of Hiredis.
+//
+// Commands issued in one loop iteration are sent by one write, replies
+// are parsed straight from the input buffer, and callbacks are kept in
+// a ring reused by later commands.  Not thread safe, call in the loop
+// thread only.
+class RedisClient : muduo::noncopyable
+{
+ public:
+  typedef std::function<void(RedisClient*, bool)> ConnectionCallback;
+  // reply is NULL if the connection is lost before the reply arrives.
+  typedef std::function<void(RedisClient*, const RedisReply*)> ReplyCallback;
+
+  RedisClient(muduo::net::EventLoop* loop,
+              const muduo::net::InetAddress& serverAddr,
+              const muduo::string& name);
+  ~RedisClient();
+
+  void setConnectionCallback(const ConnectionCallback& cb) { connectionCb_ = cb; }
+
+  void connect();
+  void disconnect();
+  bool connected() const { return conn_ && conn_->connected(); }
+
+  // eg. command(cb, {"SET", key, value}).  Commands issued before connected
+  // are sent once connected.
+  void command(const ReplyCallback& cb, std::initializer_list<muduo::StringPiece> args);
+  void command(const ReplyCallback& cb, const std::vector<muduo::StringPiece>& args);
+
+  // commands waiting for replies
+  size_t pendingCommands() const { return count_; }
+
+  // appends a command as a RESP array of bulk strings
+  static void formatCommand(muduo::net::Buffer* buf,
+                            const muduo::StringPiece* args, size_t argc);
+
+ private:
+  void onConnection(const muduo::net::TcpConnectionPtr& conn);
+  void onMessage(const muduo::net::TcpConnectionPtr& conn,
+                 muduo::net::Buffer* buf,
+                 muduo::Timestamp receiveTime);
+  void addCommand(const ReplyCallback& cb, const muduo::StringPiece* args, size_t argc);
+  void flush();
+  void pushCallback(const ReplyCallback& cb);
+  void failAll();
+
+  muduo::net::EventLoop* loop_;
+  muduo::net::TcpClient client_;
+  muduo::net::TcpConnectionPtr conn_;
+  ConnectionCallback connectionCb_;
+  RespParser parser_;
+  muduo::net::Buffer output_;  // commands of this loop iteration
+  bool flushQueued_;
+  // ring of callbacks, in the order of commands
+  std::vector<ReplyCallback> callbacks_;
+  size_t head_;
+  size_t count_;
+};
+
+}  // namespace hiredis
+
+#endif  // MUDUO_CONTRIB_HIREDIS_REDISCLIENT_H
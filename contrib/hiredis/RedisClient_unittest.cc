@@ -0,0 +1,100 @@
+#include "RedisClient.h"
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using muduo::string;
+using muduo::StringPiece;
+using muduo::net::Buffer;
+using hiredis::RedisReply;
+using hiredis::RespParser;
+
+namespace
+{
+
+RespParser::Result parseAll(RespParser* parser, const string& data, size_t* len)
+{
+  // every prefix is incomplete
+  for (size_t i = 0; i < data.size(); ++i)
+  {
+    size_t n = 0;
+    RespParser::Result result = parser->parse(data.data(), i, &n);
+    if (result != RespParser::kIncomplete)
+    {
+      return result;
+    }
+  }
+  return parser->parse(data.data(), data.size(), len);
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testParseSimple)
+{
+  RespParser parser;
+  size_t len = 0;
+
+  const string status("+OK\r\n");
+  BOOST_CHECK_EQUAL(parseAll(&parser, status, &len), RespParser::kComplete);
+  BOOST_CHECK_EQUAL(len, 5u);
+  BOOST_CHECK_EQUAL(parser.reply().type, RedisReply::kStatus);
+  BOOST_CHECK_EQUAL(parser.reply().str.as_string(), "OK");
+
+  const string error("-ERR unknown\r\n");
+  BOOST_CHECK_EQUAL(parseAll(&parser, error, &len), RespParser::kComplete);
+  BOOST_CHECK_EQUAL(parser.reply().type, RedisReply::kError);
+  BOOST_CHECK_EQUAL(parser.reply().str.as_string(), "ERR unknown");
+
+  BOOST_CHECK_EQUAL(parseAll(&parser, ":-1234\r\n", &len), RespParser::kComplete);
+  BOOST_CHECK_EQUAL(parser.reply().type, RedisReply::kInteger);
+  BOOST_CHECK_EQUAL(parser.reply().integer, -1234);
+
+  BOOST_CHECK_EQUAL(parseAll(&parser, "$-1\r\n", &len), RespParser::kComplete);
+  BOOST_CHECK_EQUAL(parser.reply().type, RedisReply::kNil);
+
+  const string bulk("$7\r\nfoo\r\nba\r\n+OK\r\n");
+  BOOST_CHECK_EQUAL(parser.parse(bulk.data(), bulk.size(), &len), RespParser::kComplete);
+  BOOST_CHECK_EQUAL(len, 13u);
+  BOOST_CHECK_EQUAL(parser.reply().type, RedisReply::kString);
+  BOOST_CHECK_EQUAL(parser.reply().str.as_string(), "foo\r\nba");
+  // points into the input
+  BOOST_CHECK(parser.reply().str.data() == bulk.data() + 4);
+}
+
+BOOST_AUTO_TEST_CASE(testParseArray)
+{
+  RespParser parser;
+  size_t len = 0;
+  const string data("*3\r\n$3\r\nfoo\r\n*2\r\n:1\r\n$-1\r\n*0\r\n");
+  BOOST_CHECK_EQUAL(parseAll(&parser, data, &len), RespParser::kComplete);
+  BOOST_CHECK_EQUAL(len, data.size());
+  const RedisReply& reply = parser.reply();
+  BOOST_CHECK_EQUAL(reply.type, RedisReply::kArray);
+  BOOST_REQUIRE_EQUAL(reply.elements, 3u);
+  BOOST_CHECK_EQUAL(reply.element[0].str.as_string(), "foo");
+  BOOST_REQUIRE_EQUAL(reply.element[1].elements, 2u);
+  BOOST_CHECK_EQUAL(reply.element[1].element[0].integer, 1);
+  BOOST_CHECK_EQUAL(reply.element[1].element[1].type, RedisReply::kNil);
+  BOOST_CHECK_EQUAL(reply.element[2].type, RedisReply::kArray);
+  BOOST_CHECK_EQUAL(reply.element[2].elements, 0u);
+  BOOST_CHECK_EQUAL(reply.toString(), "ARRAY [STRING \"foo\", ARRAY [INTEGER 1, NIL], ARRAY []]");
+}
+
+BOOST_AUTO_TEST_CASE(testParseError)
+{
+  RespParser parser;
+  size_t len = 0;
+  BOOST_CHECK_EQUAL(parseAll(&parser, "?\r\n", &len), RespParser::kError);
+  BOOST_CHECK_EQUAL(parseAll(&parser, ":12a\r\n", &len), RespParser::kError);
+  BOOST_CHECK_EQUAL(parseAll(&parser, "$3\r\nfoobar\r\n", &len), RespParser::kError);
+  BOOST_CHECK_EQUAL(parseAll(&parser, "+OK\rX", &len), RespParser::kError);
+}
+
+BOOST_AUTO_TEST_CASE(testFormatCommand)
+{
+  Buffer buf;
+  StringPiece args[] = { "SET", "key", "" };
+  hiredis::RedisClient::formatCommand(&buf, args, 3);
+  BOOST_CHECK_EQUAL(buf.retrieveAllAsString(), "*3\r\n$3\r\nSET\r\n$3\r\nkey\r\n$0\r\n\r\n");
+}
@@ -0,0 +1,97 @@
+#include "RedisClient.h"
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// keeps `pipeline` SET commands in flight, until `total` are done
+class Bench : noncopyable
+{
+ public:
+  Bench(EventLoop* loop, const InetAddress& serverAddr, int pipeline, int total)
+    : loop_(loop),
+      redis_(loop, serverAddr, "mredisbench"),
+      pipeline_(pipeline),
+      total_(total),
+      sent_(0),
+      received_(0),
+      errors_(0)
+  {
+    redis_.setConnectionCallback(std::bind(&Bench::onConnection, this, _1, _2));
+    redis_.connect();
+  }
+
+ private:
+  void onConnection(hiredis::RedisClient*, bool up)
+  {
+    if (up)
+    {
+      start_ = Timestamp::now();
+      for (int i = 0; i < pipeline_; ++i)
+      {
+        send();
+      }
+    }
+    else
+    {
+      loop_->quit();
+    }
+  }
+
+  void send()
+  {
+    char key[32];
+    snprintf(key, sizeof key, "key:%d", sent_ % 1000);
+    ++sent_;
+    redis_.command(std::bind(&Bench::onReply, this, _2), {"SET", key, "value"});
+  }
+
+  void onReply(const hiredis::RedisReply* reply)
+  {
+    if (!reply || reply->type == hiredis::RedisReply::kError)
+    {
+      ++errors_;
+    }
+    if (++received_ == total_)
+    {
+      double seconds = timeDifference(Timestamp::now(), start_);
+      printf("%d commands in %.3f seconds, %.1f commands per second, %d errors\n",
+             total_, seconds, total_ / seconds, errors_);
+      redis_.disconnect();
+    }
+    else if (sent_ < total_)
+    {
+      send();
+    }
+  }
+
+  EventLoop* loop_;
+  hiredis::RedisClient redis_;
+  const int pipeline_;
+  const int total_;
+  int sent_;
+  int received_;
+  int errors_;
+  Timestamp start_;
+};
+
+int main(int argc, char* argv[])
+{
+  if (argc < 3)
+  {
+    printf("Usage: %s host port [pipeline [commands]]\n", argv[0]);
+    return 0;
+  }
+  Logger::setLogLevel(Logger::WARN);
+  EventLoop loop;
+  InetAddress serverAddr(argv[1], static_cast<uint16_t>(atoi(argv[2])));
+  int pipeline = argc > 3 ? atoi(argv[3]) : 100;
+  int commands = argc > 4 ? atoi(argv[4]) : 1000 * 1000;
+  Bench bench(&loop, serverAddr, pipeline, commands);
+  loop.loop();
+}
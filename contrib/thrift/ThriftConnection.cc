@@ -3,34 +3,98 @@
 #include <boost/bind.hpp>
 
 #include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
 
 #include <thrift/transport/TTransportException.h>
+#include <thrift/transport/TVirtualTransport.h>
 
 #include "ThriftServer.h"
 
 using namespace muduo;
 using namespace muduo::net;
 
+namespace
+{
+
+const size_t kMaxFreeContexts = 16;
+
+// writes responses straight into a muduo Buffer, leaving room for the frame size
+class BufferTransport
+  : public apache::thrift::transport::TVirtualTransport<BufferTransport>
+{
+ public:
+  explicit BufferTransport(Buffer* buffer)
+    : buffer_(buffer)
+  {
+  }
+
+  void write(const uint8_t* buf, uint32_t len)
+  {
+    buffer_->append(buf, len);
+  }
+
+ private:
+  Buffer* buffer_;
+};
+
+}  // namespace
+
+struct ThriftConnection::Context
+{
+  int64_t seq;
+  bool reusable;
+  std::string input;  // the frame, if processed in a worker thread
+  Buffer output;
+
+  boost::shared_ptr<TMemoryBuffer> inputTransport;
+  boost::shared_ptr<BufferTransport> outputTransport;
+
+  boost::shared_ptr<TTransport> factoryInputTransport;
+  boost::shared_ptr<TTransport> factoryOutputTransport;
+
+  boost::shared_ptr<TProtocol> inputProtocol;
+  boost::shared_ptr<TProtocol> outputProtocol;
+
+  boost::shared_ptr<TProcessor> processor;
+};
+
 ThriftConnection::ThriftConnection(ThriftServer* server,
                                   const TcpConnectionPtr& conn)
   : server_(server),
     conn_(conn),
+    nextSeq_(0),
+    nextSendSeq_(0),
     state_(kExpectFrameSize),
     frameSize_(0)
 {
   conn_->setMessageCallback(boost::bind(&ThriftConnection::onMessage,
                                         this, _1, _2, _3));
   nullTransport_.reset(new TNullTransport());
-  inputTransport_.reset(new TMemoryBuffer(NULL, 0));
-  outputTransport_.reset(new TMemoryBuffer());
+}
+
+ThriftConnection::ContextPtr ThriftConnection::acquireContext()
+{
+  if (!freeContexts_.empty())
+  {
+    ContextPtr ctx(freeContexts_.back());
+    freeContexts_.pop_back();
+    return ctx;
+  }
 
-  factoryInputTransport_ = server_->getInputTransportFactory()->getTransport(inputTransport_);
-  factoryOutputTransport_ = server_->getOutputTransportFactory()->getTransport(outputTransport_);
+  ContextPtr ctx(new Context);
+  ctx->seq = 0;
+  ctx->reusable = true;
+  ctx->inputTransport.reset(new TMemoryBuffer(NULL, 0));
+  ctx->outputTransport.reset(new BufferTransport(&ctx->output));
 
-  inputProtocol_ = server_->getInputProtocolFactory()->getProtocol(factoryInputTransport_);
-  outputProtocol_ = server_->getOutputProtocolFactory()->getProtocol(factoryOutputTransport_);
+  ctx->factoryInputTransport = server_->getInputTransportFactory()->getTransport(ctx->inputTransport);
+  ctx->factoryOutputTransport = server_->getOutputTransportFactory()->getTransport(ctx->outputTransport);
 
-  processor_ = server_->getProcessor(inputProtocol_, outputProtocol_, nullTransport_);
+  ctx->inputProtocol = server_->getInputProtocolFactory()->getProtocol(ctx->factoryInputTransport);
+  ctx->outputProtocol = server_->getOutputProtocolFactory()->getProtocol(ctx->factoryOutputTransport);
+
+  ctx->processor = server_->getProcessor(ctx->inputProtocol, ctx->outputProtocol, nullTransport_);
+  return ctx;
 }
 
 void ThriftConnection::onMessage(const TcpConnectionPtr& conn,
@@ -56,20 +120,24 @@ void ThriftConnection::onMessage(const TcpConnectionPtr& conn,
     {
       if (buffer->readableBytes() >= frameSize_)
       {
-        uint8_t* buf = reinterpret_cast<uint8_t*>((const_cast<char*>(buffer->peek())));
-
-        inputTransport_->resetBuffer(buf, frameSize_, TMemoryBuffer::COPY);
-        outputTransport_->resetBuffer();
-        outputTransport_->getWritePtr(4);
-        outputTransport_->wroteBytes(4);
+        ContextPtr ctx(acquireContext());
+        ctx->seq = nextSeq_++;
 
         if (server_->isWorkerThreadPoolProcessing())
         {
-          server_->workerThreadPool().run(boost::bind(&ThriftConnection::process, this));
+          // buffer is reused before the worker runs
+          ctx->input.assign(buffer->peek(), frameSize_);
+          ctx->inputTransport->resetBuffer(
+              reinterpret_cast<uint8_t*>(&ctx->input[0]), frameSize_);
+          server_->workerThreadPool().run(
+              boost::bind(&ThriftConnection::process, shared_from_this(), ctx));
         }
         else
         {
-          process();
+          // done before buffer is retrieved, no copying
+          uint8_t* buf = reinterpret_cast<uint8_t*>((const_cast<char*>(buffer->peek())));
+          ctx->inputTransport->resetBuffer(buf, frameSize_);
+          process(ctx);
         }
 
         buffer->retrieve(frameSize_);
@@ -83,39 +151,73 @@ void ThriftConnection::onMessage(const TcpConnectionPtr& conn,
   }
 }
 
-void ThriftConnection::process()
+void ThriftConnection::process(const ContextPtr& ctx)
 {
+  ctx->output.retrieveAll();
   try
   {
-    processor_->process(inputProtocol_, outputProtocol_, NULL);
-
-    uint8_t* buf;
-    uint32_t size;
-    outputTransport_->getBuffer(&buf, &size);
-
-    assert(size >= 4);
-    uint32_t frameSize = static_cast<uint32_t>(htonl(size - 4));
-    memcpy(buf, &frameSize, 4);
-
-    conn_->send(buf, size);
+    ctx->processor->process(ctx->inputProtocol, ctx->outputProtocol, NULL);
   } catch (const TTransportException& ex)
   {
     LOG_ERROR << "ThriftServer TTransportException: " << ex.what();
-    close();
+    close(ctx);
   } catch (const std::exception& ex)
   {
     LOG_ERROR << "ThriftServer std::exception: " << ex.what();
-    close();
+    close(ctx);
   } catch (...)
   {
     LOG_ERROR << "ThriftServer unknown exception";
-    close();
+    close(ctx);
+  }
+
+  // oneway calls have no response
+  if (ctx->output.readableBytes() > 0)
+  {
+    ctx->output.prependInt32(static_cast<int32_t>(ctx->output.readableBytes()));
+  }
+  conn_->getLoop()->runInLoop(
+      boost::bind(&ThriftConnection::onProcessed, shared_from_this(), ctx));
+}
+
+void ThriftConnection::onProcessed(const ContextPtr& ctx)
+{
+  conn_->getLoop()->assertInLoopThread();
+  if (server_->isOutOfOrderResponses())
+  {
+    sendResponse(ctx);
+    return;
+  }
+
+  // responses go in the order of requests
+  completed_[ctx->seq] = ctx;
+  std::map<int64_t, ContextPtr>::iterator it = completed_.begin();
+  while (it != completed_.end() && it->first == nextSendSeq_)
+  {
+    sendResponse(it->second);
+    completed_.erase(it++);
+    ++nextSendSeq_;
+  }
+}
+
+void ThriftConnection::sendResponse(const ContextPtr& ctx)
+{
+  if (ctx->output.readableBytes() > 0)
+  {
+    conn_->send(&ctx->output);
+  }
+  ctx->input.clear();
+  if (ctx->reusable && freeContexts_.size() < kMaxFreeContexts)
+  {
+    freeContexts_.push_back(ctx);
   }
 }
 
-void ThriftConnection::close()
+void ThriftConnection::close(const ContextPtr& ctx)
 {
+  ctx->reusable = false;
+  ctx->output.retrieveAll();
   nullTransport_->close();
-  factoryInputTransport_->close();
-  factoryOutputTransport_->close();
+  ctx->factoryInputTransport->close();
+  ctx->factoryOutputTransport->close();
 }
@@ -1,6 +1,9 @@
 #ifndef MUDUO_CONTRIB_THRIFT_THRIFTCONNECTION_H
 #define MUDUO_CONTRIB_THRIFT_THRIFTCONNECTION_H
 
+#include <map>
+#include <vector>
+
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/noncopyable.hpp>
 
@@ -32,13 +35,22 @@ class ThriftConnection : boost::noncopyable,
   ThriftConnection(ThriftServer* server, const muduo::net::TcpConnectionPtr& conn);
 
  private:
+  // transports, protocols and processor of one request in flight,
+  // reused by later requests of the connection.
+  struct Context;
+  typedef boost::shared_ptr<Context> ContextPtr;
+
   void onMessage(const muduo::net::TcpConnectionPtr& conn,
                  muduo::net::Buffer* buffer,
                  muduo::Timestamp receiveTime);
 
-  void process();
+  ContextPtr acquireContext();
+  // in the IO thread, or a thread of ThriftServer::workerThreadPool()
+  void process(const ContextPtr& ctx);
+  void onProcessed(const ContextPtr& ctx);
+  void sendResponse(const ContextPtr& ctx);
 
-  void close();
+  void close(const ContextPtr& ctx);
 
  private:
   ThriftServer* server_;
@@ -46,16 +58,12 @@ class ThriftConnection : boost::noncopyable,
 
   boost::shared_ptr<TNullTransport> nullTransport_;
 
-  boost::shared_ptr<TMemoryBuffer> inputTransport_;
-  boost::shared_ptr<TMemoryBuffer> outputTransport_;
-
-  boost::shared_ptr<TTransport> factoryInputTransport_;
-  boost::shared_ptr<TTransport> factoryOutputTransport_;
-
-  boost::shared_ptr<TProtocol> inputProtocol_;
-  boost::shared_ptr<TProtocol> outputProtocol_;
-
-  boost::shared_ptr<TProcessor> processor_;
+  // accessed in the IO thread only
+  std::vector<ContextPtr> freeContexts_;
+  // processed, waiting for responses of earlier requests
+  std::map<int64_t, ContextPtr> completed_;
+  int64_t nextSeq_;
+  int64_t nextSendSeq_;
 
   enum State state_;
   uint32_t frameSize_;
@@ -32,6 +32,7 @@ class ThriftServer : boost::noncopyable,
     : TServer(processorFactory),
       server_(eventloop, addr, name),
       numWorkerThreads_(0),
+      outOfOrderResponses_(false),
       workerThreadPool_(name + muduo::string("WorkerThreadPool"))
   {
     server_.setConnectionCallback(boost::bind(&ThriftServer::onConnection,
@@ -47,6 +48,7 @@ class ThriftServer : boost::noncopyable,
     : TServer(processor),
       server_(eventloop, addr, name),
       numWorkerThreads_(0),
+      outOfOrderResponses_(false),
       workerThreadPool_(name + muduo::string("WorkerThreadPool"))
   {
     server_.setConnectionCallback(boost::bind(&ThriftServer::onConnection,
@@ -63,6 +65,7 @@ class ThriftServer : boost::noncopyable,
     : TServer(processorFactory),
       server_(eventloop, addr, name),
       numWorkerThreads_(0),
+      outOfOrderResponses_(false),
       workerThreadPool_(name + muduo::string("WorkerThreadPool"))
   {
     server_.setConnectionCallback(boost::bind(&ThriftServer::onConnection,
@@ -81,6 +84,7 @@ class ThriftServer : boost::noncopyable,
     : TServer(processor),
       server_(eventloop, addr, name),
       numWorkerThreads_(0),
+      outOfOrderResponses_(false),
       workerThreadPool_(name + muduo::string("WorkerThreadPool"))
   {
     server_.setConnectionCallback(boost::bind(&ThriftServer::onConnection,
@@ -100,6 +104,7 @@ class ThriftServer : boost::noncopyable,
     : TServer(processorFactory),
       server_(eventloop, addr, name),
       numWorkerThreads_(0),
+      outOfOrderResponses_(false),
       workerThreadPool_(name + muduo::string("WorkerThreadPool"))
   {
     server_.setConnectionCallback(boost::bind(&ThriftServer::onConnection,
@@ -121,6 +126,7 @@ class ThriftServer : boost::noncopyable,
     : TServer(processor),
       server_(eventloop, addr, name),
       numWorkerThreads_(0),
+      outOfOrderResponses_(false),
       workerThreadPool_(name + muduo::string("WorkerThreadPool"))
   {
     server_.setConnectionCallback(boost::bind(&ThriftServer::onConnection,
@@ -144,6 +150,7 @@ class ThriftServer : boost::noncopyable,
     : TServer(processorFactory),
       server_(eventloop, addr, name),
       numWorkerThreads_(0),
+      outOfOrderResponses_(false),
       workerThreadPool_(name + muduo::string("WorkerThreadPool"))
   {
     server_.setConnectionCallback(boost::bind(&ThriftServer::onConnection,
@@ -167,6 +174,7 @@ class ThriftServer : boost::noncopyable,
     : TServer(processor),
       server_(eventloop, addr, name),
       numWorkerThreads_(0),
+      outOfOrderResponses_(false),
       workerThreadPool_(name + muduo::string("WorkerThreadPool"))
   {
     server_.setConnectionCallback(boost::bind(&ThriftServer::onConnection,
@@ -206,6 +214,19 @@ class ThriftServer : boost::noncopyable,
     numWorkerThreads_ = numWorkerThreads;
   }
 
+  bool isOutOfOrderResponses() const
+  {
+    return outOfOrderResponses_;
+  }
+
+  // With worker threads, pipelined requests of a connection run in
+  // parallel, but their responses are sent in the order of requests.
+  // Clients matching responses by seqid may take them as they are done.
+  void setOutOfOrderResponses(bool on)
+  {
+    outOfOrderResponses_ = on;
+  }
+
  private:
   friend class ThriftConnection;
 
@@ -214,6 +235,7 @@ class ThriftServer : boost::noncopyable,
  private:
   muduo::net::TcpServer server_;
   int numWorkerThreads_;
+  bool outOfOrderResponses_;
   muduo::ThreadPool workerThreadPool_;
   muduo::MutexLock mutex_;
   std::map<muduo::string, ThriftConnectionPtr> conns_;
@@ -5,7 +5,6 @@
 #include <muduo/net/EventLoop.h>
 #include <muduo/net/TcpServer.h>
 
-#include <set>
 #include <stdio.h>
 #include <unistd.h>
 
@@ -40,42 +39,30 @@ public:
 
 private:
 
-	// 
-	// conn
 	void onConnection(const TcpConnectionPtr& conn)
 	{
 		LOG_INFO << conn->localAddress().toIpPort() << " -> "
 			<< conn->peerAddress().toIpPort() << " is "
 			<< (conn->connected() ? "UP" : "DOWN");
-
-		if (conn->connected())
-		{
-			connections_.insert(conn);
-		}
-		else
-		{
-			connections_.erase(conn);
-		}
 	}
 
 	// յϢ
-	// ֱӹ㲥,connections_
+	// ֱӹ㲥,server_ӷ
+	// single-threaded, so it's in the loop of server_
 	void onStringMessage(const TcpConnectionPtr&,
 		const string& message,
 		Timestamp)
 	{
-		for (ConnectionList::iterator it = connections_.begin();
-			it != connections_.end();
-			++it)
-		{
-			codec_.send(get_pointer(*it), message);
-		}
+		server_.forEachConnection([this, &message](const TcpConnectionPtr& conn) {
+			if (conn->connected())
+			{
+				codec_.send(conn, message);
+			}
+		});
 	}
 
-	typedef std::set<TcpConnectionPtr> ConnectionList;
 	TcpServer server_;
 	LengthHeaderCodec codec_; // ,ڼӹϢ
-	ConnectionList connections_; // ,ڹ㲥
 };
 
 int main(int argc, char* argv[])
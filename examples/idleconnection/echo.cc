@@ -41,6 +41,8 @@ void EchoServer::onConnection(const TcpConnectionPtr& conn)
 
   if (conn->connected())
   {
+    // onMessage() consumes all input, no need for a buffer per connection
+    conn->setSharedInputBuffer(true);
     // ʱ, һconnshared_ptr
     EntryPtr entry(new Entry(conn));
     // ҷڵǰβͰ
@@ -54,6 +54,11 @@ class QueryServer : noncopyable
     LOG_INFO << conn->localAddress().toIpPort() << " -> "
         << conn->peerAddress().toIpPort() << " is "
         << (conn->connected() ? "UP" : "DOWN");
+    if (conn->connected())
+    {
+      // answers to several queries read at once go out in one write
+      conn->setDeferredFlush(true);
+    }
   }
 
 	// dispatcher_, ַϢص
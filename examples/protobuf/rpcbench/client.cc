@@ -1,6 +1,7 @@
 #include <examples/protobuf/rpcbench/echo.pb.h>
 
 #include <muduo/base/CountDownLatch.h>
+#include <muduo/base/Histogram.h>
 #include <muduo/base/Logging.h>
 #include <muduo/net/EventLoop.h>
 #include <muduo/net/EventLoopThreadPool.h>
@@ -10,12 +11,15 @@
 #include <muduo/net/protorpc/RpcChannel.h>
 
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 using namespace muduo;
 using namespace muduo::net;
 
-static const int kRequests = 50000;
+static const int kMaxRequests = 50000;
+// large payloads make fewer calls, about 1GiB per client
+static const int64_t kMaxBytes = 1024 * 1024 * 1024;
 
 class RpcClient : noncopyable
 {
@@ -24,22 +28,33 @@ class RpcClient : noncopyable
   RpcClient(EventLoop* loop,
             const InetAddress& serverAddr,
             CountDownLatch* allConnected,
-            CountDownLatch* allFinished)
+            CountDownLatch* allFinished,
+            Histogram* latencies,
+            const string& payload,
+            bool crc32c)
     : // loop_(loop),
       client_(loop, serverAddr, "RpcClient"),
       channel_(new RpcChannel),
       stub_(get_pointer(channel_)),
       allConnected_(allConnected),
       allFinished_(allFinished),
+      latencies_(latencies),
+      payload_(payload),
+      requests_(static_cast<int>(std::min<int64_t>(kMaxRequests,
+                                                   kMaxBytes / (payload.size() + 1) + 1))),
       count_(0)
   {
     client_.setConnectionCallback(
         std::bind(&RpcClient::onConnection, this, _1));
     client_.setMessageCallback(
         std::bind(&RpcChannel::onMessage, get_pointer(channel_), _1, _2, _3));
+    channel_->setRawPayload(true);
+    channel_->setCrc32c(crc32c);
     // client_.enableRetry();
   }
 
+  int requests() const { return requests_; }
+
   void connect()
   {
     client_.connect();
@@ -48,8 +63,9 @@ class RpcClient : noncopyable
   void sendRequest()
   {
     echo::EchoRequest request;
-    request.set_payload("001010");
+    request.set_payload(payload_);
     echo::EchoResponse* response = new echo::EchoResponse;
+    sendTime_ = Timestamp::now();
     stub_.Echo(NULL, &request, response, NewCallback(this, &RpcClient::replied, response));
   }
 
@@ -69,8 +85,10 @@ class RpcClient : noncopyable
   {
     // LOG_INFO << "replied:\n" << resp->DebugString();
     // loop_->quit();
+    latencies_->record(Timestamp::now().microSecondsSinceEpoch()
+                       - sendTime_.microSecondsSinceEpoch());
     ++count_;
-    if (count_ < kRequests)
+    if (count_ < requests_)
     {
       sendRequest();
     }
@@ -87,6 +105,10 @@ class RpcClient : noncopyable
   echo::EchoService::Stub stub_;
   CountDownLatch* allConnected_;
   CountDownLatch* allFinished_;
+  Histogram* latencies_;  // shared by all clients
+  const string& payload_;
+  Timestamp sendTime_;
+  const int requests_;
   int count_;
 };
 
@@ -109,8 +131,19 @@ int main(int argc, char* argv[])
       nThreads = atoi(argv[3]);
     }
 
+    size_t payloadBytes = 6;
+
+    if (argc > 4)
+    {
+      payloadBytes = atoi(argv[4]);
+    }
+
+    bool crc32c = !(argc > 5 && strcmp(argv[5], "adler32") == 0);
+    string payload(payloadBytes, '0');
+
     CountDownLatch allConnected(nClients);
     CountDownLatch allFinished(nClients);
+    Histogram latencies;
 
     EventLoop loop;
     EventLoopThreadPool pool(&loop, "rpcbench-client");
@@ -121,7 +154,8 @@ int main(int argc, char* argv[])
     std::vector<std::unique_ptr<RpcClient>> clients;
     for (int i = 0; i < nClients; ++i)
     {
-      clients.emplace_back(new RpcClient(pool.getNextLoop(), serverAddr, &allConnected, &allFinished));
+      clients.emplace_back(new RpcClient(pool.getNextLoop(), serverAddr, &allConnected, &allFinished,
+                                         &latencies, payload, crc32c));
       clients.back()->connect();
     }
     allConnected.wait();
@@ -135,14 +169,18 @@ int main(int argc, char* argv[])
     Timestamp end(Timestamp::now());
     LOG_INFO << "all finished";
     double seconds = timeDifference(end, start);
+    const int64_t calls = static_cast<int64_t>(nClients) * clients[0]->requests();
     printf("%f seconds\n", seconds);
-    printf("%.1f calls per second\n", nClients * kRequests / seconds);
+    printf("%.1f calls per second\n", static_cast<double>(calls) / seconds);
+    printf("%.1f MiB per second each way\n",
+           static_cast<double>(calls) * static_cast<double>(payloadBytes) / seconds / 1024 / 1024);
+    printf("latency us: %s\n", latencies.snapshot().toString().c_str());
 
     exit(0);
   }
   else
   {
-    printf("Usage: %s host_ip numClients [numThreads]\n", argv[0]);
+    printf("Usage: %s host_ip numClients [numThreads [payloadBytes [crc32c|adler32]]]\n", argv[0]);
   }
 }
 
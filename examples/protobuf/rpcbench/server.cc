@@ -1,6 +1,7 @@
 #include <examples/protobuf/rpcbench/echo.pb.h>
 
 #include <muduo/base/Logging.h>
+#include <muduo/base/ThreadPool.h>
 #include <muduo/net/EventLoop.h>
 #include <muduo/net/protorpc/RpcServer.h>
 
@@ -34,10 +35,26 @@ int main(int argc, char* argv[])
   LOG_INFO << "pid = " << getpid() << " threads = " << nThreads;
   EventLoop loop;
   int port = argc > 2 ? atoi(argv[2]) : 8888;
+  int nWorkers = argc > 3 ? atoi(argv[3]) : 0;
+  int nEncoders = argc > 4 ? atoi(argv[4]) : 0;
   InetAddress listenAddr(static_cast<uint16_t>(port));
   echo::EchoServiceImpl impl;
   RpcServer server(&loop, listenAddr);
   server.setThreadNum(nThreads);
+  ThreadPool pool("EchoPool");
+  if (nWorkers > 0)
+  {
+    pool.setMaxQueueSize(65536);
+    pool.start(nWorkers);
+    server.setThreadPool("echo.EchoService", &pool);
+  }
+  ThreadPool encoders("EchoEncoder");
+  if (nEncoders > 0)
+  {
+    encoders.setMaxQueueSize(65536);
+    encoders.start(nEncoders);
+    server.setEncoderPool(&encoders, 64 * 1024);
+  }
   server.registerService(&impl);
   server.start();
   loop.loop();
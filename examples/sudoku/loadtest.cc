@@ -1,18 +1,19 @@
 #include "sudoku.h"
 
+#include <muduo/base/Histogram.h>
 #include <muduo/base/Logging.h>
 #include <muduo/base/FileUtil.h>
 #include <muduo/net/EventLoop.h>
 #include <muduo/net/TcpClient.h>
 
 #include <fstream>
-#include <numeric>
 #include <unordered_map>
 
-#include "percentile.h"
-
+#include <inttypes.h>
 #include <stdio.h>
 
+#include "percentile.h"
+
 using namespace muduo;
 using namespace muduo::net;
 
@@ -40,12 +41,14 @@ class SudokuClient : noncopyable
                const InetAddress& serverAddr,
                const InputPtr& input,
                const string& name,
-               bool nodelay)
+               bool nodelay,
+               muduo::Histogram* latencies)
     : name_(name),
       tcpNoDelay_(nodelay),
       client_(loop, serverAddr, name_),
       input_(input),
-      count_(0)
+      count_(0),
+      latencies_(latencies)
   {
     client_.setConnectionCallback(
         std::bind(&SudokuClient::onConnection, this, _1));
@@ -79,10 +82,8 @@ class SudokuClient : noncopyable
     conn_->send(&requests_);
   }
 
-  void report(std::vector<int>* latency, int* infly)
+  void report(int* infly)
   {
-    latency->insert(latency->end(), latencies_.begin(), latencies_.end());
-    latencies_.clear();
     *infly += static_cast<int>(sendTime_.size());
   }
 
@@ -148,7 +149,7 @@ class SudokuClient : noncopyable
         if (sendTime != sendTime_.end())
         {
           int64_t latency_us = recvTime.microSecondsSinceEpoch() - sendTime->second.microSecondsSinceEpoch();
-          latencies_.push_back(static_cast<int>(latency_us));
+          latencies_->record(latency_us);
           sendTime_.erase(sendTime);
         }
         else
@@ -169,7 +170,7 @@ class SudokuClient : noncopyable
   const InputPtr input_;
   int count_;
   std::unordered_map<int, Timestamp> sendTime_;
-  std::vector<int> latencies_;
+  muduo::Histogram* latencies_;  // shared by all clients
 };
 
 class SudokuLoadtest : noncopyable
@@ -190,7 +191,7 @@ class SudokuLoadtest : noncopyable
     {
       Fmt f("c%04d", i+1);
       string name(f.data(), f.length());
-      clients_.emplace_back(new SudokuClient(&loop, serverAddr, input, name, nodelay));
+      clients_.emplace_back(new SudokuClient(&loop, serverAddr, input, name, nodelay, &latencies_));
       clients_.back()->connect();
     }
 
@@ -217,22 +218,23 @@ class SudokuLoadtest : noncopyable
 
   void tock()
   {
-    std::vector<int> latencies;
     int infly = 0;
     for (const auto& client : clients_)
     {
-      client->report(&latencies, &infly);
+      client->report(&infly);
     }
 
-    Percentile p(latencies, infly);
+    Percentile p(latencies_.snapshot(), infly);
+    latencies_.reset();
     LOG_INFO << p.report();
     char buf[64];
     snprintf(buf, sizeof buf, "r%04d", count_);
-    p.save(latencies, buf);
+    p.save(buf);
     ++count_;
   }
 
   std::vector<std::unique_ptr<SudokuClient>> clients_;
+  muduo::Histogram latencies_;
   int count_;
   int64_t ticks_;
   int64_t sofar_;
@@ -1,18 +1,19 @@
 #include "sudoku.h"
 
+#include <muduo/base/Histogram.h>
 #include <muduo/base/Logging.h>
 #include <muduo/base/FileUtil.h>
 #include <muduo/net/EventLoop.h>
 #include <muduo/net/TcpClient.h>
 
 #include <fstream>
-#include <numeric>
 #include <unordered_map>
 
-#include "percentile.h"
-
+#include <inttypes.h>
 #include <stdio.h>
 
+#include "percentile.h"
+
 using namespace muduo;
 using namespace muduo::net;
 
@@ -27,13 +28,15 @@ class SudokuClient : noncopyable
                const InputPtr& input,
                const string& name,
                int pipelines,
-               bool nodelay)
+               bool nodelay,
+               muduo::Histogram* latencies)
     : name_(name),
       pipelines_(pipelines),
       tcpNoDelay_(nodelay),
       client_(loop, serverAddr, name_),
       input_(input),
-      count_(0)
+      count_(0),
+      latencies_(latencies)
   {
     client_.setConnectionCallback(
         std::bind(&SudokuClient::onConnection, this, _1));
@@ -46,10 +49,8 @@ class SudokuClient : noncopyable
     client_.connect();
   }
 
-  void report(std::vector<int>* latency, int* infly)
+  void report(int* infly)
   {
-    latency->insert(latency->end(), latencies_.begin(), latencies_.end());
-    latencies_.clear();
     *infly += static_cast<int>(sendTime_.size());
   }
 
@@ -138,7 +139,7 @@ class SudokuClient : noncopyable
         if (sendTime != sendTime_.end())
         {
           int64_t latency_us = recvTime.microSecondsSinceEpoch() - sendTime->second.microSecondsSinceEpoch();
-          latencies_.push_back(static_cast<int>(latency_us));
+          latencies_->record(latency_us);
           sendTime_.erase(sendTime);
         }
         else
@@ -159,25 +160,26 @@ class SudokuClient : noncopyable
   const InputPtr input_;
   int count_;
   std::unordered_map<int, Timestamp> sendTime_;
-  std::vector<int> latencies_;
+  muduo::Histogram* latencies_;  // shared by all clients
 };
 
-void report(const std::vector<std::unique_ptr<SudokuClient>>& clients)
+void report(const std::vector<std::unique_ptr<SudokuClient>>& clients,
+            muduo::Histogram* latencies)
 {
   static int count = 0;
 
-  std::vector<int> latencies;
   int infly = 0;
   for (const auto& client : clients)
   {
-    client->report(&latencies, &infly);
+    client->report(&infly);
   }
 
-  Percentile p(latencies, infly);
+  Percentile p(latencies->snapshot(), infly);
+  latencies->reset();
   LOG_INFO << p.report();
   char buf[64];
   snprintf(buf, sizeof buf, "p%04d", count);
-  p.save(latencies, buf);
+  p.save(buf);
   ++count;
 }
 
@@ -202,16 +204,17 @@ void runClient(const InputPtr& input,
                bool nodelay)
 {
   EventLoop loop;
+  muduo::Histogram latencies;
   std::vector<std::unique_ptr<SudokuClient>> clients;
   for (int i = 0; i < conn; ++i)
   {
     Fmt f("c%04d", i+1);
     string name(f.data(), f.length());
-    clients.emplace_back(new SudokuClient(&loop, serverAddr, input, name, pipelines, nodelay));
+    clients.emplace_back(new SudokuClient(&loop, serverAddr, input, name, pipelines, nodelay, &latencies));
     clients.back()->connect();
   }
 
-  loop.runEvery(1.0, std::bind(report, std::ref(clients)));
+  loop.runEvery(1.0, std::bind(report, std::ref(clients), &latencies));
   loop.loop();
 }
 
@@ -1,6 +1,7 @@
 #include "sudoku.h"
 
 #include <muduo/base/Atomic.h>
+#include <muduo/base/Histogram.h>
 #include <muduo/base/Logging.h>
 #include <muduo/base/Thread.h>
 #include <muduo/base/ThreadPool.h>
@@ -50,6 +51,8 @@ class SudokuServer : noncopyable
                    "statistics of sudoku solver");
     inspector_.add("sudoku", "reset", std::bind(&SudokuStat::reset, &stat_),
                    "reset statistics of sudoku solver");
+    inspector_.addHistogram("sudoku", "latency_us", &stat_.latency(),
+                            "latency of sudoku solver in microseconds");
   }
 
   void start()
@@ -3,7 +3,7 @@
 #include <muduo/base/Atomic.h>
 #include <muduo/base/Logging.h>
 #include <muduo/base/Thread.h>
-#include <muduo/base/ThreadPool.h>
+#include <muduo/base/WorkStealingThreadPool.h>
 #include <muduo/net/EventLoop.h>
 #include <muduo/net/InetAddress.h>
 #include <muduo/net/TcpServer.h>
@@ -122,7 +122,7 @@ class SudokuServer
   }
 
   TcpServer server_;
-  ThreadPool threadPool_;
+  WorkStealingThreadPool threadPool_;
   int numThreads_;
   Timestamp startTime_;
 };
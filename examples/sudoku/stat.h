@@ -62,6 +62,7 @@ class SudokuStat : muduo::noncopyable
     int64_t latencyAvg = totalResponses_ == 0 ? 0 : totalLatency_ / totalResponses_;
     result << "latency_us_avg " << latencyAvg << '\n';
     }
+    result << "latency_us " << latency_.snapshot().toString() << '\n';
     return result.buffer().toString();
   }
 
@@ -79,6 +80,7 @@ class SudokuStat : muduo::noncopyable
     totalLatency_ = 0;
     badLatency_ = 0;
     }
+    latency_.reset();
     return "reset done.";
   }
 
@@ -86,6 +88,10 @@ class SudokuStat : muduo::noncopyable
   {
     const time_t second = now.secondsSinceEpoch();
     const int64_t elapsed_us = now.microSecondsSinceEpoch() - receive.microSecondsSinceEpoch();
+    if (elapsed_us >= 0)
+    {
+      latency_.record(elapsed_us);
+    }
     MutexLockGuard lock(mutex_);
     assert(requests_.size() == latencies_.size());
     ++totalResponses_;
@@ -159,6 +165,8 @@ class SudokuStat : muduo::noncopyable
     assert(requests_.size() == latencies_.size());
   }
 
+  const Histogram& latency() const { return latency_; }
+
   void recordRequest()
   {
     MutexLockGuard lock(mutex_);
@@ -189,6 +197,7 @@ class SudokuStat : muduo::noncopyable
   boost::circular_buffer<int64_t> latencies_;
   int64_t totalRequests_, totalResponses_, totalSolved_, badRequests_, droppedRequests_, totalLatency_, badLatency_;
   // FIXME int128_t for totalLatency_;
+  Histogram latency_;  // lock free, outside of mutex_
 
   static const int kSeconds = 60;
 };
@@ -1,3 +1,4 @@
+#include <muduo/base/Histogram.h>
 #include <muduo/base/Logging.h>
 #include <muduo/base/Thread.h>
 #include <muduo/base/ThreadPool.h>
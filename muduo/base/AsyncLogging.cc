@@ -5,6 +5,7 @@
 
 #include <muduo/base/AsyncLogging.h>
 #include <muduo/base/LogFile.h>
+#include <muduo/base/Metrics.h>
 #include <muduo/base/Timestamp.h>
 
 #include <stdio.h>
@@ -26,6 +27,14 @@ AsyncLogging::AsyncLogging(const string& basename,
     nextBuffer_(new Buffer),
     buffers_()
 {
+  MetricsRegistry& metrics = MetricsRegistry::instance();
+  const string labels = MetricsRegistry::label("log", basename_);
+  writtenBytes_ = metrics.counter("muduo_asynclogging_written_bytes_total",
+                                  "Bytes written to log files by AsyncLogging.", labels);
+  droppedBuffers_ = metrics.counter("muduo_asynclogging_dropped_buffers_total",
+                                    "Log buffers dropped as the backend fell behind.", labels);
+  pendingBuffers_ = metrics.gauge("muduo_asynclogging_pending_buffers",
+                                  "Log buffers handed to the backend in last round.", labels);
   currentBuffer_->bzero();
   nextBuffer_->bzero();
   buffers_.reserve(16);
@@ -88,9 +97,11 @@ void AsyncLogging::threadFunc()
     }
 
     assert(!buffersToWrite.empty());
+    pendingBuffers_->set(static_cast<int64_t>(buffersToWrite.size()));
 
     if (buffersToWrite.size() > 25)
     {
+      droppedBuffers_->increment(static_cast<int64_t>(buffersToWrite.size()-2));
       char buf[256];
       snprintf(buf, sizeof buf, "Dropped log messages at %s, %zd larger buffers\n",
                Timestamp::now().toFormattedString().c_str(),
@@ -104,6 +115,7 @@ void AsyncLogging::threadFunc()
     {
       // FIXME: use unbuffered stdio FILE ? or use ::writev ?
       output.append(buffer->data(), buffer->length());
+      writtenBytes_->increment(buffer->length());
     }
 
     if (buffersToWrite.size() > 2)
@@ -19,6 +19,9 @@
 namespace muduo
 {
 
+class Counter;
+class Gauge;
+
 class AsyncLogging : noncopyable
 {
  public:
@@ -70,6 +73,10 @@ class AsyncLogging : noncopyable
   BufferPtr currentBuffer_ GUARDED_BY(mutex_);
   BufferPtr nextBuffer_ GUARDED_BY(mutex_);
   BufferVector buffers_ GUARDED_BY(mutex_);
+  // in MetricsRegistry, labeled by basename_
+  Counter* writtenBytes_;
+  Counter* droppedBuffers_;
+  Gauge* pendingBuffers_;
 };
 
 }  // namespace muduo
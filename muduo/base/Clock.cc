@@ -0,0 +1,229 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include <muduo/base/Clock.h>
+
+#include <muduo/base/FileUtil.h>
+
+#include <atomic>
+
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define MUDUO_HAVE_TSC 1
+#endif
+
+using namespace muduo;
+
+namespace
+{
+
+const int64_t kCalibrationUs = 100 * 1000;  // measures the rate before using it
+const int64_t kRebaseUs = 1000 * 1000;
+
+inline int64_t clockMicroseconds(clockid_t clock)
+{
+  struct timespec ts;
+  ::clock_gettime(clock, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * Timestamp::kMicroSecondsPerSecond + ts.tv_nsec / 1000;
+}
+
+#ifdef MUDUO_HAVE_TSC
+
+inline uint64_t readTsc()
+{
+  return __rdtsc();
+}
+
+bool tscUsable()
+{
+  unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+  // invariant TSC, constant rate in all of C-states and P-states
+  if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || (edx & (1u << 8)) == 0)
+  {
+    return false;
+  }
+  // the kernel checks it's synchronized across CPUs, or it picks another
+  string clocksource;
+  FileUtil::readFile("/sys/devices/system/clocksource/clocksource0/current_clocksource",
+                     64, &clocksource);
+  return clocksource == "tsc\n";
+}
+
+#else
+
+inline uint64_t readTsc()
+{
+  return 0;
+}
+
+bool tscUsable()
+{
+  return false;
+}
+
+#endif
+
+// microseconds = baseUs + (tsc - baseTsc) * mult >> 32, under a seqlock
+struct Calibration
+{
+  std::atomic<uint32_t> seq;
+  std::atomic<uint64_t> baseTsc;
+  std::atomic<int64_t> baseUs;
+  std::atomic<uint64_t> mult;  // 0 before calibrated
+  std::atomic<int64_t> rebaseTicks;
+  // CLOCK_REALTIME to measure the rate at, 0 before started
+  std::atomic<int64_t> calibrationDueUs;
+
+  std::atomic<bool> updating;
+  // the rate is measured from here, guarded by updating
+  uint64_t startTsc;
+  int64_t startMonotonicUs;
+};
+
+Calibration g_calibration;  // zero initialized
+std::atomic<int> g_source(-1);
+
+bool detectTsc()
+{
+  static const bool usable = tscUsable();
+  return usable;
+}
+
+// returns the current time, and takes it as the new base if no one else is
+int64_t rebase()
+{
+  Calibration& c = g_calibration;
+  if (c.updating.exchange(true, std::memory_order_acquire))
+  {
+    return clockMicroseconds(CLOCK_REALTIME);
+  }
+
+  // the TSC at the middle of the syscalls, the tightest of a few,
+  // in case of preemption
+  uint64_t tsc = 0;
+  int64_t realUs = 0;
+  int64_t monotonicUs = 0;
+  uint64_t minSpan = UINT64_MAX;
+  for (int i = 0; i < 3; ++i)
+  {
+    const uint64_t before = readTsc();
+    const int64_t real = clockMicroseconds(CLOCK_REALTIME);
+    const int64_t monotonic = clockMicroseconds(CLOCK_MONOTONIC);
+    const uint64_t span = readTsc() - before;
+    if (span < minSpan)
+    {
+      minSpan = span;
+      tsc = before + span / 2;
+      realUs = real;
+      monotonicUs = monotonic;
+    }
+  }
+
+  uint64_t mult = c.mult.load(std::memory_order_relaxed);
+  if (c.startTsc == 0)
+  {
+    c.startTsc = tsc;
+    c.startMonotonicUs = monotonicUs;
+  }
+  else if (monotonicUs - c.startMonotonicUs >= kCalibrationUs && tsc > c.startTsc)
+  {
+    // over the whole run, for precision
+    unsigned __int128 us = static_cast<unsigned __int128>(monotonicUs - c.startMonotonicUs);
+    mult = static_cast<uint64_t>((us << 32) / (tsc - c.startTsc));
+  }
+  if (mult == 0)
+  {
+    c.calibrationDueUs.store(realUs + kCalibrationUs - (monotonicUs - c.startMonotonicUs),
+                             std::memory_order_relaxed);
+  }
+
+  if (mult > 0)
+  {
+    const uint32_t seq = c.seq.load(std::memory_order_relaxed);
+    c.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    c.baseTsc.store(tsc, std::memory_order_relaxed);
+    c.baseUs.store(realUs, std::memory_order_relaxed);
+    c.mult.store(mult, std::memory_order_relaxed);
+    c.rebaseTicks.store(static_cast<int64_t>((static_cast<unsigned __int128>(kRebaseUs) << 32) / mult),
+                        std::memory_order_relaxed);
+    c.seq.store(seq + 2, std::memory_order_release);
+  }
+  c.updating.store(false, std::memory_order_release);
+  return realUs;
+}
+
+int64_t tscMicroseconds()
+{
+  const Calibration& c = g_calibration;
+  uint64_t baseTsc;
+  int64_t baseUs;
+  uint64_t mult;
+  int64_t rebaseTicks;
+  uint32_t seq;
+  do
+  {
+    seq = c.seq.load(std::memory_order_acquire);
+    baseTsc = c.baseTsc.load(std::memory_order_relaxed);
+    baseUs = c.baseUs.load(std::memory_order_relaxed);
+    mult = c.mult.load(std::memory_order_relaxed);
+    rebaseTicks = c.rebaseTicks.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((seq & 1) || seq != c.seq.load(std::memory_order_relaxed));
+
+  if (mult == 0)
+  {
+    // one syscall while the rate is measured, sampled again only when due
+    const int64_t realUs = clockMicroseconds(CLOCK_REALTIME);
+    const int64_t dueUs = c.calibrationDueUs.load(std::memory_order_relaxed);
+    if (dueUs != 0 && realUs < dueUs && dueUs - realUs <= kCalibrationUs)
+    {
+      return realUs;
+    }
+    return rebase();
+  }
+
+  // may be a little negative, read on another CPU than the base
+  const int64_t ticks = static_cast<int64_t>(readTsc() - baseTsc);
+  if (ticks > rebaseTicks)
+  {
+    return rebase();
+  }
+  return baseUs + static_cast<int64_t>((static_cast<__int128>(ticks) * mult) >> 32);
+}
+
+}  // namespace
+
+Clock::Source Clock::source()
+{
+  int source = g_source.load(std::memory_order_relaxed);
+  if (source < 0)
+  {
+    source = detectTsc() ? kTsc : kSystem;
+    g_source.store(source, std::memory_order_relaxed);
+  }
+  return static_cast<Source>(source);
+}
+
+void Clock::setSource(Source source)
+{
+  g_source.store(source == kTsc && detectTsc() ? kTsc : kSystem, std::memory_order_relaxed);
+}
+
+Timestamp Clock::now()
+{
+  if (source() == kTsc)
+  {
+    return Timestamp(tscMicroseconds());
+  }
+  return Timestamp(clockMicroseconds(CLOCK_REALTIME));
+}
+
+Timestamp Clock::coarseNow()
+{
+  return Timestamp(clockMicroseconds(CLOCK_REALTIME_COARSE));
+}
@@ -0,0 +1,48 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_BASE_CLOCK_H
+#define MUDUO_BASE_CLOCK_H
+
+#include <muduo/base/Timestamp.h>
+#include <muduo/base/noncopyable.h>
+
+namespace muduo
+{
+
+///
+/// Cheap wall clock for hot paths, eg. poll return time, timers and logging.
+///
+/// Reads the TSC and scales it, if the CPU has an invariant TSC and the
+/// kernel trusts it as clocksource, ie. it's synchronized across CPUs, so
+/// it's correct after migrating to another CPU.  The rate is measured
+/// against CLOCK_MONOTONIC, and the base is taken from CLOCK_REALTIME
+/// again every second, so it follows NTP and settimeofday() within a
+/// second.  Otherwise, and in the first 100ms the rate is measured over,
+/// it's clock_gettime(CLOCK_REALTIME).
+///
+/// Lock free, thread safe.
+class Clock : noncopyable
+{
+ public:
+  enum Source
+  {
+    kSystem,
+    kTsc,
+  };
+
+  static Source source();
+  /// For tests and benchmarks, kTsc is ignored if the TSC is unusable.
+  static void setSource(Source source);
+
+  /// Within microseconds of Timestamp::now().
+  static Timestamp now();
+  /// CLOCK_REALTIME_COARSE, a few milliseconds of resolution.
+  static Timestamp coarseNow();
+};
+
+}  // namespace muduo
+
+#endif  // MUDUO_BASE_CLOCK_H
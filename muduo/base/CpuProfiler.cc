@@ -0,0 +1,312 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include <muduo/base/CpuProfiler.h>
+
+#include <muduo/base/CurrentThread.h>
+#include <muduo/base/Logging.h>
+#include <muduo/base/Timestamp.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <vector>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <ucontext.h>
+
+using namespace muduo;
+
+namespace
+{
+
+const int kMaxDepth = 64;
+const int kTagSize = 32;
+const int kSlots = 4096;
+// a frame pointer further than this from the previous one is bogus.
+const uintptr_t kMaxFrameSize = 100 * 1000;
+const uintptr_t kFrameRecord = 2 * sizeof(uintptr_t);  // saved fp and return address
+
+enum SampleState { kEmpty, kWriting, kFull };
+
+// written by the signal handler of the sampled thread, read by profile().
+struct Sample
+{
+  std::atomic<int> state;
+  int depth;
+  char tag[kTagSize];
+  uintptr_t pcs[kMaxDepth];
+};
+
+__thread char t_tag[kTagSize];
+// top of the stack of this thread, 0 if not registered.
+__thread uintptr_t t_stackHigh = 0;
+
+Sample* g_samples = NULL;  // never freed, a late signal may still write
+std::atomic<uint32_t> g_next(0);
+std::atomic<int64_t> g_dropped(0);
+std::atomic<bool> g_profiling(false);
+
+// async signal safe, fills pcs from the innermost frame.
+int walkStack(void* context, uintptr_t* pcs, int maxDepth)
+{
+  const ucontext_t* uc = static_cast<const ucontext_t*>(context);
+#if defined(__x86_64__)
+  const uintptr_t pc = static_cast<uintptr_t>(uc->uc_mcontext.gregs[REG_RIP]);
+  const uintptr_t sp = static_cast<uintptr_t>(uc->uc_mcontext.gregs[REG_RSP]);
+  uintptr_t fp = static_cast<uintptr_t>(uc->uc_mcontext.gregs[REG_RBP]);
+#elif defined(__aarch64__)
+  const uintptr_t pc = static_cast<uintptr_t>(uc->uc_mcontext.pc);
+  const uintptr_t sp = static_cast<uintptr_t>(uc->uc_mcontext.sp);
+  uintptr_t fp = static_cast<uintptr_t>(uc->uc_mcontext.regs[29]);
+#else
+  (void)uc;
+  return 0;
+#endif
+  int depth = 0;
+  pcs[depth++] = pc;
+  // [sp, t_stackHigh) is mapped, a frame record outside of it may not be.
+  // Besides, the same sanity checks as gperftools: a frame must be above
+  // the previous one, not too far away, and aligned.
+  const uintptr_t high = t_stackHigh;
+  if (fp < sp || fp - sp > kMaxFrameSize)
+  {
+    return depth;
+  }
+  while (depth < maxDepth && fp % sizeof(uintptr_t) == 0
+         && fp < high && high - fp >= kFrameRecord)
+  {
+    const uintptr_t* frame = reinterpret_cast<const uintptr_t*>(fp);
+    const uintptr_t next = frame[0];
+    const uintptr_t ret = frame[1];
+    if (ret == 0)
+    {
+      break;
+    }
+    pcs[depth++] = ret;
+    if (next <= fp || next - fp > kMaxFrameSize)
+    {
+      break;
+    }
+    fp = next;
+  }
+  return depth;
+}
+
+void onSigprof(int, siginfo_t*, void* context)
+{
+  if (!g_profiling.load(std::memory_order_relaxed))
+  {
+    return;
+  }
+  const int savedErrno = errno;
+  Sample& sample = g_samples[g_next.fetch_add(1, std::memory_order_relaxed) % kSlots];
+  int expected = kEmpty;
+  if (sample.state.compare_exchange_strong(expected, kWriting, std::memory_order_acquire))
+  {
+    const char* tag = t_tag[0] ? t_tag : CurrentThread::t_threadName;
+    int i = 0;
+    for (; tag && tag[i] && i < kTagSize-1; ++i)
+    {
+      sample.tag[i] = tag[i];
+    }
+    sample.tag[i] = '\0';
+    sample.depth = walkStack(context, sample.pcs, kMaxDepth);
+    sample.state.store(kFull, std::memory_order_release);
+  }
+  else
+  {
+    g_dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+  errno = savedErrno;
+}
+
+typedef std::pair<string, std::vector<uintptr_t>> Stack;
+typedef std::map<Stack, int64_t> StackCounts;
+
+void drain(StackCounts* counts)
+{
+  for (int i = 0; i < kSlots; ++i)
+  {
+    Sample& sample = g_samples[i];
+    if (sample.state.load(std::memory_order_acquire) == kFull)
+    {
+      if (sample.depth > 0)
+      {
+        Stack stack(sample.tag, std::vector<uintptr_t>(sample.pcs, sample.pcs + sample.depth));
+        ++(*counts)[stack];
+      }
+      sample.state.store(kEmpty, std::memory_order_release);
+    }
+  }
+}
+
+class Symbolizer
+{
+ public:
+  const string& symbolize(uintptr_t pc, bool innermost)
+  {
+    // a return address points to the instruction after the call
+    const uintptr_t addr = innermost ? pc : pc - 1;
+    string& name = cache_[addr];
+    if (name.empty())
+    {
+      name = lookup(addr);
+    }
+    return name;
+  }
+
+ private:
+  static string lookup(uintptr_t addr)
+  {
+    char buf[256];
+    Dl_info info;
+    if (::dladdr(reinterpret_cast<void*>(addr), &info))
+    {
+      if (info.dli_sname)
+      {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, NULL, NULL, &status);
+        string name = status == 0 ? demangled : info.dli_sname;
+        ::free(demangled);
+        std::replace(name.begin(), name.end(), ';', ':');
+        return name;
+      }
+      if (info.dli_fname)
+      {
+        const char* slash = ::strrchr(info.dli_fname, '/');
+        snprintf(buf, sizeof buf, "%s+0x%zx",
+                 slash ? slash + 1 : info.dli_fname,
+                 addr - reinterpret_cast<uintptr_t>(info.dli_fbase));
+        return buf;
+      }
+    }
+    snprintf(buf, sizeof buf, "0x%zx", addr);
+    return buf;
+  }
+
+  std::map<uintptr_t, string> cache_;
+};
+
+string collapse(const StackCounts& counts)
+{
+  // different addresses in the same functions are merged
+  Symbolizer symbolizer;
+  std::map<string, int64_t> lines;
+  for (const auto& it : counts)
+  {
+    const std::vector<uintptr_t>& pcs = it.first.second;
+    string line = it.first.first;
+    for (size_t i = pcs.size(); i > 0; --i)
+    {
+      line += ';';
+      line += symbolizer.symbolize(pcs[i-1], i == 1);
+    }
+    lines[line] += it.second;
+  }
+
+  string result;
+  for (const auto& it : lines)
+  {
+    char buf[32];
+    snprintf(buf, sizeof buf, " %" PRId64 "\n", it.second);
+    result += it.first;
+    result += buf;
+  }
+  return result;
+}
+
+void setTimer(int frequency)
+{
+  struct itimerval timer;
+  timer.it_interval.tv_sec = 0;
+  timer.it_interval.tv_usec = frequency > 0 ? 1000 * 1000 / frequency : 0;
+  timer.it_value = timer.it_interval;
+  ::setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+}  // namespace
+
+bool CpuProfiler::isProfiling()
+{
+  return g_profiling.load(std::memory_order_relaxed);
+}
+
+void CpuProfiler::setThreadTag(const char* tag)
+{
+  snprintf(t_tag, sizeof t_tag, "%s", tag);
+}
+
+void CpuProfiler::registerThread()
+{
+  // not async signal safe, may read /proc/self/maps for the main thread
+  pthread_attr_t attr;
+  if (::pthread_getattr_np(::pthread_self(), &attr) == 0)
+  {
+    void* low = NULL;
+    size_t size = 0;
+    if (::pthread_attr_getstack(&attr, &low, &size) == 0)
+    {
+      t_stackHigh = reinterpret_cast<uintptr_t>(low) + size;
+    }
+    ::pthread_attr_destroy(&attr);
+  }
+}
+
+string CpuProfiler::profile(double seconds, int frequency)
+{
+  bool expected = false;
+  if (!g_profiling.compare_exchange_strong(expected, true))
+  {
+    return string();
+  }
+  frequency = std::min(std::max(frequency, 1), 1000);
+  if (g_samples == NULL)
+  {
+    g_samples = new Sample[kSlots];
+    for (int i = 0; i < kSlots; ++i)
+    {
+      g_samples[i].state.store(kEmpty, std::memory_order_relaxed);
+    }
+    // stays installed, SIG_DFL of SIGPROF kills the process if any
+    // signal is delivered after profile() returns.
+    struct sigaction sa;
+    ::memset(&sa, 0, sizeof sa);
+    sa.sa_sigaction = onSigprof;
+    sa.sa_flags = SA_RESTART | SA_SIGINFO;
+    ::sigemptyset(&sa.sa_mask);
+    ::sigaction(SIGPROF, &sa, NULL);
+  }
+  g_dropped.store(0, std::memory_order_relaxed);
+
+  StackCounts counts;
+  const Timestamp deadline = addTime(Timestamp::now(), seconds);
+  setTimer(frequency);
+  Timestamp now = Timestamp::now();
+  while (now < deadline)
+  {
+    const int64_t remaining = deadline.microSecondsSinceEpoch() - now.microSecondsSinceEpoch();
+    CurrentThread::sleepUsec(std::min(remaining, int64_t(50 * 1000)));
+    drain(&counts);
+    now = Timestamp::now();
+  }
+  setTimer(0);
+  drain(&counts);
+  g_profiling.store(false, std::memory_order_relaxed);
+
+  const int64_t dropped = g_dropped.load(std::memory_order_relaxed);
+  if (dropped > 0)
+  {
+    LOG_WARN << "CpuProfiler dropped " << dropped << " samples";
+  }
+  return collapse(counts);
+}
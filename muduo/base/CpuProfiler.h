@@ -0,0 +1,45 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_BASE_CPUPROFILER_H
+#define MUDUO_BASE_CPUPROFILER_H
+
+#include <muduo/base/Types.h>
+
+namespace muduo
+{
+
+///
+/// Built-in sampling CPU profiler, needs no gperftools.
+///
+/// Samples are taken by SIGPROF on the thread consuming CPU, stacks are
+/// walked by frame pointers, so build with -fno-omit-frame-pointer for
+/// full stacks, otherwise some frames may be missing.
+/// The walk stays within the stack recorded by registerThread(), samples of
+/// other threads have the interrupted function only.
+/// Symbols are resolved by dladdr(), link with -rdynamic.
+namespace CpuProfiler
+{
+  /// Profiles the whole process for @c seconds, blocking the calling thread.
+  /// Returns collapsed stacks for flame graphs, one line per stack:
+  /// <tt>tag;outermost;...;innermost count</tt>, where tag is set by
+  /// setThreadTag(), or the thread name.
+  /// Returns an empty string if another profiling is running.
+  string profile(double seconds, int frequency = 99);
+
+  bool isProfiling();
+
+  /// Tags samples of the calling thread, truncated to 31 chars.
+  /// Empty tag falls back to the thread name.
+  void setThreadTag(const char* tag);
+
+  /// Records the stack of the calling thread, for walking it safely in the
+  /// signal handler.  Called by muduo::Thread and EventLoop::loop().
+  void registerThread();
+}  // namespace CpuProfiler
+
+}  // namespace muduo
+
+#endif  // MUDUO_BASE_CPUPROFILER_H
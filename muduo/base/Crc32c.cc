@@ -0,0 +1,129 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include <muduo/base/Crc32c.h>
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+using namespace muduo;
+
+namespace
+{
+
+const uint32_t kPolynomial = 0x82f63b78;  // reversed 0x1EDC6F41
+
+struct Table
+{
+  uint32_t entries[256];
+
+  Table()
+  {
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+      uint32_t crc = i;
+      for (int j = 0; j < 8; ++j)
+      {
+        crc = (crc >> 1) ^ (kPolynomial & (0 - (crc & 1)));
+      }
+      entries[i] = crc;
+    }
+  }
+};
+
+const Table g_table;
+
+#if defined(__x86_64__)
+
+__attribute__((target("sse4.2")))
+uint32_t extendHardware(uint32_t crc, const void* data, size_t n)
+{
+  const char* p = static_cast<const char*>(data);
+  uint64_t crc64 = ~crc;
+  for (; n >= 8; n -= 8, p += 8)
+  {
+    uint64_t word;
+    ::memcpy(&word, p, sizeof word);
+    crc64 = _mm_crc32_u64(crc64, word);
+  }
+  uint32_t crc32 = static_cast<uint32_t>(crc64);
+  for (; n > 0; --n, ++p)
+  {
+    crc32 = _mm_crc32_u8(crc32, static_cast<uint8_t>(*p));
+  }
+  return ~crc32;
+}
+
+bool detectHardware()
+{
+  __builtin_cpu_init();  // may run before the constructor of libgcc
+  return __builtin_cpu_supports("sse4.2");
+}
+
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+
+uint32_t extendHardware(uint32_t crc, const void* data, size_t n)
+{
+  const char* p = static_cast<const char*>(data);
+  crc = ~crc;
+  for (; n >= 8; n -= 8, p += 8)
+  {
+    uint64_t word;
+    ::memcpy(&word, p, sizeof word);
+    crc = __crc32cd(crc, word);
+  }
+  for (; n > 0; --n, ++p)
+  {
+    crc = __crc32cb(crc, static_cast<uint8_t>(*p));
+  }
+  return ~crc;
+}
+
+bool detectHardware()
+{
+  return true;  // checked at compile time
+}
+
+#else
+
+uint32_t extendHardware(uint32_t crc, const void* data, size_t n)
+{
+  return Crc32c::extendPortable(crc, data, n);
+}
+
+bool detectHardware()
+{
+  return false;
+}
+
+#endif
+
+const bool g_hardware = detectHardware();
+
+}  // namespace
+
+uint32_t Crc32c::extendPortable(uint32_t crc, const void* data, size_t n)
+{
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  crc = ~crc;
+  for (size_t i = 0; i < n; ++i)
+  {
+    crc = g_table.entries[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+uint32_t Crc32c::extend(uint32_t crc, const void* data, size_t n)
+{
+  return g_hardware ? extendHardware(crc, data, n) : extendPortable(crc, data, n);
+}
+
+bool Crc32c::hardwareAccelerated()
+{
+  return g_hardware;
+}
@@ -0,0 +1,38 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_BASE_CRC32C_H
+#define MUDUO_BASE_CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace muduo
+{
+
+///
+/// CRC-32C (Castagnoli), as used by iSCSI, ext4 and leveldb.
+///
+/// Uses the crc32 instruction of SSE 4.2 or ARMv8 if the CPU has it,
+/// which checksums several bytes per cycle, otherwise a lookup table.
+namespace Crc32c
+{
+  /// crc of data[0, n) appended to the data whose crc is @c crc.
+  uint32_t extend(uint32_t crc, const void* data, size_t n);
+
+  inline uint32_t value(const void* data, size_t n)
+  {
+    return extend(0, data, n);
+  }
+
+  /// The table based one, for tests.
+  uint32_t extendPortable(uint32_t crc, const void* data, size_t n);
+
+  bool hardwareAccelerated();
+}  // namespace Crc32c
+
+}  // namespace muduo
+
+#endif  // MUDUO_BASE_CRC32C_H
@@ -0,0 +1,39 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_BASE_FUTEX_H
+#define MUDUO_BASE_FUTEX_H
+
+#include <atomic>
+
+#include <linux/futex.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace muduo
+{
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "futex word must be 32-bit");
+
+/// Sleeps while *addr == expected, returns early on futexWake() or a signal.
+/// Private to this process.
+inline int futexWait(std::atomic<uint32_t>* addr, uint32_t expected)
+{
+  return static_cast<int>(::syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr),
+                                    FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0));
+}
+
+/// Wakes up at most n threads waiting on addr, returns number woken.
+inline int futexWake(std::atomic<uint32_t>* addr, int n)
+{
+  return static_cast<int>(::syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr),
+                                    FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0));
+}
+
+}  // namespace muduo
+
+#endif  // MUDUO_BASE_FUTEX_H
@@ -0,0 +1,204 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include <muduo/base/Histogram.h>
+
+#include <muduo/base/CurrentThread.h>
+#include <muduo/base/LogStream.h>
+#include <muduo/base/Metrics.h>
+
+#include <algorithm>
+#include <limits>
+
+#include <assert.h>
+#include <math.h>
+
+using namespace muduo;
+
+struct Histogram::Shard
+{
+  std::atomic<int64_t> sum;
+  std::atomic<int64_t> min;
+  std::atomic<int64_t> max;
+  std::unique_ptr<std::atomic<int64_t>[]> counts;
+  char padding[64];  // keeps hot fields of neighbouring shards apart
+};
+
+namespace
+{
+
+int highestBit(int64_t value)
+{
+  assert(value > 0);
+  return 63 - __builtin_clzll(static_cast<unsigned long long>(value));
+}
+
+void resetShard(std::atomic<int64_t>* counts, int n)
+{
+  for (int i = 0; i < n; ++i)
+  {
+    counts[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+}  // namespace
+
+int Histogram::bucketOf(int64_t value, int precisionBits)
+{
+  const int64_t subBuckets = int64_t(1) << precisionBits;
+  if (value < subBuckets)
+  {
+    return static_cast<int>(value);
+  }
+  // the highest precisionBits+1 bits of value, the first one is always set.
+  const int shift = highestBit(value) - precisionBits;
+  const int64_t sub = (value >> shift) & (subBuckets - 1);
+  return static_cast<int>((shift + 1) * subBuckets + sub);
+}
+
+Histogram::Snapshot::Snapshot(int precisionBits)
+  : precisionBits_(precisionBits),
+    count_(0),
+    sum_(0),
+    min_(std::numeric_limits<int64_t>::max()),
+    max_(0)
+{
+}
+
+int64_t Histogram::Snapshot::lowerBound(int bucket) const
+{
+  const int64_t subBuckets = int64_t(1) << precisionBits_;
+  if (bucket < subBuckets)
+  {
+    return bucket;
+  }
+  const int shift = static_cast<int>(bucket / subBuckets) - 1;
+  return (subBuckets + bucket % subBuckets) << shift;
+}
+
+int64_t Histogram::Snapshot::upperBound(int bucket) const
+{
+  const int64_t subBuckets = int64_t(1) << precisionBits_;
+  if (bucket < subBuckets)
+  {
+    return bucket;
+  }
+  const int shift = static_cast<int>(bucket / subBuckets) - 1;
+  return lowerBound(bucket) + (int64_t(1) << shift) - 1;
+}
+
+int64_t Histogram::Snapshot::percentile(double q) const
+{
+  if (count_ == 0)
+  {
+    return 0;
+  }
+  int64_t rank = static_cast<int64_t>(ceil(q * static_cast<double>(count_)));
+  rank = std::max(rank, int64_t(1));
+  int64_t seen = 0;
+  for (size_t i = 0; i < counts_.size(); ++i)
+  {
+    seen += counts_[i];
+    if (seen >= rank)
+    {
+      int64_t value = upperBound(static_cast<int>(i));
+      return std::max(min(), std::min(value, max_));
+    }
+  }
+  return max_;
+}
+
+string Histogram::Snapshot::toString() const
+{
+  LogStream os;
+  os << "count " << count()
+     << " min " << min()
+     << " avg " << mean()
+     << " p50 " << percentile(0.5)
+     << " p90 " << percentile(0.9)
+     << " p99 " << percentile(0.99)
+     << " p999 " << percentile(0.999)
+     << " max " << max();
+  return os.buffer().toString();
+}
+
+string Histogram::Snapshot::toPrometheus(const string& name, const string& help) const
+{
+  string result;
+  MetricsRegistry::appendHeader(&result, name, help, "summary");
+  MetricsRegistry::appendSummary(&result, name, string(), *this);
+  return result;
+}
+
+Histogram::Histogram(int64_t highestValue, int precisionBits, int shards)
+  : highestValue_(std::max(highestValue, int64_t(1))),
+    precisionBits_(precisionBits),
+    buckets_(bucketOf(highestValue_, precisionBits) + 1),
+    numShards_(std::max(shards, 1)),
+    shards_(new Shard[numShards_])
+{
+  assert(precisionBits > 0 && precisionBits < 16);
+  for (int i = 0; i < numShards_; ++i)
+  {
+    shards_[i].counts.reset(new std::atomic<int64_t>[buckets_]);
+  }
+  reset();
+}
+
+Histogram::~Histogram() = default;
+
+Histogram::Shard& Histogram::currentShard()
+{
+  return shards_[CurrentThread::tid() % numShards_];
+}
+
+void Histogram::record(int64_t value)
+{
+  value = std::min(std::max(value, int64_t(0)), highestValue_);
+  Shard& shard = currentShard();
+  shard.counts[bucketOf(value, precisionBits_)].fetch_add(1, std::memory_order_relaxed);
+  shard.sum.fetch_add(value, std::memory_order_relaxed);
+
+  int64_t current = shard.min.load(std::memory_order_relaxed);
+  while (value < current
+         && !shard.min.compare_exchange_weak(current, value, std::memory_order_relaxed))
+  {
+  }
+  current = shard.max.load(std::memory_order_relaxed);
+  while (value > current
+         && !shard.max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+  {
+  }
+}
+
+Histogram::Snapshot Histogram::snapshot() const
+{
+  Snapshot result(precisionBits_);
+  result.counts_.resize(buckets_);
+  for (int s = 0; s < numShards_; ++s)
+  {
+    const Shard& shard = shards_[s];
+    for (int i = 0; i < buckets_; ++i)
+    {
+      int64_t n = shard.counts[i].load(std::memory_order_relaxed);
+      result.counts_[i] += n;
+      result.count_ += n;
+    }
+    result.sum_ += shard.sum.load(std::memory_order_relaxed);
+    result.min_ = std::min(result.min_, shard.min.load(std::memory_order_relaxed));
+    result.max_ = std::max(result.max_, shard.max.load(std::memory_order_relaxed));
+  }
+  return result;
+}
+
+void Histogram::reset()
+{
+  for (int s = 0; s < numShards_; ++s)
+  {
+    Shard& shard = shards_[s];
+    resetShard(shard.counts.get(), buckets_);
+    shard.sum.store(0, std::memory_order_relaxed);
+    shard.min.store(std::numeric_limits<int64_t>::max(), std::memory_order_relaxed);
+    shard.max.store(0, std::memory_order_relaxed);
+  }
+}
@@ -0,0 +1,101 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_BASE_HISTOGRAM_H
+#define MUDUO_BASE_HISTOGRAM_H
+
+#include <muduo/base/copyable.h>
+#include <muduo/base/noncopyable.h>
+#include <muduo/base/Types.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace muduo
+{
+
+///
+/// Latency histogram with log-linear buckets, a la HdrHistogram.
+///
+/// Values below 2^precisionBits are counted exactly, larger values fall in
+/// buckets whose width is 1/2^precisionBits of their magnitude, so memory is
+/// constant and percentiles carry a bounded relative error.
+///
+/// record() is lock free and thread safe, each thread updates one of a fixed
+/// number of shards, which are merged by snapshot().
+class Histogram : noncopyable
+{
+ public:
+  /// Merged counts of a Histogram at some point in time.
+  class Snapshot : public muduo::copyable
+  {
+   public:
+    int64_t count() const { return count_; }
+    int64_t sum() const { return sum_; }
+    int64_t min() const { return count_ > 0 ? min_ : 0; }
+    int64_t max() const { return max_; }
+    int64_t mean() const { return count_ > 0 ? sum_ / count_ : 0; }
+
+    /// the value at the @c q quantile by the nearest rank method, 0 <= q <= 1,
+    /// rounded up to the upper bound of its bucket.
+    int64_t percentile(double q) const;
+
+    /// bucket iteration, for dumping distributions
+    int buckets() const { return static_cast<int>(counts_.size()); }
+    int64_t countAt(int bucket) const { return counts_[bucket]; }
+    int64_t lowerBound(int bucket) const;
+    int64_t upperBound(int bucket) const;
+
+    /// one line of count, min, avg, percentiles and max
+    string toString() const;
+    /// Prometheus text format, as a summary named @c name
+    string toPrometheus(const string& name, const string& help = string()) const;
+
+   private:
+    friend class Histogram;
+    explicit Snapshot(int precisionBits);
+
+    int precisionBits_;
+    int64_t count_;
+    int64_t sum_;
+    int64_t min_;
+    int64_t max_;
+    std::vector<int64_t> counts_;
+  };
+
+  /// Tracks values in [0, highestValue], larger ones are clamped.
+  /// Default fits one hour in microseconds, with about 3% precision.
+  explicit Histogram(int64_t highestValue = 3600LL * 1000 * 1000,
+                     int precisionBits = 5,
+                     int shards = 8);
+  ~Histogram();
+
+  void record(int64_t value);
+  Snapshot snapshot() const;
+  /// Not atomic with concurrent record(), which may be counted or lost.
+  void reset();
+
+  int64_t highestValue() const { return highestValue_; }
+  int precisionBits() const { return precisionBits_; }
+
+  /// bucket index of @c value, exposed for testing.
+  static int bucketOf(int64_t value, int precisionBits);
+
+ private:
+  struct Shard;
+
+  Shard& currentShard();
+
+  const int64_t highestValue_;
+  const int precisionBits_;
+  const int buckets_;
+  const int numShards_;
+  std::unique_ptr<Shard[]> shards_;
+};
+
+}  // namespace muduo
+
+#endif  // MUDUO_BASE_HISTOGRAM_H
@@ -7,6 +7,7 @@
 
 #include <muduo/base/FileUtil.h>
 #include <muduo/base/ProcessInfo.h>
+#include <muduo/base/TimeFormat.h>
 
 #include <assert.h>
 #include <stdio.h>
@@ -114,11 +115,11 @@ string LogFile::getLogFileName(const string& basename, time_t* now)
   filename = basename;
 
   char timebuf[32];
-  struct tm tm;
   *now = time(NULL);
-  gmtime_r(now, &tm); // FIXME: localtime_r ?
-  strftime(timebuf, sizeof timebuf, ".%Y%m%d-%H%M%S.", &tm);
-  filename += timebuf;
+  timebuf[0] = '.';
+  TimeFormat::formatFileTime(*now, timebuf + 1); // FIXME: local time ?
+  timebuf[TimeFormat::kFileTimeLength + 1] = '.';
+  filename.append(timebuf, TimeFormat::kFileTimeLength + 2);
 
   filename += ProcessInfo::hostname();
 
@@ -6,6 +6,7 @@
 #include <muduo/base/LogStream.h>
 
 #include <algorithm>
+#include <cmath>
 #include <limits>
 #include <type_traits>
 #include <assert.h>
@@ -16,7 +17,6 @@
 using namespace muduo;
 using namespace muduo::detail;
 
-// TODO: better itoa.
 #if defined(__clang__)
 #pragma clang diagnostic ignored "-Wtautological-compare"
 #else
@@ -28,35 +28,64 @@ namespace muduo
 namespace detail
 {
 
-const char digits[] = "9876543210123456789";
-const char* zero = digits + 9;
-static_assert(sizeof(digits) == 20, "wrong number of digits");
+const char digitPairs[201] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
 
 const char digitsHex[] = "0123456789ABCDEF";
 static_assert(sizeof digitsHex == 17, "wrong number of digitsHex");
 
-// Efficient Integer to String Conversions, by Matthew Wilson.
+// writes decimal digits of value backwards, ending at end, two per divide.
 template<typename T>
-size_t convert(char buf[], T value)
+char* formatDecimalBackward(char* end, T value)
 {
-  T i = value;
-  char* p = buf;
-
-  do
+  static_assert(std::is_unsigned<T>::value, "T must be unsigned");
+  char* p = end;
+  while (value >= 100)
   {
-    int lsd = static_cast<int>(i % 10);
-    i /= 10;
-    *p++ = zero[lsd];
-  } while (i != 0);
+    const unsigned pair = static_cast<unsigned>(value % 100);
+    value /= 100;
+    p -= 2;
+    memcpy(p, digitPairs + pair * 2, 2);
+  }
+  if (value >= 10)
+  {
+    p -= 2;
+    memcpy(p, digitPairs + value * 2, 2);
+  }
+  else
+  {
+    *--p = static_cast<char>('0' + value);
+  }
+  return p;
+}
 
+template<typename T>
+size_t convert(char buf[], T value)
+{
+  typedef typename std::make_unsigned<T>::type U;
+  // negates in unsigned, for the minimum value
+  const U magnitude = value < 0 ? static_cast<U>(0 - static_cast<U>(value))
+                                : static_cast<U>(value);
+  char tmp[32];
+  char* end = tmp + sizeof tmp;
+  char* p = formatDecimalBackward(end, magnitude);
   if (value < 0)
   {
-    *p++ = '-';
+    *--p = '-';
   }
-  *p = '\0';
-  std::reverse(buf, p);
-
-  return p - buf;
+  const size_t len = end - p;
+  memcpy(buf, p, len);
+  buf[len] = '\0';
+  return len;
 }
 
 size_t convertHex(char buf[], uintptr_t value)
@@ -77,6 +106,369 @@ size_t convertHex(char buf[], uintptr_t value)
   return p - buf;
 }
 
+// Formats doubles like printf("%.12g") without snprintf, see "Printing
+// Floating-Point Numbers Quickly and Accurately with Integers", Florian
+// Loitsch 2010, and its precision mode in double-conversion.
+// Digits are generated with 64-bit integers, and rejected in the rare
+// cases where the error bound can't tell the correct rounding, then
+// snprintf() does it.  Up to 12 significant digits, it's also the shortest
+// decimal representation that reads back to the same double.
+namespace grisu
+{
+
+// f * 2^e
+struct DiyFp
+{
+  uint64_t f;
+  int e;
+};
+
+struct CachedPower
+{
+  uint64_t significand;
+  int16_t binaryExponent;
+  int16_t decimalExponent;
+};
+
+// 10^k for k in [-348, 340] step 8, rounded to 64 bits
+const CachedPower kCachedPowers[] =
+{
+  { 0xfa8fd5a0081c0288ULL, -1220, -348 },
+  { 0xbaaee17fa23ebf76ULL, -1193, -340 },
+  { 0x8b16fb203055ac76ULL, -1166, -332 },
+  { 0xcf42894a5dce35eaULL, -1140, -324 },
+  { 0x9a6bb0aa55653b2dULL, -1113, -316 },
+  { 0xe61acf033d1a45dfULL, -1087, -308 },
+  { 0xab70fe17c79ac6caULL, -1060, -300 },
+  { 0xff77b1fcbebcdc4fULL, -1034, -292 },
+  { 0xbe5691ef416bd60cULL, -1007, -284 },
+  { 0x8dd01fad907ffc3cULL, -980, -276 },
+  { 0xd3515c2831559a83ULL, -954, -268 },
+  { 0x9d71ac8fada6c9b5ULL, -927, -260 },
+  { 0xea9c227723ee8bcbULL, -901, -252 },
+  { 0xaecc49914078536dULL, -874, -244 },
+  { 0x823c12795db6ce57ULL, -847, -236 },
+  { 0xc21094364dfb5637ULL, -821, -228 },
+  { 0x9096ea6f3848984fULL, -794, -220 },
+  { 0xd77485cb25823ac7ULL, -768, -212 },
+  { 0xa086cfcd97bf97f4ULL, -741, -204 },
+  { 0xef340a98172aace5ULL, -715, -196 },
+  { 0xb23867fb2a35b28eULL, -688, -188 },
+  { 0x84c8d4dfd2c63f3bULL, -661, -180 },
+  { 0xc5dd44271ad3cdbaULL, -635, -172 },
+  { 0x936b9fcebb25c996ULL, -608, -164 },
+  { 0xdbac6c247d62a584ULL, -582, -156 },
+  { 0xa3ab66580d5fdaf6ULL, -555, -148 },
+  { 0xf3e2f893dec3f126ULL, -529, -140 },
+  { 0xb5b5ada8aaff80b8ULL, -502, -132 },
+  { 0x87625f056c7c4a8bULL, -475, -124 },
+  { 0xc9bcff6034c13053ULL, -449, -116 },
+  { 0x964e858c91ba2655ULL, -422, -108 },
+  { 0xdff9772470297ebdULL, -396, -100 },
+  { 0xa6dfbd9fb8e5b88fULL, -369, -92 },
+  { 0xf8a95fcf88747d94ULL, -343, -84 },
+  { 0xb94470938fa89bcfULL, -316, -76 },
+  { 0x8a08f0f8bf0f156bULL, -289, -68 },
+  { 0xcdb02555653131b6ULL, -263, -60 },
+  { 0x993fe2c6d07b7facULL, -236, -52 },
+  { 0xe45c10c42a2b3b06ULL, -210, -44 },
+  { 0xaa242499697392d3ULL, -183, -36 },
+  { 0xfd87b5f28300ca0eULL, -157, -28 },
+  { 0xbce5086492111aebULL, -130, -20 },
+  { 0x8cbccc096f5088ccULL, -103, -12 },
+  { 0xd1b71758e219652cULL, -77, -4 },
+  { 0x9c40000000000000ULL, -50, 4 },
+  { 0xe8d4a51000000000ULL, -24, 12 },
+  { 0xad78ebc5ac620000ULL, 3, 20 },
+  { 0x813f3978f8940984ULL, 30, 28 },
+  { 0xc097ce7bc90715b3ULL, 56, 36 },
+  { 0x8f7e32ce7bea5c70ULL, 83, 44 },
+  { 0xd5d238a4abe98068ULL, 109, 52 },
+  { 0x9f4f2726179a2245ULL, 136, 60 },
+  { 0xed63a231d4c4fb27ULL, 162, 68 },
+  { 0xb0de65388cc8ada8ULL, 189, 76 },
+  { 0x83c7088e1aab65dbULL, 216, 84 },
+  { 0xc45d1df942711d9aULL, 242, 92 },
+  { 0x924d692ca61be758ULL, 269, 100 },
+  { 0xda01ee641a708deaULL, 295, 108 },
+  { 0xa26da3999aef774aULL, 322, 116 },
+  { 0xf209787bb47d6b85ULL, 348, 124 },
+  { 0xb454e4a179dd1877ULL, 375, 132 },
+  { 0x865b86925b9bc5c2ULL, 402, 140 },
+  { 0xc83553c5c8965d3dULL, 428, 148 },
+  { 0x952ab45cfa97a0b3ULL, 455, 156 },
+  { 0xde469fbd99a05fe3ULL, 481, 164 },
+  { 0xa59bc234db398c25ULL, 508, 172 },
+  { 0xf6c69a72a3989f5cULL, 534, 180 },
+  { 0xb7dcbf5354e9beceULL, 561, 188 },
+  { 0x88fcf317f22241e2ULL, 588, 196 },
+  { 0xcc20ce9bd35c78a5ULL, 614, 204 },
+  { 0x98165af37b2153dfULL, 641, 212 },
+  { 0xe2a0b5dc971f303aULL, 667, 220 },
+  { 0xa8d9d1535ce3b396ULL, 694, 228 },
+  { 0xfb9b7cd9a4a7443cULL, 720, 236 },
+  { 0xbb764c4ca7a44410ULL, 747, 244 },
+  { 0x8bab8eefb6409c1aULL, 774, 252 },
+  { 0xd01fef10a657842cULL, 800, 260 },
+  { 0x9b10a4e5e9913129ULL, 827, 268 },
+  { 0xe7109bfba19c0c9dULL, 853, 276 },
+  { 0xac2820d9623bf429ULL, 880, 284 },
+  { 0x80444b5e7aa7cf85ULL, 907, 292 },
+  { 0xbf21e44003acdd2dULL, 933, 300 },
+  { 0x8e679c2f5e44ff8fULL, 960, 308 },
+  { 0xd433179d9c8cb841ULL, 986, 316 },
+  { 0x9e19db92b4e31ba9ULL, 1013, 324 },
+  { 0xeb96bf6ebadf77d9ULL, 1039, 332 },
+  { 0xaf87023b9bf0ee6bULL, 1066, 340 },
+};
+const int kCachedPowersOffset = 348;
+const int kDecimalExponentDistance = 8;
+const int kMinimalTargetExponent = -60;
+const int kMaximalTargetExponent = -32;
+
+inline DiyFp multiply(DiyFp x, DiyFp y)
+{
+  // rounds the lower 64 bits of the product
+  const unsigned __int128 product = static_cast<unsigned __int128>(x.f) * y.f;
+  const uint64_t high = static_cast<uint64_t>(product >> 64);
+  const uint64_t round = static_cast<uint64_t>(product >> 63) & 1;
+  DiyFp result = { high + round, x.e + y.e + 64 };
+  return result;
+}
+
+// v must be positive and finite
+inline DiyFp normalize(double v)
+{
+  uint64_t bits;
+  memcpy(&bits, &v, sizeof bits);
+  const uint64_t kHiddenBit = static_cast<uint64_t>(1) << 52;
+  const int biasedExponent = static_cast<int>(bits >> 52) & 0x7FF;
+  DiyFp w;
+  if (biasedExponent == 0)
+  {
+    // denormal
+    w.f = bits & (kHiddenBit - 1);
+    w.e = 1 - 1075;
+  }
+  else
+  {
+    w.f = (bits & (kHiddenBit - 1)) | kHiddenBit;
+    w.e = biasedExponent - 1075;
+  }
+  const int shift = __builtin_clzll(w.f);
+  w.f <<= shift;
+  w.e -= shift;
+  return w;
+}
+
+// a cached 10^k, such that w * 10^k has a binary exponent in the target range
+inline DiyFp cachedPower(int e, int* decimalExponent)
+{
+  const double kD_1_LOG2_10 = 0.30102999566398114;  //  1 / lg(10)
+  const int minExponent = kMinimalTargetExponent - (e + 64);
+  const int k = static_cast<int>(ceil((minExponent + 64 - 1) * kD_1_LOG2_10));
+  const int index = (kCachedPowersOffset + k - 1) / kDecimalExponentDistance + 1;
+  const CachedPower& power = kCachedPowers[index];
+  assert(minExponent <= power.binaryExponent);
+  assert(power.binaryExponent <= kMaximalTargetExponent - (e + 64));
+  *decimalExponent = power.decimalExponent;
+  DiyFp result = { power.significand, power.binaryExponent };
+  return result;
+}
+
+// rounds the last digit, with rest in [0, tenKappa) and an error of unit,
+// false if the error is too large to decide.
+bool roundWeedCounted(char* buffer, int length, uint64_t rest,
+                      uint64_t tenKappa, uint64_t unit, int* kappa)
+{
+  assert(rest < tenKappa);
+  if (unit >= tenKappa || tenKappa - unit <= unit)
+  {
+    return false;
+  }
+  // 2 * (rest + unit) <= 10^kappa, rounds down
+  if (tenKappa - rest > rest && tenKappa - 2 * rest >= 2 * unit)
+  {
+    return true;
+  }
+  // 2 * (rest - unit) >= 10^kappa, rounds up
+  if (rest > unit && tenKappa - (rest - unit) <= rest - unit)
+  {
+    buffer[length - 1]++;
+    for (int i = length - 1; i > 0; --i)
+    {
+      if (buffer[i] != '0' + 10)
+      {
+        break;
+      }
+      buffer[i] = '0';
+      buffer[i - 1]++;
+    }
+    if (buffer[0] == '0' + 10)
+    {
+      buffer[0] = '1';
+      *kappa += 1;
+    }
+    return true;
+  }
+  return false;
+}
+
+// generates exactly count digits of w, with the decimal exponent of the last
+// one in *kappa, on top of the cached power.
+bool digitGenCounted(DiyFp w, int count, char* buffer, int* kappa)
+{
+  assert(kMinimalTargetExponent <= w.e && w.e <= kMaximalTargetExponent);
+  uint64_t error = 1;
+  const int shift = -w.e;
+  const uint64_t one = static_cast<uint64_t>(1) << shift;
+  uint32_t integrals = static_cast<uint32_t>(w.f >> shift);
+  uint64_t fractionals = w.f & (one - 1);
+  assert(integrals > 0);
+
+  uint32_t divisor = 1;
+  *kappa = 1;
+  while (divisor <= integrals / 10)
+  {
+    divisor *= 10;
+    ++*kappa;
+  }
+
+  int length = 0;
+  while (*kappa > 0)
+  {
+    buffer[length++] = static_cast<char>('0' + integrals / divisor);
+    integrals %= divisor;
+    --*kappa;
+    if (--count == 0)
+    {
+      const uint64_t rest = (static_cast<uint64_t>(integrals) << shift) + fractionals;
+      return roundWeedCounted(buffer, length, rest,
+                              static_cast<uint64_t>(divisor) << shift, error, kappa);
+    }
+    divisor /= 10;
+  }
+
+  // Unlike double-conversion, goes on when fractionals is within the error,
+  // eg. for integers, the digits may be one too large or too small, but
+  // roundWeedCounted() accepts them only if rounding either way is the same.
+  while (count > 0)
+  {
+    if (error >= one / 10)
+    {
+      return false;
+    }
+    fractionals *= 10;
+    error *= 10;
+    buffer[length++] = static_cast<char>('0' + (fractionals >> shift));
+    fractionals &= one - 1;
+    --*kappa;
+    --count;
+  }
+  return roundWeedCounted(buffer, length, fractionals, one, error, kappa);
+}
+
+// printf("%.*g", precision, v), v must be positive and finite.
+// returns 0 if it can't be done fast.
+size_t formatPrecision(char* buf, double v, int precision)
+{
+  char digits[32];
+  const DiyFp w = normalize(v);
+  int mk = 0;
+  const DiyFp tenMk = cachedPower(w.e, &mk);
+  int kappa = 0;
+  if (!digitGenCounted(multiply(w, tenMk), precision, digits, &kappa))
+  {
+    return 0;
+  }
+
+  int length = precision;
+  while (length > 1 && digits[length - 1] == '0')
+  {
+    --length;
+  }
+  // v = 0.d1d2d3... * 10^(exponent+1)
+  const int exponent = kappa - mk + precision - 1;
+
+  char* p = buf;
+  if (exponent < -4 || exponent >= precision)
+  {
+    *p++ = digits[0];
+    if (length > 1)
+    {
+      *p++ = '.';
+      memcpy(p, digits + 1, length - 1);
+      p += length - 1;
+    }
+    *p++ = 'e';
+    *p++ = exponent < 0 ? '-' : '+';
+    const unsigned absExponent = exponent < 0 ? -exponent : exponent;
+    if (absExponent < 10)
+    {
+      *p++ = '0';
+    }
+    char tmp[8];
+    char* end = tmp + sizeof tmp;
+    char* start = formatDecimalBackward(end, absExponent);
+    memcpy(p, start, end - start);
+    p += end - start;
+  }
+  else if (exponent >= 0)
+  {
+    const int integers = exponent + 1;
+    if (length <= integers)
+    {
+      memcpy(p, digits, length);
+      p += length;
+      memset(p, '0', integers - length);
+      p += integers - length;
+    }
+    else
+    {
+      memcpy(p, digits, integers);
+      p += integers;
+      *p++ = '.';
+      memcpy(p, digits + integers, length - integers);
+      p += length - integers;
+    }
+  }
+  else
+  {
+    *p++ = '0';
+    *p++ = '.';
+    memset(p, '0', -exponent - 1);
+    p += -exponent - 1;
+    memcpy(p, digits, length);
+    p += length;
+  }
+  *p = '\0';
+  return p - buf;
+}
+
+}  // namespace grisu
+
+size_t formatDouble(char buf[], double v)
+{
+  const int kPrecision = 12;
+  if (v > 0 && std::isfinite(v))
+  {
+    size_t len = grisu::formatPrecision(buf, v, kPrecision);
+    if (len > 0)
+      return len;
+  }
+  else if (v < 0 && std::isfinite(v))
+  {
+    size_t len = grisu::formatPrecision(buf + 1, -v, kPrecision);
+    if (len > 0)
+    {
+      buf[0] = '-';
+      return len + 1;
+    }
+  }
+  // zeros, inf, nan and the rare ones
+  return snprintf(buf, 32, "%.*g", kPrecision, v);
+}
+
 template class FixedBuffer<kSmallBuffer>;
 template class FixedBuffer<kLargeBuffer>;
 
@@ -184,12 +576,11 @@ LogStream& LogStream::operator<<(const void* p)
   return *this;
 }
 
-// FIXME: replace this with Grisu3 by Florian Loitsch.
 LogStream& LogStream::operator<<(double v)
 {
   if (buffer_.avail() >= kMaxNumericSize)
   {
-    int len = snprintf(buffer_.current(), kMaxNumericSize, "%.12g", v);
+    size_t len = formatDouble(buffer_.current(), v);
     buffer_.add(len);
   }
   return *this;
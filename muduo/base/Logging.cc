@@ -5,7 +5,9 @@
 
 #include <muduo/base/Logging.h>
 
+#include <muduo/base/Clock.h>
 #include <muduo/base/CurrentThread.h>
+#include <muduo/base/TimeFormat.h>
 #include <muduo/base/Timestamp.h>
 #include <muduo/base/TimeZone.h>
 
@@ -36,8 +38,6 @@ class LoggerImpl
 */
 
 __thread char t_errnobuf[512];
-__thread char t_time[64];
-__thread time_t t_lastSecond;
 
 const char* strerror_tl(int savedErrno)
 {
@@ -114,7 +114,7 @@ TimeZone g_logTimeZone;
 using namespace muduo;
 
 Logger::Impl::Impl(LogLevel level, int savedErrno, const SourceFile& file, int line)
-  : time_(Timestamp::now()),
+  : time_(Clock::now()),
     stream_(),
     level_(level),
     line_(line),
@@ -135,37 +135,19 @@ void Logger::Impl::formatTime()
   int64_t microSecondsSinceEpoch = time_.microSecondsSinceEpoch();
   time_t seconds = static_cast<time_t>(microSecondsSinceEpoch / Timestamp::kMicroSecondsPerSecond);
   int microseconds = static_cast<int>(microSecondsSinceEpoch % Timestamp::kMicroSecondsPerSecond);
-  if (seconds != t_lastSecond)
-  {
-    t_lastSecond = seconds;
-    struct tm tm_time;
-    if (g_logTimeZone.valid())
-    {
-      tm_time = g_logTimeZone.toLocalTime(seconds);
-    }
-    else
-    {
-      ::gmtime_r(&seconds, &tm_time); // FIXME TimeZone::fromUtcTime
-    }
-
-    int len = snprintf(t_time, sizeof(t_time), "%4d%02d%02d %02d:%02d:%02d",
-        tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
-        tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec);
-    assert(len == 17); (void)len;
-  }
 
-  if (g_logTimeZone.valid())
-  {
-    Fmt us(".%06d ", microseconds);
-    assert(us.length() == 8);
-    stream_ << T(t_time, 17) << T(us.data(), 8);
-  }
-  else
+  char buf[32];
+  TimeFormat::formatDateTime(seconds, &g_logTimeZone, buf);
+  char* p = buf + TimeFormat::kDateTimeLength;
+  TimeFormat::formatMicroseconds(microseconds, p);
+  p += TimeFormat::kMicrosecondsLength;
+  if (!g_logTimeZone.valid())
   {
-    Fmt us(".%06dZ ", microseconds);
-    assert(us.length() == 9);
-    stream_ << T(t_time, 17) << T(us.data(), 9);
+    *p++ = 'Z';
   }
+  *p++ = ' ';
+  *p = '\0';
+  stream_ << T(buf, static_cast<unsigned>(p - buf));
 }
 
 void Logger::Impl::finish()
@@ -0,0 +1,292 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include <muduo/base/Metrics.h>
+
+#include <muduo/base/CurrentThread.h>
+#include <muduo/base/Logging.h>
+
+#include <new>
+#include <vector>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+
+namespace
+{
+
+const char* const kTypeNames[] = { "counter", "gauge", "summary" };
+enum MetricType { kCounter, kGauge, kSummary };
+
+// {labels,extra} or {extra}
+string mergeLabels(const string& labels, const string& extra)
+{
+  if (labels.empty() && extra.empty())
+  {
+    return string();
+  }
+  string result = "{" + labels;
+  if (!labels.empty() && !extra.empty())
+  {
+    result += ',';
+  }
+  result += extra;
+  result += '}';
+  return result;
+}
+
+}  // namespace
+
+static_assert(sizeof(Counter) == 8 * 64, "a cache line per shard");
+
+Counter::Counter()
+{
+  for (auto& shard : shards_)
+  {
+    shard.value.store(0, std::memory_order_relaxed);
+  }
+}
+
+void Counter::increment(int64_t n)
+{
+  shards_[CurrentThread::tid() % kShards].value.fetch_add(n, std::memory_order_relaxed);
+}
+
+void* Counter::operator new(size_t size)
+{
+  void* p = NULL;
+  if (::posix_memalign(&p, 64, size) != 0)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void Counter::operator delete(void* p)
+{
+  ::free(p);
+}
+
+int64_t Counter::value() const
+{
+  int64_t sum = 0;
+  for (const auto& shard : shards_)
+  {
+    sum += shard.value.load(std::memory_order_relaxed);
+  }
+  return sum;
+}
+
+struct MetricsRegistry::Family
+{
+  string help;
+  int type;
+  std::map<string, std::unique_ptr<Counter>> counters;
+  std::map<string, std::unique_ptr<Gauge>> gauges;
+  std::map<string, std::unique_ptr<Histogram>> histograms;
+};
+
+MetricsRegistry& MetricsRegistry::instance()
+{
+  // never destroyed, metrics may be updated by other threads at exit.
+  static MetricsRegistry* registry = new MetricsRegistry;
+  return *registry;
+}
+
+MetricsRegistry::MetricsRegistry() = default;
+MetricsRegistry::~MetricsRegistry() = default;
+
+MetricsRegistry::Family* MetricsRegistry::getFamily(const string& name,
+                                                    const string& help,
+                                                    int type)
+{
+  std::unique_ptr<Family>& family = families_[name];
+  if (!family)
+  {
+    family.reset(new Family);
+    family->help = help;
+    family->type = type;
+  }
+  else if (family->type != type)
+  {
+    LOG_FATAL << "metric " << name << " is a " << kTypeNames[family->type]
+              << ", not a " << kTypeNames[type];
+  }
+  return family.get();
+}
+
+Counter* MetricsRegistry::counter(const string& name, const string& help,
+                                  const string& labels)
+{
+  MutexLockGuard lock(mutex_);
+  std::unique_ptr<Counter>& metric = getFamily(name, help, kCounter)->counters[labels];
+  if (!metric)
+  {
+    metric.reset(new Counter);
+  }
+  return metric.get();
+}
+
+Gauge* MetricsRegistry::gauge(const string& name, const string& help,
+                              const string& labels)
+{
+  MutexLockGuard lock(mutex_);
+  std::unique_ptr<Gauge>& metric = getFamily(name, help, kGauge)->gauges[labels];
+  if (!metric)
+  {
+    metric.reset(new Gauge);
+  }
+  return metric.get();
+}
+
+Histogram* MetricsRegistry::histogram(const string& name, const string& help,
+                                      const string& labels)
+{
+  MutexLockGuard lock(mutex_);
+  std::unique_ptr<Histogram>& metric = getFamily(name, help, kSummary)->histograms[labels];
+  if (!metric)
+  {
+    metric.reset(new Histogram);
+  }
+  return metric.get();
+}
+
+void MetricsRegistry::addCollector(const string& key, const Collector& collector)
+{
+  MutexLockGuard lock(mutex_);
+  collectors_[key] = collector;
+}
+
+void MetricsRegistry::removeCollector(const string& key)
+{
+  MutexLockGuard lock(mutex_);
+  collectors_.erase(key);
+}
+
+string MetricsRegistry::exposition() const
+{
+  string result;
+  std::vector<Collector> collectors;
+  {
+  MutexLockGuard lock(mutex_);
+  for (const auto& it : families_)
+  {
+    const string& name = it.first;
+    const Family& family = *it.second;
+    appendHeader(&result, name, family.help, kTypeNames[family.type]);
+    for (const auto& metric : family.counters)
+    {
+      appendSample(&result, name, metric.first, metric.second->value());
+    }
+    for (const auto& metric : family.gauges)
+    {
+      appendSample(&result, name, metric.first, metric.second->value());
+    }
+    for (const auto& metric : family.histograms)
+    {
+      appendSummary(&result, name, metric.first, metric.second->snapshot());
+    }
+  }
+  for (const auto& it : collectors_)
+  {
+    collectors.push_back(it.second);
+  }
+  }
+
+  for (const auto& collector : collectors)
+  {
+    collector(&result);
+  }
+  return result;
+}
+
+string MetricsRegistry::label(const string& key, const string& value)
+{
+  string result = key + "=\"";
+  for (char c : value)
+  {
+    if (c == '\\' || c == '"')
+    {
+      result += '\\';
+      result += c;
+    }
+    else if (c == '\n')
+    {
+      result += "\\n";
+    }
+    else
+    {
+      result += c;
+    }
+  }
+  result += '"';
+  return result;
+}
+
+void MetricsRegistry::appendHeader(string* out, const string& name,
+                                   const string& help, const char* type)
+{
+  if (!help.empty())
+  {
+    *out += "# HELP " + name + " ";
+    // as label values, but quotes are kept
+    for (char c : help)
+    {
+      if (c == '\\')
+      {
+        *out += "\\\\";
+      }
+      else if (c == '\n')
+      {
+        *out += "\\n";
+      }
+      else
+      {
+        *out += c;
+      }
+    }
+    *out += '\n';
+  }
+  *out += "# TYPE " + name + " " + type + "\n";
+}
+
+void MetricsRegistry::appendSample(string* out, const string& name,
+                                   const string& labels, int64_t value)
+{
+  char buf[32];
+  snprintf(buf, sizeof buf, " %" PRId64 "\n", value);
+  *out += name;
+  *out += mergeLabels(labels, string());
+  *out += buf;
+}
+
+void MetricsRegistry::appendSample(string* out, const string& name,
+                                   const string& labels, double value)
+{
+  char buf[32];
+  snprintf(buf, sizeof buf, " %.15g\n", value);
+  *out += name;
+  *out += mergeLabels(labels, string());
+  *out += buf;
+}
+
+void MetricsRegistry::appendSummary(string* out, const string& name,
+                                    const string& labels, const Histogram::Snapshot& snapshot)
+{
+  static const double kQuantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+  for (double q : kQuantiles)
+  {
+    char quantile[32];
+    snprintf(quantile, sizeof quantile, "quantile=\"%g\"", q);
+    char buf[32];
+    snprintf(buf, sizeof buf, " %" PRId64 "\n", snapshot.percentile(q));
+    *out += name;
+    *out += mergeLabels(labels, quantile);
+    *out += buf;
+  }
+  appendSample(out, name + "_sum", labels, snapshot.sum());
+  appendSample(out, name + "_count", labels, snapshot.count());
+}
@@ -0,0 +1,124 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_BASE_METRICS_H
+#define MUDUO_BASE_METRICS_H
+
+#include <muduo/base/Histogram.h>
+#include <muduo/base/Mutex.h>
+#include <muduo/base/noncopyable.h>
+#include <muduo/base/Types.h>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+
+namespace muduo
+{
+
+///
+/// Monotonic counter, lock free.
+///
+/// Each thread adds to one of a few shards, each in a cache line of
+/// its own, which are summed up by value().
+class Counter : noncopyable
+{
+ public:
+  Counter();
+
+  void increment(int64_t n = 1);
+  int64_t value() const;
+
+  // cache line aligned, the operator new of C++11 aligns to 16 bytes only
+  static void* operator new(size_t size);
+  static void operator delete(void* p);
+
+ private:
+  static const int kShards = 8;
+  struct alignas(64) Shard
+  {
+    std::atomic<int64_t> value;
+  };
+  Shard shards_[kShards];
+};
+
+///
+/// Value that goes up and down, lock free.
+class Gauge : noncopyable
+{
+ public:
+  Gauge() : value_(0) { }
+
+  void set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+  void add(int64_t delta) { value_.fetch_add(delta, std::memory_order_relaxed); }
+  int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<int64_t> value_;
+};
+
+///
+/// Registry of counters, gauges and histograms of the process,
+/// rendered in the Prometheus text exposition format.
+///
+/// Metrics are created on first use and live as long as the process,
+/// so updating them needs no locking.
+class MetricsRegistry : noncopyable
+{
+ public:
+  /// appends samples in exposition format, with appendHeader() and appendSample()
+  typedef std::function<void (string* out)> Collector;
+
+  static MetricsRegistry& instance();
+
+  MetricsRegistry();
+  ~MetricsRegistry();
+
+  /// Returns the metric of @c name with @c labels, creates it if not exists.
+  /// @c labels looks like <tt>server="echo",port="80"</tt>, see label().
+  /// Metrics of the same name must be of same type.
+  Counter* counter(const string& name, const string& help,
+                   const string& labels = string());
+  Gauge* gauge(const string& name, const string& help,
+               const string& labels = string());
+  /// rendered as a summary, in microseconds by convention
+  Histogram* histogram(const string& name, const string& help,
+                       const string& labels = string());
+
+  /// For values computed on scrape, eg. from /proc or other registries.
+  /// @c collector is called without holding any lock.
+  void addCollector(const string& key, const Collector& collector);
+  void removeCollector(const string& key);
+
+  /// All metrics in Prometheus text format, version 0.0.4
+  string exposition() const;
+
+  /// <tt>key="value"</tt>, with value escaped.
+  static string label(const string& key, const string& value);
+  static void appendHeader(string* out, const string& name,
+                           const string& help, const char* type);
+  static void appendSample(string* out, const string& name,
+                           const string& labels, int64_t value);
+  static void appendSample(string* out, const string& name,
+                           const string& labels, double value);
+  /// quantiles, _sum and _count samples of a summary
+  static void appendSummary(string* out, const string& name,
+                            const string& labels, const Histogram::Snapshot& snapshot);
+
+ private:
+  struct Family;
+
+  Family* getFamily(const string& name, const string& help, int type)
+      REQUIRES(mutex_);
+
+  mutable MutexLock mutex_;
+  std::map<string, std::unique_ptr<Family>> families_ GUARDED_BY(mutex_);
+  std::map<string, Collector> collectors_ GUARDED_BY(mutex_);
+};
+
+}  // namespace muduo
+
+#endif  // MUDUO_BASE_METRICS_H
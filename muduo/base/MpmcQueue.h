@@ -0,0 +1,251 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_BASE_MPMCQUEUE_H
+#define MUDUO_BASE_MPMCQUEUE_H
+
+#include <muduo/base/Futex.h>
+#include <muduo/base/noncopyable.h>
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <assert.h>
+#include <limits.h>
+#include <stddef.h>
+
+namespace muduo
+{
+
+///
+/// Bounded lock-free multi-producer multi-consumer queue, by Dmitry Vyukov.
+/// http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+///
+/// Each cell has a sequence number telling whether it is ready for the
+/// producer or the consumer of a given round, so put and take cost one CAS
+/// each in the common case.  Capacity is rounded up to a power of 2.
+///
+/// put() and take() block on a futex only if the queue is full or empty,
+/// and make a syscall to wake up the other side only if someone is waiting.
+template<typename T>
+class MpmcQueue : noncopyable
+{
+ public:
+  explicit MpmcQueue(int maxSize)
+    : mask_(roundUp(maxSize) - 1),
+      cells_(new Cell[mask_ + 1]),
+      enqueuePos_(0),
+      dequeuePos_(0),
+      notEmptySeq_(0),
+      notFullSeq_(0)
+  {
+    for (size_t i = 0; i <= mask_; ++i)
+    {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  ~MpmcQueue()
+  {
+    T x;
+    while (tryTake(&x))
+    {
+    }
+  }
+
+  bool tryPut(const T& x)
+  {
+    return emplace(x);
+  }
+
+  bool tryPut(T&& x)
+  {
+    return emplace(std::move(x));
+  }
+
+  /// returns false if empty
+  bool tryTake(T* x)
+  {
+    Cell* cell;
+    size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      cell = &cells_[pos & mask_];
+      const size_t seq = cell->sequence.load(std::memory_order_acquire);
+      const intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (dif == 0)
+      {
+        if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (dif < 0)
+      {
+        return false;
+      }
+      else
+      {
+        pos = dequeuePos_.load(std::memory_order_relaxed);
+      }
+    }
+    T* data = cell->data();
+    *x = std::move(*data);
+    data->~T();
+    cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    signal(&notFullSeq_);
+    return true;
+  }
+
+  void put(const T& x)
+  {
+    if (!tryPut(x))
+    {
+      wait(&notFullSeq_, [this, &x] { return tryPut(x); });
+    }
+  }
+
+  void put(T&& x)
+  {
+    // x is moved from only on success
+    if (!tryPut(std::move(x)))
+    {
+      wait(&notFullSeq_, [this, &x] { return tryPut(std::move(x)); });
+    }
+  }
+
+  T take()
+  {
+    T x;
+    if (!tryTake(&x))
+    {
+      wait(&notEmptySeq_, [this, &x] { return tryTake(&x); });
+    }
+    return x;
+  }
+
+  /// approximate under concurrency
+  size_t size() const
+  {
+    const size_t tail = enqueuePos_.load(std::memory_order_acquire);
+    const size_t head = dequeuePos_.load(std::memory_order_acquire);
+    return tail > head ? tail - head : 0;
+  }
+
+  bool empty() const { return size() == 0; }
+  bool full() const { return size() >= capacity(); }
+  size_t capacity() const { return mask_ + 1; }
+
+ private:
+  static const size_t kCacheLine = 64;
+
+  struct Cell
+  {
+    std::atomic<size_t> sequence;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+    T* data() { return reinterpret_cast<T*>(&storage); }
+  };
+
+  static size_t roundUp(int maxSize)
+  {
+    assert(maxSize > 0);
+    size_t n = 2;
+    while (n < static_cast<size_t>(maxSize))
+    {
+      n <<= 1;
+    }
+    return n;
+  }
+
+  template<typename U>
+  bool emplace(U&& x)
+  {
+    Cell* cell;
+    size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      cell = &cells_[pos & mask_];
+      const size_t seq = cell->sequence.load(std::memory_order_acquire);
+      const intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (dif == 0)
+      {
+        if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (dif < 0)
+      {
+        return false;
+      }
+      else
+      {
+        pos = enqueuePos_.load(std::memory_order_relaxed);
+      }
+    }
+    new (cell->data()) T(std::forward<U>(x));
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    signal(&notEmptySeq_);
+    return true;
+  }
+
+  // Eventcount on a futex word, whose low bit is set by waiters.
+  // The waiter sets it, then retries before sleeping, the signaler
+  // publishes, then checks it.  The fences make sure one of them sees
+  // the other.  Only the first signal after a waiter sets the bit makes
+  // a syscall, waking all of the waiters.
+  template<typename Retry>
+  void wait(std::atomic<uint32_t>* seq, Retry retry)
+  {
+    for (;;)
+    {
+      uint32_t key = seq->load(std::memory_order_relaxed);
+      if ((key & 1) == 0 && !seq->compare_exchange_strong(key, key | 1))
+      {
+        continue;
+      }
+      key |= 1;
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (retry())
+      {
+        return;
+      }
+      futexWait(seq, key);
+      if (retry())
+      {
+        return;
+      }
+    }
+  }
+
+  void signal(std::atomic<uint32_t>* seq)
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint32_t key = seq->load(std::memory_order_relaxed);
+    if ((key & 1) && seq->compare_exchange_strong(key, key + 1))
+    {
+      futexWake(seq, INT_MAX);
+    }
+  }
+
+  const size_t mask_;
+  const std::unique_ptr<Cell[]> cells_;
+
+  // producers and consumers spin on their own cache lines
+  char pad0_[kCacheLine];
+  std::atomic<size_t> enqueuePos_;
+  char pad1_[kCacheLine - sizeof(size_t)];
+  std::atomic<size_t> dequeuePos_;
+  char pad2_[kCacheLine - sizeof(size_t)];
+
+  std::atomic<uint32_t> notEmptySeq_;
+  char pad3_[kCacheLine - sizeof(uint32_t)];
+  std::atomic<uint32_t> notFullSeq_;
+  char pad4_[kCacheLine - sizeof(uint32_t)];
+};
+
+}  // namespace muduo
+
+#endif  // MUDUO_BASE_MPMCQUEUE_H
@@ -0,0 +1,140 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include <muduo/base/ObjectPool.h>
+
+#include <muduo/base/CurrentThread.h>
+
+#include <assert.h>
+
+using namespace muduo;
+
+ObjectPool::ObjectPool(size_t maxFreeBlocks)
+  : ownerTid_(CurrentThread::tid()),
+    maxFreeBlocks_(maxFreeBlocks),
+    hits_(0),
+    misses_(0)
+{
+  for (SizeClass& sc : classes_)
+  {
+    sc.freeList = NULL;
+    sc.count = 0;
+    sc.remote.store(NULL, std::memory_order_relaxed);
+    sc.remoteCount.store(0, std::memory_order_relaxed);
+  }
+}
+
+ObjectPool::~ObjectPool()
+{
+  // no one else holds the pool now
+  for (SizeClass& sc : classes_)
+  {
+    Block* lists[] = { sc.freeList, sc.remote.exchange(NULL, std::memory_order_acquire) };
+    for (Block* b : lists)
+    {
+      while (b)
+      {
+        Block* next = b->next;
+        ::operator delete(b);
+        b = next;
+      }
+    }
+  }
+}
+
+bool ObjectPool::isOwnerThread() const
+{
+  return CurrentThread::tid() == ownerTid_;
+}
+
+void* ObjectPool::allocate(size_t size)
+{
+  if (size > kMaxBlockSize)
+  {
+    return ::operator new(size);
+  }
+  const size_t index = classIndex(size);
+  if (!isOwnerThread())
+  {
+    // blocks are interchangeable within a size class
+    return ::operator new(blockSize(index));
+  }
+  SizeClass& sc = classes_[index];
+  if (sc.freeList == NULL && sc.remote.load(std::memory_order_relaxed) != NULL)
+  {
+    Block* b = sc.remote.exchange(NULL, std::memory_order_acquire);
+    size_t taken = 0;
+    while (b)
+    {
+      Block* next = b->next;
+      ++taken;
+      if (sc.count < maxFreeBlocks_)
+      {
+        b->next = sc.freeList;
+        sc.freeList = b;
+        ++sc.count;
+      }
+      else
+      {
+        ::operator delete(b);
+      }
+      b = next;
+    }
+    sc.remoteCount.fetch_sub(taken, std::memory_order_relaxed);
+  }
+  if (Block* b = sc.freeList)
+  {
+    sc.freeList = b->next;
+    --sc.count;
+    increment(&hits_);
+    return b;
+  }
+  increment(&misses_);
+  return ::operator new(blockSize(index));
+}
+
+void ObjectPool::deallocate(void* p, size_t size)
+{
+  if (p == NULL)
+  {
+    return;
+  }
+  if (size > kMaxBlockSize)
+  {
+    ::operator delete(p);
+    return;
+  }
+  SizeClass& sc = classes_[classIndex(size)];
+  Block* b = static_cast<Block*>(p);
+  if (isOwnerThread())
+  {
+    if (sc.count < maxFreeBlocks_)
+    {
+      b->next = sc.freeList;
+      sc.freeList = b;
+      ++sc.count;
+    }
+    else
+    {
+      ::operator delete(p);
+    }
+  }
+  else
+  {
+    // bounded, or a thread freeing what the owner never allocates again
+    // would grow the list for good
+    if (sc.remoteCount.fetch_add(1, std::memory_order_relaxed) >= maxFreeBlocks_)
+    {
+      sc.remoteCount.fetch_sub(1, std::memory_order_relaxed);
+      ::operator delete(p);
+      return;
+    }
+    // the owner takes the whole list at once, so no ABA here
+    Block* head = sc.remote.load(std::memory_order_relaxed);
+    do
+    {
+      b->next = head;
+    } while (!sc.remote.compare_exchange_weak(head, b, std::memory_order_release,
+                                              std::memory_order_relaxed));
+  }
+}
@@ -0,0 +1,198 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_BASE_OBJECTPOOL_H
+#define MUDUO_BASE_OBJECTPOOL_H
+
+#include <muduo/base/noncopyable.h>
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace muduo
+{
+
+///
+/// Free lists of memory blocks in size classes of 64 bytes, for objects
+/// created and destroyed at high rate, eg. TcpConnection.
+///
+/// The owner, the thread constructing the pool, allocates and frees without
+/// locking.  Other threads allocate from the heap, and give blocks back to
+/// a lock-free list, which the owner takes over as a whole when its own list
+/// of that size runs dry.  Either list holds up to maxFreeBlocks, the rest
+/// go back to the heap.
+///
+/// Blocks come from ::operator new, so they are aligned like malloc(3), not
+/// to kSizeClassStep.  Blocks larger than kMaxBlockSize come from the heap
+/// directly.
+class ObjectPool : noncopyable
+{
+ public:
+  static const size_t kSizeClassStep = 64;
+  static const size_t kMaxBlockSize = 4096;
+
+  explicit ObjectPool(size_t maxFreeBlocks = 1024);
+  ~ObjectPool();
+
+  void* allocate(size_t size);
+  void deallocate(void* p, size_t size);
+
+  bool isOwnerThread() const;
+  size_t maxFreeBlocks() const { return maxFreeBlocks_; }
+
+  /// allocations served from the free lists
+  int64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+  /// allocations from the heap
+  int64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+ private:
+  struct Block
+  {
+    Block* next;
+  };
+
+  struct SizeClass
+  {
+    Block* freeList;
+    size_t count;
+    std::atomic<Block*> remote;
+    std::atomic<size_t> remoteCount;  // blocks in or being pushed to remote
+  };
+
+  static const size_t kNumClasses = kMaxBlockSize / kSizeClassStep;
+
+  static size_t classIndex(size_t size) { return (size + kSizeClassStep - 1) / kSizeClassStep - 1; }
+  static size_t blockSize(size_t index) { return (index + 1) * kSizeClassStep; }
+
+  static void increment(std::atomic<int64_t>* counter)
+  {
+    // only the owner writes
+    counter->store(counter->load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  const pid_t ownerTid_;
+  const size_t maxFreeBlocks_;
+  SizeClass classes_[kNumClasses];
+  std::atomic<int64_t> hits_;
+  std::atomic<int64_t> misses_;
+};
+
+///
+/// Allocator over an ObjectPool, for std::allocate_shared() and containers.
+///
+/// Holds the pool by shared_ptr, so objects may outlive whoever created the
+/// pool, eg. a TcpConnection destroyed after its EventLoop.
+template<typename T>
+class PoolAllocator
+{
+ public:
+  typedef T value_type;
+
+  explicit PoolAllocator(const std::shared_ptr<ObjectPool>& pool)
+    : pool_(pool)
+  {
+  }
+
+  template<typename U>
+  PoolAllocator(const PoolAllocator<U>& other)
+    : pool_(other.pool())
+  {
+  }
+
+  T* allocate(size_t n)
+  {
+    const size_t size = n * sizeof(T);
+    return static_cast<T*>(pool_ ? pool_->allocate(size) : ::operator new(size));
+  }
+
+  void deallocate(T* p, size_t n)
+  {
+    if (pool_)
+    {
+      pool_->deallocate(p, n * sizeof(T));
+    }
+    else
+    {
+      ::operator delete(p);
+    }
+  }
+
+  const std::shared_ptr<ObjectPool>& pool() const { return pool_; }
+
+ private:
+  std::shared_ptr<ObjectPool> pool_;
+};
+
+template<typename T, typename U>
+bool operator==(const PoolAllocator<T>& lhs, const PoolAllocator<U>& rhs)
+{
+  return lhs.pool() == rhs.pool();
+}
+
+template<typename T, typename U>
+bool operator!=(const PoolAllocator<T>& lhs, const PoolAllocator<U>& rhs)
+{
+  return !(lhs == rhs);
+}
+
+///
+/// Deleter for std::unique_ptr of objects made by makeUniqueFromPool().
+///
+/// Holds a plain pointer, the owner of the unique_ptr must keep the pool alive.
+template<typename T>
+struct PoolDeleter
+{
+  PoolDeleter() : pool(NULL) {}
+  explicit PoolDeleter(ObjectPool* p) : pool(p) {}
+
+  void operator()(T* p) const
+  {
+    p->~T();
+    if (pool)
+    {
+      pool->deallocate(p, sizeof(T));
+    }
+    else
+    {
+      ::operator delete(p);
+    }
+  }
+
+  ObjectPool* pool;
+};
+
+/// Constructs a T in a block of pool, or on the heap if pool is NULL.
+template<typename T, typename... Args>
+std::unique_ptr<T, PoolDeleter<T>> makeUniqueFromPool(ObjectPool* pool, Args&&... args)
+{
+  void* p = pool ? pool->allocate(sizeof(T)) : ::operator new(sizeof(T));
+  try
+  {
+    return std::unique_ptr<T, PoolDeleter<T>>(
+        new (p) T(std::forward<Args>(args)...), PoolDeleter<T>(pool));
+  }
+  catch (...)
+  {
+    if (pool)
+    {
+      pool->deallocate(p, sizeof(T));
+    }
+    else
+    {
+      ::operator delete(p);
+    }
+    throw;
+  }
+}
+
+}  // namespace muduo
+
+#endif  // MUDUO_BASE_OBJECTPOOL_H
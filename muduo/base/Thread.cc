@@ -4,6 +4,7 @@
 // Author: Shuo Chen (chenshuo at chenshuo dot com)
 
 #include <muduo/base/Thread.h>
+#include <muduo/base/CpuProfiler.h>
 #include <muduo/base/CurrentThread.h>
 #include <muduo/base/Exception.h>
 #include <muduo/base/Logging.h>
@@ -76,6 +77,7 @@ struct ThreadData
 
     muduo::CurrentThread::t_threadName = name_.empty() ? "muduoThread" : name_.c_str();
     ::prctl(PR_SET_NAME, muduo::CurrentThread::t_threadName);
+    muduo::CpuProfiler::registerThread();
     try
     {
       func_();
@@ -88,6 +88,24 @@ void ThreadPool::run(Task task)
   }
 }
 
+bool ThreadPool::tryRun(Task task, size_t maxQueueSize)
+{
+  if (threads_.empty())
+  {
+    task();
+    return true;
+  }
+
+  MutexLockGuard lock(mutex_);
+  if (!running_ || isFull() || (maxQueueSize > 0 && queue_.size() >= maxQueueSize))
+  {
+    return false;
+  }
+  queue_.push_back(std::move(task));
+  notEmpty_.notify();
+  return true;
+}
+
 ThreadPool::Task ThreadPool::take()
 {
   MutexLockGuard lock(mutex_);
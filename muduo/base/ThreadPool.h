@@ -41,6 +41,12 @@ class ThreadPool : noncopyable
   // Could block if maxQueueSize > 0
   void run(Task f);
 
+  // Never blocks, returns false if the queue is full or the pool is stopped.
+  bool tryRun(Task f) { return tryRun(std::move(f), 0); }
+  // Also returns false if maxQueueSize tasks are queued, 0 means no limit
+  // other than setMaxQueueSize().
+  bool tryRun(Task f, size_t maxQueueSize);
+
  private:
   bool isFull() const REQUIRES(mutex_);
   void runInThread();
@@ -0,0 +1,133 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include <muduo/base/TimeFormat.h>
+
+#include <muduo/base/TimeZone.h>
+
+#include <assert.h>
+#include <string.h>
+
+using namespace muduo;
+
+namespace
+{
+
+const char kDigitPairs[201] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+// Out of range values, like years after 9999 or the negative microseconds
+// of a time before 1970, are clamped instead of indexing past the tables.
+inline int clamp(int value, int maxValue)
+{
+  return value < 0 ? 0 : (value > maxValue ? maxValue : value);
+}
+
+inline char* format2(int value, char* buf)
+{
+  value = clamp(value, 99);
+  memcpy(buf, kDigitPairs + value * 2, 2);
+  return buf + 2;
+}
+
+inline char* format4(int value, char* buf)
+{
+  value = clamp(value, 9999);
+  return format2(value % 100, format2(value / 100, buf));
+}
+
+const char kWeekDays[] = "SunMonTueWedThuFriSat";
+const char kMonths[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+// the last formatted second, per thread
+__thread time_t t_dateTimeSecond = -1;
+__thread char t_dateTime[TimeFormat::kDateTimeLength];
+__thread time_t t_httpDateSecond = -1;
+__thread char t_httpDate[TimeFormat::kHttpDateLength];
+
+}  // namespace
+
+void TimeFormat::formatDateTime(time_t seconds, const TimeZone* zone, char* buf)
+{
+  if (zone && zone->valid())
+  {
+    seconds += zone->utcOffset(seconds);
+  }
+  if (seconds != t_dateTimeSecond)
+  {
+    struct tm tm_time = TimeZone::toUtcTime(seconds);
+    char* p = format4(tm_time.tm_year + 1900, t_dateTime);
+    p = format2(tm_time.tm_mon + 1, p);
+    p = format2(tm_time.tm_mday, p);
+    *p++ = ' ';
+    p = format2(tm_time.tm_hour, p);
+    *p++ = ':';
+    p = format2(tm_time.tm_min, p);
+    *p++ = ':';
+    p = format2(tm_time.tm_sec, p);
+    assert(p == t_dateTime + kDateTimeLength);
+    t_dateTimeSecond = seconds;
+  }
+  memcpy(buf, t_dateTime, kDateTimeLength);
+}
+
+void TimeFormat::formatMicroseconds(int microseconds, char* buf)
+{
+  microseconds = clamp(microseconds, 999999);
+  buf[0] = '.';
+  char* p = format2(microseconds / 10000, buf + 1);
+  p = format2(microseconds / 100 % 100, p);
+  format2(microseconds % 100, p);
+}
+
+void TimeFormat::formatFileTime(time_t seconds, char* buf)
+{
+  struct tm tm_time = TimeZone::toUtcTime(seconds);
+  char* p = format4(tm_time.tm_year + 1900, buf);
+  p = format2(tm_time.tm_mon + 1, p);
+  p = format2(tm_time.tm_mday, p);
+  *p++ = '-';
+  p = format2(tm_time.tm_hour, p);
+  p = format2(tm_time.tm_min, p);
+  p = format2(tm_time.tm_sec, p);
+  assert(p == buf + kFileTimeLength);
+}
+
+void TimeFormat::formatHttpDate(time_t seconds, char* buf)
+{
+  if (seconds != t_httpDateSecond)
+  {
+    struct tm tm_time = TimeZone::toUtcTime(seconds);
+    char* p = t_httpDate;
+    memcpy(p, kWeekDays + clamp(tm_time.tm_wday, 6) * 3, 3);
+    p += 3;
+    *p++ = ',';
+    *p++ = ' ';
+    p = format2(tm_time.tm_mday, p);
+    *p++ = ' ';
+    memcpy(p, kMonths + clamp(tm_time.tm_mon, 11) * 3, 3);
+    p += 3;
+    *p++ = ' ';
+    p = format4(tm_time.tm_year + 1900, p);
+    *p++ = ' ';
+    p = format2(tm_time.tm_hour, p);
+    *p++ = ':';
+    p = format2(tm_time.tm_min, p);
+    *p++ = ':';
+    p = format2(tm_time.tm_sec, p);
+    memcpy(p, " GMT", 4);
+    p += 4;
+    assert(p == t_httpDate + kHttpDateLength);
+    t_httpDateSecond = seconds;
+  }
+  memcpy(buf, t_httpDate, kHttpDateLength);
+}
@@ -0,0 +1,45 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_BASE_TIMEFORMAT_H
+#define MUDUO_BASE_TIMEFORMAT_H
+
+#include <time.h>
+
+namespace muduo
+{
+
+class TimeZone;
+
+///
+/// Fast formatting of time, shared by Logging, Timestamp, LogFile and
+/// HttpResponse.  Digits are emitted two at a time from a table, and the
+/// date part is cached per thread, so formatting the current time costs
+/// a compare and a copy most of the time.
+///
+/// None of them NUL-terminates @c buf.
+namespace TimeFormat
+{
+
+const int kDateTimeLength = 17;
+/// "20261019 14:39:28", @c zone is NULL or invalid for UTC.
+void formatDateTime(time_t secondsSinceEpoch, const TimeZone* zone, char* buf);
+
+const int kMicrosecondsLength = 7;
+/// ".012345"
+void formatMicroseconds(int microseconds, char* buf);
+
+const int kFileTimeLength = 15;
+/// "20261019-143928" in UTC, for file names.
+void formatFileTime(time_t secondsSinceEpoch, char* buf);
+
+const int kHttpDateLength = 29;
+/// "Mon, 19 Oct 2026 14:39:28 GMT" of RFC 7231.
+void formatHttpDate(time_t secondsSinceEpoch, char* buf);
+
+}  // namespace TimeFormat
+}  // namespace muduo
+
+#endif  // MUDUO_BASE_TIMEFORMAT_H
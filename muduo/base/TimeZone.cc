@@ -8,6 +8,8 @@
 #include <muduo/base/Date.h>
 
 #include <algorithm>
+#include <atomic>
+#include <limits>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -81,6 +83,8 @@ inline void fillHMS(unsigned seconds, struct tm* utc)
   utc->tm_hour = minutes / 60;
 }
 
+std::atomic<int64_t> g_numZones(0);
+
 }  // namespace detail
 const int kSecondsPerDay = 24*60*60;
 }  // namespace muduo
@@ -90,6 +94,8 @@ using namespace std;
 
 struct TimeZone::Data
 {
+  // identifies the zone in the per-thread caches
+  const int64_t id = ++detail::g_numZones;
   vector<detail::Transition> transitions;
   vector<detail::Localtime> localtimes;
   vector<string> names;
@@ -254,6 +260,50 @@ const Localtime* findLocaltime(const TimeZone::Data& data, Transition sentry, Co
   return local;
 }
 
+// the local time type of a zone is cached per thread until the next transition
+__thread int64_t t_cachedZone = 0;
+__thread time_t t_cachedFrom;
+__thread time_t t_cachedUntil;
+__thread const Localtime* t_cachedLocal;
+
+const Localtime* findLocaltimeCached(const TimeZone::Data& data, time_t seconds)
+{
+  if (t_cachedZone == data.id && t_cachedFrom <= seconds && seconds < t_cachedUntil)
+  {
+    return t_cachedLocal;
+  }
+
+  const vector<Transition>& transitions = data.transitions;
+  time_t from = std::numeric_limits<time_t>::min();
+  time_t until = std::numeric_limits<time_t>::max();
+  // the first transition after seconds
+  vector<Transition>::const_iterator next = upper_bound(transitions.begin(),
+                                                        transitions.end(),
+                                                        Transition(seconds, 0, 0),
+                                                        Comp(true));
+  const Localtime* local = NULL;
+  if (next == transitions.begin())
+  {
+    // FIXME: should be first non dst time zone
+    local = &data.localtimes.front();
+  }
+  else
+  {
+    local = &data.localtimes[(next - 1)->localtimeIdx];
+    from = (next - 1)->gmttime;
+  }
+  if (next != transitions.end())
+  {
+    until = next->gmttime;
+  }
+
+  t_cachedZone = data.id;
+  t_cachedFrom = from;
+  t_cachedUntil = until;
+  t_cachedLocal = local;
+  return local;
+}
+
 }  // namespace detail
 }  // namespace muduo
 
@@ -281,8 +331,7 @@ struct tm TimeZone::toLocalTime(time_t seconds) const
   assert(data_ != NULL);
   const Data& data(*data_);
 
-  detail::Transition sentry(seconds, 0, 0);
-  const detail::Localtime* local = findLocaltime(data, sentry, detail::Comp(true));
+  const detail::Localtime* local = detail::findLocaltimeCached(data, seconds);
 
   if (local)
   {
@@ -296,6 +345,12 @@ struct tm TimeZone::toLocalTime(time_t seconds) const
   return localTime;
 }
 
+int TimeZone::utcOffset(time_t seconds) const
+{
+  assert(data_ != NULL);
+  return static_cast<int>(detail::findLocaltimeCached(*data_, seconds)->gmtOffset);
+}
+
 time_t TimeZone::fromLocalTime(const struct tm& localTm) const
 {
   assert(data_ != NULL);
@@ -29,7 +29,11 @@ class TimeZone : public muduo::copyable
     return static_cast<bool>(data_);
   }
 
+  // Both are cached per thread until the next transition of this zone,
+  // so it's cheap to call them for the current time again and again.
   struct tm toLocalTime(time_t secondsSinceEpoch) const;
+  // seconds east of UTC
+  int utcOffset(time_t secondsSinceEpoch) const;
   time_t fromLocalTime(const struct tm&) const;
 
   // gmtime(3)
@@ -4,6 +4,7 @@
 // Author: Shuo Chen (chenshuo at chenshuo dot com)
 
 #include <muduo/base/Timestamp.h>
+#include <muduo/base/TimeFormat.h>
 
 #include <sys/time.h>
 #include <stdio.h>
@@ -30,26 +31,17 @@ string Timestamp::toString() const
 
 string Timestamp::toFormattedString(bool showMicroseconds) const
 {
-  char buf[64] = {0};
+  char buf[32];
   time_t seconds = static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond);
-  struct tm tm_time;
-  gmtime_r(&seconds, &tm_time);
-
+  TimeFormat::formatDateTime(seconds, NULL, buf);
+  size_t len = TimeFormat::kDateTimeLength;
   if (showMicroseconds)
   {
     int microseconds = static_cast<int>(microSecondsSinceEpoch_ % kMicroSecondsPerSecond);
-    snprintf(buf, sizeof(buf), "%4d%02d%02d %02d:%02d:%02d.%06d",
-             tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
-             tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec,
-             microseconds);
-  }
-  else
-  {
-    snprintf(buf, sizeof(buf), "%4d%02d%02d %02d:%02d:%02d",
-             tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
-             tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec);
+    TimeFormat::formatMicroseconds(microseconds, buf + len);
+    len += TimeFormat::kMicrosecondsLength;
   }
-  return buf;
+  return string(buf, len);
 }
 
 Timestamp Timestamp::now()
@@ -0,0 +1,461 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include <muduo/base/WorkStealingThreadPool.h>
+
+#include <muduo/base/Exception.h>
+
+#include <algorithm>
+
+#include <assert.h>
+#include <stdio.h>
+
+using namespace muduo;
+
+namespace
+{
+
+// the pool and index of the worker running in this thread
+__thread WorkStealingThreadPool* t_pool = NULL;
+__thread int t_worker = -1;
+
+const size_t kDequeCapacity = 4096;  // power of 2
+const size_t kGlobalBatch = 32;
+const int kSpins = 128;
+
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+}  // namespace
+
+// Chase-Lev deque of fixed capacity, see "Correct and Efficient
+// Work-Stealing for Weak Memory Models", Le et al. 2013.
+// The owner pushes and pops at the bottom, thieves steal from the top.
+class WorkStealingThreadPool::WorkDeque : noncopyable
+{
+ public:
+  WorkDeque()
+    : top_(0),
+      bottom_(0),
+      buffer_(new std::atomic<Task*>[kDequeCapacity])
+  {
+  }
+
+  // owner only, returns false if full
+  bool push(Task* task)
+  {
+    const int64_t b = bottom_.load(std::memory_order_relaxed);
+    const int64_t t = top_.load(std::memory_order_acquire);
+    if (b - t >= static_cast<int64_t>(kDequeCapacity))
+    {
+      return false;
+    }
+    buffer_[b & (kDequeCapacity - 1)].store(task, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // owner only, the last pushed one
+  Task* pop()
+  {
+    const int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    Task* task = NULL;
+    if (t <= b)
+    {
+      task = buffer_[b & (kDequeCapacity - 1)].load(std::memory_order_relaxed);
+      if (t == b)
+      {
+        // the last one, races with thieves
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed))
+        {
+          task = NULL;
+        }
+        bottom_.store(b + 1, std::memory_order_relaxed);
+      }
+    }
+    else
+    {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return task;
+  }
+
+  // any thread, the oldest one, NULL if empty or lost a race
+  Task* steal()
+  {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t < b)
+    {
+      Task* task = buffer_[t & (kDequeCapacity - 1)].load(std::memory_order_relaxed);
+      if (top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                       std::memory_order_relaxed))
+      {
+        return task;
+      }
+    }
+    return NULL;
+  }
+
+  bool empty() const
+  {
+    return bottom_.load(std::memory_order_acquire) <= top_.load(std::memory_order_acquire);
+  }
+
+ private:
+  std::atomic<int64_t> top_;
+  std::atomic<int64_t> bottom_;
+  std::unique_ptr<std::atomic<Task*>[]> buffer_;
+};
+
+WorkStealingThreadPool::WorkStealingThreadPool(const string& nameArg)
+  : name_(nameArg),
+    maxQueueSize_(0),
+    running_(false),
+    globalSize_(0),
+    parkCond_(parkMutex_),
+    sleepers_(0),
+    pending_(0),
+    notFull_(fullMutex_),
+    blockedSubmitters_(0)
+{
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool()
+{
+  if (running_)
+  {
+    stop();
+  }
+}
+
+void WorkStealingThreadPool::start(int numThreads)
+{
+  assert(threads_.empty());
+  running_ = true;
+  threads_.reserve(numThreads);
+  deques_.reserve(numThreads);
+  for (int i = 0; i < numThreads; ++i)
+  {
+    deques_.emplace_back(new WorkDeque);
+  }
+  for (int i = 0; i < numThreads; ++i)
+  {
+    char id[32];
+    snprintf(id, sizeof id, "%d", i+1);
+    threads_.emplace_back(new muduo::Thread(
+          std::bind(&WorkStealingThreadPool::runInThread, this, i), name_+id));
+    threads_[i]->start();
+  }
+  if (numThreads == 0 && threadInitCallback_)
+  {
+    threadInitCallback_();
+  }
+}
+
+void WorkStealingThreadPool::stop()
+{
+  running_ = false;
+  {
+  MutexLockGuard lock(parkMutex_);
+  parkCond_.notifyAll();
+  }
+  {
+  MutexLockGuard lock(fullMutex_);
+  notFull_.notifyAll();
+  }
+  for (auto& thr : threads_)
+  {
+    thr->join();
+  }
+
+  for (auto& deque : deques_)
+  {
+    while (Task* task = deque->steal())
+    {
+      delete task;
+    }
+  }
+  MutexLockGuard lock(globalMutex_);
+  for (Task* task : global_)
+  {
+    delete task;
+  }
+  global_.clear();
+  globalSize_ = 0;
+}
+
+size_t WorkStealingThreadPool::queueSize() const
+{
+  const int64_t n = pending_.load(std::memory_order_relaxed);
+  return n > 0 ? static_cast<size_t>(n) : 0;
+}
+
+void WorkStealingThreadPool::run(Task task)
+{
+  if (threads_.empty())
+  {
+    task();
+    return;
+  }
+  waitNotFull(1);
+  pending_.fetch_add(1);
+  push(new Task(std::move(task)));
+  wakeup(1);
+}
+
+bool WorkStealingThreadPool::tryRun(Task task)
+{
+  if (threads_.empty())
+  {
+    task();
+    return true;
+  }
+  if (!running_
+      || (maxQueueSize_ > 0 && t_pool != this
+          && pending_.load() >= static_cast<int64_t>(maxQueueSize_)))
+  {
+    return false;
+  }
+  pending_.fetch_add(1);
+  push(new Task(std::move(task)));
+  wakeup(1);
+  return true;
+}
+
+void WorkStealingThreadPool::runBatch(std::vector<Task> tasks)
+{
+  if (threads_.empty())
+  {
+    for (Task& task : tasks)
+    {
+      task();
+    }
+    return;
+  }
+  if (tasks.empty())
+  {
+    return;
+  }
+  waitNotFull(tasks.size());
+  pending_.fetch_add(static_cast<int64_t>(tasks.size()));
+  if (t_pool == this)
+  {
+    for (Task& task : tasks)
+    {
+      push(new Task(std::move(task)));
+    }
+  }
+  else
+  {
+    MutexLockGuard lock(globalMutex_);
+    for (Task& task : tasks)
+    {
+      global_.push_back(new Task(std::move(task)));
+    }
+    globalSize_.fetch_add(tasks.size());
+  }
+  wakeup(tasks.size());
+}
+
+void WorkStealingThreadPool::push(Task* task)
+{
+  if (t_pool == this && deques_[t_worker]->push(task))
+  {
+    return;
+  }
+  MutexLockGuard lock(globalMutex_);
+  global_.push_back(task);
+  globalSize_.fetch_add(1);
+}
+
+void WorkStealingThreadPool::wakeup(size_t tasks)
+{
+  // pairs with the one in park(), either the parked worker sees the task,
+  // or we see the worker.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  const int sleepers = sleepers_.load(std::memory_order_relaxed);
+  if (sleepers > 0)
+  {
+    MutexLockGuard lock(parkMutex_);
+    const size_t n = std::min(tasks, static_cast<size_t>(sleepers));
+    for (size_t i = 0; i < n; ++i)
+    {
+      parkCond_.notify();
+    }
+  }
+}
+
+void WorkStealingThreadPool::waitNotFull(size_t tasks)
+{
+  if (maxQueueSize_ == 0 || t_pool == this)
+  {
+    return;
+  }
+  const int64_t n = static_cast<int64_t>(tasks);
+  const int64_t max = static_cast<int64_t>(maxQueueSize_);
+  if (pending_.load() + n <= max)
+  {
+    return;
+  }
+  MutexLockGuard lock(fullMutex_);
+  blockedSubmitters_.fetch_add(1);
+  // a batch larger than max waits for an empty queue
+  int64_t pending = 0;
+  while (running_ && (pending = pending_.load()) > 0 && pending + n > max)
+  {
+    notFull_.wait();
+  }
+  blockedSubmitters_.fetch_sub(1);
+}
+
+void WorkStealingThreadPool::finishTake()
+{
+  pending_.fetch_sub(1);
+  if (blockedSubmitters_.load() > 0)
+  {
+    MutexLockGuard lock(fullMutex_);
+    notFull_.notifyAll();
+  }
+}
+
+WorkStealingThreadPool::Task* WorkStealingThreadPool::takeGlobal(int index)
+{
+  MutexLockGuard lock(globalMutex_);
+  if (global_.empty())
+  {
+    return NULL;
+  }
+  Task* task = global_.front();
+  global_.pop_front();
+  // takes a fair share more, for others to steal
+  size_t batch = std::min(kGlobalBatch, global_.size() / deques_.size());
+  size_t taken = 1;
+  WorkDeque* deque = deques_[index].get();
+  while (batch-- > 0 && deque->push(global_.front()))
+  {
+    global_.pop_front();
+    ++taken;
+  }
+  globalSize_.fetch_sub(taken);
+  return task;
+}
+
+WorkStealingThreadPool::Task* WorkStealingThreadPool::findTask(int index)
+{
+  Task* task = deques_[index]->pop();
+  if (task)
+  {
+    return task;
+  }
+  if (globalSize_.load(std::memory_order_relaxed) > 0)
+  {
+    task = takeGlobal(index);
+    if (task)
+    {
+      return task;
+    }
+  }
+  const size_t n = deques_.size();
+  for (size_t i = 1; i < n; ++i)
+  {
+    task = deques_[(index + i) % n]->steal();
+    if (task)
+    {
+      return task;
+    }
+  }
+  return NULL;
+}
+
+bool WorkStealingThreadPool::hasWork() const
+{
+  if (globalSize_.load() > 0)
+  {
+    return true;
+  }
+  for (const auto& deque : deques_)
+  {
+    if (!deque->empty())
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingThreadPool::park()
+{
+  MutexLockGuard lock(parkMutex_);
+  sleepers_.fetch_add(1);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  while (running_ && !hasWork())
+  {
+    parkCond_.wait();
+  }
+  sleepers_.fetch_sub(1);
+}
+
+void WorkStealingThreadPool::runInThread(int index)
+{
+  t_pool = this;
+  t_worker = index;
+  try
+  {
+    if (threadInitCallback_)
+    {
+      threadInitCallback_();
+    }
+    while (running_)
+    {
+      Task* task = findTask(index);
+      for (int spin = 0; task == NULL && spin < kSpins && running_; ++spin)
+      {
+        cpuRelax();
+        task = findTask(index);
+      }
+      if (task)
+      {
+        finishTake();
+        std::unique_ptr<Task> owner(task);
+        (*task)();
+      }
+      else
+      {
+        park();
+      }
+    }
+  }
+  catch (const Exception& ex)
+  {
+    fprintf(stderr, "exception caught in WorkStealingThreadPool %s\n", name_.c_str());
+    fprintf(stderr, "reason: %s\n", ex.what());
+    fprintf(stderr, "stack trace: %s\n", ex.stackTrace());
+    abort();
+  }
+  catch (const std::exception& ex)
+  {
+    fprintf(stderr, "exception caught in WorkStealingThreadPool %s\n", name_.c_str());
+    fprintf(stderr, "reason: %s\n", ex.what());
+    abort();
+  }
+  catch (...)
+  {
+    fprintf(stderr, "unknown exception caught in WorkStealingThreadPool %s\n", name_.c_str());
+    throw; // rethrow
+  }
+  t_pool = NULL;
+  t_worker = -1;
+}
@@ -0,0 +1,99 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_BASE_WORKSTEALINGTHREADPOOL_H
+#define MUDUO_BASE_WORKSTEALINGTHREADPOOL_H
+
+#include <muduo/base/Condition.h>
+#include <muduo/base/Mutex.h>
+#include <muduo/base/Thread.h>
+#include <muduo/base/Types.h>
+
+#include <atomic>
+#include <deque>
+#include <vector>
+
+namespace muduo
+{
+
+///
+/// Thread pool with a work-stealing deque per worker.
+///
+/// Tasks run by a worker go to its own deque, lock free, and idle workers
+/// steal from the others.  Tasks from other threads go to a global queue,
+/// taken in batches by workers.  Idle workers spin a while before parking,
+/// and submitters wake them only if some are parked.
+///
+/// Drop-in for ThreadPool, but tasks may run in any order.
+class WorkStealingThreadPool : noncopyable
+{
+ public:
+  typedef std::function<void ()> Task;
+
+  explicit WorkStealingThreadPool(const string& nameArg = string("WorkStealingThreadPool"));
+  ~WorkStealingThreadPool();
+
+  /// Must be called before start().  Like ThreadPool, run() blocks and
+  /// tryRun() fails when maxSize tasks are waiting, except in workers,
+  /// which never block.
+  void setMaxQueueSize(int maxSize) { maxQueueSize_ = maxSize; }
+  void setThreadInitCallback(const Task& cb)
+  { threadInitCallback_ = cb; }
+
+  void start(int numThreads);
+  /// Waiting tasks are destroyed without running.
+  void stop();
+
+  const string& name() const
+  { return name_; }
+
+  /// tasks not started yet
+  size_t queueSize() const;
+
+  void run(Task f);
+  bool tryRun(Task f);
+  /// Submits all of @c tasks with one lock and one wakeup.
+  void runBatch(std::vector<Task> tasks);
+
+ private:
+  class WorkDeque;
+
+  void runInThread(int index);
+  Task* findTask(int index);
+  Task* takeGlobal(int index);
+  bool hasWork() const;
+  void park();
+  void wakeup(size_t tasks);
+  void push(Task* task);
+  void waitNotFull(size_t tasks);
+  void finishTake();
+
+  string name_;
+  Task threadInitCallback_;
+  size_t maxQueueSize_;
+  std::atomic<bool> running_;
+  std::vector<std::unique_ptr<muduo::Thread>> threads_;
+  std::vector<std::unique_ptr<WorkDeque>> deques_;
+
+  // injection queue for threads not in this pool
+  mutable MutexLock globalMutex_;
+  std::deque<Task*> global_ GUARDED_BY(globalMutex_);
+  std::atomic<size_t> globalSize_;
+
+  // parked workers
+  MutexLock parkMutex_;
+  Condition parkCond_ GUARDED_BY(parkMutex_);
+  std::atomic<int> sleepers_;
+
+  // back-pressure of setMaxQueueSize()
+  std::atomic<int64_t> pending_;
+  MutexLock fullMutex_;
+  Condition notFull_ GUARDED_BY(fullMutex_);
+  std::atomic<int> blockedSubmitters_;
+};
+
+}  // namespace muduo
+
+#endif  // MUDUO_BASE_WORKSTEALINGTHREADPOOL_H
@@ -1,5 +1,7 @@
 #include <muduo/base/BlockingQueue.h>
+#include <muduo/base/BoundedBlockingQueue.h>
 #include <muduo/base/CountDownLatch.h>
+#include <muduo/base/MpmcQueue.h>
 #include <muduo/base/Thread.h>
 #include <muduo/base/Timestamp.h>
 
@@ -7,6 +9,7 @@
 #include <string>
 #include <vector>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 class Bench
@@ -96,8 +99,71 @@ class Bench
   std::vector<std::unique_ptr<muduo::Thread>> threads_;
 };
 
+// throughput of pairs of producer and consumer threads
+template<typename Queue>
+double benchPairs(Queue* queue, int pairs, int items)
+{
+  muduo::CountDownLatch start(1);
+  std::vector<std::unique_ptr<muduo::Thread>> threads;
+  for (int i = 0; i < pairs; ++i)
+  {
+    threads.emplace_back(new muduo::Thread([queue, &start, items]
+    {
+      start.wait();
+      for (int j = 0; j < items; ++j)
+      {
+        queue->put(j);
+      }
+    }));
+    threads.emplace_back(new muduo::Thread([queue, &start, items]
+    {
+      start.wait();
+      for (int j = 0; j < items; ++j)
+      {
+        queue->take();
+      }
+    }));
+  }
+  for (auto& thr : threads)
+  {
+    thr->start();
+  }
+  muduo::Timestamp begin(muduo::Timestamp::now());
+  start.countDown();
+  for (auto& thr : threads)
+  {
+    thr->join();
+  }
+  double seconds = timeDifference(muduo::Timestamp::now(), begin);
+  return static_cast<double>(pairs) * items / seconds / 1e6;
+}
+
+void compare(int items)
+{
+  const int kCapacity = 1024;
+  printf("%d items per pair, capacity %d, Mitems/s\n", items, kCapacity);
+  printf("pairs  BlockingQueue  BoundedBlockingQueue  MpmcQueue\n");
+  const int pairs[] = { 1, 4, 16 };
+  for (int n : pairs)
+  {
+    muduo::BlockingQueue<int> unbounded;
+    muduo::BoundedBlockingQueue<int> bounded(kCapacity);
+    muduo::MpmcQueue<int> mpmc(kCapacity);
+    double a = benchPairs(&unbounded, n, items);
+    double b = benchPairs(&bounded, n, items);
+    double c = benchPairs(&mpmc, n, items);
+    printf("%5d  %13.2f  %20.2f  %9.2f\n", n, a, b, c);
+  }
+}
+
 int main(int argc, char* argv[])
 {
+  if (argc > 1 && strcmp(argv[1], "-c") == 0)
+  {
+    compare(argc > 2 ? atoi(argv[2]) : 1000 * 1000);
+    return 0;
+  }
+
   int threads = argc > 1 ? atoi(argv[1]) : 1;
 
   Bench t(threads);
@@ -0,0 +1,104 @@
+#include <muduo/base/Clock.h>
+#include <muduo/base/Thread.h>
+
+#include <vector>
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+using muduo::Clock;
+using muduo::Timestamp;
+
+const int64_t kToleranceUs = 500;
+
+// Clock::now() between two Timestamp::now(), on every CPU in turn
+void checkAgainstSystem(int id, double seconds)
+{
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  sched_getaffinity(0, sizeof allowed, &allowed);
+  std::vector<int> cpus;
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+  {
+    if (CPU_ISSET(cpu, &allowed))
+      cpus.push_back(cpu);
+  }
+
+  Timestamp start(Timestamp::now());
+  Timestamp last = Clock::now();
+  int64_t checks = 0;
+  for (size_t i = id; timeDifference(Timestamp::now(), start) < seconds; ++i)
+  {
+    // migrates
+    cpu_set_t one;
+    CPU_ZERO(&one);
+    CPU_SET(cpus[i % cpus.size()], &one);
+    sched_setaffinity(0, sizeof one, &one);
+
+    for (int j = 0; j < 1000; ++j)
+    {
+      Timestamp before(Timestamp::now());
+      Timestamp now(Clock::now());
+      Timestamp after(Timestamp::now());
+      if (now.microSecondsSinceEpoch() < before.microSecondsSinceEpoch() - kToleranceUs
+          || now.microSecondsSinceEpoch() > after.microSecondsSinceEpoch() + kToleranceUs
+          || now.microSecondsSinceEpoch() < last.microSecondsSinceEpoch() - kToleranceUs)
+      {
+        printf("WRONG: %s %s %s last %s\n", before.toString().c_str(), now.toString().c_str(),
+               after.toString().c_str(), last.toString().c_str());
+        exit(1);
+      }
+      last = now;
+      ++checks;
+    }
+  }
+  sched_setaffinity(0, sizeof allowed, &allowed);
+  printf("thread %d checked %lld times on %zd CPUs\n", id, static_cast<long long>(checks), cpus.size());
+}
+
+void test(Clock::Source source)
+{
+  Clock::setSource(source);
+  printf("source %s\n", Clock::source() == Clock::kTsc ? "TSC" : "system");
+
+  std::vector<std::unique_ptr<muduo::Thread>> threads;
+  for (int i = 0; i < 4; ++i)
+  {
+    threads.emplace_back(new muduo::Thread(std::bind(checkAgainstSystem, i, 1.5)));
+    threads.back()->start();
+  }
+  for (auto& thr : threads)
+  {
+    thr->join();
+  }
+}
+
+template<typename Func>
+void bench(const char* name, Func func, int number = 1000*1000)
+{
+  int64_t sum = 0;
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < number; ++i)
+  {
+    sum += func().microSecondsSinceEpoch();
+  }
+  double ns = timeDifference(Timestamp::now(), start) * 1e9 / number;
+  printf("%-20s %6.1f ns %lld\n", name, ns, static_cast<long long>(sum % 10));
+}
+
+int main()
+{
+  const Clock::Source source = Clock::source();
+  // well within the calibration, about as cheap as Timestamp::now
+  Clock::setSource(Clock::kTsc);
+  bench("Clock::now (calib.)", &Clock::now, 10000);
+  test(Clock::kSystem);
+  test(Clock::kTsc);
+  Clock::setSource(source);
+
+  bench("Timestamp::now", &Timestamp::now);
+  bench("Clock::now", &Clock::now);
+  bench("Clock::coarseNow", &Clock::coarseNow);
+}
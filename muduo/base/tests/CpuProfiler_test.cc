@@ -0,0 +1,80 @@
+#include <muduo/base/CpuProfiler.h>
+#include <muduo/base/Logging.h>
+#include <muduo/base/Thread.h>
+
+#include <atomic>
+#include <thread>
+
+#include <math.h>
+#include <stdio.h>
+
+using namespace muduo;
+
+std::atomic<bool> g_done(false);
+double g_sum = 0;
+
+__attribute__ ((noinline)) void burnCpu()
+{
+  for (int i = 0; i < 1000; ++i)
+  {
+    g_sum += sqrt(i);
+  }
+}
+
+void spin()
+{
+  CpuProfiler::setThreadTag("spinner");
+  while (!g_done)
+  {
+    burnCpu();
+  }
+}
+
+// not registered, its stack is not walked
+void spinUnregistered()
+{
+  CpuProfiler::setThreadTag("unregistered");
+  while (!g_done)
+  {
+    burnCpu();
+  }
+}
+
+int main()
+{
+  Thread spinner(spin, "spin");
+  spinner.start();
+  std::thread unregistered(spinUnregistered);
+
+  string result = CpuProfiler::profile(1.0, 199);
+  g_done = true;
+  spinner.join();
+  unregistered.join();
+  printf("%s", result.c_str());
+
+  if (result.find("spinner;") == string::npos)
+  {
+    LOG_FATAL << "no samples of tagged thread";
+  }
+  if (result.find("spin();burnCpu()") == string::npos)
+  {
+    LOG_FATAL << "spin();burnCpu() not found";
+  }
+  if (result.find("unregistered;") == string::npos)
+  {
+    LOG_FATAL << "no samples of unregistered thread";
+  }
+  for (size_t pos = result.find("unregistered;"); pos != string::npos;
+       pos = result.find("unregistered;", pos + 1))
+  {
+    const size_t eol = result.find('\n', pos);
+    if (result.find(';', pos + sizeof "unregistered") < eol)
+    {
+      LOG_FATAL << "walked the stack of unregistered thread";
+    }
+  }
+  if (CpuProfiler::isProfiling())
+  {
+    LOG_FATAL << "still profiling";
+  }
+}
@@ -0,0 +1,66 @@
+#include <muduo/base/Crc32c.h>
+
+#include <string.h>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+namespace Crc32c = muduo::Crc32c;
+
+// from RFC 3720 section B.4
+BOOST_AUTO_TEST_CASE(testCrc32cStandardResults)
+{
+  char buf[32];
+  memset(buf, 0, sizeof buf);
+  BOOST_CHECK_EQUAL(Crc32c::value(buf, sizeof buf), 0x8a9136aaU);
+
+  memset(buf, 0xff, sizeof buf);
+  BOOST_CHECK_EQUAL(Crc32c::value(buf, sizeof buf), 0x62a8ab43U);
+
+  for (int i = 0; i < 32; ++i)
+  {
+    buf[i] = static_cast<char>(i);
+  }
+  BOOST_CHECK_EQUAL(Crc32c::value(buf, sizeof buf), 0x46dd794eU);
+
+  for (int i = 0; i < 32; ++i)
+  {
+    buf[i] = static_cast<char>(31 - i);
+  }
+  BOOST_CHECK_EQUAL(Crc32c::value(buf, sizeof buf), 0x113fdb5cU);
+
+  BOOST_CHECK_EQUAL(Crc32c::value("123456789", 9), 0xe3069283U);
+  BOOST_CHECK_EQUAL(Crc32c::value("", 0), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(testCrc32cExtend)
+{
+  const char* data = "hello world";
+  const uint32_t whole = Crc32c::value(data, 11);
+  for (size_t i = 0; i <= 11; ++i)
+  {
+    BOOST_CHECK_EQUAL(Crc32c::extend(Crc32c::value(data, i), data + i, 11 - i), whole);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testCrc32cPortable)
+{
+  char buf[4096];
+  for (size_t i = 0; i < sizeof buf; ++i)
+  {
+    buf[i] = static_cast<char>(i * 7 + (i >> 5));
+  }
+  // every alignment and tail length of the 8-byte loop
+  for (size_t offset = 0; offset < 16; ++offset)
+  {
+    for (size_t len = 0; len < 100; ++len)
+    {
+      BOOST_CHECK_EQUAL(Crc32c::extend(0, buf + offset, len),
+                        Crc32c::extendPortable(0, buf + offset, len));
+    }
+  }
+  BOOST_CHECK_EQUAL(Crc32c::value(buf, sizeof buf),
+                    Crc32c::extendPortable(0, buf, sizeof buf));
+  BOOST_TEST_MESSAGE("hardware accelerated " << Crc32c::hardwareAccelerated());
+}
@@ -1,6 +1,7 @@
 #include <muduo/base/Date.h>
 #include <assert.h>
 #include <stdio.h>
+#include <time.h>
 
 using muduo::Date;
 
@@ -0,0 +1,116 @@
+#include <muduo/base/Histogram.h>
+#include <muduo/base/Thread.h>
+
+#include <vector>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using muduo::Histogram;
+
+BOOST_AUTO_TEST_CASE(testHistogramBuckets)
+{
+  const int bits = 5;
+  BOOST_CHECK_EQUAL(Histogram::bucketOf(0, bits), 0);
+  BOOST_CHECK_EQUAL(Histogram::bucketOf(31, bits), 31);
+  BOOST_CHECK_EQUAL(Histogram::bucketOf(32, bits), 32);
+  BOOST_CHECK_EQUAL(Histogram::bucketOf(63, bits), 63);
+  BOOST_CHECK_EQUAL(Histogram::bucketOf(64, bits), 64);
+  BOOST_CHECK_EQUAL(Histogram::bucketOf(65, bits), 64);
+  BOOST_CHECK_EQUAL(Histogram::bucketOf(66, bits), 65);
+
+  Histogram h(1000 * 1000, bits, 1);
+  h.record(1);
+  Histogram::Snapshot s = h.snapshot();
+  int last = -1;
+  for (int64_t v = 0; v <= 1000 * 1000; v += 7)
+  {
+    int b = Histogram::bucketOf(v, bits);
+    BOOST_CHECK(b >= last);
+    BOOST_CHECK(s.lowerBound(b) <= v);
+    BOOST_CHECK(v <= s.upperBound(b));
+    // relative error bounded by 1/2^bits
+    BOOST_CHECK(s.upperBound(b) - s.lowerBound(b) <= s.lowerBound(b) / 32);
+    last = b;
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testHistogramPercentile)
+{
+  Histogram h;
+  Histogram::Snapshot empty = h.snapshot();
+  BOOST_CHECK_EQUAL(empty.count(), 0);
+  BOOST_CHECK_EQUAL(empty.percentile(0.99), 0);
+
+  for (int i = 1; i <= 10000; ++i)
+  {
+    h.record(i);
+  }
+  Histogram::Snapshot s = h.snapshot();
+  BOOST_CHECK_EQUAL(s.count(), 10000);
+  BOOST_CHECK_EQUAL(s.sum(), 10000LL * 10001 / 2);
+  BOOST_CHECK_EQUAL(s.min(), 1);
+  BOOST_CHECK_EQUAL(s.max(), 10000);
+  BOOST_CHECK_EQUAL(s.percentile(0.0), 1);
+  BOOST_CHECK_EQUAL(s.percentile(0.001), 10);
+  BOOST_CHECK_EQUAL(s.percentile(1.0), 10000);
+  BOOST_CHECK_CLOSE(static_cast<double>(s.percentile(0.5)), 5000.0, 3.2);
+  BOOST_CHECK_CLOSE(static_cast<double>(s.percentile(0.99)), 9900.0, 3.2);
+
+  h.record(-5);
+  h.record(1LL << 50);
+  s = h.snapshot();
+  BOOST_CHECK_EQUAL(s.min(), 0);
+  BOOST_CHECK_EQUAL(s.max(), h.highestValue());
+
+  h.reset();
+  s = h.snapshot();
+  BOOST_CHECK_EQUAL(s.count(), 0);
+  BOOST_CHECK_EQUAL(s.max(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(testHistogramThreads)
+{
+  const int kThreads = 4;
+  const int kRecords = 100 * 1000;
+  Histogram h;
+  std::vector<std::unique_ptr<muduo::Thread>> threads;
+  for (int i = 0; i < kThreads; ++i)
+  {
+    threads.emplace_back(new muduo::Thread([&h] {
+      for (int j = 0; j < kRecords; ++j)
+      {
+        h.record(j % 1000);
+      }
+    }));
+    threads.back()->start();
+  }
+  for (auto& thr : threads)
+  {
+    thr->join();
+  }
+  Histogram::Snapshot s = h.snapshot();
+  BOOST_CHECK_EQUAL(s.count(), kThreads * kRecords);
+  BOOST_CHECK_EQUAL(s.max(), 999);
+  BOOST_CHECK_EQUAL(s.sum(), int64_t(kThreads) * (kRecords / 1000) * 999 * 1000 / 2);
+}
+
+BOOST_AUTO_TEST_CASE(testHistogramExport)
+{
+  Histogram h;
+  h.record(100);
+  h.record(200);
+  Histogram::Snapshot s = h.snapshot();
+  BOOST_CHECK_EQUAL(s.toString(),
+                    "count 2 min 100 avg 150 p50 101 p90 200 p99 200 p999 200 max 200");
+  BOOST_CHECK_EQUAL(s.toPrometheus("rpc_latency_us", "latency"),
+                    "# HELP rpc_latency_us latency\n"
+                    "# TYPE rpc_latency_us summary\n"
+                    "rpc_latency_us{quantile=\"0.5\"} 101\n"
+                    "rpc_latency_us{quantile=\"0.9\"} 200\n"
+                    "rpc_latency_us{quantile=\"0.99\"} 200\n"
+                    "rpc_latency_us{quantile=\"0.999\"} 200\n"
+                    "rpc_latency_us_sum 300\n"
+                    "rpc_latency_us_count 2\n");
+}
@@ -1,4 +1,6 @@
 #include <muduo/base/LogStream.h>
+#include <muduo/base/TimeFormat.h>
+#include <muduo/base/TimeZone.h>
 #include <muduo/base/Timestamp.h>
 
 #include <sstream>
@@ -55,6 +57,61 @@ void benchLogStream()
   printf("benchLogStream %f\n", timeDifference(end, start));
 }
 
+// formats one line timestamp of Logger, for N consecutive microseconds
+
+void benchTimePrintf()
+{
+  char buf[64];
+  int64_t now = Timestamp::now().microSecondsSinceEpoch();
+  Timestamp start(Timestamp::now());
+  for (size_t i = 0; i < N; ++i)
+  {
+    int64_t us = now + static_cast<int64_t>(i);
+    time_t seconds = static_cast<time_t>(us / Timestamp::kMicroSecondsPerSecond);
+    struct tm tm_time;
+    ::gmtime_r(&seconds, &tm_time);
+    snprintf(buf, sizeof buf, "%4d%02d%02d %02d:%02d:%02d.%06dZ ",
+             tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
+             tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec,
+             static_cast<int>(us % Timestamp::kMicroSecondsPerSecond));
+  }
+  Timestamp end(Timestamp::now());
+
+  printf("benchTimePrintf %f\n", timeDifference(end, start));
+}
+
+void benchTimeFormat(const TimeZone* zone)
+{
+  char buf[64];
+  int64_t now = Timestamp::now().microSecondsSinceEpoch();
+  Timestamp start(Timestamp::now());
+  for (size_t i = 0; i < N; ++i)
+  {
+    int64_t us = now + static_cast<int64_t>(i);
+    time_t seconds = static_cast<time_t>(us / Timestamp::kMicroSecondsPerSecond);
+    TimeFormat::formatDateTime(seconds, zone, buf);
+    TimeFormat::formatMicroseconds(static_cast<int>(us % Timestamp::kMicroSecondsPerSecond),
+                                   buf + TimeFormat::kDateTimeLength);
+  }
+  Timestamp end(Timestamp::now());
+
+  printf("benchTimeFormat%s %f\n", zone ? "(local)" : "", timeDifference(end, start));
+}
+
+void benchToFormattedString()
+{
+  size_t total = 0;
+  int64_t now = Timestamp::now().microSecondsSinceEpoch();
+  Timestamp start(Timestamp::now());
+  for (size_t i = 0; i < N; ++i)
+  {
+    total += Timestamp(now + static_cast<int64_t>(i)).toFormattedString().size();
+  }
+  Timestamp end(Timestamp::now());
+
+  printf("benchToFormattedString %f %zd\n", timeDifference(end, start), total);
+}
+
 int main()
 {
   benchPrintf<int>("%d");
@@ -79,4 +136,10 @@ int main()
   benchStringStream<void*>();
   benchLogStream<void*>();
 
+  puts("time");
+  benchTimePrintf();
+  benchTimeFormat(NULL);
+  TimeZone beijing(8*3600, "CST");
+  benchTimeFormat(&beijing);
+  benchToFormattedString();
 }
@@ -1,7 +1,10 @@
 #include <muduo/base/LogStream.h>
 
 #include <limits>
+#include <random>
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 
 //#define BOOST_TEST_MODULE LogStreamTest
 #define BOOST_TEST_MAIN
@@ -169,6 +172,50 @@ BOOST_AUTO_TEST_CASE(testLogStreamFloats)
   os.resetBuffer();
 }
 
+// the same as printf("%.12g")
+void checkDouble(double v)
+{
+  muduo::LogStream os;
+  os << v;
+  char expected[64];
+  snprintf(expected, sizeof expected, "%.12g", v);
+  BOOST_CHECK_EQUAL(os.buffer().toString(), string(expected));
+}
+
+BOOST_AUTO_TEST_CASE(testLogStreamDoublesLikePrintf)
+{
+  checkDouble(-0.0);
+  checkDouble(1e100);
+  checkDouble(1e-5);
+  checkDouble(0.0001);
+  checkDouble(123456789012.0);
+  checkDouble(1234567890123.0);
+  checkDouble(999999999999.5);
+  checkDouble(0.99999999999951);
+  checkDouble(std::numeric_limits<double>::max());
+  checkDouble(std::numeric_limits<double>::min());
+  checkDouble(std::numeric_limits<double>::denorm_min());
+  checkDouble(std::numeric_limits<double>::infinity());
+  checkDouble(-std::numeric_limits<double>::infinity());
+  checkDouble(std::numeric_limits<double>::quiet_NaN());
+
+  std::mt19937_64 random(42);
+  for (int i = 0; i < 100000; ++i)
+  {
+    // any bits
+    uint64_t bits = random();
+    double v;
+    memcpy(&v, &bits, sizeof v);
+    checkDouble(v);
+    // latencies in ms
+    checkDouble(static_cast<double>(random() % 10000000) / 1000.0);
+    checkDouble(static_cast<double>(random() % 1000) / 7.0);
+    // exact ones and ties at the 13th digit
+    checkDouble(static_cast<double>(random() % 10000000000000000ULL));
+    checkDouble(static_cast<double>(random() % 10000000000000ULL) + 0.5);
+  }
+}
+
 BOOST_AUTO_TEST_CASE(testLogStreamVoid)
 {
   muduo::LogStream os;
@@ -0,0 +1,126 @@
+#include <muduo/base/Metrics.h>
+#include <muduo/base/Thread.h>
+
+#include <vector>
+
+#include <stdint.h>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using muduo::Counter;
+using muduo::Gauge;
+using muduo::MetricsRegistry;
+using muduo::string;
+
+BOOST_AUTO_TEST_CASE(testCounterThreads)
+{
+  const int kThreads = 4;
+  const int kIncrements = 100 * 1000;
+  Counter counter;
+  std::vector<std::unique_ptr<muduo::Thread>> threads;
+  for (int i = 0; i < kThreads; ++i)
+  {
+    threads.emplace_back(new muduo::Thread([&counter] {
+      for (int j = 0; j < kIncrements; ++j)
+      {
+        counter.increment();
+      }
+    }));
+    threads.back()->start();
+  }
+  for (auto& thr : threads)
+  {
+    thr->join();
+  }
+  BOOST_CHECK_EQUAL(counter.value(), kThreads * kIncrements);
+}
+
+BOOST_AUTO_TEST_CASE(testCounterAlignment)
+{
+  // shards of neighbouring counters do not share cache lines either
+  std::vector<std::unique_ptr<Counter>> counters;
+  for (int i = 0; i < 10; ++i)
+  {
+    counters.emplace_back(new Counter);
+    BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(counters.back().get()) % 64, 0u);
+  }
+  Counter onStack;
+  BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(&onStack) % 64, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(testRegistry)
+{
+  MetricsRegistry registry;
+  const string labels = MetricsRegistry::label("server", "echo");
+  Counter* requests = registry.counter("requests_total", "Requests.", labels);
+  BOOST_CHECK_EQUAL(requests, registry.counter("requests_total", "Requests.", labels));
+  BOOST_CHECK(requests != registry.counter("requests_total", "Requests."));
+  requests->increment(3);
+
+  Gauge* connections = registry.gauge("connections", "");
+  connections->add(5);
+  connections->add(-2);
+
+  registry.histogram("latency_us", "Latency.", labels)->record(10);
+  registry.addCollector("extra", [](string* out) {
+    MetricsRegistry::appendHeader(out, "ratio", "", "gauge");
+    MetricsRegistry::appendSample(out, "ratio", string(), 0.25);
+  });
+
+  BOOST_CHECK_EQUAL(registry.exposition(),
+                    "# TYPE connections gauge\n"
+                    "connections 3\n"
+                    "# HELP latency_us Latency.\n"
+                    "# TYPE latency_us summary\n"
+                    "latency_us{server=\"echo\",quantile=\"0.5\"} 10\n"
+                    "latency_us{server=\"echo\",quantile=\"0.9\"} 10\n"
+                    "latency_us{server=\"echo\",quantile=\"0.99\"} 10\n"
+                    "latency_us{server=\"echo\",quantile=\"0.999\"} 10\n"
+                    "latency_us_sum{server=\"echo\"} 10\n"
+                    "latency_us_count{server=\"echo\"} 1\n"
+                    "# HELP requests_total Requests.\n"
+                    "# TYPE requests_total counter\n"
+                    "requests_total 0\n"
+                    "requests_total{server=\"echo\"} 3\n"
+                    "# TYPE ratio gauge\n"
+                    "ratio 0.25\n");
+
+  registry.removeCollector("extra");
+  BOOST_CHECK(registry.exposition().find("ratio") == string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(testLabelEscaping)
+{
+  BOOST_CHECK_EQUAL(MetricsRegistry::label("path", "a\"b\\c\nd"),
+                    "path=\"a\\\"b\\\\c\\nd\"");
+  string header;
+  MetricsRegistry::appendHeader(&header, "x", "a\"b\\c\nd", "gauge");
+  BOOST_CHECK_EQUAL(header, "# HELP x a\"b\\\\c\\nd\n# TYPE x gauge\n");
+}
+
+BOOST_AUTO_TEST_CASE(testSummary)
+{
+  muduo::Histogram histogram;
+  histogram.record(10);
+  const muduo::Histogram::Snapshot snapshot = histogram.snapshot();
+  string summary;
+  MetricsRegistry::appendSummary(&summary, "x_us", MetricsRegistry::label("tid", "1"), snapshot);
+  BOOST_CHECK_EQUAL(summary,
+                    "x_us{tid=\"1\",quantile=\"0.5\"} 10\n"
+                    "x_us{tid=\"1\",quantile=\"0.9\"} 10\n"
+                    "x_us{tid=\"1\",quantile=\"0.99\"} 10\n"
+                    "x_us{tid=\"1\",quantile=\"0.999\"} 10\n"
+                    "x_us_sum{tid=\"1\"} 10\n"
+                    "x_us_count{tid=\"1\"} 1\n");
+  // same lines as toPrometheus(), which has no labels
+  BOOST_CHECK_EQUAL(snapshot.toPrometheus("x_us"),
+                    "# TYPE x_us summary\n"
+                    "x_us{quantile=\"0.5\"} 10\n"
+                    "x_us{quantile=\"0.9\"} 10\n"
+                    "x_us{quantile=\"0.99\"} 10\n"
+                    "x_us{quantile=\"0.999\"} 10\n"
+                    "x_us_sum 10\n"
+                    "x_us_count 1\n");
+}
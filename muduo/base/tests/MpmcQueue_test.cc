@@ -0,0 +1,110 @@
+#include <muduo/base/MpmcQueue.h>
+#include <muduo/base/Thread.h>
+
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHECK(cond) \
+  if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); abort(); }
+
+void testBasic()
+{
+  muduo::MpmcQueue<std::string> queue(5);
+  CHECK(queue.capacity() == 8);
+  CHECK(queue.empty());
+  for (int i = 0; i < 8; ++i)
+  {
+    CHECK(queue.tryPut(std::to_string(i)));
+  }
+  CHECK(queue.full());
+  CHECK(!queue.tryPut("full"));
+  std::string x;
+  for (int i = 0; i < 8; ++i)
+  {
+    CHECK(queue.tryTake(&x));
+    CHECK(x == std::to_string(i));
+  }
+  CHECK(!queue.tryTake(&x));
+
+  // wraps around, destroys the rest
+  queue.put("hello");
+  queue.put(std::string(100, 'x'));
+  CHECK(queue.take() == "hello");
+  CHECK(queue.size() == 1);
+}
+
+void testMoveOnly()
+{
+  muduo::MpmcQueue<std::unique_ptr<int>> queue(2);
+  std::unique_ptr<int> p(new int(42));
+  CHECK(queue.tryPut(std::move(p)));
+  CHECK(!p);
+  queue.put(std::unique_ptr<int>(new int(43)));
+  std::unique_ptr<int> q(new int(44));
+  CHECK(!queue.tryPut(std::move(q)));
+  CHECK(q && *q == 44);
+  CHECK(*queue.take() == 42);
+  CHECK(*queue.take() == 43);
+}
+
+// blocks on both full and empty, every item taken once, in order per producer
+void testThreads(int pairs)
+{
+  const int kItems = 200 * 1000;
+  muduo::MpmcQueue<int64_t> queue(16);
+  std::vector<std::unique_ptr<muduo::Thread>> threads;
+  std::vector<int64_t> sums(pairs);
+  for (int i = 0; i < pairs; ++i)
+  {
+    threads.emplace_back(new muduo::Thread([&queue, i, kItems]
+    {
+      for (int j = 0; j < kItems; ++j)
+      {
+        queue.put(static_cast<int64_t>(i) * kItems + j);
+      }
+    }));
+    threads.emplace_back(new muduo::Thread([&queue, &sums, i, pairs, kItems]
+    {
+      std::vector<int64_t> last(pairs, -1);
+      int64_t sum = 0;
+      for (int j = 0; j < kItems; ++j)
+      {
+        int64_t x = queue.take();
+        int64_t producer = x / kItems;
+        CHECK(last[producer] < x);
+        last[producer] = x;
+        sum += x;
+      }
+      sums[i] = sum;
+    }));
+  }
+  for (auto& thr : threads)
+  {
+    thr->start();
+  }
+  for (auto& thr : threads)
+  {
+    thr->join();
+  }
+  int64_t total = 0;
+  for (int64_t sum : sums)
+  {
+    total += sum;
+  }
+  const int64_t n = static_cast<int64_t>(pairs) * kItems;
+  CHECK(total == n * (n - 1) / 2);
+  CHECK(queue.empty());
+  printf("%d pairs passed\n", pairs);
+}
+
+int main()
+{
+  testBasic();
+  testMoveOnly();
+  testThreads(1);
+  testThreads(4);
+  testThreads(16);
+}
@@ -0,0 +1,238 @@
+#include <muduo/base/ObjectPool.h>
+#include <muduo/base/Thread.h>
+#include <muduo/base/Timestamp.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHECK(cond) \
+  if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); abort(); }
+
+using muduo::ObjectPool;
+using muduo::PoolAllocator;
+
+struct Foo
+{
+  explicit Foo(const std::string& n) : name(n) { ++live; }
+  ~Foo() { --live; }
+
+  std::string name;
+  char padding[100];
+  static std::atomic<int> live;
+};
+
+std::atomic<int> Foo::live(0);
+
+void testReuse()
+{
+  ObjectPool pool;
+  void* p = pool.allocate(100);
+  pool.deallocate(p, 100);
+  // same size class
+  void* q = pool.allocate(128);
+  CHECK(q == p);
+  CHECK(pool.hits() == 1);
+  CHECK(pool.misses() == 1);
+  pool.deallocate(q, 128);
+
+  // another size class
+  void* r = pool.allocate(129);
+  CHECK(r != p);
+  CHECK(pool.misses() == 2);
+  pool.deallocate(r, 129);
+
+  // too large to pool
+  void* big = pool.allocate(ObjectPool::kMaxBlockSize + 1);
+  pool.deallocate(big, ObjectPool::kMaxBlockSize + 1);
+  CHECK(pool.misses() == 2);
+}
+
+void testMaxFreeBlocks()
+{
+  ObjectPool pool(2);
+  void* blocks[3];
+  for (void*& p : blocks)
+  {
+    p = pool.allocate(64);
+  }
+  for (void* p : blocks)
+  {
+    pool.deallocate(p, 64);
+  }
+  for (void*& p : blocks)
+  {
+    p = pool.allocate(64);
+  }
+  CHECK(pool.hits() == 2);
+  CHECK(pool.misses() == 4);
+  for (void* p : blocks)
+  {
+    pool.deallocate(p, 64);
+  }
+}
+
+void testRemoteFree()
+{
+  ObjectPool pool;
+  std::vector<void*> blocks;
+  for (int i = 0; i < 100; ++i)
+  {
+    blocks.push_back(pool.allocate(256));
+  }
+  void* other = NULL;
+  muduo::Thread thr([&] {
+    CHECK(!pool.isOwnerThread());
+    for (void* p : blocks)
+    {
+      pool.deallocate(p, 256);
+    }
+    // not the owner, from the heap
+    other = pool.allocate(256);
+  });
+  thr.start();
+  thr.join();
+  CHECK(pool.hits() == 0);
+  CHECK(pool.misses() == 100);
+
+  for (int i = 0; i < 100; ++i)
+  {
+    blocks[i] = pool.allocate(256);
+  }
+  CHECK(pool.hits() == 100);
+  pool.deallocate(other, 256);
+  for (void* p : blocks)
+  {
+    pool.deallocate(p, 256);
+  }
+}
+
+void testRemoteMaxFreeBlocks()
+{
+  ObjectPool pool(10);
+  std::vector<void*> blocks;
+  for (int i = 0; i < 100; ++i)
+  {
+    blocks.push_back(pool.allocate(256));
+  }
+  // the rest go back to the heap
+  muduo::Thread thr([&] {
+    for (void* p : blocks)
+    {
+      pool.deallocate(p, 256);
+    }
+  });
+  thr.start();
+  thr.join();
+
+  for (int i = 0; i < 100; ++i)
+  {
+    blocks[i] = pool.allocate(256);
+  }
+  CHECK(pool.hits() == 10);
+  CHECK(pool.misses() == 190);
+  // room for more once the owner took them
+  muduo::Thread thr2([&] {
+    for (void* p : blocks)
+    {
+      pool.deallocate(p, 256);
+    }
+  });
+  thr2.start();
+  thr2.join();
+  for (int i = 0; i < 20; ++i)
+  {
+    blocks[i] = pool.allocate(256);
+  }
+  CHECK(pool.hits() == 20);
+  for (int i = 0; i < 20; ++i)
+  {
+    pool.deallocate(blocks[i], 256);
+  }
+}
+
+void testAllocateShared()
+{
+  std::weak_ptr<ObjectPool> weakPool;
+  std::shared_ptr<Foo> foo;
+  {
+    std::shared_ptr<ObjectPool> pool(new ObjectPool);
+    weakPool = pool;
+    PoolAllocator<Foo> alloc(pool);
+    std::allocate_shared<Foo>(alloc, "first");
+    foo = std::allocate_shared<Foo>(alloc, "second");
+    CHECK(pool->hits() == 1);
+    CHECK(pool->misses() == 1);
+
+    auto bar = muduo::makeUniqueFromPool<Foo>(pool.get(), "third");
+    CHECK(bar->name == "third");
+    CHECK(Foo::live == 2);
+  }
+  // the control block holds the allocator
+  CHECK(!weakPool.expired());
+  CHECK(foo->name == "second");
+  foo.reset();
+  CHECK(weakPool.expired());
+  CHECK(Foo::live == 0);
+
+  auto heap = muduo::makeUniqueFromPool<Foo>(NULL, "heap");
+  CHECK(Foo::live == 1);
+}
+
+void testConcurrent()
+{
+  std::shared_ptr<ObjectPool> pool(new ObjectPool);
+  PoolAllocator<Foo> alloc(pool);
+  const int kRounds = 100;
+  const int kBatch = 1000;
+  // another thread allocates and frees on its own
+  std::atomic<bool> running(true);
+  muduo::Thread other([&] {
+    while (running)
+    {
+      std::allocate_shared<Foo>(alloc, "other");
+    }
+  });
+  other.start();
+
+  // the owner allocates, others free
+  muduo::Timestamp start(muduo::Timestamp::now());
+  for (int i = 0; i < kRounds; ++i)
+  {
+    std::vector<std::shared_ptr<Foo>> made;
+    for (int j = 0; j < kBatch; ++j)
+    {
+      made.push_back(std::allocate_shared<Foo>(alloc, "owner"));
+    }
+    muduo::Thread freer([&made] { made.clear(); });
+    freer.start();
+    freer.join();
+  }
+  running = false;
+  other.join();
+  CHECK(Foo::live == 0);
+  CHECK(pool->hits() + pool->misses() == kRounds * kBatch);
+  // "other" fills the remote list too, so how many of the blocks freed by
+  // freer make it there varies, but at most maxFreeBlocks are reused per
+  // round after the first.
+  CHECK(pool->hits() > 0);
+  CHECK(pool->hits() <= (kRounds - 1) * static_cast<int64_t>(pool->maxFreeBlocks()));
+  printf("hits %lld misses %lld in %.3fs\n",
+         static_cast<long long>(pool->hits()),
+         static_cast<long long>(pool->misses()),
+         muduo::timeDifference(muduo::Timestamp::now(), start));
+}
+
+int main()
+{
+  testReuse();
+  testMaxFreeBlocks();
+  testRemoteFree();
+  testRemoteMaxFreeBlocks();
+  testAllocateShared();
+  testConcurrent();
+  printf("All tests passed.\n");
+}
@@ -0,0 +1,95 @@
+#include <muduo/base/ThreadPool.h>
+#include <muduo/base/WorkStealingThreadPool.h>
+#include <muduo/base/CountDownLatch.h>
+#include <muduo/base/Timestamp.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// CPU-bound task of about a microsecond
+void spin(muduo::CountDownLatch* latch)
+{
+  volatile int x = 0;
+  for (int i = 0; i < 300; ++i)
+  {
+    x = x + i;
+  }
+  latch->countDown();
+}
+
+template<typename Pool>
+double benchRun(int numThreads, int tasks)
+{
+  Pool pool("bench");
+  pool.start(numThreads);
+  muduo::CountDownLatch latch(tasks);
+  muduo::Timestamp start(muduo::Timestamp::now());
+  for (int i = 0; i < tasks; ++i)
+  {
+    pool.run(std::bind(spin, &latch));
+  }
+  latch.wait();
+  double seconds = timeDifference(muduo::Timestamp::now(), start);
+  pool.stop();
+  return seconds;
+}
+
+// one task fanning out to all, like a request split into sub-jobs
+double benchFanout(int numThreads, int tasks)
+{
+  muduo::WorkStealingThreadPool pool("bench");
+  pool.start(numThreads);
+  muduo::CountDownLatch latch(tasks);
+  muduo::Timestamp start(muduo::Timestamp::now());
+  pool.run([&pool, &latch, tasks]
+  {
+    for (int i = 0; i < tasks; ++i)
+    {
+      pool.run(std::bind(spin, &latch));
+    }
+  });
+  latch.wait();
+  double seconds = timeDifference(muduo::Timestamp::now(), start);
+  pool.stop();
+  return seconds;
+}
+
+double benchBatch(int numThreads, int tasks, int batchSize)
+{
+  muduo::WorkStealingThreadPool pool("bench");
+  pool.start(numThreads);
+  muduo::CountDownLatch latch(tasks);
+  muduo::Timestamp start(muduo::Timestamp::now());
+  for (int i = 0; i < tasks; i += batchSize)
+  {
+    std::vector<muduo::WorkStealingThreadPool::Task> batch;
+    for (int j = 0; j < batchSize; ++j)
+    {
+      batch.push_back(std::bind(spin, &latch));
+    }
+    pool.runBatch(std::move(batch));
+  }
+  latch.wait();
+  double seconds = timeDifference(muduo::Timestamp::now(), start);
+  pool.stop();
+  return seconds;
+}
+
+int main(int argc, char* argv[])
+{
+  const int kTasks = argc > 1 ? atoi(argv[1]) : 1000 * 1000;
+  const int kBatch = 64;
+  printf("%d tasks, Mtasks/s\n", kTasks);
+  printf("threads  ThreadPool  WorkStealing  fanout  batch%d\n", kBatch);
+  const int threads[] = { 1, 4, 8, 16 };
+  for (int n : threads)
+  {
+    double mutex = benchRun<muduo::ThreadPool>(n, kTasks);
+    double stealing = benchRun<muduo::WorkStealingThreadPool>(n, kTasks);
+    double fanout = benchFanout(n, kTasks);
+    double batch = benchBatch(n, kTasks / kBatch * kBatch, kBatch);
+    printf("%7d  %10.2f  %12.2f  %6.2f  %7.2f\n", n,
+           kTasks / mutex / 1e6, kTasks / stealing / 1e6,
+           kTasks / fanout / 1e6, kTasks / batch / 1e6);
+  }
+}
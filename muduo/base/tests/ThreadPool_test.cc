@@ -41,6 +41,46 @@ void test(int maxSize)
   pool.stop();
 }
 
+void testTryRun()
+{
+  LOG_WARN << "Test ThreadPool::tryRun";
+  muduo::ThreadPool pool("TryRunThreadPool");
+  pool.setMaxQueueSize(1);
+  pool.start(1);
+
+  muduo::CountDownLatch started(1);
+  muduo::CountDownLatch blocker(1);
+  pool.run([&] { started.countDown(); blocker.wait(); });
+  started.wait();
+  if (!pool.tryRun(print))
+  {
+    LOG_FATAL << "tryRun on an empty queue";
+  }
+  if (pool.tryRun(print))
+  {
+    LOG_FATAL << "tryRun on a full queue";
+  }
+  blocker.countDown();
+  pool.stop();
+
+  muduo::ThreadPool unbounded("TryRunThreadPool");
+  unbounded.start(1);
+  muduo::CountDownLatch started2(1);
+  muduo::CountDownLatch blocker2(1);
+  unbounded.run([&] { started2.countDown(); blocker2.wait(); });
+  started2.wait();
+  if (!unbounded.tryRun(print, 2) || !unbounded.tryRun(print, 2))
+  {
+    LOG_FATAL << "tryRun below the limit";
+  }
+  if (unbounded.tryRun(print, 2))
+  {
+    LOG_FATAL << "tryRun at the limit";
+  }
+  blocker2.countDown();
+  unbounded.stop();
+}
+
 int main()
 {
   test(0);
@@ -48,4 +88,5 @@ int main()
   test(5);
   test(10);
   test(50);
+  testTryRun();
 }
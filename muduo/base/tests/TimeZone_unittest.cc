@@ -1,8 +1,11 @@
 #include <muduo/base/TimeZone.h>
+#include <muduo/base/TimeFormat.h>
 #include <muduo/base/Types.h>
 
 #include <assert.h>
+#include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 using muduo::TimeZone;
@@ -58,7 +61,8 @@ void test(const TimeZone& tz, TestCase tc)
   char buf[256];
   strftime(buf, sizeof buf, "%F %T%z(%Z)", &local);
 
-  if (strcmp(buf, tc.local) != 0 || tc.isdst != local.tm_isdst)
+  if (strcmp(buf, tc.local) != 0 || tc.isdst != local.tm_isdst
+      || tz.utcOffset(gmt) != local.tm_gmtoff)
   {
     printf("WRONG: ");
   }
@@ -265,6 +269,91 @@ void testFixedTimezone()
   }
 }
 
+// against strftime(3), across transitions of New York
+void testTimeFormat()
+{
+  TimeZone tz("/usr/share/zoneinfo/America/New_York");
+  time_t start = getGmt("2006-03-01 00:00:00");
+  for (time_t t = start; t < start + 400*24*3600; t += 3599)
+  {
+    char expected[64];
+    char buf[64];
+    struct tm tm_time = TimeZone::toUtcTime(t);
+    strftime(expected, sizeof expected, "%Y%m%d %H:%M:%S", &tm_time);
+    muduo::TimeFormat::formatDateTime(t, NULL, buf);
+    buf[muduo::TimeFormat::kDateTimeLength] = '\0';
+    bool ok = strcmp(buf, expected) == 0;
+
+    tm_time = tz.toLocalTime(t);
+    strftime(expected, sizeof expected, "%Y%m%d %H:%M:%S", &tm_time);
+    muduo::TimeFormat::formatDateTime(t, &tz, buf);
+    buf[muduo::TimeFormat::kDateTimeLength] = '\0';
+    ok = ok && strcmp(buf, expected) == 0;
+
+    tm_time = TimeZone::toUtcTime(t);
+    strftime(expected, sizeof expected, "%a, %d %b %Y %H:%M:%S GMT", &tm_time);
+    muduo::TimeFormat::formatHttpDate(t, buf);
+    buf[muduo::TimeFormat::kHttpDateLength] = '\0';
+    ok = ok && strcmp(buf, expected) == 0;
+
+    strftime(expected, sizeof expected, "%Y%m%d-%H%M%S", &tm_time);
+    muduo::TimeFormat::formatFileTime(t, buf);
+    buf[muduo::TimeFormat::kFileTimeLength] = '\0';
+    ok = ok && strcmp(buf, expected) == 0;
+    if (!ok)
+    {
+      printf("WRONG TimeFormat: %s %s\n", buf, expected);
+      exit(1);
+    }
+  }
+
+  char buf[16] = { 0 };
+  muduo::TimeFormat::formatMicroseconds(1234, buf);
+  if (strcmp(buf, ".001234") != 0)
+  {
+    printf("WRONG formatMicroseconds: %s\n", buf);
+    exit(1);
+  }
+  // of Timestamp(-1)
+  muduo::TimeFormat::formatMicroseconds(-1, buf);
+  if (strcmp(buf, ".000000") != 0)
+  {
+    printf("WRONG formatMicroseconds: %s\n", buf);
+    exit(1);
+  }
+}
+
+// years out of 0000-9999 are clamped
+void testTimeFormatRange()
+{
+  struct Case
+  {
+    time_t t;
+    const char* dateTime;
+    const char* httpDate;
+  } cases[] = {
+    { getGmt("1900-01-01 00:00:00"), "19000101 00:00:00", "Mon, 01 Jan 1900 00:00:00 GMT" },
+    { getGmt("9999-12-31 23:59:59"), "99991231 23:59:59", "Fri, 31 Dec 9999 23:59:59 GMT" },
+    { getGmt("9999-12-31 23:59:59") + 1, "99990101 00:00:00", "Sat, 01 Jan 9999 00:00:00 GMT" },
+    { getGmt("0000-01-01 00:00:00") - 1, "00001231 23:59:59", "Fri, 31 Dec 0000 23:59:59 GMT" },
+  };
+  for (const Case& c : cases)
+  {
+    char buf[64];
+    muduo::TimeFormat::formatDateTime(c.t, NULL, buf);
+    buf[muduo::TimeFormat::kDateTimeLength] = '\0';
+    bool ok = strcmp(buf, c.dateTime) == 0;
+    muduo::TimeFormat::formatHttpDate(c.t, buf);
+    buf[muduo::TimeFormat::kHttpDateLength] = '\0';
+    ok = ok && strcmp(buf, c.httpDate) == 0;
+    if (!ok)
+    {
+      printf("WRONG TimeFormat of %" PRId64 ": %s\n", static_cast<int64_t>(c.t), buf);
+      exit(1);
+    }
+  }
+}
+
 int main()
 {
   testNewYork();
@@ -273,4 +362,6 @@ int main()
   testHongKong();
   testFixedTimezone();
   testUtc();
+  testTimeFormat();
+  testTimeFormatRange();
 }
@@ -0,0 +1,145 @@
+#include <muduo/base/WorkStealingThreadPool.h>
+#include <muduo/base/CountDownLatch.h>
+#include <muduo/base/CurrentThread.h>
+#include <muduo/base/Logging.h>
+
+#include <atomic>
+#include <set>
+
+#include <stdio.h>
+#include <unistd.h>  // usleep
+
+void test(int maxSize)
+{
+  LOG_WARN << "Test WorkStealingThreadPool with max queue size = " << maxSize;
+  muduo::WorkStealingThreadPool pool("MainThreadPool");
+  pool.setMaxQueueSize(maxSize);
+  pool.start(4);
+
+  const int kTasks = 100000;
+  std::atomic<int> done(0);
+  muduo::CountDownLatch latch(kTasks);
+  for (int i = 0; i < kTasks; ++i)
+  {
+    pool.run([&] { ++done; latch.countDown(); });
+  }
+  latch.wait();
+  if (done != kTasks)
+  {
+    LOG_FATAL << "done " << done.load();
+  }
+  pool.stop();
+}
+
+// tasks submitting tasks go to the worker's own deque, and are stolen
+void testNested()
+{
+  LOG_WARN << "Test WorkStealingThreadPool nested run";
+  muduo::WorkStealingThreadPool pool("NestedThreadPool");
+  pool.setMaxQueueSize(16);
+  pool.start(4);
+
+  const int kFanout = 1000;
+  muduo::CountDownLatch latch(kFanout);
+  muduo::MutexLock mutex;
+  std::set<int> tids;
+  pool.run([&]
+  {
+    for (int i = 0; i < kFanout; ++i)
+    {
+      pool.run([&]
+      {
+        usleep(100);
+        {
+        muduo::MutexLockGuard lock(mutex);
+        tids.insert(muduo::CurrentThread::tid());
+        }
+        latch.countDown();
+      });
+    }
+  });
+  latch.wait();
+  LOG_INFO << tids.size() << " workers ran nested tasks";
+  if (tids.size() < 2)
+  {
+    LOG_FATAL << "nothing stolen";
+  }
+  pool.stop();
+}
+
+void testBatch()
+{
+  LOG_WARN << "Test WorkStealingThreadPool::runBatch";
+  muduo::WorkStealingThreadPool pool("BatchThreadPool");
+  pool.setMaxQueueSize(64);
+  pool.start(8);
+
+  const int kBatches = 1000;
+  const int kBatchSize = 100;  // larger than max queue size
+  // odd batches are large, even ones are single tasks
+  muduo::CountDownLatch latch(kBatches / 2 * (kBatchSize + 1));
+  for (int i = 0; i < kBatches; ++i)
+  {
+    std::vector<muduo::WorkStealingThreadPool::Task> tasks;
+    const int n = i % 2 ? kBatchSize : 1;
+    for (int j = 0; j < n; ++j)
+    {
+      tasks.push_back([&] { latch.countDown(); });
+    }
+    pool.runBatch(std::move(tasks));
+  }
+  latch.wait();
+  pool.stop();
+}
+
+void testTryRun()
+{
+  LOG_WARN << "Test WorkStealingThreadPool::tryRun";
+  muduo::WorkStealingThreadPool pool("TryRunThreadPool");
+  pool.setMaxQueueSize(1);
+  pool.start(1);
+
+  muduo::CountDownLatch started(1);
+  muduo::CountDownLatch blocker(1);
+  pool.run([&] { started.countDown(); blocker.wait(); });
+  started.wait();
+  if (!pool.tryRun([] {}))
+  {
+    LOG_FATAL << "tryRun on an empty queue";
+  }
+  if (pool.tryRun([] {}))
+  {
+    LOG_FATAL << "tryRun on a full queue";
+  }
+  if (pool.queueSize() != 1)
+  {
+    LOG_FATAL << "queueSize " << pool.queueSize();
+  }
+  blocker.countDown();
+  pool.stop();
+}
+
+void testNoThreads()
+{
+  LOG_WARN << "Test WorkStealingThreadPool without threads";
+  muduo::WorkStealingThreadPool pool("InlineThreadPool");
+  pool.start(0);
+  int n = 0;
+  pool.run([&n] { ++n; });
+  pool.runBatch({ [&n] { ++n; }, [&n] { ++n; } });
+  if (n != 3)
+  {
+    LOG_FATAL << "n " << n;
+  }
+}
+
+int main()
+{
+  test(0);
+  test(1);
+  test(50);
+  testNested();
+  testBatch();
+  testTryRun();
+  testNoThreads();
+}
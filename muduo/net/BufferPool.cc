@@ -0,0 +1,91 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include <muduo/net/BufferPool.h>
+
+#include <muduo/base/Metrics.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const size_t BufferPool::kLargeSize;
+
+namespace
+{
+// bursts don't pin more than this per pooled Buffer
+const size_t kMaxPooledCapacity = 4 * BufferPool::kLargeSize + Buffer::kCheapPrepend;
+}
+
+BufferPool::BufferPool(size_t maxBuffers)
+  : maxBuffers_(maxBuffers),
+    readBuffer_(kLargeSize),
+    size_(0),
+    bytes_(0)
+{
+  buffers_.reserve(maxBuffers_);
+}
+
+BufferPool::~BufferPool()
+{
+  update(-static_cast<int64_t>(bytes()));
+}
+
+Gauge* BufferPool::bytesGauge()
+{
+  static Gauge* gauge = MetricsRegistry::instance().gauge(
+      "muduo_buffer_pool_bytes", "Capacity of large Buffers pooled by EventLoops.");
+  return gauge;
+}
+
+Gauge* BufferPool::connectionBytesGauge()
+{
+  static Gauge* gauge = MetricsRegistry::instance().gauge(
+      "muduo_tcpconnection_buffer_bytes",
+      "Capacity of input and output Buffers of TcpConnections.");
+  return gauge;
+}
+
+void BufferPool::update(int64_t delta)
+{
+  size_.store(buffers_.size(), std::memory_order_relaxed);
+  bytes_.store(static_cast<size_t>(static_cast<int64_t>(bytes()) + delta),
+               std::memory_order_relaxed);
+  bytesGauge()->add(delta);
+}
+
+void BufferPool::get(Buffer* buf)
+{
+  if (buf->writableBytes() >= kLargeSize)
+  {
+    return;
+  }
+  Buffer large(0);
+  if (buffers_.empty())
+  {
+    large.ensureWritableBytes(kLargeSize + buf->readableBytes());
+  }
+  else
+  {
+    large.swap(buffers_.back());
+    buffers_.pop_back();
+    update(-static_cast<int64_t>(large.internalCapacity()));
+  }
+  large.append(buf->peek(), buf->readableBytes());
+  buf->swap(large);
+}
+
+void BufferPool::put(Buffer* buf)
+{
+  assert(buf->readableBytes() == 0);
+  Buffer old;
+  buf->swap(old);
+  const size_t capacity = old.internalCapacity();
+  if (capacity >= kLargeSize + Buffer::kCheapPrepend
+      && capacity <= kMaxPooledCapacity
+      && buffers_.size() < maxBuffers_)
+  {
+    old.retrieveAll();
+    buffers_.push_back(std::move(old));
+    update(static_cast<int64_t>(capacity));
+  }
+}
@@ -0,0 +1,73 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_BUFFERPOOL_H
+#define MUDUO_NET_BUFFERPOOL_H
+
+#include <muduo/base/noncopyable.h>
+#include <muduo/net/Buffer.h>
+
+#include <atomic>
+#include <vector>
+
+namespace muduo
+{
+class Gauge;
+
+namespace net
+{
+
+///
+/// Large empty Buffers of an EventLoop, lent to connections reading
+/// a burst, and taken back when they go quiet.
+/// Also holds the read buffer shared by connections of the loop,
+/// see TcpConnection::setSharedInputBuffer().
+///
+/// get(), put() and readBuffer() are called in the loop thread only,
+/// size() and bytes() are safe to read from other threads.
+class BufferPool : noncopyable
+{
+ public:
+  static const size_t kLargeSize = 64*1024;
+
+  explicit BufferPool(size_t maxBuffers = 32);
+  ~BufferPool();
+
+  /// Gives buf at least kLargeSize writable bytes, keeping its content.
+  void get(Buffer* buf);
+
+  /// Replaces buf with a new small Buffer, and keeps the old storage
+  /// if it's large but not huge, and the pool isn't full.
+  /// buf must be empty.
+  void put(Buffer* buf);
+
+  /// Reads of connections in shared input mode land here,
+  /// it's empty between reads.
+  Buffer& readBuffer() { return readBuffer_; }
+
+  size_t size() const { return size_.load(std::memory_order_relaxed); }
+  /// capacity of the pooled Buffers
+  size_t bytes() const { return bytes_.load(std::memory_order_relaxed); }
+
+  /// capacity of pooled Buffers of all loops, muduo_buffer_pool_bytes
+  static Gauge* bytesGauge();
+  /// capacity of input and output Buffers of all TcpConnections,
+  /// muduo_tcpconnection_buffer_bytes
+  static Gauge* connectionBytesGauge();
+
+ private:
+  void update(int64_t delta);
+
+  const size_t maxBuffers_;
+  std::vector<Buffer> buffers_;
+  Buffer readBuffer_;
+  std::atomic<size_t> size_;
+  std::atomic<size_t> bytes_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_BUFFERPOOL_H
@@ -11,6 +11,7 @@
 
 #include <muduo/base/Logging.h>
 #include <muduo/net/Channel.h>
+#include <muduo/net/DnsResolver.h>
 #include <muduo/net/EventLoop.h>
 #include <muduo/net/SocketsOps.h>
 
@@ -30,18 +31,39 @@ const int Connector::kMaxRetryDelayMs;
 Connector::Connector(EventLoop* loop, const InetAddress& serverAddr)
   : loop_(loop),
     serverAddr_(serverAddr),
+    resolver_(NULL),
+    port_(serverAddr.toPort()),
+    nextCandidate_(0),
     connect_(false),
     state_(kDisconnected),
-    retryDelayMs_(kInitRetryDelayMs)
+    retryDelayMs_(kInitRetryDelayMs),
+    random_(std::random_device()())
 {
   LOG_DEBUG << "ctor[" << this << "]";
 }
 
+Connector::Connector(EventLoop* loop, DnsResolver* resolver,
+                     const string& host, uint16_t port)
+  : loop_(loop),
+    resolver_(CHECK_NOTNULL(resolver)),
+    host_(host),
+    port_(port),
+    nextCandidate_(0),
+    connect_(false),
+    state_(kDisconnected),
+    retryDelayMs_(kInitRetryDelayMs),
+    random_(std::random_device()())
+{
+  assert(resolver->getLoop() == loop);
+  LOG_DEBUG << "ctor[" << this << "] " << host_ << ":" << port_;
+}
+
 //ͷ
 Connector::~Connector()
 {
   LOG_DEBUG << "dtor[" << this << "]";
   assert(!channel_);
+  assert(attempts_.empty());
 }
 
 //ʼ
@@ -57,7 +79,14 @@ void Connector::startInLoop()
   assert(state_ == kDisconnected);
   if (connect_)
   {
-    connect();
+    if (resolver_)
+    {
+      resolveAndConnect();
+    }
+    else
+    {
+      connect();
+    }
   }
   else
   {
@@ -65,6 +94,151 @@ void Connector::startInLoop()
   }
 }
 
+// resolved again before every connect, following DNS changes
+void Connector::resolveAndConnect()
+{
+  std::weak_ptr<Connector> weakSelf(shared_from_this());
+  resolver_->resolve(host_, port_,
+                     [weakSelf](const std::vector<InetAddress>& addresses)
+                     {
+                       std::shared_ptr<Connector> self(weakSelf.lock());
+                       if (self)
+                       {
+                         self->onResolved(addresses);
+                       }
+                     },
+                     DnsResolver::kAny);
+}
+
+void Connector::onResolved(const std::vector<InetAddress>& addresses)
+{
+  loop_->assertInLoopThread();
+  if (!connect_ || state_ != kDisconnected)
+  {
+    return;
+  }
+  if (addresses.empty())
+  {
+    LOG_WARN << "Connector::onResolved - can't resolve " << host_;
+    scheduleRetry();
+    return;
+  }
+  std::vector<InetAddress> v6, v4;
+  for (const InetAddress& addr : addresses)
+  {
+    (addr.family() == AF_INET6 ? v6 : v4).push_back(addr);
+  }
+  candidates_.clear();
+  for (size_t i = 0; i < std::max(v6.size(), v4.size()); ++i)
+  {
+    if (i < v6.size())
+      candidates_.push_back(v6[i]);
+    if (i < v4.size())
+      candidates_.push_back(v4[i]);
+  }
+  nextCandidate_ = 0;
+  setState(kConnecting);
+  startAttempt();
+}
+
+void Connector::startAttempt()
+{
+  loop_->assertInLoopThread();
+  if (!connect_ || state_ != kConnecting)
+  {
+    // eg. the timer of a finished race
+    return;
+  }
+  while (nextCandidate_ < candidates_.size())
+  {
+    const InetAddress& addr = candidates_[nextCandidate_++];
+    int sockfd = sockets::createNonblockingOrDie(addr.family());
+    int ret = sockets::connect(sockfd, addr.getSockAddr());
+    int savedErrno = (ret == 0) ? 0 : errno;
+    if (savedErrno == 0 || savedErrno == EINPROGRESS
+        || savedErrno == EINTR || savedErrno == EISCONN)
+    {
+      Attempt& attempt = attempts_[sockfd];
+      attempt.channel.reset(new Channel(loop_, sockfd));
+      attempt.address = addr;
+      attempt.channel->setWriteCallback(
+          std::bind(&Connector::handleAttempt, this, sockfd)); // FIXME: unsafe
+      attempt.channel->setErrorCallback(
+          std::bind(&Connector::handleAttempt, this, sockfd)); // FIXME: unsafe
+      // failed attempts are expected in a race
+      attempt.channel->doNotLogHup();
+      attempt.channel->enableWriting();
+      if (nextCandidate_ < candidates_.size())
+      {
+        attemptTimer_ = loop_->runAfter(kAttemptDelayMs / 1000.0,
+            std::bind(&Connector::startAttempt, shared_from_this()));
+      }
+      return;
+    }
+    LOG_WARN << "Connector::startAttempt - " << addr.toIpPort()
+             << " " << strerror_tl(savedErrno);
+    sockets::close(sockfd);
+  }
+  if (attempts_.empty())
+  {
+    scheduleRetry();
+  }
+}
+
+void Connector::handleAttempt(int sockfd)
+{
+  auto it = attempts_.find(sockfd);
+  if (it == attempts_.end())
+  {
+    return;
+  }
+  Attempt attempt(it->second);
+  attempts_.erase(it);
+  attempt.channel->disableAll();
+  attempt.channel->remove();
+  // Can't destroy the channel here, because we are inside Channel::handleEvent
+  std::shared_ptr<Channel> channel(attempt.channel);
+  loop_->queueInLoop([channel] {});
+
+  int err = sockets::getSocketError(sockfd);
+  if (err || sockets::isSelfConnect(sockfd))
+  {
+    LOG_WARN << "Connector::handleAttempt - " << attempt.address.toIpPort()
+             << " SO_ERROR = " << err << " " << strerror_tl(err);
+    sockets::close(sockfd);
+    // the next one at once
+    loop_->cancel(attemptTimer_);
+    startAttempt();
+    return;
+  }
+
+  loop_->cancel(attemptTimer_);
+  closeAttempts();
+  serverAddr_ = attempt.address;
+  setState(kConnected);
+  if (connect_)
+  {
+    newConnectionCallback_(sockfd);
+  }
+  else
+  {
+    sockets::close(sockfd);
+  }
+}
+
+void Connector::closeAttempts()
+{
+  for (auto& entry : attempts_)
+  {
+    std::shared_ptr<Channel> channel(entry.second.channel);
+    channel->disableAll();
+    channel->remove();
+    loop_->queueInLoop([channel] {});
+    sockets::close(entry.first);
+  }
+  attempts_.clear();
+}
+
 void Connector::stop()
 {
   connect_ = false;
@@ -77,6 +251,13 @@ void Connector::stopInLoop()
   loop_->assertInLoopThread();
   if (state_ == kConnecting)
   {
+    if (resolver_)
+    {
+      loop_->cancel(attemptTimer_);
+      closeAttempts();
+      scheduleRetry();
+      return;
+    }
     setState(kDisconnected);
     int sockfd = removeAndResetChannel();
     retry(sockfd);
@@ -243,14 +424,23 @@ void Connector::retry(int sockfd)
 {
   //رյǰsocket
   sockets::close(sockfd);
+  scheduleRetry();
+}
+
+void Connector::scheduleRetry()
+{
   //ǰΪϿ
   setState(kDisconnected);
   if (connect_)
   {
-    LOG_INFO << "Connector::retry - Retry connecting to " << serverAddr_.toIpPort()
-             << " in " << retryDelayMs_ << " milliseconds. ";
+    // with jitter, so clients of a restarted server don't come back together
+    const int delayMs = retryDelayMs_ / 2
+        + static_cast<int>(random_() % static_cast<unsigned>(retryDelayMs_ / 2 + 1));
+    LOG_INFO << "Connector::retry - Retry connecting to "
+             << (resolver_ ? host_ : serverAddr_.toIpPort())
+             << " in " << delayMs << " milliseconds. ";
     //뵽ʱ    
-    loop_->runAfter(retryDelayMs_/1000.0,
+    loop_->runAfter(delayMs/1000.0,
                     std::bind(&Connector::startInLoop, shared_from_this()));
     retryDelayMs_ = std::min(retryDelayMs_ * 2, kMaxRetryDelayMs);
   }
@@ -13,9 +13,13 @@
 
 #include <muduo/base/noncopyable.h>
 #include <muduo/net/InetAddress.h>
+#include <muduo/net/TimerId.h>
 
 #include <functional>
+#include <map>
 #include <memory>
+#include <random>
+#include <vector>
 
 namespace muduo
 {
@@ -23,6 +27,7 @@ namespace net
 {
 
 class Channel;
+class DnsResolver;
 class EventLoop;
 
 // ֻsocket, 𴴽TcpConnection
@@ -33,6 +38,12 @@ class Connector : noncopyable,
   typedef std::function<void (int sockfd)> NewConnectionCallback;
 
   Connector(EventLoop* loop, const InetAddress& serverAddr);
+  /// Resolves @c host by @c resolver before each connect, and races connects
+  /// to its addresses, IPv6 and IPv4 interleaved, starting the next one
+  /// every kAttemptDelayMs or when one fails (Happy Eyeballs, RFC 8305).
+  /// The first one established wins.
+  /// @c resolver must outlive this, in the same loop.
+  Connector(EventLoop* loop, DnsResolver* resolver, const string& host, uint16_t port);
   ~Connector();
 
   // ӻص
@@ -45,6 +56,8 @@ class Connector : noncopyable,
 
   // ˵ַ
   const InetAddress& serverAddress() const { return serverAddr_; }
+  /// empty if not resolving
+  const string& serverHost() const { return host_; }
 
  private:
    // ״̬  
@@ -53,6 +66,13 @@ class Connector : noncopyable,
   static const int kMaxRetryDelayMs = 30*1000;
   // ʼʱ500ms
   static const int kInitRetryDelayMs = 500;
+  static const int kAttemptDelayMs = 250;
+
+  struct Attempt
+  {
+    std::shared_ptr<Channel> channel;
+    InetAddress address;
+  };
 
   // ǰ״̬
   void setState(States s) { state_ = s; }
@@ -62,6 +82,11 @@ class Connector : noncopyable,
   void stopInLoop();
   // 
   void connect();
+  void resolveAndConnect();
+  void onResolved(const std::vector<InetAddress>& addresses);
+  void startAttempt();
+  void handleAttempt(int sockfd);
+  void closeAttempts();
   // 
   void connecting(int sockfd);
   // д
@@ -70,6 +95,7 @@ class Connector : noncopyable,
   void handleError();
   //
   void retry(int sockfd);
+  void scheduleRetry();
   //ƳͷChannel
   int removeAndResetChannel();
   //ͷChannel
@@ -79,6 +105,14 @@ class Connector : noncopyable,
   EventLoop* loop_;
   //˵ַ
   InetAddress serverAddr_;
+  DnsResolver* resolver_;
+  const string host_;
+  const uint16_t port_;
+  // addresses to race, and connects in flight by sockfd
+  std::vector<InetAddress> candidates_;
+  size_t nextCandidate_;
+  std::map<int, Attempt> attempts_;
+  TimerId attemptTimer_;
   //״̬λ
   bool connect_; // atomic
   States state_;  // FIXME: use atomic variable
@@ -88,6 +122,8 @@ class Connector : noncopyable,
   NewConnectionCallback newConnectionCallback_;
   //
   int retryDelayMs_;
+  // for jitter of retryDelayMs_
+  std::minstd_rand random_;
 };
 
 }  // namespace net
@@ -0,0 +1,615 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include <muduo/net/DnsResolver.h>
+
+#include <muduo/base/FileUtil.h>
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/SocketsOps.h>
+#include <muduo/net/UdpSocket.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const uint16_t kTypeA = 1;
+const uint16_t kTypeAAAA = 28;
+const uint16_t kClassIN = 1;
+const uint16_t kFlagResponse = 0x8000;
+const uint16_t kFlagRecursionDesired = 0x0100;
+const int kRcodeNxDomain = 3;
+const size_t kHeaderLen = 12;
+const size_t kMaxNameLen = 255;
+
+uint16_t read16(const unsigned char* p)
+{
+  return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+uint32_t read32(const unsigned char* p)
+{
+  return (static_cast<uint32_t>(read16(p)) << 16) | read16(p + 2);
+}
+
+void write16(unsigned char* p, uint16_t v)
+{
+  p[0] = static_cast<unsigned char>(v >> 8);
+  p[1] = static_cast<unsigned char>(v);
+}
+
+// lower case, without the trailing dot
+string normalize(const string& hostname)
+{
+  string name(hostname);
+  if (!name.empty() && name.back() == '.')
+  {
+    name.pop_back();
+  }
+  std::transform(name.begin(), name.end(), name.begin(),
+                 [](char c) { return static_cast<char>(tolower(static_cast<unsigned char>(c))); });
+  return name;
+}
+
+string cacheKey(uint16_t qtype, const string& name)
+{
+  return (qtype == kTypeAAAA ? "6:" : "4:") + name;
+}
+
+// returns length of the query, 0 if name is invalid
+size_t encodeQuery(uint16_t id, const string& name, uint16_t qtype,
+                   unsigned char* buf, size_t size)
+{
+  if (name.empty() || name.size() > kMaxNameLen || size < kHeaderLen + name.size() + 6)
+  {
+    return 0;
+  }
+  memZero(buf, kHeaderLen);
+  write16(buf, id);
+  write16(buf + 2, kFlagRecursionDesired);
+  write16(buf + 4, 1);  // QDCOUNT
+  unsigned char* p = buf + kHeaderLen;
+  size_t begin = 0;
+  while (begin <= name.size())
+  {
+    size_t dot = name.find('.', begin);
+    if (dot == string::npos)
+    {
+      dot = name.size();
+    }
+    const size_t label = dot - begin;
+    if (label == 0 || label > 63)
+    {
+      return 0;
+    }
+    *p++ = static_cast<unsigned char>(label);
+    memcpy(p, name.data() + begin, label);
+    p += label;
+    begin = dot + 1;
+  }
+  *p++ = 0;
+  write16(p, qtype);
+  write16(p + 2, kClassIN);
+  p += 4;
+  return p - buf;
+}
+
+// reads a possibly compressed name at *offset, which is moved past it.
+bool readName(const unsigned char* msg, size_t len, size_t* offset, string* name)
+{
+  size_t pos = *offset;
+  bool jumped = false;
+  int jumps = 0;
+  if (name)
+  {
+    name->clear();
+  }
+  while (true)
+  {
+    if (pos >= len)
+    {
+      return false;
+    }
+    const unsigned char c = msg[pos];
+    if (c == 0)
+    {
+      if (!jumped)
+      {
+        *offset = pos + 1;
+      }
+      return true;
+    }
+    else if ((c & 0xC0) == 0xC0)
+    {
+      if (pos + 1 >= len || ++jumps > 64)
+      {
+        return false;
+      }
+      if (!jumped)
+      {
+        *offset = pos + 2;
+        jumped = true;
+      }
+      pos = ((c & 0x3F) << 8) | msg[pos + 1];
+    }
+    else if (c > 63 || pos + 1 + c > len)
+    {
+      return false;
+    }
+    else
+    {
+      if (name)
+      {
+        if (!name->empty())
+        {
+          name->push_back('.');
+        }
+        name->append(reinterpret_cast<const char*>(msg + pos + 1), c);
+        if (name->size() > kMaxNameLen)
+        {
+          return false;
+        }
+      }
+      pos += 1 + c;
+    }
+  }
+}
+
+InetAddress withPort(const InetAddress& addr, uint16_t port)
+{
+  struct sockaddr_in6 sa = *sockets::sockaddr_in6_cast(addr.getSockAddr());
+  if (sa.sin6_family == AF_INET6)
+  {
+    sa.sin6_port = sockets::hostToNetwork16(port);
+    return InetAddress(sa);
+  }
+  struct sockaddr_in sa4 = *sockets::sockaddr_in_cast(addr.getSockAddr());
+  sa4.sin_port = sockets::hostToNetwork16(port);
+  return InetAddress(sa4);
+}
+
+bool parseAddress(const string& ip, uint16_t port, InetAddress* out)
+{
+  struct in_addr a4;
+  struct in6_addr a6;
+  if (::inet_pton(AF_INET, ip.c_str(), &a4) == 1)
+  {
+    *out = InetAddress(ip, port);
+    return true;
+  }
+  if (::inet_pton(AF_INET6, ip.c_str(), &a6) == 1)
+  {
+    *out = InetAddress(ip, port, true);
+    return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+DnsResolver::DnsResolver(EventLoop* loop)
+  : DnsResolver(loop, std::vector<InetAddress>())
+{
+  nameservers_ = readResolvConf("/etc/resolv.conf", &timeout_, &attempts_);
+  if (nameservers_.empty())
+  {
+    // as the resolver of libc
+    nameservers_.push_back(InetAddress("127.0.0.1", 53));
+  }
+  loadHosts("/etc/hosts");
+}
+
+DnsResolver::DnsResolver(EventLoop* loop, const std::vector<InetAddress>& nameservers)
+  : loop_(CHECK_NOTNULL(loop)),
+    nameservers_(nameservers),
+    timeout_(5),
+    attempts_(2),
+    maxTtl_(3600),
+    negativeTtl_(30),
+    maxCacheEntries_(4096),
+    random_(std::random_device()()),
+    queriesSent_(0),
+    cacheHits_(0)
+{
+}
+
+DnsResolver::~DnsResolver()
+{
+  loop_->assertInLoopThread();
+  // callbacks of pending queries are not called
+  for (auto& entry : queries_)
+  {
+    loop_->cancel(entry.second.timer);
+  }
+}
+
+std::vector<InetAddress> DnsResolver::readResolvConf(const char* path,
+                                                     double* timeout,
+                                                     int* attempts)
+{
+  std::vector<InetAddress> nameservers;
+  string content;
+  if (FileUtil::readFile(path, 64 * 1024, &content) != 0)
+  {
+    LOG_WARN << "DnsResolver - can't read " << path;
+    return nameservers;
+  }
+  std::istringstream lines(content);
+  string line;
+  while (std::getline(lines, line))
+  {
+    std::istringstream words(line);
+    string keyword;
+    words >> keyword;
+    if (keyword == "nameserver")
+    {
+      string ip;
+      words >> ip;
+      ip = ip.substr(0, ip.find('%'));  // no scope id
+      InetAddress addr;
+      if (parseAddress(ip, 53, &addr))
+      {
+        nameservers.push_back(addr);
+      }
+    }
+    else if (keyword == "options")
+    {
+      string option;
+      while (words >> option)
+      {
+        if (timeout && option.compare(0, 8, "timeout:") == 0)
+        {
+          *timeout = std::max(atoi(option.c_str() + 8), 1);
+        }
+        else if (attempts && option.compare(0, 9, "attempts:") == 0)
+        {
+          *attempts = std::max(atoi(option.c_str() + 9), 1);
+        }
+      }
+    }
+  }
+  return nameservers;
+}
+
+void DnsResolver::loadHosts(const char* path)
+{
+  string content;
+  if (FileUtil::readFile(path, 1024 * 1024, &content) != 0)
+  {
+    return;
+  }
+  std::istringstream lines(content);
+  string line;
+  while (std::getline(lines, line))
+  {
+    line = line.substr(0, line.find('#'));
+    std::istringstream words(line);
+    string ip;
+    InetAddress addr;
+    if (!(words >> ip) || !parseAddress(ip, 0, &addr))
+    {
+      continue;
+    }
+    const uint16_t qtype = addr.family() == AF_INET6 ? kTypeAAAA : kTypeA;
+    string name;
+    while (words >> name)
+    {
+      hosts_[cacheKey(qtype, normalize(name))].push_back(addr);
+    }
+  }
+}
+
+void DnsResolver::resolve(const string& hostname, uint16_t port, const Callback& cb,
+                          Family family)
+{
+  if (loop_->isInLoopThread())
+  {
+    resolveInLoop(hostname, port, cb, family);
+  }
+  else
+  {
+    loop_->runInLoop(std::bind(&DnsResolver::resolveInLoop, this, hostname, port, cb, family));
+  }
+}
+
+void DnsResolver::resolveInLoop(const string& hostname, uint16_t port, const Callback& cb,
+                                Family family)
+{
+  loop_->assertInLoopThread();
+  InetAddress numeric;
+  if (parseAddress(hostname, port, &numeric))
+  {
+    std::vector<InetAddress> addresses;
+    if (family == kAny || (family == kIPv6) == (numeric.family() == AF_INET6))
+    {
+      addresses.push_back(numeric);
+    }
+    cb(addresses);
+    return;
+  }
+
+  const string name = normalize(hostname);
+  if (family == kAny)
+  {
+    struct Both
+    {
+      std::vector<InetAddress> v4, v6;
+      int remaining;
+    };
+    std::shared_ptr<Both> both(new Both);
+    both->remaining = 2;
+    auto done = [both, port, cb]()
+    {
+      if (--both->remaining == 0)
+      {
+        std::vector<InetAddress> addresses;
+        for (const InetAddress& addr : both->v4)
+          addresses.push_back(withPort(addr, port));
+        for (const InetAddress& addr : both->v6)
+          addresses.push_back(withPort(addr, port));
+        cb(addresses);
+      }
+    };
+    lookup(name, kTypeA, [both, done](const std::vector<InetAddress>& addresses)
+           { both->v4 = addresses; done(); });
+    lookup(name, kTypeAAAA, [both, done](const std::vector<InetAddress>& addresses)
+           { both->v6 = addresses; done(); });
+  }
+  else
+  {
+    lookup(name, family == kIPv6 ? kTypeAAAA : kTypeA,
+           [port, cb](const std::vector<InetAddress>& addresses)
+           {
+             std::vector<InetAddress> result;
+             result.reserve(addresses.size());
+             for (const InetAddress& addr : addresses)
+               result.push_back(withPort(addr, port));
+             cb(result);
+           });
+  }
+}
+
+void DnsResolver::lookup(const string& name, uint16_t qtype, const Callback& cb)
+{
+  const string key = cacheKey(qtype, name);
+  auto host = hosts_.find(key);
+  if (host != hosts_.end())
+  {
+    cb(host->second);
+    return;
+  }
+
+  auto cached = cache_.find(key);
+  if (cached != cache_.end())
+  {
+    if (Timestamp::now() < cached->second.expiration)
+    {
+      ++cacheHits_;
+      cb(cached->second.addresses);
+      return;
+    }
+    cache_.erase(cached);
+  }
+
+  auto inflight = inflight_.find(key);
+  if (inflight != inflight_.end())
+  {
+    queries_[inflight->second].callbacks.push_back(cb);
+    return;
+  }
+
+  uint16_t id = 0;
+  do
+  {
+    id = static_cast<uint16_t>(random_());
+  } while (queries_.find(id) != queries_.end());
+  Query& query = queries_[id];
+  query.name = name;
+  query.qtype = qtype;
+  query.callbacks.push_back(cb);
+  query.tries = 0;
+  inflight_[key] = id;
+  send(id);
+}
+
+void DnsResolver::send(uint16_t id)
+{
+  Query& query = queries_[id];
+  if (nameservers_.empty()
+      || query.tries >= attempts_ * static_cast<int>(nameservers_.size()))
+  {
+    LOG_WARN << "DnsResolver - no answer for " << query.name;
+    finish(id, std::vector<InetAddress>(), negativeTtl_);
+    return;
+  }
+  unsigned char packet[kHeaderLen + kMaxNameLen + 8];
+  const size_t len = encodeQuery(id, query.name, query.qtype, packet, sizeof packet);
+  if (len == 0)
+  {
+    LOG_ERROR << "DnsResolver - invalid name " << query.name;
+    finish(id, std::vector<InetAddress>(), 0);
+    return;
+  }
+  query.server = nameservers_[query.tries % nameservers_.size()];
+  ++query.tries;
+  socketFor(query.server)->sendTo(query.server, packet, len);
+  ++queriesSent_;
+  query.timer = loop_->runAfter(timeout_, std::bind(&DnsResolver::onTimeout, this, id));
+}
+
+void DnsResolver::onTimeout(uint16_t id)
+{
+  auto it = queries_.find(id);
+  if (it != queries_.end())
+  {
+    LOG_DEBUG << "DnsResolver - " << it->second.name << " timed out on "
+              << it->second.server.toIpPort();
+    send(id);
+  }
+}
+
+UdpSocket* DnsResolver::socketFor(const InetAddress& server)
+{
+  const bool ipv6 = server.family() == AF_INET6;
+  std::unique_ptr<UdpSocket>& socket = ipv6 ? socket6_ : socket4_;
+  if (!socket)
+  {
+    // unbound, the kernel picks a random port on first send
+    socket.reset(new UdpSocket(loop_, "DnsResolver", server.family()));
+    socket->setMessageCallback(
+        [this](UdpSocket*, StringPiece datagram, const InetAddress& peer, Timestamp)
+        { onMessage(datagram, peer); });
+    socket->start();
+  }
+  return get_pointer(socket);
+}
+
+void DnsResolver::onMessage(StringPiece datagram, const InetAddress& peer)
+{
+  const unsigned char* msg = reinterpret_cast<const unsigned char*>(datagram.data());
+  const size_t len = datagram.size();
+  if (len < kHeaderLen)
+  {
+    return;
+  }
+  const uint16_t id = read16(msg);
+  const uint16_t flags = read16(msg + 2);
+  auto it = queries_.find(id);
+  if (it == queries_.end() || !(flags & kFlagResponse) || read16(msg + 4) != 1)
+  {
+    return;
+  }
+  const string peerIpPort = peer.toIpPort();
+  if (std::none_of(nameservers_.begin(), nameservers_.end(),
+                   [&peerIpPort](const InetAddress& ns) { return ns.toIpPort() == peerIpPort; }))
+  {
+    LOG_WARN << "DnsResolver - unexpected answer from " << peerIpPort;
+    return;
+  }
+
+  // the question must be ours, against spoofed answers
+  Query& query = it->second;
+  size_t offset = kHeaderLen;
+  string qname;
+  if (!readName(msg, len, &offset, &qname) || offset + 4 > len
+      || normalize(qname) != query.name || read16(msg + offset) != query.qtype)
+  {
+    return;
+  }
+  offset += 4;
+
+  const int rcode = flags & 0x0F;
+  if (rcode == kRcodeNxDomain)
+  {
+    finish(id, std::vector<InetAddress>(), negativeTtl_);
+    return;
+  }
+  if (rcode != 0)
+  {
+    // eg. SERVFAIL or REFUSED, asks the next one
+    loop_->cancel(query.timer);
+    send(id);
+    return;
+  }
+
+  std::vector<InetAddress> addresses;
+  uint32_t ttl = UINT32_MAX;
+  const uint16_t answers = read16(msg + 6);
+  for (uint16_t i = 0; i < answers; ++i)
+  {
+    if (!readName(msg, len, &offset, NULL) || offset + 10 > len)
+    {
+      break;
+    }
+    const uint16_t type = read16(msg + offset);
+    const uint16_t cls = read16(msg + offset + 2);
+    const uint32_t recordTtl = read32(msg + offset + 4);
+    const uint16_t rdlength = read16(msg + offset + 8);
+    offset += 10;
+    if (offset + rdlength > len)
+    {
+      break;
+    }
+    // CNAMEs are followed by the server, their TTLs count too
+    if (cls == kClassIN)
+    {
+      ttl = std::min(ttl, recordTtl);
+    }
+    if (cls == kClassIN && type == kTypeA && type == query.qtype && rdlength == 4)
+    {
+      struct sockaddr_in addr;
+      memZero(&addr, sizeof addr);
+      addr.sin_family = AF_INET;
+      memcpy(&addr.sin_addr, msg + offset, 4);
+      addresses.push_back(InetAddress(addr));
+    }
+    else if (cls == kClassIN && type == kTypeAAAA && type == query.qtype && rdlength == 16)
+    {
+      struct sockaddr_in6 addr;
+      memZero(&addr, sizeof addr);
+      addr.sin6_family = AF_INET6;
+      memcpy(&addr.sin6_addr, msg + offset, 16);
+      addresses.push_back(InetAddress(addr));
+    }
+    offset += rdlength;
+  }
+
+  if (addresses.empty())
+  {
+    // the name exists, but not of this type
+    finish(id, addresses, negativeTtl_);
+  }
+  else
+  {
+    finish(id, addresses, static_cast<int>(std::min<uint32_t>(ttl, INT32_MAX)));
+  }
+}
+
+void DnsResolver::finish(uint16_t id, const std::vector<InetAddress>& addresses, int ttl)
+{
+  auto it = queries_.find(id);
+  assert(it != queries_.end());
+  Query query(std::move(it->second));
+  queries_.erase(it);
+  loop_->cancel(query.timer);
+
+  const string key = cacheKey(query.qtype, query.name);
+  inflight_.erase(key);
+  ttl = std::min(ttl, maxTtl_);
+  if (ttl > 0)
+  {
+    if (cache_.size() >= maxCacheEntries_)
+    {
+      const Timestamp now = Timestamp::now();
+      for (auto entry = cache_.begin(); entry != cache_.end(); )
+      {
+        if (entry->second.expiration < now)
+          entry = cache_.erase(entry);
+        else
+          ++entry;
+      }
+      if (cache_.size() >= maxCacheEntries_)
+      {
+        cache_.erase(cache_.begin());
+      }
+    }
+    CacheEntry& entry = cache_[key];
+    entry.addresses = addresses;
+    entry.expiration = addTime(Timestamp::now(), ttl);
+  }
+
+  for (const Callback& cb : query.callbacks)
+  {
+    cb(addresses);
+  }
+}
@@ -0,0 +1,138 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_DNSRESOLVER_H
+#define MUDUO_NET_DNSRESOLVER_H
+
+#include <muduo/base/StringPiece.h>
+#include <muduo/base/Timestamp.h>
+#include <muduo/base/Types.h>
+#include <muduo/base/noncopyable.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/TimerId.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace muduo
+{
+namespace net
+{
+
+class EventLoop;
+class UdpSocket;
+
+///
+/// Asynchronous DNS stub resolver in an EventLoop.
+///
+/// Sends A/AAAA queries over UDP to the nameservers of /etc/resolv.conf,
+/// one after another on timeout, and caches answers for their TTL,
+/// failures for setNegativeTtl().  Concurrent lookups of a name share
+/// one query.  /etc/hosts and numeric addresses are answered without
+/// a query.  No search domains and no TCP fallback, truncated answers
+/// are used as they are.
+///
+/// Must be destroyed in the loop thread, resolve() is thread safe.
+class DnsResolver : noncopyable
+{
+ public:
+  enum Family
+  {
+    kIPv4,  // A
+    kIPv6,  // AAAA
+    kAny,   // both, IPv4 addresses first
+  };
+
+  /// @c addresses is empty if the name can't be resolved.
+  typedef std::function<void(const std::vector<InetAddress>& addresses)> Callback;
+
+  /// nameservers, timeout and attempts of /etc/resolv.conf, and /etc/hosts
+  explicit DnsResolver(EventLoop* loop);
+  /// queries @c nameservers only, eg. a stub server in tests
+  DnsResolver(EventLoop* loop, const std::vector<InetAddress>& nameservers);
+  ~DnsResolver();
+
+  EventLoop* getLoop() const { return loop_; }
+  const std::vector<InetAddress>& nameservers() const { return nameservers_; }
+
+  /// Seconds to wait for each nameserver.
+  void setTimeout(double seconds) { timeout_ = seconds; }
+  /// Rounds over all nameservers.
+  void setAttempts(int attempts) { attempts_ = attempts; }
+  /// Caps TTL of answers, 0 disables the cache.
+  void setMaxTtl(int seconds) { maxTtl_ = seconds; }
+  /// Seconds to remember names that don't exist or failed.
+  void setNegativeTtl(int seconds) { negativeTtl_ = seconds; }
+
+  /// Addresses come with @c port.  @c cb runs in the loop thread,
+  /// before resolve() returns if answered from cache.
+  void resolve(const string& hostname, uint16_t port, const Callback& cb,
+               Family family = kIPv4);
+
+  /// in the loop thread
+  size_t cacheSize() const { return cache_.size(); }
+  int64_t queriesSent() const { return queriesSent_; }
+  int64_t cacheHits() const { return cacheHits_; }
+
+  /// nameservers, and "options timeout:N attempts:N" if any.
+  static std::vector<InetAddress> readResolvConf(const char* path,
+                                                 double* timeout = NULL,
+                                                 int* attempts = NULL);
+
+ private:
+  struct CacheEntry
+  {
+    std::vector<InetAddress> addresses;  // port 0
+    Timestamp expiration;
+  };
+
+  struct Query
+  {
+    string name;
+    uint16_t qtype;
+    std::vector<Callback> callbacks;  // port 0
+    int tries;
+    TimerId timer;
+    InetAddress server;
+  };
+
+  void resolveInLoop(const string& hostname, uint16_t port, const Callback& cb,
+                     Family family);
+  // cb gets addresses with port 0
+  void lookup(const string& name, uint16_t qtype, const Callback& cb);
+  void send(uint16_t id);
+  void onTimeout(uint16_t id);
+  void onMessage(StringPiece datagram, const InetAddress& peer);
+  void finish(uint16_t id, const std::vector<InetAddress>& addresses, int ttl);
+  UdpSocket* socketFor(const InetAddress& server);
+  void loadHosts(const char* path);
+
+  EventLoop* loop_;
+  std::vector<InetAddress> nameservers_;
+  double timeout_;
+  int attempts_;
+  int maxTtl_;
+  int negativeTtl_;
+  size_t maxCacheEntries_;
+  std::unique_ptr<UdpSocket> socket4_;
+  std::unique_ptr<UdpSocket> socket6_;
+  std::mt19937 random_;
+  // by query id
+  std::map<uint16_t, Query> queries_;
+  // by qtype and lower case name
+  std::map<string, uint16_t> inflight_;
+  std::map<string, CacheEntry> cache_;
+  std::map<string, std::vector<InetAddress>> hosts_;
+  int64_t queriesSent_;
+  int64_t cacheHits_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_DNSRESOLVER_H
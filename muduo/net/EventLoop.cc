@@ -8,14 +8,20 @@
 
 #include <muduo/net/EventLoop.h>
 
+#include <muduo/base/Clock.h>
+#include <muduo/base/CpuProfiler.h>
 #include <muduo/base/Logging.h>
+#include <muduo/base/Metrics.h>
 #include <muduo/base/Mutex.h>
+#include <muduo/net/BufferPool.h>
 #include <muduo/net/Channel.h>
+#include <muduo/net/EventLoopStats.h>
 #include <muduo/net/Poller.h>
 #include <muduo/net/SocketsOps.h>
 #include <muduo/net/TimerQueue.h>
 
 #include <algorithm>
+#include <set>
 
 #include <signal.h>
 #include <sys/eventfd.h>
@@ -60,6 +66,77 @@ class IgnoreSigPipe
 #pragma GCC diagnostic error "-Wold-style-cast"
 
 IgnoreSigPipe initObj;
+
+void collectLoopMetrics(string* out);
+
+struct LoopRegistry
+{
+  LoopRegistry()
+  {
+    MetricsRegistry::instance().addCollector("muduo_eventloop", collectLoopMetrics);
+  }
+
+  MutexLock mutex;
+  std::set<EventLoop*> loops GUARDED_BY(mutex);
+};
+
+LoopRegistry& loopRegistry()
+{
+  // never destructed, EventLoop could be a global object
+  static LoopRegistry* registry = new LoopRegistry;
+  return *registry;
+}
+
+void collectLoopMetrics(string* out)
+{
+  enum { kIterations, kBusy, kIdle, kSlow, kCallback, kNumFamilies };
+  static const char* const kNames[kNumFamilies] =
+  {
+    "muduo_eventloop_iterations_total",
+    "muduo_eventloop_busy_seconds_total",
+    "muduo_eventloop_idle_seconds_total",
+    "muduo_eventloop_slow_callbacks_total",
+    "muduo_eventloop_callback_us",
+  };
+  static const char* const kHelps[kNumFamilies] =
+  {
+    "Iterations of EventLoop::loop().",
+    "Time spent on handling events and functors.",
+    "Time spent waiting in poll.",
+    "Callbacks slower than the threshold.",
+    "Latency of channel callbacks in microseconds.",
+  };
+  static const char* const kTypes[kNumFamilies] =
+  {
+    "counter", "counter", "counter", "counter", "summary",
+  };
+  string samples[kNumFamilies];
+  EventLoop::forEachLoop([&samples](EventLoop* loop)
+  {
+    const EventLoopStats& stats = loop->stats();
+    const string labels = MetricsRegistry::label("tid", std::to_string(loop->threadId()));
+    MetricsRegistry::appendSample(&samples[kIterations], kNames[kIterations], labels,
+                                  stats.iterations());
+    MetricsRegistry::appendSample(&samples[kBusy], kNames[kBusy], labels,
+                                  static_cast<double>(stats.busyUs()) / 1e6);
+    MetricsRegistry::appendSample(&samples[kIdle], kNames[kIdle], labels,
+                                  static_cast<double>(stats.idleUs()) / 1e6);
+    MetricsRegistry::appendSample(&samples[kSlow], kNames[kSlow], labels,
+                                  stats.slowCallbacks());
+    MetricsRegistry::appendSummary(&samples[kCallback], kNames[kCallback], labels,
+                                   stats.callbackUs().snapshot());
+  });
+  for (int i = 0; i < kNumFamilies; ++i)
+  {
+    MetricsRegistry::appendHeader(out, kNames[i], kHelps[i], kTypes[i]);
+    *out += samples[i];
+  }
+}
+
+int64_t microSecondsBetween(Timestamp high, Timestamp low)
+{
+  return high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+}
 }  // namespace
 
 // ǰ̲߳IO̵߳Ļ, ͻ᷵NULL
@@ -75,10 +152,15 @@ EventLoop::EventLoop()
     callingPendingFunctors_(false),
     iteration_(0),
     threadId_(CurrentThread::tid()), // 洴߳, ȷone loop per thread
+    pollReturnTime_(Clock::now()),
     poller_(Poller::newDefaultPoller(this)), // һpolloer
     timerQueue_(new TimerQueue(this)), // һʱ
     wakeupFd_(createEventfd()), // һ¼fd
     wakeupChannel_(new Channel(this, wakeupFd_)), // һ¼ͨ
+    stats_(new EventLoopStats),
+    objectPool_(new ObjectPool),
+    bufferPool_(new BufferPool),
+    slowCallbackThresholdUs_(0),
     currentActiveChannel_(NULL)
 {
   LOG_DEBUG << "EventLoop created " << this << " in thread " << threadId_;
@@ -100,7 +182,11 @@ EventLoop::EventLoop()
   wakeupChannel_->setReadCallback(
       std::bind(&EventLoop::handleRead, this));
   // we are always reading the wakeupfd
-  wakeupChannel_->enableRe..ading();
+  wakeupChannel_->enableReading();
+
+  LoopRegistry& registry = loopRegistry();
+  MutexLockGuard lock(registry.mutex);
+  registry.loops.insert(this);
 }
 
 //  
@@ -110,6 +196,11 @@ EventLoop::~EventLoop()
 {
   LOG_DEBUG << "EventLoop " << this << " of thread " << threadId_
             << " destructs in thread " << CurrentThread::tid();
+  {
+  LoopRegistry& registry = loopRegistry();
+  MutexLockGuard lock(registry.mutex);
+  registry.loops.erase(this);
+  }
   wakeupChannel_->disableAll();
   wakeupChannel_->remove();
   ::close(wakeupFd_);
@@ -131,6 +222,10 @@ void EventLoop::loop()
   looping_ = true;
   quit_ = false;  // FIXME: what if someone calls quit() before loop() ?
   LOG_TRACE << "EventLoop " << this << " start looping";
+  // so profiles tell loop threads apart from others
+  CpuProfiler::setThreadTag(("EventLoop:" + string(CurrentThread::name())).c_str());
+  CpuProfiler::registerThread();
+  Timestamp iterationEnd = Clock::now();
 
   // ʼѭ
   while (!quit_)
@@ -149,15 +244,24 @@ void EventLoop::loop()
     // TODO sort channel by priority
     eventHandling_ = true; // , ִֹremove /* atomic */
     // ѯList, Handler
+    Timestamp callbackStart = pollReturnTime_;
     for (Channel* channel : activeChannels_)
     {
       currentActiveChannel_ = channel;
+      const int fd = channel->fd();  // channel may be gone after handleEvent()
       currentActiveChannel_->handleEvent(pollReturnTime_); // 뵱ǰʱ
+      Timestamp callbackEnd = Clock::now();
+      checkSlowCallback(microSecondsBetween(callbackEnd, callbackStart), channel, fd);
+      callbackStart = callbackEnd;
     }
     currentActiveChannel_ = NULL;
     eventHandling_ = false;
     // ¶ǷҪִеĻص
-    doPendingFunctors();
+    Timestamp now = doPendingFunctors(callbackStart);
+    stats_->addIteration(microSecondsBetween(pollReturnTime_, iterationEnd),
+                         microSecondsBetween(now, pollReturnTime_),
+                         activeChannels_.size());
+    iterationEnd = now;
   }
 
   //, ѭ
@@ -230,13 +334,13 @@ TimerId EventLoop::runAt(Timestamp time, TimerCallback cb)
 
 TimerId EventLoop::runAfter(double delay, TimerCallback cb)
 {
-  Timestamp time(addTime(Timestamp::now(), delay));
+  Timestamp time(addTime(Clock::now(), delay));
   return runAt(time, std::move(cb));
 }
 
 TimerId EventLoop::runEvery(double interval, TimerCallback cb)
 {
-  Timestamp time(addTime(Timestamp::now(), interval));
+  Timestamp time(addTime(Clock::now(), interval));
   return timerQueue_->addTimer(std::move(cb), time, interval);
 }
 
@@ -328,7 +432,7 @@ void EventLoop::handleRead()
 // еĻص
 // ִһ
 // һswapʱ, ִ, ⳤʱ
-void EventLoop::doPendingFunctors()
+Timestamp EventLoop::doPendingFunctors(Timestamp start)
 {
   // swapصб
   std::vector<Functor> functors;
@@ -342,11 +446,56 @@ void EventLoop::doPendingFunctors()
   functors.swap(pendingFunctors_);
   }
 
+  if (!functors.empty())
+  {
+    stats_->addFunctorBatch(functors.size());
+  }
   for (const Functor& functor : functors)
   {
     functor();
+    Timestamp end = Clock::now();
+    int64_t latencyUs = microSecondsBetween(end, start);
+    stats_->addFunctor(latencyUs);
+    int64_t threshold = slowCallbackThresholdUs_.load(std::memory_order_relaxed);
+    if (threshold > 0 && latencyUs >= threshold)
+    {
+      stats_->addSlowCallback();
+      LOG_WARN << "EventLoop::doPendingFunctors() slow functor " << latencyUs
+               << "us, " << functors.size() << " functors queued";
+    }
+    start = end;
   }
   callingPendingFunctors_ = false;
+  return start;
+}
+
+void EventLoop::checkSlowCallback(int64_t latencyUs, const Channel* channel, int fd) const
+{
+  stats_->addCallback(latencyUs);
+  int64_t threshold = slowCallbackThresholdUs_.load(std::memory_order_relaxed);
+  if (threshold > 0 && latencyUs >= threshold)
+  {
+    stats_->addSlowCallback();
+    LOG_WARN << "EventLoop::loop() slow callback " << latencyUs
+             << "us, channel " << channel << " fd = " << fd;
+  }
+}
+
+void EventLoop::setSlowCallbackThreshold(double seconds)
+{
+  slowCallbackThresholdUs_.store(
+      static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond),
+      std::memory_order_relaxed);
+}
+
+void EventLoop::forEachLoop(const std::function<void(EventLoop*)>& func)
+{
+  LoopRegistry& registry = loopRegistry();
+  MutexLockGuard lock(registry.mutex);
+  for (EventLoop* loop : registry.loops)
+  {
+    func(loop);
+  }
 }
 
 // »ԾͨӦ¼ڵ
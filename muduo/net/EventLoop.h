@@ -19,6 +19,7 @@
 
 #include <muduo/base/Mutex.h>
 #include <muduo/base/CurrentThread.h>
+#include <muduo/base/ObjectPool.h>
 #include <muduo/base/Timestamp.h>
 #include <muduo/net/Callbacks.h>
 #include <muduo/net/TimerId.h>
@@ -28,7 +29,9 @@ namespace muduo
 namespace net
 {
 
+class BufferPool;
 class Channel;
+class EventLoopStats;
 class Poller;
 class TimerQueue;
 
@@ -64,12 +67,32 @@ class EventLoop : noncopyable
   ///
   Timestamp pollReturnTime() const { return pollReturnTime_; }
 
+  ///
+  /// Clock::now() cached once per iteration, for code that tolerates
+  /// loop-granularity time, eg. idle timeouts.  Stale by the time spent
+  /// in callbacks of this iteration.
+  ///
+  Timestamp cachedNow() const { return pollReturnTime_; }
+
   int64_t iteration() const { return iteration_; }
 
+  /// Busy/idle time and latency histograms of this loop.
+  /// Safe to read from other threads.
+  const EventLoopStats& stats() const { return *stats_; }
+
+  /// Logs event callbacks and functors running longer than @c seconds,
+  /// 0 means never, which is the default.
+  /// Safe to call from other threads.
+  void setSlowCallbackThreshold(double seconds);
+
+  /// Calls @c func with every EventLoop alive, they won't be destructed
+  /// until @c func returns.  Don't create or destroy EventLoop in @c func.
+  static void forEachLoop(const std::function<void(EventLoop*)>& func);
+
   /// Runs callback immediately in the loop thread.
   /// It wakes up the loop, and run the cb.
   /// If in the same loop thread, cb is run within the function.
-  /// Safe to call from other threads.\
+  /// Safe to call from other threads.
   // ԱIO̵̻߳߳
   // cbIO̵߳EventLoopִлص
   void runInLoop(Functor cb);
@@ -123,6 +146,7 @@ class EventLoop : noncopyable
   // ⵱ǰ߳ǷѾEventLoop
   // ڹ캯, ס˱ڵ߳threadId_, ҲIO߳
   bool isInLoopThread() const { return threadId_ == CurrentThread::tid(); }
+  pid_t threadId() const { return threadId_; }
   // bool callingPendingFunctors() const { return callingPendingFunctors_; }
   bool eventHandling() const { return eventHandling_; }
 
@@ -135,6 +159,17 @@ class EventLoop : noncopyable
   boost::any* getMutableContext()
   { return &context_; }
 
+  ///
+  /// Blocks for objects living in this loop, eg. TcpConnection.
+  /// Lock-free in the loop thread, see ObjectPool.
+  ///
+  const std::shared_ptr<ObjectPool>& objectPool() const
+  { return objectPool_; }
+
+  /// Large Buffers for connections in this loop, used in loop thread.
+  BufferPool& bufferPool() { return *bufferPool_; }
+  const BufferPool& bufferPool() const { return *bufferPool_; }
+
   // ǰ̲߳IO̵߳Ļ, ͻ᷵NULL
   static EventLoop* getEventLoopOfCurrentThread();
 
@@ -143,7 +178,9 @@ class EventLoop : noncopyable
   // 8ֽ
   void handleRead();  // waked up
   // еĻص
-  void doPendingFunctors();
+  // returns the time the last functor finishes
+  Timestamp doPendingFunctors(Timestamp start);
+  void checkSlowCallback(int64_t latencyUs, const Channel* channel, int fd) const;
 
   void printActiveChannels() const; // DEBUG
 
@@ -166,6 +203,10 @@ class EventLoop : noncopyable
   // ڴwakeupFd_ϵreadableʱ, ʱַhandleRead()
   std::unique_ptr<Channel> wakeupChannel_;
   boost::any context_;
+  std::unique_ptr<EventLoopStats> stats_;
+  std::shared_ptr<ObjectPool> objectPool_;
+  std::unique_ptr<BufferPool> bufferPool_;
+  std::atomic<int64_t> slowCallbackThresholdUs_;
 
   // scratch variables
   ChannelList activeChannels_;
@@ -0,0 +1,47 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include <muduo/net/EventLoopStats.h>
+
+#include <muduo/base/LogStream.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+EventLoopStats::EventLoopStats()
+  : iterations_(0),
+    idleUs_(0),
+    busyUs_(0),
+    slowCallbacks_(0),
+    activeChannels_(1024 * 1024, 5, 1),
+    callbackUs_(3600LL * 1000 * 1000, 5, 1),
+    functorUs_(3600LL * 1000 * 1000, 5, 1),
+    queueDepth_(1024 * 1024, 5, 1)
+{
+}
+
+void EventLoopStats::addIteration(int64_t idleUs, int64_t busyUs, size_t activeChannels)
+{
+  increment(&iterations_);
+  increment(&idleUs_, idleUs);
+  increment(&busyUs_, busyUs);
+  activeChannels_.record(static_cast<int64_t>(activeChannels));
+}
+
+string EventLoopStats::toString() const
+{
+  const int64_t busy = busyUs();
+  const int64_t total = busy + idleUs();
+  LogStream os;
+  os << "iterations " << iterations()
+     << "\nbusy_us " << busy
+     << "\nidle_us " << idleUs()
+     << "\nutilization " << (total > 0 ? static_cast<double>(busy) / static_cast<double>(total) : 0.0)
+     << "\nslow_callbacks " << slowCallbacks()
+     << "\nactive_channels " << activeChannels_.snapshot().toString()
+     << "\ncallback_us " << callbackUs_.snapshot().toString()
+     << "\nfunctor_us " << functorUs_.snapshot().toString()
+     << "\npending_functors " << queueDepth_.snapshot().toString()
+     << "\n";
+  return os.buffer().toString();
+}
@@ -0,0 +1,68 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_EVENTLOOPSTATS_H
+#define MUDUO_NET_EVENTLOOPSTATS_H
+
+#include <muduo/base/Histogram.h>
+#include <muduo/base/noncopyable.h>
+#include <muduo/base/Types.h>
+
+#include <atomic>
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// Counters and latency histograms of an EventLoop.
+///
+/// Updated by the loop thread only, so counters are plain relaxed stores,
+/// and histograms have a single shard.  Can be read from any thread.
+class EventLoopStats : noncopyable
+{
+ public:
+  EventLoopStats();
+
+  // in loop thread
+  void addIteration(int64_t idleUs, int64_t busyUs, size_t activeChannels);
+  void addCallback(int64_t latencyUs) { callbackUs_.record(latencyUs); }
+  void addFunctor(int64_t latencyUs) { functorUs_.record(latencyUs); }
+  void addFunctorBatch(size_t queueDepth) { queueDepth_.record(static_cast<int64_t>(queueDepth)); }
+  void addSlowCallback() { increment(&slowCallbacks_); }
+
+  int64_t iterations() const { return iterations_.load(std::memory_order_relaxed); }
+  int64_t idleUs() const { return idleUs_.load(std::memory_order_relaxed); }
+  int64_t busyUs() const { return busyUs_.load(std::memory_order_relaxed); }
+  int64_t slowCallbacks() const { return slowCallbacks_.load(std::memory_order_relaxed); }
+  const Histogram& activeChannels() const { return activeChannels_; }
+  const Histogram& callbackUs() const { return callbackUs_; }
+  const Histogram& functorUs() const { return functorUs_; }
+  const Histogram& queueDepth() const { return queueDepth_; }
+
+  string toString() const;
+
+ private:
+  static void increment(std::atomic<int64_t>* counter, int64_t delta = 1)
+  {
+    counter->store(counter->load(std::memory_order_relaxed) + delta,
+                   std::memory_order_relaxed);
+  }
+
+  std::atomic<int64_t> iterations_;
+  std::atomic<int64_t> idleUs_;
+  std::atomic<int64_t> busyUs_;
+  std::atomic<int64_t> slowCallbacks_;
+  Histogram activeChannels_;
+  Histogram callbackUs_;
+  Histogram functorUs_;
+  Histogram queueDepth_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_EVENTLOOPSTATS_H
@@ -65,7 +65,7 @@ class InetAddress : public muduo::copyable
 
   // resolve hostname to IP address, not changing port or sin_family
   // return true on success.
-  // thread safe
+  // thread safe, but blocking, see DnsResolver for event loops.
   static bool resolve(StringArg hostname, InetAddress* result);
   // static std::vector<InetAddress> resolveAll(const char* hostname, uint16_t port = 0);
 
@@ -54,8 +54,24 @@ void removeConnector(const ConnectorPtr& connector)
 TcpClient::TcpClient(EventLoop* loop,
                      const InetAddress& serverAddr,
                      const string& nameArg)
+  : TcpClient(loop, std::make_shared<Connector>(loop, serverAddr), nameArg)
+{
+}
+
+TcpClient::TcpClient(EventLoop* loop,
+                     DnsResolver* resolver,
+                     const string& host,
+                     uint16_t port,
+                     const string& nameArg)
+  : TcpClient(loop, std::make_shared<Connector>(loop, resolver, host, port), nameArg)
+{
+}
+
+TcpClient::TcpClient(EventLoop* loop,
+                     const ConnectorPtr& connector,
+                     const string& nameArg)
   : loop_(CHECK_NOTNULL(loop)),
-    connector_(new Connector(loop, serverAddr)),
+    connector_(connector),
     name_(nameArg),
     connectionCallback_(defaultConnectionCallback),
     messageCallback_(defaultMessageCallback),
@@ -105,7 +121,8 @@ void TcpClient::connect()
 {
   // FIXME: check state
   LOG_INFO << "TcpClient::connect[" << name_ << "] - connecting to "
-           << connector_->serverAddress().toIpPort();
+           << (connector_->serverHost().empty()
+               ? connector_->serverAddress().toIpPort() : connector_->serverHost());
   connect_ = true;
   connector_->start();
 }
@@ -140,12 +157,9 @@ void TcpClient::newConnection(int sockfd)
 
   InetAddress localAddr(sockets::getLocalAddr(sockfd));
   // FIXME poll with zero timeout to double confirm the new connection
-  // FIXME use make_shared if necessary
-  TcpConnectionPtr conn(new TcpConnection(loop_,
-                                          connName,
-                                          sockfd,
-                                          localAddr,
-                                          peerAddr));
+  TcpConnectionPtr conn(std::allocate_shared<TcpConnection>(
+      PoolAllocator<TcpConnection>(loop_->objectPool()),
+      loop_, connName, sockfd, localAddr, peerAddr, loop_->objectPool()));
 
   conn->setConnectionCallback(connectionCallback_);
   conn->setMessageCallback(messageCallback_);
@@ -21,6 +21,7 @@ namespace net
 
 class Connector;
 typedef std::shared_ptr<Connector> ConnectorPtr;
+class DnsResolver;
 
 class TcpClient : noncopyable
 {
@@ -30,6 +31,13 @@ class TcpClient : noncopyable
   TcpClient(EventLoop* loop,
             const InetAddress& serverAddr,
             const string& nameArg);
+  /// Resolves @c host before each connect, without blocking the loop.
+  /// @c resolver must outlive this, in the same loop.
+  TcpClient(EventLoop* loop,
+            DnsResolver* resolver,
+            const string& host,
+            uint16_t port,
+            const string& nameArg);
   ~TcpClient();  // force out-line dtor, for std::unique_ptr members.
 
   void connect();
@@ -66,6 +74,7 @@ class TcpClient : noncopyable
 
  private:
   /// Not thread safe, but in loop
+  TcpClient(EventLoop* loop, const ConnectorPtr& connector, const string& nameArg);
   void newConnection(int sockfd);
   /// Not thread safe, but in loop
   void removeConnection(const TcpConnectionPtr& conn);
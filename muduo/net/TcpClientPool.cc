@@ -0,0 +1,287 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include <muduo/net/TcpClientPool.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/TcpClient.h>
+
+#include <algorithm>
+
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+struct TcpClientPool::Member
+{
+  std::unique_ptr<TcpClient> client;
+  TcpConnectionPtr conn;  // NULL if not connected
+  bool busy;
+  Timestamp idleSince;
+};
+
+TcpClientPool::TcpClientPool(EventLoop* loop, const InetAddress& serverAddr,
+                             const string& name)
+  : loop_(CHECK_NOTNULL(loop)),
+    name_(name),
+    newClient_([loop, serverAddr](const string& clientName)
+               { return new TcpClient(loop, serverAddr, clientName); }),
+    minConnections_(1),
+    maxConnections_(16),
+    idleTimeout_(60),
+    healthCheckInterval_(0),
+    started_(false),
+    nextId_(1),
+    nextWaiterId_(1)
+{
+}
+
+TcpClientPool::TcpClientPool(EventLoop* loop, DnsResolver* resolver,
+                             const string& host, uint16_t port, const string& name)
+  : loop_(CHECK_NOTNULL(loop)),
+    name_(name),
+    newClient_([loop, resolver, host, port](const string& clientName)
+               { return new TcpClient(loop, resolver, host, port, clientName); }),
+    minConnections_(1),
+    maxConnections_(16),
+    idleTimeout_(60),
+    healthCheckInterval_(0),
+    started_(false),
+    nextId_(1),
+    nextWaiterId_(1)
+{
+}
+
+TcpClientPool::~TcpClientPool()
+{
+  loop_->assertInLoopThread();
+  loop_->cancel(trimTimer_);
+  loop_->cancel(healthTimer_);
+  for (const Waiter& waiter : waiters_)
+  {
+    loop_->cancel(waiter.timer);
+  }
+  while (!members_.empty())
+  {
+    removeMember(members_.size() - 1);
+  }
+}
+
+void TcpClientPool::start()
+{
+  loop_->assertInLoopThread();
+  assert(!started_);
+  assert(0 <= minConnections_ && minConnections_ <= maxConnections_);
+  started_ = true;
+  for (int i = 0; i < minConnections_; ++i)
+  {
+    addMember();
+  }
+  if (idleTimeout_ > 0)
+  {
+    trimTimer_ = loop_->runEvery(idleTimeout_ / 2, std::bind(&TcpClientPool::trimIdle, this));
+  }
+  if (healthCheck_ && healthCheckInterval_ > 0)
+  {
+    healthTimer_ = loop_->runEvery(healthCheckInterval_,
+                                   std::bind(&TcpClientPool::checkHealth, this));
+  }
+}
+
+void TcpClientPool::addMember()
+{
+  char buf[32];
+  snprintf(buf, sizeof buf, "#%d", nextId_);
+  ++nextId_;
+  std::shared_ptr<Member> member(new Member);
+  member->client.reset(newClient_(name_ + buf));
+  member->busy = false;
+  std::weak_ptr<Member> weakMember(member);
+  member->client->setConnectionCallback(
+      [this, weakMember](const TcpConnectionPtr& conn) { onConnection(weakMember, conn); });
+  member->client->setMessageCallback(
+      messageCallback_ ? messageCallback_ : MessageCallback(defaultMessageCallback));
+  member->client->enableRetry();
+  members_.push_back(member);
+  member->client->connect();
+}
+
+void TcpClientPool::removeMember(size_t index)
+{
+  std::shared_ptr<Member> member(members_[index]);
+  members_.erase(members_.begin() + index);
+  TcpConnectionPtr conn;
+  conn.swap(member->conn);
+  // TcpClient closes the connection only if it holds the last reference.
+  member->client.reset();
+  if (conn)
+  {
+    // the pool may be gone when it's closed
+    conn->setConnectionCallback(
+        connectionCallback_ ? connectionCallback_ : ConnectionCallback(defaultConnectionCallback));
+    conn->forceClose();
+  }
+}
+
+void TcpClientPool::onConnection(const std::weak_ptr<Member>& weakMember,
+                                 const TcpConnectionPtr& conn)
+{
+  if (connectionCallback_)
+  {
+    connectionCallback_(conn);
+  }
+  std::shared_ptr<Member> member(weakMember.lock());
+  if (!member)
+  {
+    return;
+  }
+  if (conn->connected())
+  {
+    member->conn = conn;
+    member->busy = false;
+    member->idleSince = loop_->cachedNow();
+    serveWaiters();
+  }
+  else
+  {
+    // TcpClient reconnects
+    member->conn.reset();
+    member->busy = false;
+  }
+}
+
+void TcpClientPool::acquire(const AcquireCallback& cb, double timeout)
+{
+  loop_->assertInLoopThread();
+  int connecting = 0;
+  for (const auto& member : members_)
+  {
+    if (member->conn && !member->busy && member->conn->connected())
+    {
+      member->busy = true;
+      cb(member->conn);
+      return;
+    }
+    if (!member->conn)
+    {
+      ++connecting;
+    }
+  }
+  // one more connection for each waiter, up to the max
+  if (connecting <= static_cast<int>(waiters_.size())
+      && connections() < maxConnections_)
+  {
+    addMember();
+  }
+  Waiter waiter;
+  waiter.id = nextWaiterId_++;
+  waiter.cb = cb;
+  waiter.timer = loop_->runAfter(timeout,
+                                 std::bind(&TcpClientPool::onWaiterTimeout, this, waiter.id));
+  waiters_.push_back(waiter);
+}
+
+void TcpClientPool::release(const TcpConnectionPtr& conn)
+{
+  loop_->assertInLoopThread();
+  for (const auto& member : members_)
+  {
+    if (member->conn == conn)
+    {
+      member->busy = false;
+      member->idleSince = loop_->cachedNow();
+      serveWaiters();
+      return;
+    }
+  }
+  // disconnected since acquired
+}
+
+void TcpClientPool::serveWaiters()
+{
+  // runs callbacks after the loop, they may call acquire(), which may
+  // add to members_
+  std::vector<std::pair<AcquireCallback, TcpConnectionPtr>> served;
+  for (const auto& member : members_)
+  {
+    if (waiters_.empty())
+    {
+      break;
+    }
+    if (member->conn && !member->busy && member->conn->connected())
+    {
+      Waiter waiter(waiters_.front());
+      waiters_.pop_front();
+      loop_->cancel(waiter.timer);
+      member->busy = true;
+      served.push_back(std::make_pair(waiter.cb, member->conn));
+    }
+  }
+  for (const auto& it : served)
+  {
+    it.first(it.second);
+  }
+}
+
+void TcpClientPool::onWaiterTimeout(int64_t id)
+{
+  auto it = std::find_if(waiters_.begin(), waiters_.end(),
+                         [id](const Waiter& waiter) { return waiter.id == id; });
+  if (it != waiters_.end())
+  {
+    AcquireCallback cb(it->cb);
+    waiters_.erase(it);
+    LOG_WARN << "TcpClientPool[" << name_ << "] - no connection in time, "
+             << connectedConnections() << " connected";
+    cb(TcpConnectionPtr());
+  }
+}
+
+void TcpClientPool::trimIdle()
+{
+  const Timestamp now = loop_->cachedNow();
+  // the newest ones first, also those reconnecting
+  for (size_t i = members_.size(); i > 0 && connections() > minConnections_; --i)
+  {
+    const Member& member = *members_[i-1];
+    if (!member.busy
+        && (!member.conn || timeDifference(now, member.idleSince) >= idleTimeout_))
+    {
+      LOG_DEBUG << "TcpClientPool[" << name_ << "] - closing "
+                << member.client->name();
+      removeMember(i-1);
+    }
+  }
+}
+
+void TcpClientPool::checkHealth()
+{
+  // by index, healthCheck_ may call acquire()
+  for (size_t i = 0; i < members_.size(); ++i)
+  {
+    std::shared_ptr<Member> member(members_[i]);
+    if (member->conn && !member->busy && member->conn->connected()
+        && !healthCheck_(member->conn))
+    {
+      LOG_WARN << "TcpClientPool[" << name_ << "] - " << member->conn->name()
+               << " is unhealthy, reconnecting";
+      member->conn->forceClose();
+    }
+  }
+}
+
+int TcpClientPool::connectedConnections() const
+{
+  return static_cast<int>(std::count_if(members_.begin(), members_.end(),
+      [](const std::shared_ptr<Member>& member)
+      { return member->conn && member->conn->connected(); }));
+}
+
+int TcpClientPool::idleConnections() const
+{
+  return static_cast<int>(std::count_if(members_.begin(), members_.end(),
+      [](const std::shared_ptr<Member>& member)
+      { return member->conn && !member->busy && member->conn->connected(); }));
+}
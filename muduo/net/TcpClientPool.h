@@ -0,0 +1,121 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_TCPCLIENTPOOL_H
+#define MUDUO_NET_TCPCLIENTPOOL_H
+
+#include <muduo/base/noncopyable.h>
+#include <muduo/net/Callbacks.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/TimerId.h>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace muduo
+{
+namespace net
+{
+
+class DnsResolver;
+class EventLoop;
+class TcpClient;
+
+///
+/// Pool of warm connections to one endpoint.
+///
+/// Keeps at least setMinConnections() connections open, each reconnecting
+/// by itself with the jittered backoff of Connector, so they come back
+/// together after a server restart.  acquire() leases an idle connection,
+/// opening more up to setMaxConnections(), release() gives it back.
+/// Connections idle for setIdleTimeout() are closed down to the minimum,
+/// idle ones failing the health check are reconnected.
+///
+/// Not thread safe, all calls must be in the loop thread.
+class TcpClientPool : noncopyable
+{
+ public:
+  /// @c conn is NULL if no connection is available before the timeout.
+  typedef std::function<void (const TcpConnectionPtr& conn)> AcquireCallback;
+  /// Returns false if an idle connection is broken, eg. no reply to the
+  /// last ping sent by the user.
+  typedef std::function<bool (const TcpConnectionPtr& conn)> HealthCheck;
+
+  TcpClientPool(EventLoop* loop, const InetAddress& serverAddr, const string& name);
+  /// resolves @c host by @c resolver, racing connects to its addresses.
+  TcpClientPool(EventLoop* loop, DnsResolver* resolver,
+                const string& host, uint16_t port, const string& name);
+  ~TcpClientPool();
+
+  // All of the setters must be called before start().
+  void setMinConnections(int n) { minConnections_ = n; }
+  void setMaxConnections(int n) { maxConnections_ = n; }
+  /// 0 means never
+  void setIdleTimeout(double seconds) { idleTimeout_ = seconds; }
+  void setHealthCheck(double interval, const HealthCheck& check)
+  { healthCheckInterval_ = interval; healthCheck_ = check; }
+  /// for all connections, up and down
+  void setConnectionCallback(const ConnectionCallback& cb)
+  { connectionCallback_ = cb; }
+  void setMessageCallback(const MessageCallback& cb)
+  { messageCallback_ = cb; }
+
+  /// Opens min connections.
+  void start();
+
+  /// @c cb runs before acquire() returns if a connection is idle.
+  void acquire(const AcquireCallback& cb, double timeout = 1.0);
+  /// Returns a leased connection, it may have been disconnected.
+  void release(const TcpConnectionPtr& conn);
+
+  const string& name() const { return name_; }
+  int connections() const { return static_cast<int>(members_.size()); }
+  int connectedConnections() const;
+  int idleConnections() const;
+  size_t waiters() const { return waiters_.size(); }
+
+ private:
+  struct Member;
+  struct Waiter
+  {
+    int64_t id;
+    AcquireCallback cb;
+    TimerId timer;
+  };
+
+  void addMember();
+  void onConnection(const std::weak_ptr<Member>& weakMember, const TcpConnectionPtr& conn);
+  void serveWaiters();
+  void onWaiterTimeout(int64_t id);
+  void trimIdle();
+  void checkHealth();
+  void removeMember(size_t index);
+
+  EventLoop* loop_;
+  const string name_;
+  std::function<TcpClient* (const string& name)> newClient_;
+  int minConnections_;
+  int maxConnections_;
+  double idleTimeout_;
+  double healthCheckInterval_;
+  HealthCheck healthCheck_;
+  ConnectionCallback connectionCallback_;
+  MessageCallback messageCallback_;
+  bool started_;
+  int nextId_;
+  int64_t nextWaiterId_;
+  // callbacks of connections hold weak pointers
+  std::vector<std::shared_ptr<Member>> members_;
+  std::deque<Waiter> waiters_;
+  TimerId trimTimer_;
+  TimerId healthTimer_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_TCPCLIENTPOOL_H
@@ -9,17 +9,29 @@
 #include <muduo/net/TcpConnection.h>
 
 #include <muduo/base/Logging.h>
+#include <muduo/base/Metrics.h>
 #include <muduo/base/WeakCallback.h>
+#include <muduo/net/BufferPool.h>
 #include <muduo/net/Channel.h>
 #include <muduo/net/EventLoop.h>
 #include <muduo/net/Socket.h>
 #include <muduo/net/SocketsOps.h>
 
 #include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
 
 using namespace muduo;
 using namespace muduo::net;
 
+namespace
+{
+
+const double kDefaultBufferIdleTimeout = 10.0;
+const size_t kSmallBufferCapacity = Buffer::kCheapPrepend + Buffer::kInitialSize;
+
+}  // namespace
+
 // Ĭӻص״̬
 void muduo::net::defaultConnectionCallback(const TcpConnectionPtr& conn)
 {
@@ -48,34 +60,71 @@ TcpConnection::TcpConnection(EventLoop* loop,
                              const string& nameArg,
                              int sockfd,
                              const InetAddress& localAddr,
-                             const InetAddress& peerAddr)
+                             const InetAddress& peerAddr,
+                             const std::shared_ptr<ObjectPool>& pool)
+  : TcpConnection(loop, nameArg, std::shared_ptr<const string>(), 0,
+                  sockfd, localAddr, peerAddr, pool)
+{
+}
+
+TcpConnection::TcpConnection(EventLoop* loop,
+                             const std::shared_ptr<const string>& namePrefix,
+                             uint64_t id,
+                             int sockfd,
+                             const InetAddress& localAddr,
+                             const InetAddress& peerAddr,
+                             const std::shared_ptr<ObjectPool>& pool)
+  : TcpConnection(loop, string(), namePrefix, id,
+                  sockfd, localAddr, peerAddr, pool)
+{
+}
+
+TcpConnection::TcpConnection(EventLoop* loop,
+                             const string& nameArg,
+                             const std::shared_ptr<const string>& namePrefix,
+                             uint64_t id,
+                             int sockfd,
+                             const InetAddress& localAddr,
+                             const InetAddress& peerAddr,
+                             const std::shared_ptr<ObjectPool>& pool)
   : loop_(CHECK_NOTNULL(loop)),
+    id_(id),
+    namePrefix_(namePrefix),
     // TcpConnectionơ
     name_(nameArg),
+    slot_(0),
     // ״̬ʼС
     state_(kConnecting),
     reading_(true),
+    migrating_(false),
+    pool_(pool),
+    channelPool_(pool),
     // װsockfdΪSocket
     // TcpConnectionûнӵĹ, ڹ캯лᴫѾõsocket fd, TcpServer
-    socket_(new Socket(sockfd)),
+    socket_(makeUniqueFromPool<Socket>(pool_.get(), sockfd)),
     // loopsockfdһͨ
-    channel_(new Channel(loop, sockfd)),
+    channel_(makeUniqueFromPool<Channel>(channelPool_.get(), loop, sockfd)),
     // صַ+ ͻ˵ַ
     localAddr_(localAddr),
     peerAddr_(peerAddr),
     // Ĭϸˮλֵ
-    highWaterMark_(64*1024*1024)
+    highWaterMark_(64*1024*1024),
+    queuedSends_(0),
+    sentQueued_(0),
+    receivedBytes_(NULL),
+    sentBytes_(NULL),
+    bufferIdleTimeout_(kDefaultBufferIdleTimeout),
+    bufferTimerArmed_(false),
+    readBurst_(false),
+    sharedInput_(false),
+    deferredFlush_(false),
+    deferredFlushQueued_(false),
+    bufferBytes_(0)
 {
+  accountBuffers();
   // öصᴫһ
-  channel_->setReadCallback(
-      std::bind(&TcpConnection::handleRead, this, _1));
-  channel_->setWriteCallback(
-      std::bind(&TcpConnection::handleWrite, this));
-  channel_->setCloseCallback(
-      std::bind(&TcpConnection::handleClose, this));
-  channel_->setErrorCallback(
-      std::bind(&TcpConnection::handleError, this));
-  LOG_DEBUG << "TcpConnection::ctor[" <<  name_ << "] at " << this
+  setupChannel();
+  LOG_DEBUG << "TcpConnection::ctor[" <<  name() << "] at " << this
             << " fd=" << sockfd;
   // Эջ
   socket_->setKeepAlive(true);
@@ -85,10 +134,123 @@ TcpConnection::TcpConnection(EventLoop* loop,
 // ӦöⲿйFIXME ȷϡ
 TcpConnection::~TcpConnection()
 {
-  LOG_DEBUG << "TcpConnection::dtor[" <<  name_ << "] at " << this
+  LOG_DEBUG << "TcpConnection::dtor[" <<  name() << "] at " << this
             << " fd=" << channel_->fd()
             << " state=" << stateToString();
   assert(state_ == kDisconnected);
+  BufferPool::connectionBytesGauge()->add(-static_cast<int64_t>(bufferBytes_));
+}
+
+void TcpConnection::makeName() const
+{
+  if (namePrefix_)
+  {
+    char buf[32];
+    snprintf(buf, sizeof buf, "#%" PRIu64, id_);
+    name_ = *namePrefix_ + buf;
+  }
+}
+
+void TcpConnection::accountBuffers()
+{
+  const size_t bytes = inputBuffer_.internalCapacity() + outputBuffer_.internalCapacity();
+  if (bytes != bufferBytes_)
+  {
+    BufferPool::connectionBytesGauge()->add(static_cast<int64_t>(bytes) - static_cast<int64_t>(bufferBytes_));
+    bufferBytes_ = bytes;
+  }
+}
+
+void TcpConnection::updateBuffers()
+{
+  accountBuffers();
+  if (!bufferTimerArmed_ && bufferIdleTimeout_ > 0
+      && bufferBytes_ > 2 * kSmallBufferCapacity && state_ != kDisconnected)
+  {
+    bufferTimer_ = getLoop()->runAfter(bufferIdleTimeout_,
+        makeWeakCallback(shared_from_this(), &TcpConnection::checkIdleBuffers));
+    bufferTimerArmed_ = true;
+  }
+}
+
+void TcpConnection::checkIdleBuffers()
+{
+  getLoop()->assertInLoopThread();
+  bufferTimerArmed_ = false;
+  if (state_ == kDisconnected || bufferIdleTimeout_ <= 0)
+  {
+    return;
+  }
+  const double idle = timeDifference(getLoop()->cachedNow(), lastActive_);
+  if (idle < bufferIdleTimeout_)
+  {
+    bufferTimer_ = getLoop()->runAfter(bufferIdleTimeout_ - idle,
+        makeWeakCallback(shared_from_this(), &TcpConnection::checkIdleBuffers));
+    bufferTimerArmed_ = true;
+    return;
+  }
+
+  BufferPool& pool = getLoop()->bufferPool();
+  const size_t readable = inputBuffer_.readableBytes();
+  if (readable == 0)
+  {
+    if (inputBuffer_.internalCapacity() > kSmallBufferCapacity)
+    {
+      pool.put(&inputBuffer_);
+    }
+    if (sharedInput_)
+    {
+      releaseInputBuffer();
+    }
+  }
+  else if (inputBuffer_.internalCapacity() > 2 * (readable + kSmallBufferCapacity))
+  {
+    // a partial message waits for the rest
+    inputBuffer_.shrink(0);
+  }
+  // unsent data waits for the peer
+  if (outputBuffer_.readableBytes() == 0
+      && outputBuffer_.internalCapacity() > kSmallBufferCapacity)
+  {
+    pool.put(&outputBuffer_);
+  }
+  readBurst_ = false;
+  accountBuffers();
+}
+
+void TcpConnection::setSharedInputBuffer(bool on)
+{
+  getLoop()->assertInLoopThread();
+  sharedInput_ = on;
+  if (sharedInput_ && inputBuffer_.readableBytes() == 0)
+  {
+    releaseInputBuffer();
+    accountBuffers();
+  }
+}
+
+void TcpConnection::releaseInputBuffer()
+{
+  if (inputBuffer_.internalCapacity() > kSmallBufferCapacity)
+  {
+    // eg. lent by the pool for a burst
+    getLoop()->bufferPool().put(&inputBuffer_);
+  }
+  // keeps only the prependable bytes
+  Buffer empty(0);
+  inputBuffer_.swap(empty);
+}
+
+void TcpConnection::setupChannel()
+{
+  channel_->setReadCallback(
+      std::bind(&TcpConnection::handleRead, this, _1));
+  channel_->setWriteCallback(
+      std::bind(&TcpConnection::handleWrite, this));
+  channel_->setCloseCallback(
+      std::bind(&TcpConnection::handleClose, this));
+  channel_->setErrorCallback(
+      std::bind(&TcpConnection::handleError, this));
 }
 
 bool TcpConnection::getTcpInfo(struct tcp_info* tcpi) const
@@ -116,7 +278,7 @@ void TcpConnection::send(const StringPiece& message)
   if (state_ == kConnected)
   {
     // ǵǰֱ߳̾ӷ
-    if (loop_->isInLoopThread())
+    if (getLoop()->isInLoopThread())
     {
       sendInLoop(message);
     }
@@ -124,13 +286,7 @@ void TcpConnection::send(const StringPiece& message)
     // 漰ݿ
     else
     {
-      // sendInloopӹɺָ, ŵrunInLoop
-      void (TcpConnection::*fp)(const StringPiece& message) = &TcpConnection::sendInLoop;
-      loop_->runInLoop(
-          std::bind(fp,
-                    this,     // FIXME
-                    message.as_string()));
-                    //std::forward<string>(message)));
+      queueSend(message.data(), message.size());
     }
   }
 }
@@ -141,23 +297,62 @@ void TcpConnection::send(Buffer* buf)
 {
   if (state_ == kConnected)
   {
-    if (loop_->isInLoopThread())
+    if (getLoop()->isInLoopThread())
     {
       sendInLoop(buf->peek(), buf->readableBytes());
       buf->retrieveAll();
     }
     else
     {
-      void (TcpConnection::*fp)(const StringPiece& message) = &TcpConnection::sendInLoop;
-      loop_->runInLoop(
-          std::bind(fp,
-                    this,     // FIXME
-                    buf->retrieveAllAsString()));
-                    //std::forward<string>(message)));
+      queueSend(buf->peek(), buf->readableBytes());
+      buf->retrieveAll();
     }
   }
 }
 
+void TcpConnection::queueSend(const void* data, size_t len)
+{
+  const uint64_t seq = queuedSends_.fetch_add(1);
+  getLoop()->queueInLoop(std::bind(&TcpConnection::sendQueuedInLoop, shared_from_this(),
+                                   seq, string(static_cast<const char*>(data), len)));
+}
+
+void TcpConnection::sendQueuedInLoop(uint64_t seq, const string& message)
+{
+  EventLoop* loop = getLoop();
+  if (!loop->isInLoopThread())
+  {
+    // migrated after being queued, follow the connection
+    loop->queueInLoop(std::bind(&TcpConnection::sendQueuedInLoop, shared_from_this(),
+                                seq, message));
+    return;
+  }
+  if (seq != sentQueued_)
+  {
+    // overtaken by a later send queued straight to the new loop
+    earlySends_[seq] = message;
+    return;
+  }
+  sendInLoop(message);
+  ++sentQueued_;
+  while (!earlySends_.empty() && earlySends_.begin()->first == sentQueued_)
+  {
+    sendInLoop(earlySends_.begin()->second);
+    earlySends_.erase(earlySends_.begin());
+    ++sentQueued_;
+  }
+  if (deferredFlush_ && !channel_->isWriting() && outputBuffer_.readableBytes() > 0)
+  {
+    // already coalesced, don't wait for another iteration
+    flushDeferred();
+  }
+  else if (state_ == kDisconnecting)
+  {
+    // shutdownInLoop() might have waited for us
+    shutdownInLoop();
+  }
+}
+
 void TcpConnection::sendInLoop(const StringPiece& message)
 {
   sendInLoop(message.data(), message.size());
@@ -168,7 +363,7 @@ void TcpConnection::sendInLoop(const StringPiece& message)
 // ߴouterBuffer, ȴص(handleWrite)
 void TcpConnection::sendInLoop(const void* data, size_t len)
 {
-  loop_->assertInLoopThread();
+  getLoop()->assertInLoopThread();
   // Ѿ͵
   ssize_t nwrote = 0;
   // ʣҪ͵
@@ -180,7 +375,7 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
     return;
   }
   // if no thing in output queue, try writing directly
-  if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+  if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0 && !deferredFlush_)
   {
     // ͨûдݣͬʱǿյ
     // ֱchannelfdдݣ
@@ -189,13 +384,17 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
     //  >= 0
     if (nwrote >= 0)
     {
+      if (sentBytes_)
+      {
+        sentBytes_->increment(nwrote);
+      }
       // ʣµ
       remaining = len - nwrote;
       if (remaining == 0 && writeCompleteCallback_)
       {
         // һԶˣͬʱҲдɻص
         // дɻص
-        loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+        getLoop()->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
       }
     }
     else // nwrote < 0
@@ -230,11 +429,20 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
       // µĴ֮ݴСѳõľ
       // صõĸˮƽֵصеĳ
       // ˮƽˮλߵʹó?
-      loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
+      getLoop()->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
     }
     // outputBufferݡ漰ݵĿ
     outputBuffer_.append(static_cast<const char*>(data)+nwrote, remaining);
-    if (!channel_->isWriting())
+    if (deferredFlush_ && !channel_->isWriting())
+    {
+      if (!deferredFlushQueued_)
+      {
+        // functors queued while handling events run in this iteration
+        deferredFlushQueued_ = true;
+        getLoop()->queueInLoop(std::bind(&TcpConnection::flushDeferred, shared_from_this()));
+      }
+    }
+    else if (!channel_->isWriting())
     {
       // ͨóɿд״̬
       // channelһд¼
@@ -246,6 +454,58 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
       // ʵʱҪߵݣִһʱ
       channel_->enableWriting();
     }
+    updateBuffers();
+  }
+}
+
+void TcpConnection::flushDeferred()
+{
+  if (!getLoop()->isInLoopThread())
+  {
+    // migrated after being queued, follow the connection
+    getLoop()->queueInLoop(std::bind(&TcpConnection::flushDeferred, shared_from_this()));
+    return;
+  }
+  deferredFlushQueued_ = false;
+  if (state_ == kDisconnected || channel_->isWriting() || outputBuffer_.readableBytes() == 0)
+  {
+    // handleWrite() takes care of the rest if writing
+    return;
+  }
+  ssize_t nwrote = sockets::write(channel_->fd(), outputBuffer_.peek(), outputBuffer_.readableBytes());
+  if (nwrote >= 0)
+  {
+    if (sentBytes_)
+    {
+      sentBytes_->increment(nwrote);
+    }
+    outputBuffer_.retrieve(nwrote);
+    lastActive_ = getLoop()->cachedNow();
+  }
+  else if (errno != EWOULDBLOCK)
+  {
+    LOG_SYSERR << "TcpConnection::flushDeferred";
+    if (errno == EPIPE || errno == ECONNRESET)
+    {
+      return;
+    }
+  }
+
+  if (outputBuffer_.readableBytes() > 0)
+  {
+    channel_->enableWriting();
+  }
+  else
+  {
+    if (writeCompleteCallback_)
+    {
+      getLoop()->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+    }
+    if (state_ == kDisconnecting)
+    {
+      // shutdown() waited for us
+      shutdownInLoop();
+    }
   }
 }
 
@@ -261,7 +521,7 @@ void TcpConnection::shutdown()
     setState(kDisconnecting);
     // FIXME: shared_from_this()?
 	// TcpConnection::shutdownInLoop()
-    loop_->runInLoop(std::bind(&TcpConnection::shutdownInLoop, this));
+    getLoop()->runInLoop(std::bind(&TcpConnection::shutdownInLoop, this));
   }
 }
 
@@ -273,8 +533,15 @@ void TcpConnection::shutdown()
 //   ״̬ǶϿshutdownWrite
 void TcpConnection::shutdownInLoop()
 {
-  loop_->assertInLoopThread();
-  if (!channel_->isWriting()) // Ѿд
+  if (!getLoop()->isInLoopThread())
+  {
+    // migrated after being queued, follow the connection
+    getLoop()->queueInLoop(std::bind(&TcpConnection::shutdownInLoop, shared_from_this()));
+    return;
+  }
+  // sends queued before shutdown() go first
+  const bool pending = queuedSends_.load() != sentQueued_;
+  if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0 && !pending) // Ѿд
   {
     // we are not writing
     socket_->shutdownWrite(); // ر"д"
@@ -287,19 +554,19 @@ void TcpConnection::shutdownInLoop()
 //   if (state_ == kConnected)
 //   {
 //     setState(kDisconnecting);
-//     loop_->runInLoop(std::bind(&TcpConnection::shutdownAndForceCloseInLoop, this, seconds));
+//     getLoop()->runInLoop(std::bind(&TcpConnection::shutdownAndForceCloseInLoop, this, seconds));
 //   }
 // }
 
 // void TcpConnection::shutdownAndForceCloseInLoop(double seconds)
 // {
-//   loop_->assertInLoopThread();
+//   getLoop()->assertInLoopThread();
 //   if (!channel_->isWriting())
 //   {
 //     // we are not writing
 //     socket_->shutdownWrite();
 //   }
-//   loop_->runAfter(
+//   getLoop()->runAfter(
 //       seconds,
 //       makeWeakCallback(shared_from_this(),
 //                        &TcpConnection::forceCloseInLoop));
@@ -312,7 +579,7 @@ void TcpConnection::forceClose()
   if (state_ == kConnected || state_ == kDisconnecting)
   {
     setState(kDisconnecting);
-    loop_->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+    getLoop()->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
   }
 }
 
@@ -321,7 +588,7 @@ void TcpConnection::forceCloseWithDelay(double seconds)
   if (state_ == kConnected || state_ == kDisconnecting)
   {
     setState(kDisconnecting);
-    loop_->runAfter(
+    getLoop()->runAfter(
         seconds,
         makeWeakCallback(shared_from_this(),
                          &TcpConnection::forceClose));  // not forceCloseInLoop to avoid race condition
@@ -330,7 +597,12 @@ void TcpConnection::forceCloseWithDelay(double seconds)
 
 void TcpConnection::forceCloseInLoop()
 {
-  loop_->assertInLoopThread();
+  if (!getLoop()->isInLoopThread())
+  {
+    // migrated after being queued, follow the connection
+    getLoop()->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+    return;
+  }
   if (state_ == kConnected || state_ == kDisconnecting)
   {
     // as if we received 0 byte in handleRead();
@@ -365,12 +637,17 @@ void TcpConnection::setTcpNoDelay(bool on)
 
 void TcpConnection::startRead()
 {
-  loop_->runInLoop(std::bind(&TcpConnection::startReadInLoop, this));
+  getLoop()->runInLoop(std::bind(&TcpConnection::startReadInLoop, this));
 }
 
 void TcpConnection::startReadInLoop()
 {
-  loop_->assertInLoopThread();
+  if (!getLoop()->isInLoopThread())
+  {
+    // migrated after being queued, follow the connection
+    getLoop()->queueInLoop(std::bind(&TcpConnection::startReadInLoop, shared_from_this()));
+    return;
+  }
   if (!reading_ || !channel_->isReading())
   {
     channel_->enableReading();
@@ -380,12 +657,17 @@ void TcpConnection::startReadInLoop()
 
 void TcpConnection::stopRead()
 {
-  loop_->runInLoop(std::bind(&TcpConnection::stopReadInLoop, this));
+  getLoop()->runInLoop(std::bind(&TcpConnection::stopReadInLoop, this));
 }
 
 void TcpConnection::stopReadInLoop()
 {
-  loop_->assertInLoopThread();
+  if (!getLoop()->isInLoopThread())
+  {
+    // migrated after being queued, follow the connection
+    getLoop()->queueInLoop(std::bind(&TcpConnection::stopReadInLoop, shared_from_this()));
+    return;
+  }
   if (reading_ || channel_->isReading())
   {
     channel_->disableReading();
@@ -393,6 +675,79 @@ void TcpConnection::stopReadInLoop()
   }
 }
 
+void TcpConnection::migrateTo(EventLoop* loop, const ConnectionCallback& cb)
+{
+  assert(loop != NULL);
+  // queue, not run, as the channel can't be removed within its own handleEvent()
+  getLoop()->queueInLoop(std::bind(&TcpConnection::migrateInLoop, shared_from_this(), loop, cb));
+}
+
+void TcpConnection::migrateInLoop(EventLoop* loop, const ConnectionCallback& cb)
+{
+  if (!getLoop()->isInLoopThread())
+  {
+    getLoop()->queueInLoop(std::bind(&TcpConnection::migrateInLoop, shared_from_this(), loop, cb));
+    return;
+  }
+  if (migrating_)
+  {
+    // queued to the new loop ahead of attachInLoop(), wait for it
+    getLoop()->queueInLoop(std::bind(&TcpConnection::migrateInLoop, shared_from_this(), loop, cb));
+    return;
+  }
+  if (state_ != kConnected || loop == getLoop())
+  {
+    return;
+  }
+  LOG_DEBUG << "TcpConnection::migrateInLoop [" << name() << "] from "
+            << getLoop() << " to " << loop;
+  // unread data stays in the socket, unsent data stays in outputBuffer_,
+  // both are picked up by the new channel in attachInLoop().
+  channel_->disableAll();
+  channel_->remove();
+  if (bufferTimerArmed_)
+  {
+    getLoop()->cancel(bufferTimer_);
+    bufferTimerArmed_ = false;
+  }
+  // from the pool of this thread, not pool_ whose loop may be another one
+  std::shared_ptr<ObjectPool> pool(getLoop()->objectPool());
+  channel_ = makeUniqueFromPool<Channel>(pool.get(), loop, socket_->fd());
+  // after the old channel went back to the old pool
+  channelPool_.swap(pool);
+  setupChannel();
+  channel_->tie(shared_from_this());
+  migrating_ = true;
+  // publishes the new channel, functors queued to the new loop from now on
+  // may run before attachInLoop()
+  loop_.store(loop, std::memory_order_release);
+  loop->queueInLoop(std::bind(&TcpConnection::attachInLoop, shared_from_this(), cb));
+}
+
+void TcpConnection::attachInLoop(const ConnectionCallback& cb)
+{
+  getLoop()->assertInLoopThread();
+  migrating_ = false;
+  if (state_ == kDisconnected)
+  {
+    // closed while moving
+    return;
+  }
+  if (reading_ && !channel_->isReading())
+  {
+    channel_->enableReading();
+  }
+  if (outputBuffer_.readableBytes() > 0 && !channel_->isWriting())
+  {
+    channel_->enableWriting();
+  }
+  updateBuffers();
+  if (cb)
+  {
+    cb(shared_from_this());
+  }
+}
+
 // ӽɷ
 // TcpServer accepts a new connectionʱô˷
 // a״̬
@@ -400,9 +755,10 @@ void TcpConnection::stopReadInLoop()
 // cӽɵĻص
 void TcpConnection::connectEstablished()
 {
-  loop_->assertInLoopThread();
+  getLoop()->assertInLoopThread();
   assert(state_ == kConnecting);
   setState(kConnected);
+  lastActive_ = getLoop()->cachedNow();
   channel_->tie(shared_from_this());
   channel_->enableReading();
 
@@ -419,7 +775,12 @@ void TcpConnection::connectEstablished()
 // TcpConnectionǰõһ
 void TcpConnection::connectDestroyed()
 {
-  loop_->assertInLoopThread();
+  if (!getLoop()->isInLoopThread())
+  {
+    // migrated after being queued, follow the connection
+    getLoop()->queueInLoop(std::bind(&TcpConnection::connectDestroyed, shared_from_this()));
+    return;
+  }
   if (state_ == kConnected)
   {
     setState(kDisconnected);
@@ -427,6 +788,11 @@ void TcpConnection::connectDestroyed()
 
     connectionCallback_(shared_from_this());
   }
+  if (bufferTimerArmed_)
+  {
+    getLoop()->cancel(bufferTimer_);
+    bufferTimerArmed_ = false;
+  }
   // Ƴǰͨ
   channel_->remove();
 }
@@ -434,19 +800,52 @@ void TcpConnection::connectDestroyed()
 // пɶ¼ʱ.
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
-  loop_->assertInLoopThread();
+  getLoop()->assertInLoopThread();
   int savedErrno = 0;
+  Buffer* buf = &inputBuffer_;
+  if (sharedInput_ && inputBuffer_.readableBytes() == 0)
+  {
+    // nothing left over, read into the loop's buffer
+    buf = &getLoop()->bufferPool().readBuffer();
+    assert(buf->readableBytes() == 0);
+  }
+  else if (readBurst_)
+  {
+    // more is likely coming, read into a large buffer instead of
+    // the stack buffer of readFd(), which is then appended.
+    getLoop()->bufferPool().get(&inputBuffer_);
+  }
+  const size_t writable = buf->writableBytes();
   // ֱӽݶinputBuffer
-  ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+  ssize_t n = buf->readFd(channel_->fd(), &savedErrno);
   // Ȼreadķֵ, ݷֵʲôcb
   // رҲ
   if (n > 0)
   {
+    if (receivedBytes_)
+    {
+      receivedBytes_->increment(n);
+    }
+    lastActive_ = receiveTime;
+    readBurst_ = implicit_cast<size_t>(n) >= writable
+        && implicit_cast<size_t>(n) >= Buffer::kInitialSize;
     // aȡݴ0»ص
     // messageCallback_ ûûصTcpServer
     // TcpServerûصTcpConnection
     // TcpConnectionûصChannel    
-    messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+    messageCallback_(shared_from_this(), buf, receiveTime);
+    if (buf != &inputBuffer_)
+    {
+      // keeps the partial message for the next read
+      inputBuffer_.append(buf->peek(), buf->readableBytes());
+      buf->retrieveAll();
+    }
+    else if (sharedInput_ && inputBuffer_.readableBytes() == 0
+             && inputBuffer_.internalCapacity() > Buffer::kCheapPrepend)
+    {
+      releaseInputBuffer();
+    }
+    updateBuffers();
   }
   else if (n == 0)
   {
@@ -473,7 +872,7 @@ void TcpConnection::handleRead(Timestamp receiveTime)
 // ԱҪʱԵhandleWriteǿйر
 void TcpConnection::handleWrite()
 {
-  loop_->assertInLoopThread();
+  getLoop()->assertInLoopThread();
   // ͨдŽ
   if (channel_->isWriting())
   {
@@ -483,11 +882,16 @@ void TcpConnection::handleWrite()
                                outputBuffer_.readableBytes());
     if (n > 0)
     {
+      if (sentBytes_)
+      {
+        sentBytes_->increment(static_cast<int64_t>(n));
+      }
       // Ϻ, outputBufferɾ
       // ˶ݣBuffer
       // ⲿTcpConnection::shutdownʱҲֱӹر
       // Ҫݷ֮ٹرա
       outputBuffer_.retrieve(n);
+      lastActive_ = getLoop()->cachedNow();
 
       // ɶΪ0Ŀɶϵͳͺ˵ģû
       // ϵͳͺ˵ɶΪ0ʾݶˣд
@@ -500,7 +904,7 @@ void TcpConnection::handleWrite()
         if (writeCompleteCallback_)
         {
           // IOִ߳
-          loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+          getLoop()->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
         }
         // ״̬ѾǶϿУ
         // ҪرաFIXME_hqb õ?
@@ -538,7 +942,7 @@ void TcpConnection::handleWrite()
 // Socketsȥرsocket
 void TcpConnection::handleClose()
 {
-  loop_->assertInLoopThread();
+  getLoop()->assertInLoopThread();
   LOG_TRACE << "fd = " << channel_->fd() << " state = " << stateToString();
   assert(state_ == kConnected || state_ == kDisconnecting);
   // we don't close fd, leave it to dtor, so we can find leaks easily.
@@ -557,7 +961,7 @@ void TcpConnection::handleClose()
 void TcpConnection::handleError()
 {
   int err = sockets::getSocketError(channel_->fd());
-  LOG_ERROR << "TcpConnection::handleError [" << name_
+  LOG_ERROR << "TcpConnection::handleError [" << name()
             << "] - SO_ERROR = " << err << " " << strerror_tl(err);
 }
 
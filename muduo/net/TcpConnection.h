@@ -12,13 +12,18 @@
 #define MUDUO_NET_TCPCONNECTION_H
 
 #include <muduo/base/noncopyable.h>
+#include <muduo/base/ObjectPool.h>
 #include <muduo/base/StringPiece.h>
 #include <muduo/base/Types.h>
 #include <muduo/net/Callbacks.h>
 #include <muduo/net/Buffer.h>
 #include <muduo/net/InetAddress.h>
+#include <muduo/net/TimerId.h>
 
+#include <atomic>
+#include <map>
 #include <memory>
+#include <mutex>
 
 #include <boost/any.hpp>
 
@@ -27,6 +32,8 @@ struct tcp_info;
 
 namespace muduo
 {
+class Counter;
+
 namespace net
 {
 
@@ -45,17 +52,36 @@ class TcpConnection : noncopyable,
   /// Constructs a TcpConnection with a connected sockfd
   ///
   /// User should not create this object.
+  /// Its Socket and Channel come from pool if given, which must be the
+  /// ObjectPool of loop, created in its thread to avoid locking.
   TcpConnection(EventLoop* loop,
                 const string& name,
                 int sockfd,
                 const InetAddress& localAddr,
-                const InetAddress& peerAddr);
+                const InetAddress& peerAddr,
+                const std::shared_ptr<ObjectPool>& pool = std::shared_ptr<ObjectPool>());
+  /// Constructs a TcpConnection of TcpServer, named "namePrefix#id"
+  /// only when name() is first called.
+  TcpConnection(EventLoop* loop,
+                const std::shared_ptr<const string>& namePrefix,
+                uint64_t id,
+                int sockfd,
+                const InetAddress& localAddr,
+                const InetAddress& peerAddr,
+                const std::shared_ptr<ObjectPool>& pool = std::shared_ptr<ObjectPool>());
   ~TcpConnection();
 
   // ȡǰTcpConnectionڵEventLoop
-  EventLoop* getLoop() const { return loop_; }
+  EventLoop* getLoop() const { return loop_.load(std::memory_order_acquire); }
   // TcpConnection
-  const string& name() const { return name_; }
+  // thread safe
+  const string& name() const
+  {
+    std::call_once(nameOnce_, &TcpConnection::makeName, this);
+    return name_;
+  }
+  /// Unique in its TcpServer, 0 if not made by TcpServer.
+  uint64_t id() const { return id_; }
   // ǰ˵ַ
   const InetAddress& localAddress() const { return localAddr_; }
   // Զӿͻ˵ַ
@@ -89,6 +115,14 @@ class TcpConnection : noncopyable,
   void stopRead();
   bool isReading() const { return reading_; }; // NOT thread safe, may race with start/stopReadInLoop
 
+  /// Moves this connection, with its socket and buffered data, to @c loop.
+  /// Takes effect after the owner loop finishes handling current events,
+  /// @c cb is called in @c loop once the move is done.
+  /// Only a connected connection can be moved, otherwise it's a no-op.
+  /// Thread safe.
+  void migrateTo(EventLoop* loop,
+                 const ConnectionCallback& cb = ConnectionCallback());
+
   // ݡݿκݣҪһʱ洢á
   void setContext(const boost::any& context)
   { context_ = context; }
@@ -118,6 +152,29 @@ class TcpConnection : noncopyable,
   void setHighWaterMarkCallback(const HighWaterMarkCallback& cb, size_t highWaterMark)
   { highWaterMarkCallback_ = cb; highWaterMark_ = highWaterMark; }
 
+  /// Input and output buffers grown by a burst go back to the loop's
+  /// BufferPool, or are freed, after @c seconds without reading or writing.
+  /// 0 keeps them. Default 10 seconds.
+  /// Not thread safe, call in loop, eg. in connection callback.
+  void setBufferIdleTimeout(double seconds)
+  { bufferIdleTimeout_ = seconds; }
+
+  /// For request/response protocols whose messages are mostly consumed
+  /// in one message callback.  Reads land in a Buffer shared by the loop,
+  /// the input buffer of this connection holds only what the callback
+  /// leaves unconsumed, and gives back its memory once that's consumed.
+  /// The Buffer passed to the message callback is valid only during the
+  /// call, and inputBuffer() has only the leftovers.
+  /// Not thread safe, call in loop, eg. in connection callback.
+  void setSharedInputBuffer(bool on);
+
+  /// Sends in loop go to the output buffer, which is written once after
+  /// the current batch of events, instead of a write(2) per send(),
+  /// eg. for handlers sending header, body and trailer separately.
+  /// Not thread safe, call in loop, eg. in connection callback.
+  void setDeferredFlush(bool on)
+  { deferredFlush_ = on; }
+
   // ȡBufferַ
   /// Advanced interface
   Buffer* inputBuffer()
@@ -135,6 +192,14 @@ class TcpConnection : noncopyable,
   void setCloseCallback(const CloseCallback& cb)
   { closeCallback_ = cb; }
 
+  /// Internal use only, for per server metrics, call before connectEstablished().
+  void setByteCounters(Counter* received, Counter* sent)
+  { receivedBytes_ = received; sentBytes_ = sent; }
+
+  /// Internal use only, index in the slot table of TcpServer.
+  void setSlot(size_t slot) { slot_ = slot; }
+  size_t slot() const { return slot_; }
+
   // called when TcpServer accepts a new connection
   void connectEstablished();   // should be called only once
   // called when TcpServer has removed me from its map
@@ -144,6 +209,14 @@ class TcpConnection : noncopyable,
 
  private:
   enum StateE { kDisconnected, kConnecting, kConnected, kDisconnecting };
+  TcpConnection(EventLoop* loop,
+                const string& name,
+                const std::shared_ptr<const string>& namePrefix,
+                uint64_t id,
+                int sockfd,
+                const InetAddress& localAddr,
+                const InetAddress& peerAddr,
+                const std::shared_ptr<ObjectPool>& pool);
   // TcpConnectionhandle*ϵ, setchannelcallback*ϵ
   // handleReadлread, Ȼreadķֵ, ݷֵʲôcb
   // رҲ, readֵΪ0
@@ -168,18 +241,42 @@ class TcpConnection : noncopyable,
   const char* stateToString() const;
   void startReadInLoop();
   void stopReadInLoop();
+  void setupChannel();
+  // for send() from other threads
+  void queueSend(const void* message, size_t len);
+  void sendQueuedInLoop(uint64_t seq, const string& message);
+  void migrateInLoop(EventLoop* loop, const ConnectionCallback& cb);
+  void attachInLoop(const ConnectionCallback& cb);
+  void makeName() const;
+  // call after buffers may have grown
+  void updateBuffers();
+  void accountBuffers();
+  void checkIdleBuffers();
+  void releaseInputBuffer();
+  void flushDeferred();
 
-  EventLoop* loop_;
-  const string name_;
+  // changed only by migrateInLoop(), in the old loop thread,
+  // read by send() and friends in any thread
+  std::atomic<EventLoop*> loop_;
+  const uint64_t id_;
+  const std::shared_ptr<const string> namePrefix_;  // NULL if named in ctor
+  mutable std::once_flag nameOnce_;
+  mutable string name_;
+  size_t slot_;
   StateE state_;  // FIXME: use atomic variable
   bool reading_;
+  bool migrating_;  // until attachInLoop() in the new loop
+  // outlives socket_, which is freed to it
+  const std::shared_ptr<ObjectPool> pool_;
+  // outlives channel_, pool_ until the first move
+  std::shared_ptr<ObjectPool> channelPool_;
   // we don't expose those classes to client.
   // Socket
   // Զclose fd
-  std::unique_ptr<Socket> socket_;
+  std::unique_ptr<Socket, PoolDeleter<Socket>> socket_;
   // ͨ
   // TcpConnectionʹchannelsocketϵIO¼
-  std::unique_ptr<Channel> channel_;
+  std::unique_ptr<Channel, PoolDeleter<Channel>> channel_;
   // ǰ˵ַ
   const InetAddress localAddr_;
   // ǰӿͻ˵ַ
@@ -195,6 +292,23 @@ class TcpConnection : noncopyable,
   // Buffer
   Buffer inputBuffer_;
   Buffer outputBuffer_; // FIXME: use list<Buffer> as output buffer.
+  // sends from other threads are numbered and written in that order,
+  // those forwarded to the new loop after a move may arrive late.
+  std::atomic<uint64_t> queuedSends_;
+  uint64_t sentQueued_;                    // in loop
+  std::map<uint64_t, string> earlySends_;  // in loop, waiting for their turn
+  Counter* receivedBytes_;  // may be NULL
+  Counter* sentBytes_;      // may be NULL
+  // adaptive buffers, in loop
+  double bufferIdleTimeout_;
+  Timestamp lastActive_;  // last read or write
+  TimerId bufferTimer_;
+  bool bufferTimerArmed_;
+  bool readBurst_;  // the last read filled inputBuffer_
+  bool sharedInput_;
+  bool deferredFlush_;
+  bool deferredFlushQueued_;
+  size_t bufferBytes_;  // accounted capacity of the buffers
 
   // TcpConnectioncontext
   // ڱconnection󶨵
@@ -9,13 +9,12 @@
 #include <muduo/net/TcpServer.h>
 
 #include <muduo/base/Logging.h>
+#include <muduo/base/Metrics.h>
 #include <muduo/net/Acceptor.h>
 #include <muduo/net/EventLoop.h>
 #include <muduo/net/EventLoopThreadPool.h>
 #include <muduo/net/SocketsOps.h>
 
-#include <stdio.h>  // snprintf
-
 using namespace muduo;
 using namespace muduo::net;
 
@@ -27,6 +26,7 @@ TcpServer::TcpServer(EventLoop* loop,
   // ֵϢ
     ipPort_(listenAddr.toIpPort()),
     name_(nameArg),
+    connNamePrefix_(std::make_shared<const string>(name_ + "-" + ipPort_)),
   // ½һAcceptor, 𱻶, ӵʱᴴConnection
     acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)),
   // һ̳߳
@@ -35,27 +35,53 @@ TcpServer::TcpServer(EventLoop* loop,
     connectionCallback_(defaultConnectionCallback),
     messageCallback_(defaultMessageCallback),
   // ״̬ĬfalseһIDĬ1
-    nextConnId_(1)
+    nextConnId_(1),
+    numConnections_(0),
+    rebalanceInterval_(0.0),
+    rebalanceTolerance_(0.0),
+    acceptedConnections_(NULL),
+    activeConnections_(NULL),
+    receivedBytes_(NULL),
+    sentBytes_(NULL)
 {
   // ӵʱTcpServerӻص
   acceptor_->setNewConnectionCallback(
       std::bind(&TcpServer::newConnection, this, _1, _2));
+
+  MetricsRegistry& metrics = MetricsRegistry::instance();
+  const string labels = MetricsRegistry::label("server", name_);
+  acceptedConnections_ = metrics.counter("muduo_tcpserver_accepted_connections_total",
+                                         "Connections accepted by TcpServer.", labels);
+  activeConnections_ = metrics.gauge("muduo_tcpserver_active_connections",
+                                     "Connections currently held by TcpServer.", labels);
+  receivedBytes_ = metrics.counter("muduo_tcpserver_received_bytes_total",
+                                   "Bytes read from connections of TcpServer.", labels);
+  sentBytes_ = metrics.counter("muduo_tcpserver_sent_bytes_total",
+                               "Bytes written to connections of TcpServer.", labels);
 }
 
 // Ĺ̾ͷTcpConnection
 // Ͽ
 // removeConnectionǱϿ
-// KVӳ typedef std::map<string, TcpConnectionPtr> ConnectionMap connections_;
 TcpServer::~TcpServer()
 {
   loop_->assertInLoopThread();
   LOG_TRACE << "TcpServer::~TcpServer [" << name_ << "] destructing";
+  if (rebalanceInterval_ > 0)
+  {
+    loop_->cancel(rebalanceTimer_);
+  }
+  activeConnections_->add(-static_cast<int64_t>(numConnections_));
 
-  for (auto& item : connections_)
+  for (TcpConnectionPtr& slot : connections_)
   {
-    TcpConnectionPtr conn(item.second);
+    if (!slot)
+    {
+      continue;
+    }
+    TcpConnectionPtr conn(slot);
     // üһ
-    item.second.reset();
+    slot.reset();
     // ÿTcpConnection::conectDestroyed()ȥٶӦChannel
     conn->getLoop()->runInLoop(
       std::bind(&TcpConnection::connectDestroyed, conn));
@@ -80,9 +106,21 @@ void TcpServer::start()
     // ½ļ
     loop_->runInLoop(
         std::bind(&Acceptor::listen, get_pointer(acceptor_)));
+    if (rebalanceInterval_ > 0)
+    {
+      rebalanceTimer_ = loop_->runEvery(rebalanceInterval_,
+                                        std::bind(&TcpServer::rebalance, this));
+    }
   }
 }
 
+void TcpServer::enableRebalance(double interval, double tolerance)
+{
+  assert(interval > 0 && tolerance >= 0);
+  rebalanceInterval_ = interval;
+  rebalanceTolerance_ = tolerance;
+}
+
 // ӵʱõĴص
 // TcpConnectionconn
 void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
@@ -93,19 +131,11 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
   EventLoop* ioLoop = threadPool_->getNextLoop();
   // ֯ӵTcpServerName:˿#ID
   // ĬϽһIDż1
-  char buf[64];
-  snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
-  ++nextConnId_;
-  // TcpConnection, key
-  string connName = name_ + buf;
-
-  LOG_INFO << "TcpServer::newConnection [" << name_
-           << "] - new connection [" << connName
-           << "] from " << peerAddr.toIpPort();
+  // the name is made only if someone asks, eg. for logging
+  const uint64_t id = nextConnId_++;
   InetAddress localAddr(sockets::getLocalAddr(sockfd));
 
   // FIXME poll with zero timeout to double confirm the new connection
-  // FIXME use make_shared if necessary
 
   // ؼ
 
@@ -120,14 +150,43 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
   // socket
   // ǰַ
   // Զӵַ
-  TcpConnectionPtr conn(new TcpConnection(ioLoop,
-                                          connName,
-                                          sockfd,
-                                          localAddr,
-                                          peerAddr));
+  LOG_INFO << "TcpServer::newConnection [" << name_
+           << "] - new connection #" << id
+           << " from " << peerAddr.toIpPort();
   // 浱ǰ
-  // TcpConnection, key
-  connections_[connName] = conn;
+  // the slot is kept until addConnectionInLoop() fills it
+  size_t slot = connections_.size();
+  if (freeSlots_.empty())
+  {
+    connections_.push_back(TcpConnectionPtr());
+  }
+  else
+  {
+    slot = freeSlots_.back();
+    freeSlots_.pop_back();
+  }
+  acceptedConnections_->increment();
+  // made in ioLoop, from its pool, where it is destroyed too
+  ioLoop->runInLoop(
+      std::bind(&TcpServer::newConnectionInLoop, this, ioLoop, sockfd,
+                id, slot, localAddr, peerAddr)); // FIXME: unsafe
+}
+
+void TcpServer::newConnectionInLoop(EventLoop* ioLoop,
+                                    int sockfd,
+                                    uint64_t id,
+                                    size_t slot,
+                                    const InetAddress& localAddr,
+                                    const InetAddress& peerAddr)
+{
+  ioLoop->assertInLoopThread();
+  // from the pool of this loop, the one allocating without locking,
+  // given back here when the last TcpConnectionPtr goes.
+  TcpConnectionPtr conn(std::allocate_shared<TcpConnection>(
+      PoolAllocator<TcpConnection>(ioLoop->objectPool()),
+      ioLoop, connNamePrefix_, id, sockfd, localAddr, peerAddr, ioLoop->objectPool()));
+  conn->setSlot(slot);
+  conn->setByteCounters(receivedBytes_, sentBytes_);
   // ɻص
   // ӻصӶϿ͹رնã
   conn->setConnectionCallback(connectionCallback_);
@@ -137,10 +196,20 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
   // ùرջصƳӦTcpConnection
   conn->setCloseCallback(
       std::bind(&TcpServer::removeConnection, this, _1)); // FIXME: unsafe
-  
+  // queued ahead of removeConnectionInLoop()
+  loop_->runInLoop(std::bind(&TcpServer::addConnectionInLoop, this, conn)); // FIXME: unsafe
+
   // ӽ(ʼ״̬Channdelʼ )
-  // ioLoop: ӵʱҪ̳߳ȥһEventLoopµʹ
-  ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+  conn->connectEstablished();
+}
+
+void TcpServer::addConnectionInLoop(const TcpConnectionPtr& conn)
+{
+  loop_->assertInLoopThread();
+  assert(conn->slot() < connections_.size() && !connections_[conn->slot()]);
+  connections_[conn->slot()] = conn;
+  ++numConnections_;
+  activeConnections_->add(1);
 }
 
 void TcpServer::removeConnection(const TcpConnectionPtr& conn)
@@ -154,13 +223,86 @@ void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn)
 {
   loop_->assertInLoopThread();
   LOG_INFO << "TcpServer::removeConnectionInLoop [" << name_
-           << "] - connection " << conn->name();
-  size_t n = connections_.erase(conn->name());
-  (void)n;
-  assert(n == 1);
+           << "] - connection #" << conn->id()
+           << " from " << conn->peerAddress().toIpPort();
+  const size_t slot = conn->slot();
+  assert(slot < connections_.size() && connections_[slot] == conn);
+  connections_[slot].reset();
+  freeSlots_.push_back(slot);
+  --numConnections_;
+  activeConnections_->add(-1);
   EventLoop* ioLoop = conn->getLoop();
   // std::bindTcpConnectionڳconnectDestroyed()ʱ
   ioLoop->queueInLoop(
       std::bind(&TcpConnection::connectDestroyed, conn));
 }
 
+void TcpServer::forEachConnection(const ConnectionCallback& f) const
+{
+  loop_->assertInLoopThread();
+  for (const TcpConnectionPtr& conn : connections_)
+  {
+    if (conn)
+    {
+      f(conn);
+    }
+  }
+}
+
+void TcpServer::rebalance()
+{
+  loop_->assertInLoopThread();
+  std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+  if (loops.size() < 2)
+  {
+    return;
+  }
+
+  std::map<EventLoop*, std::vector<TcpConnectionPtr>> loads;
+  for (EventLoop* ioLoop : loops)
+  {
+    loads[ioLoop];
+  }
+  size_t total = 0;
+  for (const TcpConnectionPtr& conn : connections_)
+  {
+    if (!conn)
+    {
+      continue;
+    }
+    auto it = loads.find(conn->getLoop());
+    if (conn->connected() && it != loads.end())
+    {
+      it->second.push_back(conn);
+      ++total;
+    }
+  }
+
+  const size_t average = (total + loops.size() - 1) / loops.size();
+  const double limit = static_cast<double>(average) * (1.0 + rebalanceTolerance_);
+  std::vector<TcpConnectionPtr> surplus;
+  for (auto& load : loads)
+  {
+    std::vector<TcpConnectionPtr>& conns = load.second;
+    if (static_cast<double>(conns.size()) > limit)
+    {
+      surplus.insert(surplus.end(), conns.begin() + average, conns.end());
+      conns.resize(average);
+    }
+  }
+  if (surplus.empty())
+  {
+    return;
+  }
+
+  LOG_INFO << "TcpServer::rebalance [" << name_ << "] - moving "
+           << surplus.size() << " of " << total << " connections";
+  for (auto& load : loads)
+  {
+    for (size_t n = load.second.size(); n < average && !surplus.empty(); ++n)
+    {
+      surplus.back()->migrateTo(load.first, migrationCallback_);
+      surplus.pop_back();
+    }
+  }
+}
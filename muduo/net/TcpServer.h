@@ -14,11 +14,16 @@
 #include <muduo/base/Atomic.h>
 #include <muduo/base/Types.h>
 #include <muduo/net/TcpConnection.h>
+#include <muduo/net/TimerId.h>
 
 #include <map>
+#include <vector>
 
 namespace muduo
 {
+class Counter;
+class Gauge;
+
 namespace net
 {
 
@@ -93,11 +98,39 @@ class TcpServer : noncopyable
   void setWriteCompleteCallback(const WriteCompleteCallback& cb)
   { writeCompleteCallback_ = cb; }
 
+  /// Every @c interval seconds, moves connections off the loops holding
+  /// more than (1 + @c tolerance) times the average number of connections,
+  /// for long-lived connections drifting from round-robin placement.
+  /// Must be called before @c start
+  void enableRebalance(double interval, double tolerance = 0.1);
+
+  /// Set callback called in the new loop after a connection is moved there.
+  /// Not thread safe.
+  void setMigrationCallback(const ConnectionCallback& cb)
+  { migrationCallback_ = cb; }
+
+  /// Calls @c f for every connection, in no particular order,
+  /// eg. for broadcasting.
+  /// Not thread safe, but in loop
+  void forEachConnection(const ConnectionCallback& f) const;
+
+  /// Not thread safe, but in loop
+  size_t numConnections() const { return numConnections_; }
+
  private:
   /// Not thread safe, but in loop
   // ӵʱõķ
   // ӴTcpConnection, TcpConnectionPtr
   void newConnection(int sockfd, const InetAddress& peerAddr);
+  /// Not thread safe, but in ioLoop
+  void newConnectionInLoop(EventLoop* ioLoop,
+                           int sockfd,
+                           uint64_t id,
+                           size_t slot,
+                           const InetAddress& localAddr,
+                           const InetAddress& peerAddr);
+  /// Not thread safe, but in loop
+  void addConnectionInLoop(const TcpConnectionPtr& conn);
   /// Thread safe.
   // Ƴһ
   void removeConnection(const TcpConnectionPtr& conn);
@@ -106,14 +139,17 @@ class TcpServer : noncopyable
   // ûTcpConnectionPtrĻ, connüѾ͵1
   // std::bindTcpConnectionڳconnectDestroyed()ʱ
   void removeConnectionInLoop(const TcpConnectionPtr& conn);
+  /// Not thread safe, but in loop
+  void rebalance();
 
-  // KVӳ
-  typedef std::map<string, TcpConnectionPtr> ConnectionMap;
+  // indexed by TcpConnection::slot(), NULL if free
+  typedef std::vector<TcpConnectionPtr> ConnectionList;
 
   EventLoop* loop_;  // the acceptor loop
   const string ipPort_;
   // 
   const string name_;
+  const std::shared_ptr<const string> connNamePrefix_;  // "name-ip:port"
   // ݽ
   // Ĺ
   // Acceptorжaccept()ķװµ
@@ -124,13 +160,24 @@ class TcpServer : noncopyable
   MessageCallback messageCallback_;
   WriteCompleteCallback writeCompleteCallback_;
   ThreadInitCallback threadInitCallback_;
+  ConnectionCallback migrationCallback_;
   // ʼ־
   AtomicInt32 started_;
   // always in loop thread
   // һID
-  int nextConnId_;
+  uint64_t nextConnId_;
   // TcpConnectionӳ
-  ConnectionMap connections_;
+  ConnectionList connections_;
+  std::vector<size_t> freeSlots_;
+  size_t numConnections_;
+  double rebalanceInterval_;
+  double rebalanceTolerance_;
+  TimerId rebalanceTimer_;
+  // in MetricsRegistry, labeled by name_
+  Counter* acceptedConnections_;
+  Gauge* activeConnections_;
+  Counter* receivedBytes_;
+  Counter* sentBytes_;
 };
 
 }  // namespace net
@@ -12,6 +12,7 @@
 
 #include <muduo/net/TimerQueue.h>
 
+#include <muduo/base/Clock.h>
 #include <muduo/base/Logging.h>
 #include <muduo/net/EventLoop.h>
 #include <muduo/net/Timer.h>
@@ -41,7 +42,7 @@ int createTimerfd()
 struct timespec howMuchTimeFromNow(Timestamp when)
 {
   int64_t microseconds = when.microSecondsSinceEpoch()
-                         - Timestamp::now().microSecondsSinceEpoch();
+                         - Clock::now().microSecondsSinceEpoch();
   if (microseconds < 100)
   {
     microseconds = 100;
@@ -194,7 +195,7 @@ void TimerQueue::cancelInLoop(TimerId timerId)
 void TimerQueue::handleRead()
 {
   loop_->assertInLoopThread();
-  Timestamp now(Timestamp::now());
+  Timestamp now(Clock::now());
   // ʱڣȡһξ
   readTimerfd(timerfd_, now);
   // timers_ƳѵڵTimer, ͨvector
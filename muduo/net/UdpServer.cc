@@ -0,0 +1,99 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include <muduo/net/UdpServer.h>
+
+#include <muduo/base/CountDownLatch.h>
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/EventLoopThreadPool.h>
+
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+UdpServer::UdpServer(EventLoop* loop, const InetAddress& listenAddr, const string& name)
+  : loop_(CHECK_NOTNULL(loop)),
+    listenAddr_(listenAddr),
+    name_(name),
+    threadPool_(new EventLoopThreadPool(loop, name)),
+    maxDatagramSize_(2048),
+    batch_(64),
+    gso_(false),
+    gro_(false),
+    started_(false)
+{
+}
+
+UdpServer::~UdpServer()
+{
+  loop_->assertInLoopThread();
+  LOG_TRACE << "UdpServer::~UdpServer [" << name_ << "] destructing";
+
+  // sockets are closed in their own loops, before the threads quit
+  CountDownLatch latch(static_cast<int>(sockets_.size()));
+  for (auto& socket : sockets_)
+  {
+    UdpSocket* s = socket.release();
+    EventLoop* ioLoop = s->getLoop();
+    if (ioLoop == loop_)
+    {
+      delete s;
+      latch.countDown();
+    }
+    else
+    {
+      ioLoop->runInLoop([s, &latch] { delete s; latch.countDown(); });
+    }
+  }
+  latch.wait();
+}
+
+void UdpServer::setThreadNum(int numThreads)
+{
+  assert(0 <= numThreads);
+  threadPool_->setThreadNum(numThreads);
+}
+
+void UdpServer::start()
+{
+  loop_->runInLoop(std::bind(&UdpServer::startInLoop, this));
+}
+
+void UdpServer::startInLoop()
+{
+  loop_->assertInLoopThread();
+  if (started_)
+  {
+    return;
+  }
+  started_ = true;
+  threadPool_->start(threadInitCallback_);
+
+  const std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+  const sa_family_t family = listenAddr_.family();
+  for (size_t i = 0; i < loops.size(); ++i)
+  {
+    char buf[32];
+    snprintf(buf, sizeof buf, "#%zd", i);
+    std::unique_ptr<UdpSocket> socket(new UdpSocket(loops[i], name_ + buf, family));
+    socket->setMessageCallback(messageCallback_);
+    socket->setMaxDatagramSize(maxDatagramSize_);
+    socket->setBatchSize(batch_);
+    if (gso_)
+    {
+      socket->setGso(true);
+    }
+    if (gro_)
+    {
+      socket->setGro(true);
+    }
+    socket->setReusePort(loops.size() > 1);
+    socket->bindAddress(listenAddr_);
+    socket->start();
+    sockets_.push_back(std::move(socket));
+  }
+  LOG_INFO << "UdpServer [" << name_ << "] listening on " << listenAddr_.toIpPort()
+           << " with " << sockets_.size() << " socket(s)";
+}
@@ -0,0 +1,81 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_UDPSERVER_H
+#define MUDUO_NET_UDPSERVER_H
+
+#include <muduo/net/UdpSocket.h>
+
+#include <memory>
+#include <vector>
+
+namespace muduo
+{
+namespace net
+{
+
+class EventLoop;
+class EventLoopThreadPool;
+
+///
+/// UDP server, sharded over loops.
+///
+/// Each loop of setThreadNum() owns a UdpSocket bound to the same address
+/// with SO_REUSEPORT, the kernel spreads peers over them by hash.
+/// The message callback runs in the loop of the socket, replies sent with
+/// UdpSocket::sendTo() go out of the same socket.
+class UdpServer : noncopyable
+{
+ public:
+  typedef std::function<void(EventLoop*)> ThreadInitCallback;
+
+  UdpServer(EventLoop* loop, const InetAddress& listenAddr, const string& name);
+  ~UdpServer();  // force out-line dtor, for std::unique_ptr members.
+
+  const string& name() const { return name_; }
+  EventLoop* getLoop() const { return loop_; }
+
+  /// Set the number of threads, each owning a socket.
+  /// - 0 means one socket in the loop passed to ctor, default.
+  /// - N means N sockets in N loops, none in the loop passed to ctor.
+  /// All of the setters must be called before start().
+  void setThreadNum(int numThreads);
+  void setThreadInitCallback(const ThreadInitCallback& cb)
+  { threadInitCallback_ = cb; }
+  void setMessageCallback(const UdpSocket::MessageCallback& cb)
+  { messageCallback_ = cb; }
+  void setMaxDatagramSize(size_t size) { maxDatagramSize_ = size; }
+  void setBatchSize(int batch) { batch_ = batch; }
+  void setGso(bool on) { gso_ = on; }
+  void setGro(bool on) { gro_ = on; }
+
+  /// Binds and starts receiving, thread safe.
+  void start();
+
+  /// valid after start(), each one is used in its own loop only.
+  const std::vector<std::unique_ptr<UdpSocket>>& sockets() const
+  { return sockets_; }
+
+ private:
+  void startInLoop();
+
+  EventLoop* loop_;
+  const InetAddress listenAddr_;
+  const string name_;
+  std::unique_ptr<EventLoopThreadPool> threadPool_;
+  ThreadInitCallback threadInitCallback_;
+  UdpSocket::MessageCallback messageCallback_;
+  size_t maxDatagramSize_;
+  int batch_;
+  bool gso_;
+  bool gro_;
+  bool started_;
+  std::vector<std::unique_ptr<UdpSocket>> sockets_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_UDPSERVER_H
@@ -0,0 +1,520 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include <muduo/net/UdpSocket.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/base/Metrics.h>
+#include <muduo/net/Channel.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/Socket.h>
+#include <muduo/net/SocketsOps.h>
+
+#include <algorithm>
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <string.h>
+#include <unistd.h>
+
+// from linux/udp.h, missing in older libc headers
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const size_t kMaxUdpPayload = 65507;
+const size_t kGroSlotSize = 65536;
+const int kMaxSendBatch = 64;
+const size_t kMaxSegments = 64;
+const size_t kMaxPendingBytes = 4 * 1024 * 1024;
+// recvmmsg() calls per POLLIN, so other channels get their turns
+const int kMaxReadRounds = 4;
+
+const size_t kRecvControlLen = CMSG_SPACE(sizeof(int));
+const size_t kSendControlLen = CMSG_SPACE(sizeof(uint16_t));
+
+int createNonblockingUdpOrDie(sa_family_t family)
+{
+  int sockfd = ::socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+  if (sockfd < 0)
+  {
+    LOG_SYSFATAL << "createNonblockingUdpOrDie";
+  }
+  return sockfd;
+}
+
+socklen_t addrLen(const struct sockaddr_in6& addr)
+{
+  return static_cast<socklen_t>(addr.sin6_family == AF_INET6
+      ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
+}
+
+bool sameAddr(const struct sockaddr_in6& lhs, const struct sockaddr_in6& rhs)
+{
+  if (lhs.sin6_family != rhs.sin6_family || lhs.sin6_port != rhs.sin6_port)
+  {
+    return false;
+  }
+  if (lhs.sin6_family == AF_INET6)
+  {
+    return memcmp(&lhs.sin6_addr, &rhs.sin6_addr, sizeof lhs.sin6_addr) == 0;
+  }
+  return sockets::sockaddr_in_cast(sockets::sockaddr_cast(&lhs))->sin_addr.s_addr
+      == sockets::sockaddr_in_cast(sockets::sockaddr_cast(&rhs))->sin_addr.s_addr;
+}
+
+}  // namespace
+
+UdpSocket::UdpSocket(EventLoop* loop, const string& name, sa_family_t family)
+  : loop_(CHECK_NOTNULL(loop)),
+    name_(name),
+    family_(family),
+    sockfd_(createNonblockingUdpOrDie(family)),
+    channel_(new Channel(loop, sockfd_)),
+    maxDatagramSize_(2048),
+    batch_(64),
+    gso_(false),
+    gro_(false),
+    started_(false),
+    flushQueued_(false),
+    sendMsgs_(kMaxSendBatch),
+    sendIovs_(kMaxSendBatch),
+    sendControl_(kMaxSendBatch * kSendControlLen),
+    received_(0),
+    sent_(0),
+    dropped_(0)
+{
+  channel_->setReadCallback(std::bind(&UdpSocket::handleRead, this, _1));
+  channel_->setWriteCallback(std::bind(&UdpSocket::handleWrite, this));
+
+  MetricsRegistry& metrics = MetricsRegistry::instance();
+  const string labels = MetricsRegistry::label("socket", name_);
+  receivedDatagrams_ = metrics.counter("muduo_udp_received_datagrams_total",
+                                       "Datagrams received by UdpSocket", labels);
+  sentDatagrams_ = metrics.counter("muduo_udp_sent_datagrams_total",
+                                   "Datagrams sent by UdpSocket", labels);
+  droppedDatagrams_ = metrics.counter("muduo_udp_dropped_datagrams_total",
+                                      "Datagrams dropped by UdpSocket, truncated or not sent",
+                                      labels);
+}
+
+UdpSocket::~UdpSocket()
+{
+  loop_->assertInLoopThread();
+  channel_->disableAll();
+  channel_->remove();
+  sockets::close(sockfd_);
+}
+
+void UdpSocket::setMaxDatagramSize(size_t size)
+{
+  assert(!started_);
+  maxDatagramSize_ = std::min(size, kMaxUdpPayload);
+}
+
+void UdpSocket::setBatchSize(int batch)
+{
+  assert(!started_);
+  batch_ = std::max(batch, 1);
+}
+
+bool UdpSocket::setGso(bool on)
+{
+  // UDP_SEGMENT of 0 means no default segment size, it is set per sendmsg.
+  int optval = 0;
+  if (on && ::setsockopt(sockfd_, SOL_UDP, UDP_SEGMENT, &optval, sizeof optval) < 0)
+  {
+    LOG_SYSERR << "UdpSocket::setGso [" << name_ << "] - UDP_SEGMENT is not supported";
+    gso_ = false;
+    return false;
+  }
+  gso_ = on;
+  return true;
+}
+
+bool UdpSocket::setGro(bool on)
+{
+  assert(!started_);
+  int optval = on ? 1 : 0;
+  if (::setsockopt(sockfd_, SOL_UDP, UDP_GRO, &optval, sizeof optval) < 0)
+  {
+    LOG_SYSERR << "UdpSocket::setGro [" << name_ << "] - UDP_GRO is not supported";
+    gro_ = false;
+    return !on;
+  }
+  gro_ = on;
+  return true;
+}
+
+void UdpSocket::setReusePort(bool on)
+{
+#ifdef SO_REUSEPORT
+  int optval = on ? 1 : 0;
+  if (::setsockopt(sockfd_, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof optval) < 0 && on)
+  {
+    LOG_SYSERR << "SO_REUSEPORT failed.";
+  }
+#else
+  if (on)
+  {
+    LOG_ERROR << "SO_REUSEPORT is not supported.";
+  }
+#endif
+}
+
+void UdpSocket::bindAddress(const InetAddress& addr)
+{
+  sockets::bindOrDie(sockfd_, addr.getSockAddr());
+}
+
+int UdpSocket::connect(const InetAddress& peer)
+{
+  struct sockaddr_in6 addr = *sockets::sockaddr_in6_cast(peer.getSockAddr());
+  return ::connect(sockfd_, peer.getSockAddr(), addrLen(addr)) < 0 ? errno : 0;
+}
+
+InetAddress UdpSocket::localAddress() const
+{
+  return InetAddress(sockets::getLocalAddr(sockfd_));
+}
+
+void UdpSocket::start()
+{
+  loop_->runInLoop(std::bind(&UdpSocket::startInLoop, this));
+}
+
+void UdpSocket::startInLoop()
+{
+  loop_->assertInLoopThread();
+  if (started_)
+  {
+    return;
+  }
+  started_ = true;
+  // one slot per datagram, a GRO slot holds many
+  const size_t slotSize = gro_ ? kGroSlotSize : maxDatagramSize_;
+  const size_t batch = static_cast<size_t>(batch_);
+  recvBuffer_.resize(batch * slotSize);
+  recvMsgs_.resize(batch);
+  recvIovs_.resize(batch);
+  recvAddrs_.resize(batch);
+  recvControl_.resize(batch * kRecvControlLen);
+  for (size_t i = 0; i < batch; ++i)
+  {
+    recvIovs_[i].iov_base = &recvBuffer_[i * slotSize];
+    recvIovs_[i].iov_len = slotSize;
+    struct msghdr& hdr = recvMsgs_[i].msg_hdr;
+    memZero(&hdr, sizeof hdr);
+    hdr.msg_name = &recvAddrs_[i];
+    hdr.msg_iov = &recvIovs_[i];
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = &recvControl_[i * kRecvControlLen];
+  }
+  channel_->enableReading();
+}
+
+void UdpSocket::handleRead(Timestamp receiveTime)
+{
+  loop_->assertInLoopThread();
+  for (int round = 0; round < kMaxReadRounds; ++round)
+  {
+    for (int i = 0; i < batch_; ++i)
+    {
+      struct msghdr& hdr = recvMsgs_[i].msg_hdr;
+      hdr.msg_namelen = sizeof(struct sockaddr_in6);
+      hdr.msg_controllen = gro_ ? kRecvControlLen : 0;
+      hdr.msg_flags = 0;
+    }
+    int n = ::recvmmsg(sockfd_, &recvMsgs_[0], batch_, 0, NULL);
+    if (n < 0)
+    {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+      {
+        // eg. ECONNREFUSED of a connected socket
+        LOG_SYSERR << "UdpSocket::handleRead [" << name_ << "]";
+      }
+      break;
+    }
+
+    int64_t received = 0;
+    for (int i = 0; i < n; ++i)
+    {
+      struct msghdr& hdr = recvMsgs_[i].msg_hdr;
+      if (hdr.msg_flags & MSG_TRUNC)
+      {
+        drop(1);
+        continue;
+      }
+      const size_t len = recvMsgs_[i].msg_len;
+      size_t segment = len;
+      if (gro_)
+      {
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(&hdr, cmsg))
+        {
+          if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+          {
+            int gsoSize = 0;
+            memcpy(&gsoSize, CMSG_DATA(cmsg), sizeof gsoSize);
+            if (gsoSize > 0)
+            {
+              segment = static_cast<size_t>(gsoSize);
+            }
+          }
+        }
+      }
+      const InetAddress peer(recvAddrs_[i]);
+      const char* data = static_cast<const char*>(recvIovs_[i].iov_base);
+      size_t offset = 0;
+      do
+      {
+        const size_t datagram = std::min(segment, len - offset);
+        ++received;
+        if (messageCallback_)
+        {
+          messageCallback_(this, StringPiece(data + offset, static_cast<int>(datagram)),
+                           peer, receiveTime);
+        }
+        offset += datagram;
+      } while (offset < len);
+    }
+    received_ += received;
+    receivedDatagrams_->increment(received);
+
+    if (n < batch_)
+    {
+      break;
+    }
+  }
+}
+
+void UdpSocket::sendTo(const InetAddress& peer, const void* data, size_t len)
+{
+  if (loop_->isInLoopThread())
+  {
+    enqueue(sockets::sockaddr_in6_cast(peer.getSockAddr()), data, len);
+  }
+  else
+  {
+    loop_->runInLoop(std::bind(&UdpSocket::enqueueInLoop, this, true, peer,
+                               string(static_cast<const char*>(data), len)));
+  }
+}
+
+void UdpSocket::send(const void* data, size_t len)
+{
+  if (loop_->isInLoopThread())
+  {
+    enqueue(NULL, data, len);
+  }
+  else
+  {
+    loop_->runInLoop(std::bind(&UdpSocket::enqueueInLoop, this, false, InetAddress(),
+                               string(static_cast<const char*>(data), len)));
+  }
+}
+
+void UdpSocket::enqueueInLoop(bool hasPeer, const InetAddress& peer, const string& datagram)
+{
+  enqueue(hasPeer ? sockets::sockaddr_in6_cast(peer.getSockAddr()) : NULL,
+          datagram.data(), datagram.size());
+}
+
+void UdpSocket::enqueue(const struct sockaddr_in6* peer, const void* data, size_t len)
+{
+  loop_->assertInLoopThread();
+  if (len > kMaxUdpPayload || output_.readableBytes() + len > kMaxPendingBytes)
+  {
+    drop(1);
+    return;
+  }
+  Pending pending;
+  pending.len = len;
+  pending.hasPeer = peer != NULL;
+  if (peer)
+  {
+    pending.peer = *peer;
+  }
+  else
+  {
+    memZero(&pending.peer, sizeof pending.peer);
+  }
+  output_.append(data, len);
+  pending_.push_back(pending);
+  if (!flushQueued_ && !channel_->isWriting())
+  {
+    // after other channels of this iteration, which may send more
+    flushQueued_ = true;
+    loop_->queueInLoop(std::bind(&UdpSocket::flush, this));
+    if (!loop_->eventHandling())
+    {
+      // eg. before loop()
+      loop_->wakeup();
+    }
+  }
+}
+
+int UdpSocket::prepareSend(size_t first, std::vector<int>* datagrams)
+{
+  datagrams->clear();
+  char* base = const_cast<char*>(output_.peek());
+  for (size_t i = 0; i < first; ++i)
+  {
+    base += pending_[i].len;
+  }
+
+  int msgs = 0;
+  size_t i = first;
+  while (i < pending_.size() && msgs < kMaxSendBatch)
+  {
+    const Pending& head = pending_[i];
+    size_t bytes = head.len;
+    size_t j = i + 1;
+    if (gso_ && head.len > 0)
+    {
+      // a run of datagrams to the same peer, all of the same size but
+      // the last one, goes as one message.
+      while (j < pending_.size()
+             && j - i < kMaxSegments
+             && pending_[j].len > 0
+             && pending_[j].len <= head.len
+             && bytes + pending_[j].len <= kMaxUdpPayload
+             && pending_[j].hasPeer == head.hasPeer
+             && (!head.hasPeer || sameAddr(pending_[j].peer, head.peer)))
+      {
+        bytes += pending_[j].len;
+        ++j;
+        if (pending_[j-1].len < head.len)
+        {
+          break;
+        }
+      }
+    }
+
+    struct mmsghdr& msg = sendMsgs_[msgs];
+    memZero(&msg, sizeof msg);
+    sendIovs_[msgs].iov_base = base;
+    sendIovs_[msgs].iov_len = bytes;
+    msg.msg_hdr.msg_iov = &sendIovs_[msgs];
+    msg.msg_hdr.msg_iovlen = 1;
+    if (head.hasPeer)
+    {
+      msg.msg_hdr.msg_name = const_cast<struct sockaddr_in6*>(&head.peer);
+      msg.msg_hdr.msg_namelen = addrLen(head.peer);
+    }
+    if (j - i > 1)
+    {
+      msg.msg_hdr.msg_control = &sendControl_[msgs * kSendControlLen];
+      msg.msg_hdr.msg_controllen = kSendControlLen;
+      struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg.msg_hdr);
+      cmsg->cmsg_level = SOL_UDP;
+      cmsg->cmsg_type = UDP_SEGMENT;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+      const uint16_t segment = static_cast<uint16_t>(head.len);
+      memcpy(CMSG_DATA(cmsg), &segment, sizeof segment);
+    }
+    datagrams->push_back(static_cast<int>(j - i));
+    base += bytes;
+    i = j;
+    ++msgs;
+  }
+  return msgs;
+}
+
+void UdpSocket::flush()
+{
+  loop_->assertInLoopThread();
+  flushQueued_ = false;
+  std::vector<int> datagrams;
+  size_t done = 0;  // datagrams sent or dropped
+  size_t doneBytes = 0;
+  while (done < pending_.size())
+  {
+    const int msgs = prepareSend(done, &datagrams);
+    int n = ::sendmmsg(sockfd_, &sendMsgs_[0], msgs, 0);
+    int failed = 0;
+    if (n < 0)
+    {
+      const int savedErrno = errno;
+      if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK)
+      {
+        if (!channel_->isWriting())
+        {
+          channel_->enableWriting();
+        }
+        break;
+      }
+      if (savedErrno == EINTR)
+      {
+        continue;
+      }
+      if (gso_ && datagrams[0] > 1 && (savedErrno == EIO || savedErrno == EINVAL))
+      {
+        // eg. no checksum offload on the route
+        LOG_WARN << "UdpSocket::flush [" << name_ << "] - GSO failed, turns it off";
+        gso_ = false;
+        continue;
+      }
+      errno = savedErrno;
+      LOG_SYSERR << "UdpSocket::flush [" << name_ << "]";
+      // drops the first message, eg. to an unreachable peer
+      n = 1;
+      failed = 1;
+    }
+
+    int64_t sent = 0;
+    for (int m = 0; m < n; ++m)
+    {
+      for (int k = 0; k < datagrams[m]; ++k)
+      {
+        doneBytes += pending_[done].len;
+        ++done;
+      }
+      if (m >= failed)
+      {
+        sent += datagrams[m];
+      }
+    }
+    if (failed)
+    {
+      drop(datagrams[0]);
+    }
+    sent_ += sent;
+    sentDatagrams_->increment(sent);
+  }
+
+  if (done == pending_.size())
+  {
+    output_.retrieveAll();
+    pending_.clear();
+    if (channel_->isWriting())
+    {
+      channel_->disableWriting();
+    }
+  }
+  else
+  {
+    output_.retrieve(doneBytes);
+    pending_.erase(pending_.begin(), pending_.begin() + done);
+  }
+}
+
+void UdpSocket::handleWrite()
+{
+  flush();
+}
+
+void UdpSocket::drop(int64_t n)
+{
+  dropped_ += n;
+  droppedDatagrams_->increment(n);
+}
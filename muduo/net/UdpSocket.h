@@ -0,0 +1,151 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_UDPSOCKET_H
+#define MUDUO_NET_UDPSOCKET_H
+
+#include <muduo/base/StringPiece.h>
+#include <muduo/base/Timestamp.h>
+#include <muduo/base/Types.h>
+#include <muduo/base/noncopyable.h>
+#include <muduo/net/Buffer.h>
+#include <muduo/net/InetAddress.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace muduo
+{
+class Counter;
+
+namespace net
+{
+
+class Channel;
+class EventLoop;
+
+///
+/// Non-blocking UDP socket in an EventLoop.
+///
+/// Receives with recvmmsg(2) into a ring of buffers allocated once,
+/// and sends with sendmmsg(2) all datagrams queued in a loop iteration.
+/// With GRO/GSO (UDP_GRO and UDP_SEGMENT, Linux 5.0), a burst of
+/// datagrams to or from the same peer crosses the stack as one.
+///
+/// Must be destroyed in the loop thread, sendTo() is thread safe.
+class UdpSocket : noncopyable
+{
+ public:
+  /// @c datagram is valid only during the callback.
+  typedef std::function<void (UdpSocket*,
+                              StringPiece datagram,
+                              const InetAddress& peer,
+                              Timestamp receiveTime)> MessageCallback;
+
+  UdpSocket(EventLoop* loop, const string& name, sa_family_t family = AF_INET);
+  ~UdpSocket();
+
+  EventLoop* getLoop() const { return loop_; }
+  const string& name() const { return name_; }
+  int fd() const { return sockfd_; }
+
+  /// Not thread safe.
+  void setMessageCallback(const MessageCallback& cb)
+  { messageCallback_ = cb; }
+
+  /// Larger datagrams are dropped, 65507 at most.  Must be called before start().
+  void setMaxDatagramSize(size_t size);
+  /// Datagrams per recvmmsg(2).  Must be called before start().
+  void setBatchSize(int batch);
+  /// Returns false if not supported by the kernel.
+  bool setGso(bool on);
+  bool setGro(bool on);
+  void setReusePort(bool on);
+
+  /// abort if address in use
+  void bindAddress(const InetAddress& addr);
+  /// for send() without an address.  Returns 0 on success, or errno.
+  int connect(const InetAddress& peer);
+  InetAddress localAddress() const;
+
+  /// Starts receiving.  Thread safe.
+  void start();
+
+  /// Sent after the current loop iteration, together with other datagrams.
+  /// Dropped if too many bytes are waiting for the socket to be writable.
+  /// Thread safe, datagram is copied.
+  void sendTo(const InetAddress& peer, const void* data, size_t len);
+  void sendTo(const InetAddress& peer, StringPiece datagram)
+  { sendTo(peer, datagram.data(), datagram.size()); }
+  /// to the connected peer
+  void send(const void* data, size_t len);
+
+  int64_t receivedDatagrams() const { return received_; }
+  int64_t sentDatagrams() const { return sent_; }
+  int64_t droppedDatagrams() const { return dropped_; }
+
+ private:
+  struct Pending
+  {
+    size_t len;  // bytes in output_
+    bool hasPeer;
+    struct sockaddr_in6 peer;
+  };
+
+  void startInLoop();
+  void handleRead(Timestamp receiveTime);
+  void handleWrite();
+  void enqueue(const struct sockaddr_in6* peer, const void* data, size_t len);
+  void enqueueInLoop(bool hasPeer, const InetAddress& peer, const string& datagram);
+  void flush();
+  // fills sendMsgs_ from pending_[first], returns datagrams in each message
+  int prepareSend(size_t first, std::vector<int>* datagrams);
+  void drop(int64_t n);
+
+  EventLoop* loop_;
+  const string name_;
+  const sa_family_t family_;
+  const int sockfd_;
+  std::unique_ptr<Channel> channel_;
+  MessageCallback messageCallback_;
+  size_t maxDatagramSize_;
+  int batch_;
+  bool gso_;
+  bool gro_;
+  bool started_;
+
+  // receive ring, allocated in start()
+  std::vector<char> recvBuffer_;
+  std::vector<struct mmsghdr> recvMsgs_;
+  std::vector<struct iovec> recvIovs_;
+  std::vector<struct sockaddr_in6> recvAddrs_;
+  std::vector<char> recvControl_;
+
+  // datagrams queued in this iteration, or waiting for POLLOUT
+  Buffer output_;
+  std::vector<Pending> pending_;
+  bool flushQueued_;
+  std::vector<struct mmsghdr> sendMsgs_;
+  std::vector<struct iovec> sendIovs_;
+  std::vector<char> sendControl_;
+
+  // in the loop thread
+  int64_t received_;
+  int64_t sent_;
+  int64_t dropped_;
+  // in MetricsRegistry, labeled by name_
+  Counter* receivedDatagrams_;
+  Counter* sentDatagrams_;
+  Counter* droppedDatagrams_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_UDPSOCKET_H
@@ -8,9 +8,11 @@
 //
 
 #include <muduo/net/http/HttpResponse.h>
+#include <muduo/base/TimeFormat.h>
 #include <muduo/net/Buffer.h>
 
 #include <stdio.h>
+#include <time.h>
 
 using namespace muduo;
 using namespace muduo::net;
@@ -34,6 +36,15 @@ void HttpResponse::appendToBuffer(Buffer* output) const
     output->append("Connection: Keep-Alive\r\n");
   }
 
+  if (headers_.find("Date") == headers_.end())
+  {
+    char date[TimeFormat::kHttpDateLength];
+    TimeFormat::formatHttpDate(::time(NULL), date);
+    output->append("Date: ");
+    output->append(date, sizeof date);
+    output->append("\r\n");
+  }
+
   for (const auto& header : headers_)
   {
     output->append(header.first);
@@ -60,6 +60,8 @@ void HttpServer::onConnection(const TcpConnectionPtr& conn)
   if (conn->connected())
   {
     conn->setContext(HttpContext());
+    // responses to pipelined requests go out in one write
+    conn->setDeferredFlush(true);
   }
 }
 
@@ -9,11 +9,14 @@
 
 #include <muduo/net/inspect/Inspector.h>
 
+#include <muduo/base/Histogram.h>
 #include <muduo/base/Logging.h>
+#include <muduo/base/Metrics.h>
 #include <muduo/base/Thread.h>
 #include <muduo/net/EventLoop.h>
 #include <muduo/net/http/HttpRequest.h>
 #include <muduo/net/http/HttpResponse.h>
+#include <muduo/net/inspect/LoopInspector.h>
 #include <muduo/net/inspect/ProcessInspector.h>
 #include <muduo/net/inspect/PerformanceInspector.h>
 #include <muduo/net/inspect/SystemInspector.h>
@@ -55,6 +58,25 @@ std::vector<string> split(const string& str)
   return result;
 }
 
+// ?a=1&b=2 to "a=1", "b=2"
+void splitQuery(const string& query, std::vector<string>* args)
+{
+  size_t start = query.empty() || query[0] != '?' ? 0 : 1;
+  while (start < query.size())
+  {
+    size_t end = query.find('&', start);
+    if (end == string::npos)
+    {
+      end = query.size();
+    }
+    if (end > start)
+    {
+      args->push_back(query.substr(start, end - start));
+    }
+    start = end + 1;
+  }
+}
+
 }  // namespace
 
 extern char favicon[1743];
@@ -64,6 +86,8 @@ Inspector::Inspector(EventLoop* loop,
                      const string& name)
     : server_(loop, httpAddr, "Inspector:"+name),
       processInspector_(new ProcessInspector),
+      loopInspector_(new LoopInspector),
+      performanceInspector_(new PerformanceInspector),
       systemInspector_(new SystemInspector)
 {
   assert(CurrentThread::isMainThread());
@@ -71,11 +95,9 @@ Inspector::Inspector(EventLoop* loop,
   g_globalInspector = this;
   server_.setHttpCallback(std::bind(&Inspector::onRequest, this, _1, _2));
   processInspector_->registerCommands(this);
-  systemInspector_->registerCommands(this);
-#ifdef HAVE_TCMALLOC
-  performanceInspector_.reset(new PerformanceInspector);
+  loopInspector_->registerCommands(this);
   performanceInspector_->registerCommands(this);
-#endif
+  systemInspector_->registerCommands(this);
   loop->runAfter(0, std::bind(&Inspector::start, this)); // little race condition
 }
 
@@ -106,6 +128,23 @@ void Inspector::remove(const string& module, const string& command)
   }
 }
 
+void Inspector::addHistogram(const string& module,
+                             const string& command,
+                             const Histogram* hist,
+                             const string& help)
+{
+  const string name = module + "_" + command;
+  add(module, command, [hist, name, help](HttpRequest::Method, const ArgList& args)
+      {
+        Histogram::Snapshot snapshot = hist->snapshot();
+        if (!args.empty() && args[0] == "prometheus")
+        {
+          return snapshot.toPrometheus(name, help);
+        }
+        return snapshot.toString() + "\n";
+      }, help);
+}
+
 void Inspector::start()
 {
   server_.start();
@@ -134,6 +173,9 @@ void Inspector::onRequest(const HttpRequest& req, HttpResponse* resp)
         result += "\n";
       }
     }
+    result += "/metrics";
+    result += string(19, ' ');
+    result += "all metrics in Prometheus text format\n";
     resp->setStatusCode(HttpResponse::k200Ok);
     resp->setStatusMessage("OK");
     resp->setContentType("text/plain");
@@ -153,7 +195,15 @@ void Inspector::onRequest(const HttpRequest& req, HttpResponse* resp)
     else if (result.size() == 1)
     {
       string module = result[0];
-      if (module == "favicon.ico")
+      if (module == "metrics")
+      {
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setStatusMessage("OK");
+        resp->setContentType("text/plain; version=0.0.4");
+        resp->setBody(MetricsRegistry::instance().exposition());
+        ok = true;
+      }
+      else if (module == "favicon.ico")
       {
         resp->setStatusCode(HttpResponse::k200Ok);
         resp->setStatusMessage("OK");
@@ -180,6 +230,7 @@ void Inspector::onRequest(const HttpRequest& req, HttpResponse* resp)
         if (it != commList.end())
         {
           ArgList args(result.begin()+2, result.end());
+          splitQuery(req.query(), &args);
           if (it->second)
           {
             resp->setStatusCode(HttpResponse::k200Ok);
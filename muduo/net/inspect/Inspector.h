@@ -19,15 +19,19 @@
 
 namespace muduo
 {
+class Histogram;
+
 namespace net
 {
 
+class LoopInspector;
 class ProcessInspector;
 class PerformanceInspector;
 class SystemInspector;
 
 // An internal inspector of the running process, usually a singleton.
 // Better to run in a seperated thread, as some method may block for seconds
+// Serves MetricsRegistry at /metrics, in Prometheus text format.
 class Inspector : noncopyable
 {
  public:
@@ -39,12 +43,22 @@ class Inspector : noncopyable
   ~Inspector();
 
   /// Add a Callback for handling the special uri : /mudule/command
+  /// Path segments after command are passed in args, followed by
+  /// query parameters as "key=value".
   void add(const string& module,
            const string& command,
            const Callback& cb,
            const string& help);
   void remove(const string& module, const string& command);
 
+  /// Exports @c hist at /module/command as one line of text,
+  /// or in Prometheus text format at /module/command/prometheus.
+  /// @c hist must outlive this Inspector.
+  void addHistogram(const string& module,
+                    const string& command,
+                    const Histogram* hist,
+                    const string& help);
+
  private:
   typedef std::map<string, Callback> CommandList;
   typedef std::map<string, string> HelpList;
@@ -54,6 +68,7 @@ class Inspector : noncopyable
 
   HttpServer server_;
   std::unique_ptr<ProcessInspector> processInspector_;
+  std::unique_ptr<LoopInspector> loopInspector_;
   std::unique_ptr<PerformanceInspector> performanceInspector_;
   std::unique_ptr<SystemInspector> systemInspector_;
   MutexLock mutex_;
@@ -0,0 +1,72 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include <muduo/net/inspect/LoopInspector.h>
+
+#include <muduo/base/Metrics.h>
+#include <muduo/net/BufferPool.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/EventLoopStats.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+void LoopInspector::registerCommands(Inspector* ins)
+{
+  ins->add("loops", "stats", LoopInspector::stats,
+           "print busy/idle time and latency of each EventLoop");
+  ins->add("loops", "slowcallback", LoopInspector::slowCallback,
+           "/loops/slowcallback/<ms> logs callbacks slower than that, 0 to disable");
+  ins->add("loops", "buffers", LoopInspector::buffers,
+           "print resident bytes of connection buffers and pooled buffers");
+}
+
+string LoopInspector::stats(HttpRequest::Method, const Inspector::ArgList&)
+{
+  string result;
+  EventLoop::forEachLoop([&result](EventLoop* loop)
+  {
+    char buf[64];
+    snprintf(buf, sizeof buf, "loop %p tid %d\n", loop, loop->threadId());
+    result += buf;
+    result += loop->stats().toString();
+    result += "\n";
+  });
+  return result;
+}
+
+string LoopInspector::buffers(HttpRequest::Method, const Inspector::ArgList&)
+{
+  string result;
+  char buf[128];
+  EventLoop::forEachLoop([&result, &buf](EventLoop* loop)
+  {
+    const BufferPool& pool = loop->bufferPool();
+    snprintf(buf, sizeof buf, "loop %p tid %d pooled %zd buffers %zd bytes\n",
+             loop, loop->threadId(), pool.size(), pool.bytes());
+    result += buf;
+  });
+  snprintf(buf, sizeof buf, "connection buffers %" PRId64 " bytes\npooled buffers %" PRId64 " bytes\n",
+           BufferPool::connectionBytesGauge()->value(),
+           BufferPool::bytesGauge()->value());
+  result += buf;
+  return result;
+}
+
+string LoopInspector::slowCallback(HttpRequest::Method, const Inspector::ArgList& args)
+{
+  if (args.size() != 1)
+  {
+    return "usage: /loops/slowcallback/<ms>\n";
+  }
+  const double ms = ::atof(args[0].c_str());
+  EventLoop::forEachLoop([ms](EventLoop* loop)
+  {
+    loop->setSlowCallbackThreshold(ms / 1000.0);
+  });
+  return "slow callback threshold set to " + args[0] + "ms\n";
+}
@@ -0,0 +1,30 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is an internal header file, you should not include this.
+
+#ifndef MUDUO_NET_INSPECT_LOOPINSPECTOR_H
+#define MUDUO_NET_INSPECT_LOOPINSPECTOR_H
+
+#include <muduo/net/inspect/Inspector.h>
+
+namespace muduo
+{
+namespace net
+{
+
+// Statistics of all EventLoops in this process.
+class LoopInspector : noncopyable
+{
+ public:
+  void registerCommands(Inspector* ins);
+
+  static string stats(HttpRequest::Method, const Inspector::ArgList&);
+  static string slowCallback(HttpRequest::Method, const Inspector::ArgList&);
+  static string buffers(HttpRequest::Method, const Inspector::ArgList&);
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_INSPECT_LOOPINSPECTOR_H
@@ -8,31 +8,70 @@
 //
 
 #include <muduo/net/inspect/PerformanceInspector.h>
+#include <muduo/base/CpuProfiler.h>
 #include <muduo/base/FileUtil.h>
 #include <muduo/base/LogStream.h>
 #include <muduo/base/ProcessInfo.h>
 
+#include <stdlib.h>
 #include <unistd.h>
 
 #ifdef HAVE_TCMALLOC
 #include <gperftools/malloc_extension.h>
 #include <gperftools/profiler.h>
+#endif
 
 using namespace muduo;
 using namespace muduo::net;
 
 void PerformanceInspector::registerCommands(Inspector* ins)
 {
+  ins->add("pprof", "profile", PerformanceInspector::profile,
+           "collapsed stacks of cpu profile, ?seconds=30&hz=99. CAUTION: blocking thread!");
+#ifdef HAVE_TCMALLOC
   ins->add("pprof", "heap", PerformanceInspector::heap, "get heap information");
   ins->add("pprof", "growth", PerformanceInspector::growth, "get heap growth information");
-  ins->add("pprof", "profile", PerformanceInspector::profile,
+  ins->add("pprof", "gperftools_profile", PerformanceInspector::gperftoolsProfile,
            "get cpu profiling information. CAUTION: blocking thread for 30 seconds!");
   ins->add("pprof", "cmdline", PerformanceInspector::cmdline, "get command line");
   ins->add("pprof", "memstats", PerformanceInspector::memstats, "get memory stats");
   ins->add("pprof", "memhistogram", PerformanceInspector::memhistogram, "get memory histogram");
   ins->add("pprof", "releasefreememory", PerformanceInspector::releaseFreeMemory, "release free memory");
+#endif
 }
 
+// /pprof/profile/10 or /pprof/profile?seconds=10&hz=99
+string PerformanceInspector::profile(HttpRequest::Method, const Inspector::ArgList& args)
+{
+  double seconds = 30;
+  int frequency = 99;
+  for (const string& arg : args)
+  {
+    if (arg.compare(0, 8, "seconds=") == 0)
+    {
+      seconds = atof(arg.c_str() + 8);
+    }
+    else if (arg.compare(0, 3, "hz=") == 0)
+    {
+      frequency = atoi(arg.c_str() + 3);
+    }
+    else
+    {
+      seconds = atof(arg.c_str());
+    }
+  }
+  if (seconds <= 0 || seconds > 600)
+  {
+    return "seconds should be in (0, 600]\n";
+  }
+  if (CpuProfiler::isProfiling())
+  {
+    return "another profiling is running\n";
+  }
+  return CpuProfiler::profile(seconds, frequency);
+}
+
+#ifdef HAVE_TCMALLOC
 string PerformanceInspector::heap(HttpRequest::Method, const Inspector::ArgList&)
 {
   std::string result;
@@ -47,7 +86,7 @@ string PerformanceInspector::growth(HttpRequest::Method, const Inspector::ArgLis
   return string(result.data(), result.size());
 }
 
-string PerformanceInspector::profile(HttpRequest::Method, const Inspector::ArgList&)
+string PerformanceInspector::gperftoolsProfile(HttpRequest::Method, const Inspector::ArgList&)
 {
   string filename = "/tmp/" + ProcessInfo::procname();
   filename += ".";
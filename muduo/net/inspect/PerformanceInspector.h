@@ -25,7 +25,10 @@ class PerformanceInspector : noncopyable
 
   static string heap(HttpRequest::Method, const Inspector::ArgList&);
   static string growth(HttpRequest::Method, const Inspector::ArgList&);
+  // built-in sampling profiler, collapsed stacks
   static string profile(HttpRequest::Method, const Inspector::ArgList&);
+  // needs HAVE_TCMALLOC
+  static string gperftoolsProfile(HttpRequest::Method, const Inspector::ArgList&);
   static string cmdline(HttpRequest::Method, const Inspector::ArgList&);
   static string memstats(HttpRequest::Method, const Inspector::ArgList&);
   static string memhistogram(HttpRequest::Method, const Inspector::ArgList&);
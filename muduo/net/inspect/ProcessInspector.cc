@@ -9,6 +9,7 @@
 
 #include <muduo/net/inspect/ProcessInspector.h>
 #include <muduo/base/FileUtil.h>
+#include <muduo/base/Metrics.h>
 #include <muduo/base/ProcessInfo.h>
 #include <limits.h>
 #include <stdio.h>
@@ -128,6 +129,43 @@ void ProcessInspector::registerCommands(Inspector* ins)
   ins->add("proc", "status", ProcessInspector::procStatus, "print /proc/self/status");
   // ins->add("proc", "opened_files", ProcessInspector::openedFiles, "count /proc/self/fd");
   ins->add("proc", "threads", ProcessInspector::threads, "list /proc/self/task");
+  MetricsRegistry::instance().addCollector("process", ProcessInspector::collectMetrics);
+}
+
+void ProcessInspector::collectMetrics(string* out)
+{
+  ProcessInfo::CpuTime cpu = ProcessInfo::cpuTime();
+  MetricsRegistry::appendHeader(out, "process_cpu_seconds_total",
+                                "Total user and system CPU time spent in seconds.", "counter");
+  MetricsRegistry::appendSample(out, "process_cpu_seconds_total", string(),
+                                cpu.userSeconds + cpu.systemSeconds);
+
+  // /proc/self/statm: size resident shared text lib data dt, in pages
+  string statm;
+  long resident = 0;
+  if (FileUtil::readFile("/proc/self/statm", 1024, &statm) == 0)
+  {
+    sscanf(statm.c_str(), "%*s %ld", &resident);
+  }
+  MetricsRegistry::appendHeader(out, "process_resident_memory_bytes",
+                                "Resident memory size in bytes.", "gauge");
+  MetricsRegistry::appendSample(out, "process_resident_memory_bytes", string(),
+                                static_cast<int64_t>(resident) * ProcessInfo::pageSize());
+
+  MetricsRegistry::appendHeader(out, "process_open_fds", "Number of open file descriptors.", "gauge");
+  MetricsRegistry::appendSample(out, "process_open_fds", string(),
+                                static_cast<int64_t>(ProcessInfo::openedFiles()));
+  MetricsRegistry::appendHeader(out, "process_max_fds", "Maximum number of open file descriptors.", "gauge");
+  MetricsRegistry::appendSample(out, "process_max_fds", string(),
+                                static_cast<int64_t>(ProcessInfo::maxOpenFiles()));
+  MetricsRegistry::appendHeader(out, "process_threads", "Number of OS threads.", "gauge");
+  MetricsRegistry::appendSample(out, "process_threads", string(),
+                                static_cast<int64_t>(ProcessInfo::numThreads()));
+  MetricsRegistry::appendHeader(out, "process_start_time_seconds",
+                                "Start time of the process since unix epoch in seconds.", "gauge");
+  MetricsRegistry::appendSample(out, "process_start_time_seconds", string(),
+                                static_cast<double>(ProcessInfo::startTime().microSecondsSinceEpoch())
+                                / Timestamp::kMicroSecondsPerSecond);
 }
 
 string ProcessInspector::overview(HttpRequest::Method, const Inspector::ArgList&)
@@ -28,6 +28,8 @@ class ProcessInspector : noncopyable
   static string procStatus(HttpRequest::Method, const Inspector::ArgList&);
   static string openedFiles(HttpRequest::Method, const Inspector::ArgList&);
   static string threads(HttpRequest::Method, const Inspector::ArgList&);
+  /// standard process_* metrics, a MetricsRegistry::Collector
+  static void collectMetrics(string* out);
 
   static string username_;
 };
@@ -8,6 +8,7 @@
 
 #include <muduo/net/poller/EPollPoller.h>
 
+#include <muduo/base/Clock.h>
 #include <muduo/base/Logging.h>
 #include <muduo/net/Channel.h>
 
@@ -60,7 +61,7 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList* activeChannels)
                                static_cast<int>(events_.size()),
                                timeoutMs);
   int savedErrno = errno;
-  Timestamp now(Timestamp::now());
+  Timestamp now(Clock::now());
   if (numEvents > 0)
   {
     LOG_TRACE << numEvents << " events happened";
@@ -8,6 +8,7 @@
 
 #include <muduo/net/poller/PollPoller.h>
 
+#include <muduo/base/Clock.h>
 #include <muduo/base/Logging.h>
 #include <muduo/base/Types.h>
 #include <muduo/net/Channel.h>
@@ -36,7 +37,7 @@ Timestamp PollPoller::poll(int timeoutMs, ChannelList* activeChannels)
   // ܻfillActiveChannelsڱ, ֻŻ, Ŀһ
   int numEvents = ::poll(&*pollfds_.begin(), pollfds_.size(), timeoutMs);
   int savedErrno = errno;
-  Timestamp now(Timestamp::now());
+  Timestamp now(Clock::now());
   if (numEvents > 0)
   {
     // ֵ0ʾӦԾļ
@@ -133,7 +134,7 @@ void PollPoller::updateChannel(Channel* channel)
     struct pollfd& pfd = pollfds_[idx];
     assert(pfd.fd == channel->fd() || pfd.fd == -channel->fd()-1);
     pfd.fd = channel->fd();
-    pfd.events = static_cast<short>(channel->events()) // û¼;
+    pfd.events = static_cast<short>(channel->events()); // û¼
     pfd.revents = 0;
     if (channel->isNoneEvent())
     {
@@ -8,7 +8,13 @@
 
 #include <muduo/net/protorpc/RpcChannel.h>
 
+#include <muduo/base/Crc32c.h>
 #include <muduo/base/Logging.h>
+#include <muduo/base/Metrics.h>
+#include <muduo/base/ThreadPool.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/TcpConnection.h>
+#include <muduo/net/protorpc/RpcController.h>
 #include <muduo/net/protorpc/rpc.pb.h>
 
 #include <google/protobuf/descriptor.h>
@@ -16,17 +22,58 @@
 using namespace muduo;
 using namespace muduo::net;
 
+namespace
+{
+
+const int kWheelSlots = 64;
+const size_t kInitialOutstandingSlots = 64;
+const int64_t kTickUs = 10 * 1000;
+
+}  // namespace
+
 RpcChannel::RpcChannel()
-  : codec_(std::bind(&RpcChannel::onRpcMessage, this, _1, _2, _3)),
-    services_(NULL)
+  : codec_(std::bind(&RpcChannel::onRpcMessage, this, _1, _2, _3),
+           std::bind(&RpcChannel::onRawMessage, this, _1, _2, _3)),
+    outstandings_(kInitialOutstandingSlots),
+    nextId_(1),
+    wheel_(kWheelSlots),
+    lastTick_(0),
+    timedCalls_(0),
+    outstandingCalls_(0),
+    timerArmed_(false),
+    defaultTimeout_(0),
+    services_(NULL),
+    methods_(NULL),
+    rawPayload_(false),
+    peerRawPayload_(false),
+    crc32c_(Crc32c::hardwareAccelerated()),
+    peerCrc32c_(false),
+    encoderPool_(NULL),
+    encodeMinBytes_(0)
 {
   LOG_INFO << "RpcChannel::ctor - " << this;
 }
 
 RpcChannel::RpcChannel(const TcpConnectionPtr& conn)
-  : codec_(std::bind(&RpcChannel::onRpcMessage, this, _1, _2, _3)),
+  : codec_(std::bind(&RpcChannel::onRpcMessage, this, _1, _2, _3),
+           std::bind(&RpcChannel::onRawMessage, this, _1, _2, _3)),
     conn_(conn),
-    services_(NULL)
+    outstandings_(kInitialOutstandingSlots),
+    nextId_(1),
+    wheel_(kWheelSlots),
+    lastTick_(0),
+    timedCalls_(0),
+    outstandingCalls_(0),
+    timerArmed_(false),
+    defaultTimeout_(0),
+    services_(NULL),
+    methods_(NULL),
+    rawPayload_(false),
+    peerRawPayload_(false),
+    crc32c_(Crc32c::hardwareAccelerated()),
+    peerCrc32c_(false),
+    encoderPool_(NULL),
+    encodeMinBytes_(0)
 {
   LOG_INFO << "RpcChannel::ctor - " << this;
 }
@@ -34,11 +81,13 @@ RpcChannel::RpcChannel(const TcpConnectionPtr& conn)
 RpcChannel::~RpcChannel()
 {
   LOG_INFO << "RpcChannel::dtor - " << this;
-  for (const auto& outstanding : outstandings_)
+  for (const OutstandingSlot& slot : outstandings_)
   {
-    OutstandingCall out = outstanding.second;
-    delete out.response;
-    delete out.done;
+    if (slot.id != 0)
+    {
+      delete slot.call.response;
+      delete slot.call.done;
+    }
   }
 }
 
@@ -53,20 +102,341 @@ void RpcChannel::CallMethod(const ::google::protobuf::MethodDescriptor* method,
                             ::google::protobuf::Message* response,
                             ::google::protobuf::Closure* done)
 {
+  RpcController* muduoController = dynamic_cast<RpcController*>(controller);
+  double timeout = defaultTimeout_;
+  if (muduoController && muduoController->timeout() > 0)
+  {
+    timeout = muduoController->timeout();
+  }
+
   RpcMessage message;
   message.set_type(REQUEST);
-  int64_t id = id_.incrementAndGet();
-  message.set_id(id);
   message.set_service(method->service()->full_name());
   message.set_method(method->name());
-  message.set_request(request->SerializeAsString()); // FIXME: error check
+  OutstandingCall out = { response, done, muduoController, 0 };
+  if (timeout > 0)
+  {
+    const int64_t timeoutUs = static_cast<int64_t>(timeout * Timestamp::kMicroSecondsPerSecond);
+    message.set_timeout_us(timeoutUs);
+    out.deadline = Timestamp::now().microSecondsSinceEpoch() + timeoutUs;
+  }
 
-  OutstandingCall out = { response, done };
+  bool armTimer = false;
+  int64_t id = 0;
   {
   MutexLockGuard lock(mutex_);
-  outstandings_[id] = out;
+  id = nextId_++;
+  message.set_id(id);
+  addOutstanding(id, out);
+  if (out.deadline > 0)
+  {
+    addToWheel(id, out.deadline);
+    ++timedCalls_;
+    if (!timerArmed_)
+    {
+      timerArmed_ = true;
+      armTimer = true;
+      lastTick_ = Timestamp::now().microSecondsSinceEpoch() / kTickUs;
+    }
+  }
+  }
+  if (armTimer)
+  {
+    std::weak_ptr<RpcChannel> weakChannel(shared_from_this());
+    conn_->getLoop()->runAfter(static_cast<double>(kTickUs) / Timestamp::kMicroSecondsPerSecond,
+                               std::bind(&RpcChannel::onTimeoutTick, weakChannel));
+  }
+  if (conn_ && !conn_->connected())
+  {
+    // lost before sending, or between failAll() and here.
+    // fails this call only, others are failed by the connection callback.
+    OutstandingCall lost = { NULL, NULL, NULL, 0 };
+    {
+    MutexLockGuard lock(mutex_);
+    if (takeOutstanding(id, &lost))
+    {
+      if (lost.deadline > 0)
+      {
+        --timedCalls_;
+      }
+    }
+    }
+    if (lost.response)
+    {
+      RpcMessage unavailable;
+      unavailable.set_type(RESPONSE);
+      unavailable.set_error(UNAVAILABLE);
+      finishCall(lost, &unavailable, StringPiece());
+    }
+    return;
+  }
+  send(&message, request);
+}
+
+void RpcChannel::addOutstanding(int64_t id, const OutstandingCall& out)
+{
+  auto place = [this](int64_t slotId, const OutstandingCall& call)
+  {
+    const size_t mask = outstandings_.size() - 1;
+    size_t i = static_cast<size_t>(slotId) & mask;
+    while (outstandings_[i].id != 0)
+    {
+      i = (i + 1) & mask;
+    }
+    outstandings_[i].id = slotId;
+    outstandings_[i].call = call;
+  };
+
+  const size_t count = static_cast<size_t>(outstandingCalls_.load(std::memory_order_relaxed));
+  if (2 * (count + 1) > outstandings_.size())
+  {
+    std::vector<OutstandingSlot> old(2 * outstandings_.size());
+    old.swap(outstandings_);
+    for (const OutstandingSlot& slot : old)
+    {
+      if (slot.id != 0)
+      {
+        place(slot.id, slot.call);
+      }
+    }
+  }
+  place(id, out);
+  outstandingCalls_.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t RpcChannel::findOutstanding(int64_t id) const
+{
+  const size_t mask = outstandings_.size() - 1;
+  for (size_t i = static_cast<size_t>(id) & mask; outstandings_[i].id != 0; i = (i + 1) & mask)
+  {
+    if (outstandings_[i].id == id)
+    {
+      return i;
+    }
+  }
+  return outstandings_.size();
+}
+
+bool RpcChannel::takeOutstanding(int64_t id, OutstandingCall* out)
+{
+  size_t hole = findOutstanding(id);
+  if (hole == outstandings_.size())
+  {
+    return false;
+  }
+  *out = outstandings_[hole].call;
+  outstandingCalls_.fetch_sub(1, std::memory_order_relaxed);
+
+  // shifts back the slots after it that probed past it, no tombstones
+  const size_t mask = outstandings_.size() - 1;
+  for (size_t i = (hole + 1) & mask; outstandings_[i].id != 0; i = (i + 1) & mask)
+  {
+    const size_t home = static_cast<size_t>(outstandings_[i].id) & mask;
+    // stays unless its home is cyclically in (hole, i]
+    if (((i - home) & mask) >= ((i - hole) & mask))
+    {
+      outstandings_[hole] = outstandings_[i];
+      hole = i;
+    }
+  }
+  outstandings_[hole].id = 0;
+  return true;
+}
+
+void RpcChannel::addToWheel(int64_t id, int64_t deadline)
+{
+  // rounds up, so a call is never visited before its deadline
+  const int64_t tick = (deadline + kTickUs - 1) / kTickUs;
+  wheel_[tick % kWheelSlots].push_back(id);
+}
+
+void RpcChannel::onTimeoutTick(const std::weak_ptr<RpcChannel>& weakChannel)
+{
+  RpcChannelPtr channel(weakChannel.lock());
+  if (channel)
+  {
+    channel->expireTimeouts();
+  }
+}
+
+void RpcChannel::expireTimeouts()
+{
+  const int64_t now = Timestamp::now().microSecondsSinceEpoch();
+  const int64_t nowTick = now / kTickUs;
+  std::vector<OutstandingCall> expired;
+  bool rearm = false;
+  {
+  MutexLockGuard lock(mutex_);
+  // visits every slot at most once, even if the loop was busy for long
+  const int64_t firstTick = std::max(lastTick_ + 1, nowTick - kWheelSlots + 1);
+  for (int64_t tick = firstTick; tick <= nowTick; ++tick)
+  {
+    std::vector<int64_t> ids;
+    ids.swap(wheel_[tick % kWheelSlots]);
+    for (int64_t id : ids)
+    {
+      const size_t i = findOutstanding(id);
+      if (i == outstandings_.size())
+      {
+        continue;  // finished
+      }
+      const int64_t deadline = outstandings_[i].call.deadline;
+      if (deadline <= now)
+      {
+        OutstandingCall out;
+        takeOutstanding(id, &out);
+        expired.push_back(out);
+        --timedCalls_;
+      }
+      else
+      {
+        addToWheel(id, deadline);  // due in a later round
+      }
+    }
+  }
+  lastTick_ = nowTick;
+  rearm = timedCalls_ > 0;
+  timerArmed_ = rearm;
+  }
+
+  for (const OutstandingCall& out : expired)
+  {
+    RpcMessage timeout;
+    timeout.set_type(RESPONSE);
+    timeout.set_error(TIMEOUT);
+    finishCall(out, &timeout, StringPiece());
+  }
+  if (!expired.empty())
+  {
+    LOG_WARN << "RpcChannel::expireTimeouts - " << expired.size() << " calls timed out";
+  }
+  if (rearm)
+  {
+    std::weak_ptr<RpcChannel> weakChannel(shared_from_this());
+    conn_->getLoop()->runAfter(static_cast<double>(kTickUs) / Timestamp::kMicroSecondsPerSecond,
+                               std::bind(&RpcChannel::onTimeoutTick, weakChannel));
+  }
+}
+
+void RpcChannel::failAll(ErrorCode error)
+{
+  std::vector<OutstandingCall> failed;
+  {
+  MutexLockGuard lock(mutex_);
+  for (OutstandingSlot& slot : outstandings_)
+  {
+    if (slot.id != 0)
+    {
+      failed.push_back(slot.call);
+      slot.id = 0;
+    }
+  }
+  timedCalls_ = 0;
+  outstandingCalls_.store(0, std::memory_order_relaxed);
+  }
+
+  RpcMessage message;
+  message.set_type(RESPONSE);
+  message.set_error(error);
+  for (const OutstandingCall& out : failed)
+  {
+    finishCall(out, &message, StringPiece());
+  }
+}
+
+void RpcChannel::finishCall(const OutstandingCall& out, const RpcMessage* message,
+                            StringPiece payload)
+{
+  std::unique_ptr<google::protobuf::Message> d(out.response);
+  if (message->has_error() && message->error() != NO_ERROR)
+  {
+    if (out.controller)
+    {
+      out.controller->setErrorCode(message->error());
+    }
+  }
+  else
+  {
+    out.response->ParseFromArray(payload.data(), payload.size());
+  }
+  if (out.done)
+  {
+    out.done->Run();
+  }
+}
+
+void RpcChannel::send(RpcMessage* message, const ::google::protobuf::Message* payload)
+{
+  Buffer buf;
+  if (rawPayload())
+  {
+    if (!RpcRawCodec::fillEmptyBuffer(&buf, *message, payload, crc32c()))
+    {
+      return;
+    }
+  }
+  else
+  {
+    if (rawPayload_)
+    {
+      message->set_raw_payload(true);
+      if (crc32c_)
+      {
+        message->set_crc32c(true);
+      }
+    }
+    if (payload)
+    {
+      // FIXME: error check
+      if (message->type() == REQUEST)
+      {
+        message->set_request(payload->SerializeAsString());
+      }
+      else
+      {
+        message->set_response(payload->SerializeAsString());
+      }
+    }
+    codec_.fillEmptyBuffer(&buf, *message);
+  }
+
+  EventLoop* loop = conn_->getLoop();
+  if (message->type() == RESPONSE && !loop->isInLoopThread())
+  {
+    // from a pool thread, wakes up the IO thread once for many responses.
+    // RpcServer owns the channel by RpcChannelPtr.
+    bool wakeup = false;
+    {
+    MutexLockGuard lock(responseMutex_);
+    wakeup = responses_.readableBytes() == 0;
+    if (wakeup)
+    {
+      responses_.swap(buf);  // no copying of large responses
+    }
+    else
+    {
+      responses_.append(buf.peek(), buf.readableBytes());
+    }
+    }
+    if (wakeup)
+    {
+      loop->queueInLoop(std::bind(&RpcChannel::flushResponses, shared_from_this()));
+    }
   }
-  codec_.send(conn_, message);
+  else
+  {
+    conn_->send(&buf);
+  }
+}
+
+void RpcChannel::flushResponses()
+{
+  Buffer output;
+  {
+  MutexLockGuard lock(responseMutex_);
+  output.swap(responses_);
+  }
+  conn_->send(&output);
 }
 
 void RpcChannel::onMessage(const TcpConnectionPtr& conn,
@@ -82,103 +452,253 @@ void RpcChannel::onRpcMessage(const TcpConnectionPtr& conn,
 {
   assert(conn == conn_);
   //printf("%s\n", message.DebugString().c_str());
-  RpcMessage& message = *messagePtr;
-  if (message.type() == RESPONSE)
+  const RpcMessage& message = *messagePtr;
+  if (message.raw_payload())
   {
-    int64_t id = message.id();
-    assert(message.has_response() || message.has_error());
+    peerRawPayload_.store(true, std::memory_order_relaxed);
+  }
+  if (message.crc32c())
+  {
+    peerCrc32c_.store(true, std::memory_order_relaxed);
+  }
+  handleMessage(message,
+                message.type() == RESPONSE ? message.response() : message.request(),
+                receiveTime);
+}
 
-    OutstandingCall out = { NULL, NULL };
+bool RpcChannel::onRawMessage(const TcpConnectionPtr& conn,
+                              StringPiece frame,
+                              Timestamp receiveTime)
+{
+  if (!RpcRawCodec::isRawFrame(frame))
+  {
+    return true;  // "RPC0", parsed by codec_
+  }
 
+  RpcMessage message;
+  StringPiece payload;
+  ProtobufCodecLite::ErrorCode errorCode = RpcRawCodec::parse(frame, &message, &payload);
+  if (errorCode == ProtobufCodecLite::kNoError)
+  {
+    peerRawPayload_.store(true, std::memory_order_relaxed);
+    if (RpcRawCodec::isCrc32cFrame(frame))
     {
-      MutexLockGuard lock(mutex_);
-      std::map<int64_t, OutstandingCall>::iterator it = outstandings_.find(id);
-      if (it != outstandings_.end())
-      {
-        out = it->second;
-        outstandings_.erase(it);
-      }
+      peerCrc32c_.store(true, std::memory_order_relaxed);
     }
+    handleMessage(message, payload, receiveTime);
+  }
+  else
+  {
+    ProtobufCodecLite::defaultErrorCallback(conn, NULL, receiveTime, errorCode);
+  }
+  return false;
+}
 
-    if (out.response)
+void RpcChannel::handleMessage(const RpcMessage& message, StringPiece payload,
+                               Timestamp receiveTime)
+{
+  if (message.type() == RESPONSE)
+  {
+    handleResponse(message, payload);
+  }
+  else if (message.type() == REQUEST)
+  {
+    handleRequest(message, payload, receiveTime);
+  }
+  else if (message.type() == ERROR)
+  {
+  }
+}
+
+void RpcChannel::handleResponse(const RpcMessage& message, StringPiece payload)
+{
+  OutstandingCall out = { NULL, NULL, NULL, 0 };
+  {
+  MutexLockGuard lock(mutex_);
+  if (takeOutstanding(message.id(), &out))
+  {
+    if (out.deadline > 0)
     {
-      std::unique_ptr<google::protobuf::Message> d(out.response);
-      if (message.has_response())
-      {
-        out.response->ParseFromString(message.response());
-      }
-      if (out.done)
-      {
-        out.done->Run();
-      }
+      --timedCalls_;
     }
   }
-  else if (message.type() == REQUEST)
+  }
+
+  // NULL if timed out or failed already
+  if (out.response)
+  {
+    finishCall(out, &message, payload);
+  }
+}
+
+void RpcChannel::handleRequest(const RpcMessage& message, StringPiece payload,
+                               Timestamp receiveTime)
+{
+  ErrorCode error = WRONG_PROTO;
+  Timestamp deadline;
+  if (message.has_timeout_us())
   {
-    // FIXME: extract to a function
-    ErrorCode error = WRONG_PROTO;
-    if (services_)
+    deadline = Timestamp(receiveTime.microSecondsSinceEpoch() + message.timeout_us());
+  }
+  if (deadline.valid() && Timestamp::now() >= deadline)
+  {
+    // the client has given up, don't waste time on it
+    error = TIMEOUT;
+  }
+  else if (services_)
+  {
+    std::map<std::string, google::protobuf::Service*>::const_iterator it = services_->find(message.service());
+    if (it != services_->end())
     {
-      std::map<std::string, google::protobuf::Service*>::const_iterator it = services_->find(message.service());
-      if (it != services_->end())
+      google::protobuf::Service* service = it->second;
+      assert(service != NULL);
+      const google::protobuf::ServiceDescriptor* desc = service->GetDescriptor();
+      const google::protobuf::MethodDescriptor* method
+        = desc->FindMethodByName(message.method());
+      if (method)
       {
-        google::protobuf::Service* service = it->second;
-        assert(service != NULL);
-        const google::protobuf::ServiceDescriptor* desc = service->GetDescriptor();
-        const google::protobuf::MethodDescriptor* method
-          = desc->FindMethodByName(message.method());
-        if (method)
+        std::unique_ptr<google::protobuf::Message> request(service->GetRequestPrototype(method).New());
+        if (request->ParseFromArray(payload.data(), payload.size()))
         {
-          std::unique_ptr<google::protobuf::Message> request(service->GetRequestPrototype(method).New());
-          if (request->ParseFromString(message.request()))
+          // controller and response are deleted in doneCallback
+          RpcController* controller = new RpcController;
+          controller->id_ = message.id();
+          controller->deadline_ = deadline;
+          google::protobuf::Message* response = service->GetResponsePrototype(method).New();
+          const RpcMethodInfo* info = NULL;
+          if (methods_)
           {
-            google::protobuf::Message* response = service->GetResponsePrototype(method).New();
-            // response is deleted in doneCallback
-            int64_t id = message.id();
-            service->CallMethod(method, NULL, get_pointer(request), response,
-                                NewCallback(this, &RpcChannel::doneCallback, response, id));
-            error = NO_ERROR;
+            RpcMethodInfoMap::const_iterator found = methods_->find(method);
+            if (found != methods_->end())
+            {
+              info = &found->second;
+              controller->execTime_ = info->execTime;
+            }
+          }
+          error = NO_ERROR;
+          if (info && info->pool)
+          {
+            controller->startTime_ = Timestamp::now();
+            MessagePtr shared(request.release());
+            if (!info->pool->tryRun(std::bind(&RpcChannel::runQueued, shared_from_this(),
+                                              service, method, controller,
+                                              shared, response, info),
+                                    info->maxQueueSize))
+            {
+              info->rejected->increment();
+              delete controller;
+              delete response;
+              error = OVERLOADED;
+            }
           }
           else
           {
-            error = INVALID_REQUEST;
+            callMethod(service, method, controller, get_pointer(request), response);
           }
         }
         else
         {
-          error = NO_METHOD;
+          error = INVALID_REQUEST;
         }
       }
       else
       {
-        error = NO_SERVICE;
+        error = NO_METHOD;
       }
     }
     else
     {
       error = NO_SERVICE;
     }
-    if (error != NO_ERROR)
-    {
-      RpcMessage response;
-      response.set_type(RESPONSE);
-      response.set_id(message.id());
-      response.set_error(error);
-      codec_.send(conn_, response);
-    }
   }
-  else if (message.type() == ERROR)
+  else
+  {
+    error = NO_SERVICE;
+  }
+  if (error != NO_ERROR)
+  {
+    sendError(message.id(), error);
+  }
+}
+
+void RpcChannel::sendError(int64_t id, ErrorCode error)
+{
+  RpcMessage response;
+  response.set_type(RESPONSE);
+  response.set_id(id);
+  response.set_error(error);
+  send(&response, NULL);
+}
+
+void RpcChannel::callMethod(::google::protobuf::Service* service,
+                            const ::google::protobuf::MethodDescriptor* method,
+                            RpcController* controller,
+                            const ::google::protobuf::Message* request,
+                            ::google::protobuf::Message* response)
+{
+  controller->startTime_ = Timestamp::now();
+  service->CallMethod(method, controller, request, response,
+                      NewCallback(this, &RpcChannel::doneCallback, controller, response));
+}
+
+void RpcChannel::runQueued(::google::protobuf::Service* service,
+                           const ::google::protobuf::MethodDescriptor* method,
+                           RpcController* controller,
+                           const MessagePtr& request,
+                           ::google::protobuf::Message* response,
+                           const RpcMethodInfo* info)
+{
+  const Timestamp now = Timestamp::now();
+  info->queueTime->record(now.microSecondsSinceEpoch() - controller->startTime_.microSecondsSinceEpoch());
+  if (controller->IsCanceled())
   {
+    // timed out in the queue
+    sendError(controller->id_, TIMEOUT);
+    delete controller;
+    delete response;
+    return;
   }
+  callMethod(service, method, controller, get_pointer(request), response);
 }
 
-void RpcChannel::doneCallback(::google::protobuf::Message* response, int64_t id)
+void RpcChannel::doneCallback(RpcController* controller, ::google::protobuf::Message* response)
 {
+  std::unique_ptr<RpcController> c(controller);
   std::unique_ptr<google::protobuf::Message> d(response);
+  if (controller->execTime_)
+  {
+    controller->execTime_->record(Timestamp::now().microSecondsSinceEpoch()
+                                  - controller->startTime_.microSecondsSinceEpoch());
+  }
+  if (controller->IsCanceled())
+  {
+    LOG_DEBUG << "RpcChannel::doneCallback - drops response of timed out call "
+              << controller->id_;
+    return;
+  }
+  if (encoderPool_
+      && conn_->getLoop()->isInLoopThread()
+      && response->ByteSizeLong() >= encodeMinBytes_)
+  {
+    MessagePtr shared(d.release());
+    if (encoderPool_->tryRun(std::bind(&RpcChannel::sendResponse, shared_from_this(),
+                                       controller->id_, shared)))
+    {
+      return;
+    }
+    sendResponse(controller->id_, shared);  // pool is full
+    return;
+  }
   RpcMessage message;
   message.set_type(RESPONSE);
-  message.set_id(id);
-  message.set_response(response->SerializeAsString()); // FIXME: error check
-  codec_.send(conn_, message);
+  message.set_id(controller->id_);
+  send(&message, response);
 }
 
+void RpcChannel::sendResponse(int64_t id, const MessagePtr& response)
+{
+  RpcMessage message;
+  message.set_type(RESPONSE);
+  message.set_id(id);
+  send(&message, get_pointer(response));
+}
@@ -11,13 +11,16 @@
 #ifndef MUDUO_NET_PROTORPC_RPCCHANNEL_H
 #define MUDUO_NET_PROTORPC_RPCCHANNEL_H
 
-#include <muduo/base/Atomic.h>
 #include <muduo/base/Mutex.h>
+#include <muduo/net/Buffer.h>
 #include <muduo/net/protorpc/RpcCodec.h>
+#include <muduo/net/protorpc/rpc.pb.h>
 
 #include <google/protobuf/service.h>
 
+#include <atomic>
 #include <map>
+#include <vector>
 
 // Service and RpcChannel classes are incorporated from
 // google/protobuf/service.h
@@ -73,6 +76,29 @@ class Service;
 }  // namespace protobuf
 }  // namespace google
 
+namespace muduo
+{
+class Counter;
+class Histogram;
+class ThreadPool;
+
+namespace net
+{
+class RpcController;
+
+// how RpcServer runs a method, see RpcServer::setThreadPool()
+struct RpcMethodInfo
+{
+  ThreadPool* pool;      // NULL to run in the IO thread
+  size_t maxQueueSize;   // calls waiting for pool, more are rejected
+  Histogram* queueTime;  // microseconds waiting for pool
+  Histogram* execTime;   // microseconds from CallMethod() to done
+  Counter* rejected;     // as pool is full
+};
+typedef std::map<const ::google::protobuf::MethodDescriptor*, RpcMethodInfo> RpcMethodInfoMap;
+}  // namespace net
+}  // namespace muduo
+
 
 namespace muduo
 {
@@ -88,7 +114,12 @@ namespace net
 //   RpcChannel* channel = new MyRpcChannel("remotehost.example.com:1234");
 //   MyService* service = new MyService::Stub(channel);
 //   service->MyMethod(request, &response, callback);
-class RpcChannel : public ::google::protobuf::RpcChannel
+//
+// A channel must be owned by a RpcChannelPtr, the timer of call timeouts
+// and the threads of RpcServer::setThreadPool() refer to it by
+// shared_from_this().
+class RpcChannel : public ::google::protobuf::RpcChannel,
+                   public std::enable_shared_from_this<RpcChannel>
 {
  public:
   RpcChannel();
@@ -107,11 +138,78 @@ class RpcChannel : public ::google::protobuf::RpcChannel
     services_ = services;
   }
 
+  void setMethods(const RpcMethodInfoMap* methods)
+  {
+    methods_ = methods;
+  }
+
+  // Sends requests and responses in "RPC1" frames once the peer says it
+  // accepts them, saves copying payloads into RpcMessage on both ends.
+  // Off by default, as proxies parsing "RPC0" frames can not relay them.
+  // Not thread safe, call before sending anything.
+  void setRawPayload(bool on)
+  {
+    rawPayload_ = on;
+  }
+
+  bool rawPayload() const
+  {
+    return rawPayload_ && peerRawPayload_.load(std::memory_order_relaxed);
+  }
+
+  // Checksums raw frames by CRC-32C ("RPC2") instead of adler32 once the
+  // peer does too.  On by default if the CPU has a crc32 instruction.
+  // Not thread safe, call before sending anything.
+  void setCrc32c(bool on)
+  {
+    crc32c_ = on;
+  }
+
+  bool crc32c() const
+  {
+    return crc32c_ && peerCrc32c_.load(std::memory_order_relaxed);
+  }
+
+  // Responses of at least minBytes done in the IO thread are serialized
+  // and checksummed in pool, the framed buffer is then handed back to
+  // the IO thread.  Requests are always framed by the caller of
+  // CallMethod(), as the caller owns them.  pool must outlive the channel.
+  void setEncoderPool(ThreadPool* pool, size_t minBytes)
+  {
+    encoderPool_ = pool;
+    encodeMinBytes_ = minBytes;
+  }
+
+  // Timeout of calls without a RpcController::setTimeout(),
+  // 0 means waiting forever, which is the default.
+  // Expired calls run done with RpcController::errorCode() being TIMEOUT,
+  // and the server skips them if not started yet.
+  void setDefaultTimeout(double seconds)
+  {
+    defaultTimeout_ = seconds;
+  }
+
+  double defaultTimeout() const
+  {
+    return defaultTimeout_;
+  }
+
+  // calls waiting for responses, for load balancing
+  int outstandingCalls() const
+  {
+    return outstandingCalls_.load(std::memory_order_relaxed);
+  }
+
+  // Runs done of all outstanding calls with error, eg. UNAVAILABLE
+  // when the connection is lost.  Thread safe.
+  void failAll(ErrorCode error);
+
   // Call the given method of the remote service.  The signature of this
   // procedure looks the same as Service::CallMethod(), but the requirements
   // are less strict in one important way:  the request and response objects
   // need not be of any specific class as long as their descriptors are
   // method->input_type() and method->output_type().
+  // If the connection is lost, done runs with UNAVAILABLE before returning.
   void CallMethod(const ::google::protobuf::MethodDescriptor* method,
                   ::google::protobuf::RpcController* controller,
                   const ::google::protobuf::Message* request,
@@ -127,22 +225,96 @@ class RpcChannel : public ::google::protobuf::RpcChannel
                     const RpcMessagePtr& messagePtr,
                     Timestamp receiveTime);
 
-  void doneCallback(::google::protobuf::Message* response, int64_t id);
+  bool onRawMessage(const TcpConnectionPtr& conn,
+                    StringPiece frame,
+                    Timestamp receiveTime);
+
+  // payload is request or response, depends on message.type()
+  void handleMessage(const RpcMessage& message, StringPiece payload,
+                     Timestamp receiveTime);
+  void handleResponse(const RpcMessage& message, StringPiece payload);
+  void handleRequest(const RpcMessage& message, StringPiece payload,
+                     Timestamp receiveTime);
+  void send(RpcMessage* message, const ::google::protobuf::Message* payload);
+
+  void callMethod(::google::protobuf::Service* service,
+                  const ::google::protobuf::MethodDescriptor* method,
+                  RpcController* controller,
+                  const ::google::protobuf::Message* request,
+                  ::google::protobuf::Message* response);
+  // in a thread of RpcMethodInfo::pool
+  void runQueued(::google::protobuf::Service* service,
+                 const ::google::protobuf::MethodDescriptor* method,
+                 RpcController* controller,
+                 const MessagePtr& request,
+                 ::google::protobuf::Message* response,
+                 const RpcMethodInfo* info);
+  void doneCallback(RpcController* controller, ::google::protobuf::Message* response);
+  // in a thread of encoderPool_
+  void sendResponse(int64_t id, const MessagePtr& response);
+  void sendError(int64_t id, ErrorCode error);
+  void flushResponses();
 
   struct OutstandingCall
   {
     ::google::protobuf::Message* response;
     ::google::protobuf::Closure* done;
+    RpcController* controller;  // NULL if not a muduo RpcController
+    int64_t deadline;  // microseconds since epoch, 0 for none
   };
 
+  struct OutstandingSlot
+  {
+    int64_t id;  // 0 if empty
+    OutstandingCall call;
+  };
+
+  // outstandings_ is an open addressing table with linear probing,
+  // the home slot of an id is id & (size - 1).
+  void addOutstanding(int64_t id, const OutstandingCall& out) REQUIRES(mutex_);
+  // index in outstandings_, or its size if finished already
+  size_t findOutstanding(int64_t id) const REQUIRES(mutex_);
+  // returns false if finished already
+  bool takeOutstanding(int64_t id, OutstandingCall* out) REQUIRES(mutex_);
+
+  // the timing wheel is driven by a timer in the loop of conn_,
+  // which is armed as long as some calls have a deadline.
+  void addToWheel(int64_t id, int64_t deadline) REQUIRES(mutex_);
+  static void onTimeoutTick(const std::weak_ptr<RpcChannel>& weakChannel);
+  void expireTimeouts();
+  static void finishCall(const OutstandingCall& out, const RpcMessage* message,
+                         StringPiece payload);
+
   RpcCodec codec_;
   TcpConnectionPtr conn_;
-  AtomicInt64 id_;
 
   MutexLock mutex_;
-  std::map<int64_t, OutstandingCall> outstandings_ GUARDED_BY(mutex_);
+  // Ids are assigned in order, so calls in flight mostly sit in their home
+  // slots, a flat array without allocation per call.  Slots are freed once
+  // calls finish, so a call that never gets a response holds only its own.
+  // A power of two, at least twice outstandingCalls_.
+  std::vector<OutstandingSlot> outstandings_ GUARDED_BY(mutex_);
+  int64_t nextId_ GUARDED_BY(mutex_);
+  // ids bucketed by deadline tick, a call can be in only one bucket
+  std::vector<std::vector<int64_t>> wheel_ GUARDED_BY(mutex_);
+  int64_t lastTick_ GUARDED_BY(mutex_);
+  int timedCalls_ GUARDED_BY(mutex_);
+  std::atomic<int> outstandingCalls_;
+  bool timerArmed_ GUARDED_BY(mutex_);
+  double defaultTimeout_;
+
+  // responses from pool threads, sent in one go by the IO thread
+  MutexLock responseMutex_;
+  Buffer responses_ GUARDED_BY(responseMutex_);
 
   const std::map<std::string, ::google::protobuf::Service*>* services_;
+  const RpcMethodInfoMap* methods_;
+  bool rawPayload_;
+  std::atomic<bool> peerRawPayload_;
+  bool crc32c_;
+  std::atomic<bool> peerCrc32c_;
+  ThreadPool* encoderPool_;
+  size_t encodeMinBytes_;
 };
 typedef std::shared_ptr<RpcChannel> RpcChannelPtr;
 
@@ -0,0 +1,382 @@
+#include <muduo/net/protorpc/RpcChannel.h>
+#include <muduo/net/protorpc/RpcController.h>
+#include <muduo/net/protorpc/RpcServer.h>
+#include <muduo/net/protorpc/rpctest.pb.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/SocketsOps.h>
+#include <muduo/net/TcpClient.h>
+
+//#define BOOST_TEST_MODULE RpcChannelTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+
+uint16_t freePort()
+{
+  int sockfd = sockets::createNonblockingOrDie(AF_INET);
+  sockets::bindOrDie(sockfd, InetAddress(0, true).getSockAddr());
+  const uint16_t port = InetAddress(sockets::getLocalAddr(sockfd)).toPort();
+  sockets::close(sockfd);
+  return port;
+}
+
+void runUntil(EventLoop* loop, const std::function<bool()>& done)
+{
+  TimerId poll = loop->runEvery(0.01, [loop, done] { if (done()) loop->quit(); });
+  TimerId timeout = loop->runAfter(5.0, [] { LOG_FATAL << "timeout"; });
+  loop->loop();
+  loop->cancel(poll);
+  loop->cancel(timeout);
+}
+
+// Answers after delay_ms whether or not the client has given up,
+// never answers "never", unlike RpcServer.
+class StubServer
+{
+ public:
+  StubServer(EventLoop* loop, const InetAddress& listenAddr)
+    : loop_(loop),
+      server_(loop, listenAddr, "StubServer"),
+      codec_(std::bind(&StubServer::onRpcMessage, this, _1, _2, _3)),
+      requests_(0)
+  {
+    server_.setMessageCallback(std::bind(&RpcCodec::onMessage, &codec_, _1, _2, _3));
+    server_.start();
+  }
+
+  int requests() const { return requests_; }
+  size_t numConnections() const { return server_.numConnections(); }
+
+ private:
+  void onRpcMessage(const TcpConnectionPtr& conn, const RpcMessagePtr& message, Timestamp)
+  {
+    ++requests_;
+    rpctest::EchoRequest request;
+    BOOST_REQUIRE(request.ParseFromString(message->request()));
+    if (request.payload() != "never")
+    {
+      loop_->runAfter(request.delay_ms() / 1000.0,
+                      std::bind(&StubServer::reply, this, conn, message->id(), request.payload()));
+    }
+  }
+
+  void reply(const TcpConnectionPtr& conn, int64_t id, const string& payload)
+  {
+    rpctest::EchoResponse response;
+    response.set_payload(payload);
+    RpcMessage message;
+    message.set_type(RESPONSE);
+    message.set_id(id);
+    message.set_response(response.SerializeAsString());
+    Buffer buf;
+    codec_.fillEmptyBuffer(&buf, message);
+    conn->send(&buf);
+  }
+
+  EventLoop* loop_;
+  TcpServer server_;
+  RpcCodec codec_;
+  int requests_;
+};
+
+class Client
+{
+ public:
+  Client(EventLoop* loop, const InetAddress& serverAddr)
+    : client_(loop, serverAddr, "RpcClient"),
+      channel_(new RpcChannel),
+      stub_(get_pointer(channel_)),
+      up_(false)
+  {
+    client_.setConnectionCallback(std::bind(&Client::onConnection, this, _1));
+    client_.setMessageCallback(
+        std::bind(&RpcChannel::onMessage, get_pointer(channel_), _1, _2, _3));
+    client_.connect();
+  }
+
+  const RpcChannelPtr& channel() const { return channel_; }
+  rpctest::EchoService::Stub& stub() { return stub_; }
+  bool up() const { return up_; }
+
+  void disconnect() { client_.disconnect(); }
+
+ private:
+  void onConnection(const TcpConnectionPtr& conn)
+  {
+    up_ = conn->connected();
+    if (conn->connected())
+    {
+      channel_->setConnection(conn);
+    }
+    else
+    {
+      channel_->failAll(UNAVAILABLE);
+    }
+  }
+
+  TcpClient client_;
+  RpcChannelPtr channel_;
+  rpctest::EchoService::Stub stub_;
+  bool up_;
+};
+
+struct Result
+{
+  Result() : runs(0), error(NO_ERROR) { }
+
+  void done(RpcController* controller, rpctest::EchoResponse* response)
+  {
+    ++runs;
+    error = controller->errorCode();
+    payload = response->payload();
+    finished = Timestamp::now();
+  }
+
+  int runs;
+  ErrorCode error;
+  string payload;
+  Timestamp finished;
+};
+
+void call(Client* client, const string& payload, int delayMs, double timeout,
+          RpcController* controller, Result* result)
+{
+  rpctest::EchoRequest request;
+  request.set_payload(payload);
+  request.set_delay_ms(delayMs);
+  controller->setTimeout(timeout);
+  rpctest::EchoResponse* response = new rpctest::EchoResponse;
+  client->stub().Echo(controller, &request, response,
+                      NewCallback(result, &Result::done, controller, response));
+}
+
+void shutdown(EventLoop* loop, Client* client)
+{
+  client->disconnect();
+  runUntil(loop, [client] { return !client->up(); });
+}
+
+BOOST_AUTO_TEST_CASE(testTimeout)
+{
+  EventLoop loop;
+  const InetAddress addr(freePort(), true);
+  StubServer server(&loop, addr);
+  Client client(&loop, addr);
+  runUntil(&loop, [&client] { return client.up(); });
+
+  RpcController fast, slow;
+  Result fastResult, slowResult;
+  const Timestamp start = Timestamp::now();
+  call(&client, "fast", 10, 1.0, &fast, &fastResult);
+  call(&client, "slow", 300, 0.1, &slow, &slowResult);
+  BOOST_CHECK_EQUAL(client.channel()->outstandingCalls(), 2);
+  runUntil(&loop, [&] { return fastResult.runs == 1 && slowResult.runs == 1; });
+
+  BOOST_CHECK_EQUAL(fastResult.error, NO_ERROR);
+  BOOST_CHECK_EQUAL(fastResult.payload, "fast");
+  BOOST_CHECK_EQUAL(slowResult.error, TIMEOUT);
+  BOOST_CHECK(slow.Failed());
+  const double elapsed = timeDifference(slowResult.finished, start);
+  BOOST_CHECK_GE(elapsed, 0.1);
+  BOOST_CHECK_LT(elapsed, 0.3);
+  BOOST_CHECK_EQUAL(client.channel()->outstandingCalls(), 0);
+
+  // the late response of "slow" is dropped, done ran once
+  runUntil(&loop, [&start] { return timeDifference(Timestamp::now(), start) > 0.4; });
+  BOOST_CHECK_EQUAL(slowResult.runs, 1);
+  BOOST_CHECK_EQUAL(slowResult.error, TIMEOUT);
+
+  // and the channel still works
+  RpcController again;
+  Result againResult;
+  call(&client, "again", 0, 1.0, &again, &againResult);
+  runUntil(&loop, [&againResult] { return againResult.runs == 1; });
+  BOOST_CHECK_EQUAL(againResult.error, NO_ERROR);
+  BOOST_CHECK_EQUAL(againResult.payload, "again");
+
+  shutdown(&loop, &client);
+}
+
+BOOST_AUTO_TEST_CASE(testDefaultTimeout)
+{
+  EventLoop loop;
+  const InetAddress addr(freePort(), true);
+  StubServer server(&loop, addr);
+  Client client(&loop, addr);
+  client.channel()->setDefaultTimeout(0.05);
+  runUntil(&loop, [&client] { return client.up(); });
+
+  RpcController controller;
+  Result result;
+  call(&client, "never", 0, 0, &controller, &result);
+  runUntil(&loop, [&result] { return result.runs == 1; });
+  BOOST_CHECK_EQUAL(result.error, TIMEOUT);
+  BOOST_CHECK_EQUAL(client.channel()->outstandingCalls(), 0);
+
+  shutdown(&loop, &client);
+}
+
+BOOST_AUTO_TEST_CASE(testUnansweredCall)
+{
+  EventLoop loop;
+  const InetAddress addr(freePort(), true);
+  StubServer server(&loop, addr);
+  Client client(&loop, addr);
+  runUntil(&loop, [&client] { return client.up(); });
+
+  // a call without deadline which is never answered
+  // does not hold the calls after it
+  RpcController never;
+  Result neverResult;
+  call(&client, "never", 0, 0, &never, &neverResult);
+  const int kCalls = 1000;
+  std::vector<RpcController> controllers(kCalls);
+  std::vector<Result> results(kCalls);
+  for (int i = 0; i < kCalls; ++i)
+  {
+    call(&client, "x", 0, 0, &controllers[i], &results[i]);
+  }
+  runUntil(&loop, [&server] { return server.requests() == kCalls + 1; });
+  runUntil(&loop, [&client] { return client.channel()->outstandingCalls() == 1; });
+  for (const Result& result : results)
+  {
+    BOOST_CHECK_EQUAL(result.runs, 1);
+  }
+
+  // fails with the connection
+  shutdown(&loop, &client);
+  BOOST_CHECK_EQUAL(neverResult.runs, 1);
+  BOOST_CHECK_EQUAL(neverResult.error, UNAVAILABLE);
+  BOOST_CHECK_EQUAL(client.channel()->outstandingCalls(), 0);
+  runUntil(&loop, [&server] { return server.numConnections() == 0; });
+}
+
+BOOST_AUTO_TEST_CASE(testOutOfOrder)
+{
+  EventLoop loop;
+  const InetAddress addr(freePort(), true);
+  StubServer server(&loop, addr);
+  Client client(&loop, addr);
+  runUntil(&loop, [&client] { return client.up(); });
+
+  // Responses in shuffled order, in rounds, so ids wrap around the table
+  // of outstanding calls many times and collide with the calls never
+  // answered, a few per round.
+  const int kRounds = 40;
+  const int kCalls = 500;
+  std::vector<RpcController> nevers(kRounds * 3);
+  std::vector<Result> neverResults(nevers.size());
+  for (int round = 0; round < kRounds; ++round)
+  {
+    std::vector<RpcController> controllers(kCalls);
+    std::vector<Result> results(kCalls);
+    for (int i = 0; i < kCalls; ++i)
+    {
+      if (i % 200 == round % 200)
+      {
+        const size_t n = round * 3 + i / 200;
+        call(&client, "never", 0, 0, &nevers[n], &neverResults[n]);
+      }
+      else
+      {
+        call(&client, std::to_string(i), (i * 7919 + round) % 20, 0,
+             &controllers[i], &results[i]);
+      }
+    }
+    const int never = (round + 1) * 3;
+    runUntil(&loop, [&] { return client.channel()->outstandingCalls() == never; });
+    for (int i = 0; i < kCalls; ++i)
+    {
+      if (i % 200 != round % 200)
+      {
+        BOOST_CHECK_EQUAL(results[i].runs, 1);
+        BOOST_CHECK_EQUAL(results[i].payload, std::to_string(i));
+      }
+    }
+  }
+  BOOST_CHECK_EQUAL(server.requests(), kRounds * kCalls);
+
+  // fail with the connection
+  shutdown(&loop, &client);
+  for (const Result& result : neverResults)
+  {
+    BOOST_CHECK_EQUAL(result.runs, 1);
+    BOOST_CHECK_EQUAL(result.error, UNAVAILABLE);
+  }
+  BOOST_CHECK_EQUAL(client.channel()->outstandingCalls(), 0);
+  runUntil(&loop, [&server] { return server.numConnections() == 0; });
+}
+
+class EchoServiceImpl : public rpctest::EchoService
+{
+ public:
+  explicit EchoServiceImpl(EventLoop* loop)
+    : loop_(loop), canceled_(0), notified_(0)
+  {
+  }
+
+  void Echo(::google::protobuf::RpcController* controller,
+            const rpctest::EchoRequest* request,
+            rpctest::EchoResponse* response,
+            ::google::protobuf::Closure* done) override
+  {
+    controller->NotifyOnCancel(NewCallback(this, &EchoServiceImpl::onCancel));
+    response->set_payload(request->payload());
+    loop_->runAfter(request->delay_ms() / 1000.0,
+                    std::bind(&EchoServiceImpl::reply, this, controller, done));
+  }
+
+  int canceled() const { return canceled_; }
+  int notified() const { return notified_; }
+
+ private:
+  void reply(::google::protobuf::RpcController* controller, ::google::protobuf::Closure* done)
+  {
+    if (controller->IsCanceled())
+    {
+      ++canceled_;
+    }
+    done->Run();
+  }
+
+  void onCancel()
+  {
+    ++notified_;
+  }
+
+  EventLoop* loop_;
+  int canceled_;
+  int notified_;
+};
+
+BOOST_AUTO_TEST_CASE(testServerCancel)
+{
+  EventLoop loop;
+  const InetAddress addr(freePort(), true);
+  EchoServiceImpl impl(&loop);
+  RpcServer server(&loop, addr);
+  server.registerService(&impl);
+  server.start();
+  Client client(&loop, addr);
+  runUntil(&loop, [&client] { return client.up(); });
+
+  RpcController fast, slow;
+  Result fastResult, slowResult;
+  call(&client, "fast", 0, 1.0, &fast, &fastResult);
+  call(&client, "slow", 100, 0.05, &slow, &slowResult);
+  runUntil(&loop, [&impl] { return impl.notified() == 2; });
+
+  // the server sees the deadline of the client
+  BOOST_CHECK_EQUAL(impl.canceled(), 1);
+  BOOST_CHECK_EQUAL(fastResult.runs, 1);
+  BOOST_CHECK_EQUAL(fastResult.payload, "fast");
+  BOOST_CHECK_EQUAL(slowResult.runs, 1);
+  BOOST_CHECK_EQUAL(slowResult.error, TIMEOUT);
+
+  shutdown(&loop, &client);
+}
@@ -0,0 +1,484 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include <muduo/net/protorpc/RpcClientPool.h>
+
+#include <muduo/base/CountDownLatch.h>
+#include <muduo/base/CurrentThread.h>
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/EventLoopThreadPool.h>
+#include <muduo/net/TcpClient.h>
+#include <muduo/net/protorpc/RpcController.h>
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/message.h>
+
+#include <limits>
+
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+__thread uint32_t t_seed = 0;
+// the Attempt in RpcChannel::CallMethod() of this thread, its done runs
+// in there only if the connection was lost before sending
+__thread const void* t_sending = NULL;
+
+// xorshift32, good enough for picking two channels
+uint32_t fastRandom()
+{
+  if (t_seed == 0)
+  {
+    t_seed = static_cast<uint32_t>(CurrentThread::tid()) * 2654435761u | 1;
+  }
+  t_seed ^= t_seed << 13;
+  t_seed ^= t_seed >> 17;
+  t_seed ^= t_seed << 5;
+  return t_seed;
+}
+
+bool retryable(ErrorCode error)
+{
+  return error == TIMEOUT || error == OVERLOADED || error == UNAVAILABLE;
+}
+
+}  // namespace
+
+struct RpcClientPool::Connection
+{
+  int backend;  // index of backends_
+  EventLoop* loop;
+  std::unique_ptr<TcpClient> client;
+  // NULL if not connected, accessed with std::atomic_load and std::atomic_store
+  RpcChannelPtr channel;
+  double defaultTimeout;
+  bool rawPayload;
+};
+
+struct RpcClientPool::Call
+{
+  const ::google::protobuf::MethodDescriptor* method;
+  // NULL after sending, unless owned for retries
+  const ::google::protobuf::Message* request;
+  std::unique_ptr< ::google::protobuf::Message> ownedRequest;
+  ::google::protobuf::Message* response;
+  ::google::protobuf::Closure* done;
+  RpcController* controller;  // of the caller, may be NULL
+  double timeout;
+  Policy policy;
+
+  MutexLock mutex;
+  int attempts GUARDED_BY(mutex);
+  int unsent GUARDED_BY(mutex);  // attempts on connections lost before sending
+  int inFlight GUARDED_BY(mutex);
+  bool finished GUARDED_BY(mutex);
+  int lastBackend GUARDED_BY(mutex);  // retries and hedges go elsewhere
+};
+
+struct RpcClientPool::Attempt
+{
+  CallPtr call;
+  RpcController controller;
+  ::google::protobuf::Message* response;  // deleted by RpcChannel after done
+};
+
+RpcClientPool::RpcClientPool(EventLoop* loop, const string& name)
+  : loop_(CHECK_NOTNULL(loop)),
+    name_(name),
+    threadPool_(new EventLoopThreadPool(loop, name)),
+    connectionsPerBackend_(1),
+    balance_(kLeastOutstanding),
+    defaultTimeout_(0),
+    rawPayload_(false),
+    self_(new RpcClientPool*(this))
+{
+}
+
+RpcClientPool::~RpcClientPool()
+{
+  LOG_TRACE << "RpcClientPool::~RpcClientPool [" << name_ << "] destructing";
+  loop_->assertInLoopThread();
+  // The channel in the context of a connection holds it, so ~TcpClient
+  // would leave it open.  Closes them in their loops like ~TcpServer,
+  // and waits, as those loops may quit right after.
+  std::vector<TcpConnectionPtr> conns;
+  for (const ConnectionPtr& connection : connections_)
+  {
+    TcpConnectionPtr conn(connection->client->connection());
+    if (conn)
+    {
+      conns.push_back(conn);
+    }
+  }
+  CountDownLatch latch(static_cast<int>(conns.size()));
+  for (const TcpConnectionPtr& conn : conns)
+  {
+    conn->getLoop()->runInLoop([conn, &latch]
+                               {
+                                 // unless closed by the peer meanwhile
+                                 if (conn->connected())
+                                   conn->connectDestroyed();
+                                 latch.countDown();
+                               });
+  }
+  latch.wait();
+}
+
+void RpcClientPool::addBackend(const InetAddress& addr)
+{
+  backends_.push_back(addr);
+}
+
+void RpcClientPool::setThreadNum(int numThreads)
+{
+  threadPool_->setThreadNum(numThreads);
+}
+
+void RpcClientPool::setIdempotent(const string& methodFullName, int maxAttempts,
+                                  double hedgeDelay)
+{
+  Policy policy = { std::max(maxAttempts, 1), hedgeDelay };
+  idempotents_[methodFullName] = policy;
+}
+
+void RpcClientPool::start()
+{
+  loop_->assertInLoopThread();
+  assert(connections_.empty());
+  threadPool_->start();
+  for (size_t b = 0; b < backends_.size(); ++b)
+  {
+    const InetAddress& addr = backends_[b];
+    for (int i = 0; i < connectionsPerBackend_; ++i)
+    {
+      char buf[64];
+      snprintf(buf, sizeof buf, "%s-%s#%d", name_.c_str(), addr.toIpPort().c_str(), i);
+      ConnectionPtr conn(new Connection);
+      conn->backend = static_cast<int>(b);
+      conn->loop = threadPool_->getNextLoop();
+      conn->client.reset(new TcpClient(conn->loop, addr, buf));
+      conn->client->setConnectionCallback(
+          std::bind(&RpcClientPool::onConnection, std::weak_ptr<Connection>(conn), _1));
+      conn->client->enableRetry();
+      conn->defaultTimeout = defaultTimeout_;
+      conn->rawPayload = rawPayload_;
+      connections_.push_back(conn);
+    }
+  }
+  for (const ConnectionPtr& conn : connections_)
+  {
+    conn->client->connect();
+  }
+}
+
+int RpcClientPool::connectedChannels() const
+{
+  int count = 0;
+  for (const ConnectionPtr& conn : connections_)
+  {
+    if (std::atomic_load(&conn->channel))
+    {
+      ++count;
+    }
+  }
+  return count;
+}
+
+void RpcClientPool::onConnection(const std::weak_ptr<Connection>& weakConn,
+                                 const TcpConnectionPtr& conn)
+{
+  ConnectionPtr connection(weakConn.lock());
+  if (!connection)
+  {
+    // the pool is gone
+    if (!conn->connected())
+    {
+      conn->setContext(RpcChannelPtr());
+    }
+    return;
+  }
+  LOG_INFO << "RpcClientPool - " << conn->name() << " is "
+           << (conn->connected() ? "UP" : "DOWN");
+  if (conn->connected())
+  {
+    conn->setTcpNoDelay(true);
+    RpcChannelPtr channel(new muduo::net::RpcChannel(conn));
+    channel->setDefaultTimeout(connection->defaultTimeout);
+    channel->setRawPayload(connection->rawPayload);
+    conn->setMessageCallback(
+        std::bind(&muduo::net::RpcChannel::onMessage, get_pointer(channel), _1, _2, _3));
+    // outlives the Connection, as long as messages may arrive
+    conn->setContext(channel);
+    std::atomic_store(&connection->channel, channel);
+  }
+  else
+  {
+    RpcChannelPtr channel(std::atomic_exchange(&connection->channel, RpcChannelPtr()));
+    if (channel)
+    {
+      // retries go to other connections
+      channel->failAll(UNAVAILABLE);
+    }
+    // the channel holds conn
+    conn->setContext(RpcChannelPtr());
+  }
+}
+
+RpcChannelPtr RpcClientPool::pick(int excludeBackend, int* backend, EventLoop** loop)
+{
+  const size_t n = connections_.size();
+  RpcChannelPtr best;
+  int bestLoad = std::numeric_limits<int>::max();
+  if (n == 0)
+  {
+    return best;
+  }
+
+  if (balance_ == kPowerOfTwoChoices && n > 2)
+  {
+    for (int i = 0; i < 2; ++i)
+    {
+      const Connection& conn = *connections_[fastRandom() % n];
+      RpcChannelPtr channel(std::atomic_load(&conn.channel));
+      if (channel && conn.backend != excludeBackend && channel->outstandingCalls() < bestLoad)
+      {
+        bestLoad = channel->outstandingCalls();
+        best = channel;
+        *backend = conn.backend;
+        *loop = conn.loop;
+      }
+    }
+    if (best)
+    {
+      return best;
+    }
+    // both are down or excluded, falls back to a full scan
+  }
+
+  // starts from a random one, so ties are spread
+  const size_t start = fastRandom() % n;
+  RpcChannelPtr excluded;
+  const Connection* excludedConn = NULL;
+  for (size_t i = 0; i < n; ++i)
+  {
+    const Connection& conn = *connections_[(start + i) % n];
+    RpcChannelPtr channel(std::atomic_load(&conn.channel));
+    if (!channel)
+    {
+      continue;
+    }
+    const int load = channel->outstandingCalls();
+    if (conn.backend == excludeBackend)
+    {
+      if (!excluded || load < excluded->outstandingCalls())
+      {
+        excluded = channel;
+        excludedConn = &conn;
+      }
+      continue;
+    }
+    if (load < bestLoad)
+    {
+      bestLoad = load;
+      best = channel;
+      *backend = conn.backend;
+      *loop = conn.loop;
+      if (load == 0)
+      {
+        break;
+      }
+    }
+  }
+  if (!best && excluded)
+  {
+    // the only backend connected
+    best = excluded;
+    *backend = excludedConn->backend;
+    *loop = excludedConn->loop;
+  }
+  return best;
+}
+
+void RpcClientPool::CallMethod(const ::google::protobuf::MethodDescriptor* method,
+                               ::google::protobuf::RpcController* controller,
+                               const ::google::protobuf::Message* request,
+                               ::google::protobuf::Message* response,
+                               ::google::protobuf::Closure* done)
+{
+  CallPtr call(new Call);
+  call->method = method;
+  call->response = response;
+  call->done = done;
+  call->controller = dynamic_cast<RpcController*>(controller);
+  call->timeout = call->controller && call->controller->timeout() > 0
+      ? call->controller->timeout() : defaultTimeout_;
+  call->attempts = 0;
+  call->unsent = 0;
+  call->inFlight = 0;
+  call->finished = false;
+  call->lastBackend = -1;
+
+  std::map<string, Policy>::const_iterator it = idempotents_.find(method->full_name());
+  if (it != idempotents_.end() && it->second.maxAttempts > 1)
+  {
+    call->policy = it->second;
+    // kept for later attempts, the caller may free request after we return
+    call->ownedRequest.reset(request->New());
+    call->ownedRequest->CopyFrom(*request);
+    call->request = get_pointer(call->ownedRequest);
+  }
+  else
+  {
+    Policy once = { 1, 0 };
+    call->policy = once;
+    call->request = request;
+  }
+  sendAttempt(call);
+}
+
+void RpcClientPool::sendAttempt(const CallPtr& call)
+{
+  EventLoop* loop = NULL;
+  int lastBackend = -1;
+  {
+  MutexLockGuard lock(call->mutex);
+  lastBackend = call->lastBackend;
+  }
+  int backend = -1;
+  RpcChannelPtr channel(pick(lastBackend, &backend, &loop));
+
+  bool hedging = false;
+  bool unavailable = false;
+  {
+  MutexLockGuard lock(call->mutex);
+  if (channel)
+  {
+    ++call->attempts;
+    ++call->inFlight;
+    call->lastBackend = backend;
+    hedging = call->attempts == 1 && call->policy.hedgeDelay > 0;
+  }
+  else if (!call->finished && call->inFlight == 0)
+  {
+    call->finished = true;
+    unavailable = true;
+  }
+  }
+
+  if (unavailable)
+  {
+    finish(call, UNAVAILABLE);
+    return;
+  }
+  if (!channel)
+  {
+    return;  // others in flight
+  }
+
+  if (hedging)
+  {
+    loop_->runAfter(call->policy.hedgeDelay,
+                    std::bind(&RpcClientPool::hedge, std::weak_ptr<RpcClientPool*>(self_), call));
+  }
+  Attempt* attempt = new Attempt;
+  attempt->call = call;
+  attempt->controller.setTimeout(call->timeout);
+  attempt->response = call->response->New();
+  const void* outer = t_sending;
+  t_sending = attempt;
+  channel->CallMethod(call->method, &attempt->controller, call->request, attempt->response,
+                      NewCallback(this, &RpcClientPool::onAttemptDone, attempt));
+  t_sending = outer;
+  if (!call->ownedRequest)
+  {
+    call->request = NULL;  // not ours, never sent again
+  }
+}
+
+void RpcClientPool::onAttemptDone(Attempt* attempt)
+{
+  std::unique_ptr<Attempt> d(attempt);
+  CallPtr call(attempt->call);
+  const ErrorCode error = attempt->controller.errorCode();
+  // never sent, so safe to retry even if not idempotent
+  const bool unsent = attempt == t_sending;
+  bool retry = false;
+  bool finished = false;
+  {
+  MutexLockGuard lock(call->mutex);
+  --call->inFlight;
+  if (call->finished)
+  {
+    return;  // the other attempt won
+  }
+  if (unsent)
+  {
+    --call->attempts;
+    ++call->unsent;
+  }
+  if (error == NO_ERROR)
+  {
+    finished = true;
+    call->response->GetReflection()->Swap(call->response, attempt->response);
+  }
+  else if (unsent && call->unsent < static_cast<int>(connections_.size()))
+  {
+    retry = true;  // fails over to another connection
+  }
+  else if (call->attempts < call->policy.maxAttempts && retryable(error))
+  {
+    retry = true;
+  }
+  else if (call->inFlight == 0)
+  {
+    finished = true;
+  }
+  call->finished = finished;
+  }
+
+  if (retry)
+  {
+    LOG_DEBUG << "RpcClientPool::onAttemptDone - retries " << call->method->full_name()
+              << " after " << ErrorCode_Name(error);
+    sendAttempt(call);
+  }
+  else if (finished)
+  {
+    finish(call, error);
+  }
+}
+
+void RpcClientPool::hedge(const std::weak_ptr<RpcClientPool*>& weakSelf, const CallPtr& call)
+{
+  std::shared_ptr<RpcClientPool*> self(weakSelf.lock());
+  if (!self)
+  {
+    return;
+  }
+  {
+  MutexLockGuard lock(call->mutex);
+  if (call->finished || call->attempts >= call->policy.maxAttempts)
+  {
+    return;
+  }
+  }
+  (*self)->sendAttempt(call);
+}
+
+void RpcClientPool::finish(const CallPtr& call, ErrorCode error)
+{
+  std::unique_ptr< ::google::protobuf::Message> d(call->response);
+  if (error != NO_ERROR && call->controller)
+  {
+    call->controller->setErrorCode(error);
+  }
+  if (call->done)
+  {
+    call->done->Run();
+  }
+}
@@ -0,0 +1,115 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_PROTORPC_RPCCLIENTPOOL_H
+#define MUDUO_NET_PROTORPC_RPCCLIENTPOOL_H
+
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/protorpc/RpcChannel.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace muduo
+{
+namespace net
+{
+
+class EventLoop;
+class EventLoopThreadPool;
+
+///
+/// Client side RpcChannel over many connections to many backends.
+///
+/// Keeps N connections to each backend, spread over the loops of
+/// setThreadNum(), which reconnect with the backoff of Connector.
+/// Each call goes to the connected channel with least outstanding
+/// calls, or the better of two random ones (P2C) for large pools.
+/// Calls of idempotent methods may be retried or hedged.
+///
+/// Like RpcChannel, response is deleted after done runs.
+/// Calls fail with UNAVAILABLE if no backend is connected.
+/// Must be destroyed in the loop passed to ctor, after all calls finished.
+class RpcClientPool : public ::google::protobuf::RpcChannel
+{
+ public:
+  enum Balance
+  {
+    kLeastOutstanding,
+    kPowerOfTwoChoices,
+  };
+
+  RpcClientPool(EventLoop* loop, const string& name);
+  ~RpcClientPool() override;
+
+  // All of the setters must be called before start().
+  void addBackend(const InetAddress& addr);
+  void setConnectionsPerBackend(int n) { connectionsPerBackend_ = n; }
+  // 0 means all connections are in the loop passed to ctor
+  void setThreadNum(int numThreads);
+  void setBalance(Balance balance) { balance_ = balance; }
+  void setDefaultTimeout(double seconds) { defaultTimeout_ = seconds; }
+  void setRawPayload(bool on) { rawPayload_ = on; }
+
+  /// Failed calls of @c methodFullName, like "echo.EchoService.Echo", are
+  /// retried on other connections, up to @c maxAttempts in total.
+  /// If @c hedgeDelay > 0, another attempt is sent when there's no response
+  /// after hedgeDelay seconds, and the first successful response wins.
+  void setIdempotent(const string& methodFullName, int maxAttempts = 2,
+                     double hedgeDelay = 0);
+
+  void start();
+
+  int connectedChannels() const;
+
+  void CallMethod(const ::google::protobuf::MethodDescriptor* method,
+                  ::google::protobuf::RpcController* controller,
+                  const ::google::protobuf::Message* request,
+                  ::google::protobuf::Message* response,
+                  ::google::protobuf::Closure* done) override;
+
+ private:
+  struct Connection;
+  typedef std::shared_ptr<Connection> ConnectionPtr;
+  struct Call;
+  typedef std::shared_ptr<Call> CallPtr;
+  struct Attempt;
+
+  struct Policy
+  {
+    int maxAttempts;
+    double hedgeDelay;
+  };
+
+  static void onConnection(const std::weak_ptr<Connection>& weakConn,
+                           const TcpConnectionPtr& conn);
+  // picks a channel to a backend other than excludeBackend, if possible
+  RpcChannelPtr pick(int excludeBackend, int* backend, EventLoop** loop);
+  void sendAttempt(const CallPtr& call);
+  void onAttemptDone(Attempt* attempt);
+  static void hedge(const std::weak_ptr<RpcClientPool*>& weakSelf, const CallPtr& call);
+  void finish(const CallPtr& call, ErrorCode error);
+
+  EventLoop* loop_;
+  const string name_;
+  std::unique_ptr<EventLoopThreadPool> threadPool_;
+  std::vector<InetAddress> backends_;
+  std::map<string, Policy> idempotents_;
+  int connectionsPerBackend_;
+  Balance balance_;
+  double defaultTimeout_;
+  bool rawPayload_;
+  // fixed after start(), destroyed before threadPool_
+  std::vector<ConnectionPtr> connections_;
+  // hedge timers run in loop_ and hold a weak_ptr of self_,
+  // so they do nothing once the pool is gone.
+  std::shared_ptr<RpcClientPool*> self_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_PROTORPC_RPCCLIENTPOOL_H
@@ -0,0 +1,400 @@
+#include <muduo/net/protorpc/RpcClientPool.h>
+#include <muduo/net/protorpc/RpcController.h>
+#include <muduo/net/protorpc/RpcServer.h>
+#include <muduo/net/protorpc/rpctest.pb.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/base/Metrics.h>
+#include <muduo/net/BufferPool.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/SocketsOps.h>
+
+//#define BOOST_TEST_MODULE RpcClientPoolTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+
+uint16_t freePort()
+{
+  int sockfd = sockets::createNonblockingOrDie(AF_INET);
+  sockets::bindOrDie(sockfd, InetAddress(0, true).getSockAddr());
+  const uint16_t port = InetAddress(sockets::getLocalAddr(sockfd)).toPort();
+  sockets::close(sockfd);
+  return port;
+}
+
+void runUntil(EventLoop* loop, const std::function<bool()>& done)
+{
+  TimerId poll = loop->runEvery(0.01, [loop, done] { if (done()) loop->quit(); });
+  TimerId timeout = loop->runAfter(5.0, [] { LOG_FATAL << "timeout"; });
+  loop->loop();
+  loop->cancel(poll);
+  loop->cancel(timeout);
+}
+
+void runFor(EventLoop* loop, double seconds)
+{
+  const Timestamp until = addTime(Timestamp::now(), seconds);
+  runUntil(loop, [until] { return Timestamp::now() >= until; });
+}
+
+// answers after delayMs
+class EchoServiceImpl : public rpctest::EchoService
+{
+ public:
+  EchoServiceImpl(EventLoop* loop, int delayMs)
+    : loop_(loop), delayMs_(delayMs), calls_(0), replied_(0)
+  {
+  }
+
+  void Echo(::google::protobuf::RpcController*,
+            const rpctest::EchoRequest* request,
+            rpctest::EchoResponse* response,
+            ::google::protobuf::Closure* done) override
+  {
+    ++calls_;
+    response->set_payload(request->payload());
+    loop_->runAfter(delayMs_ / 1000.0, std::bind(&EchoServiceImpl::reply, this, done));
+  }
+
+  int calls() const { return calls_; }
+  int replied() const { return replied_; }
+
+ private:
+  void reply(::google::protobuf::Closure* done)
+  {
+    ++replied_;
+    done->Run();
+  }
+
+  EventLoop* loop_;
+  int delayMs_;
+  int calls_;
+  int replied_;
+};
+
+struct EchoBackend
+{
+  EchoBackend(EventLoop* loop, int delayMs)
+    : EchoBackend(loop, delayMs, InetAddress(freePort(), true))
+  {
+  }
+
+  EchoBackend(EventLoop* loop, int delayMs, const InetAddress& listenAddr)
+    : addr(listenAddr),
+      impl(loop, delayMs),
+      server(loop, addr)
+  {
+    server.registerService(&impl);
+    server.start();
+  }
+
+  InetAddress addr;
+  EchoServiceImpl impl;
+  RpcServer server;
+};
+
+// never answers, or drops the connection on the first request if crash
+struct SinkBackend
+{
+  SinkBackend(EventLoop* loop, bool crash)
+    : addr(freePort(), true),
+      server(loop, addr, "SinkBackend"),
+      requests(0)
+  {
+    server.setMessageCallback([this, crash](const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+                              {
+                                ++requests;
+                                buf->retrieveAll();
+                                if (crash)
+                                  conn->forceClose();
+                              });
+    server.start();
+  }
+
+  InetAddress addr;
+  TcpServer server;
+  int requests;
+};
+
+struct Result
+{
+  Result() : runs(0), error(NO_ERROR) { }
+
+  void done(rpctest::EchoResponse* response)
+  {
+    ++runs;
+    error = controller.errorCode();
+    payload = response->payload();
+    finished = Timestamp::now();
+  }
+
+  RpcController controller;
+  int runs;
+  ErrorCode error;
+  string payload;
+  Timestamp finished;
+};
+
+void call(RpcClientPool* pool, const string& payload, Result* result)
+{
+  rpctest::EchoService::Stub stub(pool);
+  rpctest::EchoRequest request;
+  request.set_payload(payload);
+  rpctest::EchoResponse* response = new rpctest::EchoResponse;
+  stub.Echo(&result->controller, &request, response,
+            NewCallback(result, &Result::done, response));
+}
+
+bool allDone(const std::vector<Result>& results)
+{
+  for (const Result& r : results)
+  {
+    if (r.runs == 0)
+      return false;
+  }
+  return true;
+}
+
+// closes the connections while the loop runs
+void destroy(EventLoop* loop, std::unique_ptr<RpcClientPool>* pool)
+{
+  pool->reset();
+  runFor(loop, 0.1);
+}
+
+const char kEcho[] = "rpctest.EchoService.Echo";
+
+BOOST_AUTO_TEST_CASE(testBalance)
+{
+  EventLoop loop;
+  EchoBackend a(&loop, 20), b(&loop, 20);
+  std::unique_ptr<RpcClientPool> pool(new RpcClientPool(&loop, "pool"));
+  pool->addBackend(a.addr);
+  pool->addBackend(b.addr);
+  pool->setConnectionsPerBackend(2);
+  pool->start();
+  runUntil(&loop, [&pool] { return pool->connectedChannels() == 4; });
+
+  // least outstanding spreads calls in flight evenly
+  std::vector<Result> results(100);
+  for (size_t i = 0; i < results.size(); ++i)
+  {
+    call(get_pointer(pool), std::to_string(i), &results[i]);
+  }
+  runUntil(&loop, [&results] { return allDone(results); });
+  for (size_t i = 0; i < results.size(); ++i)
+  {
+    BOOST_CHECK_EQUAL(results[i].error, NO_ERROR);
+    BOOST_CHECK_EQUAL(results[i].payload, std::to_string(i));
+  }
+  BOOST_CHECK_EQUAL(a.impl.calls(), 50);
+  BOOST_CHECK_EQUAL(b.impl.calls(), 50);
+
+  destroy(&loop, &pool);
+}
+
+BOOST_AUTO_TEST_CASE(testRetry)
+{
+  EventLoop loop;
+  SinkBackend a(&loop, false);
+  EchoBackend b(&loop, 0);
+  std::unique_ptr<RpcClientPool> retrying(new RpcClientPool(&loop, "retrying"));
+  std::unique_ptr<RpcClientPool> once(new RpcClientPool(&loop, "once"));
+  for (RpcClientPool* pool : { get_pointer(retrying), get_pointer(once) })
+  {
+    pool->addBackend(a.addr);
+    pool->addBackend(b.addr);
+    pool->setDefaultTimeout(0.05);
+    pool->start();
+  }
+  retrying->setIdempotent(kEcho, 2);
+  runUntil(&loop, [&] { return retrying->connectedChannels() == 2
+                               && once->connectedChannels() == 2; });
+
+  // one of the two goes to a, which never answers
+  std::vector<Result> results(2);
+  call(get_pointer(retrying), "x", &results[0]);
+  call(get_pointer(retrying), "y", &results[1]);
+  runUntil(&loop, [&results] { return allDone(results); });
+  BOOST_CHECK_EQUAL(results[0].error, NO_ERROR);
+  BOOST_CHECK_EQUAL(results[1].error, NO_ERROR);
+  BOOST_CHECK_EQUAL(a.requests, 1);
+  BOOST_CHECK_EQUAL(b.impl.calls(), 2);
+
+  // not idempotent, not retried
+  std::vector<Result> onceResults(2);
+  call(get_pointer(once), "x", &onceResults[0]);
+  call(get_pointer(once), "y", &onceResults[1]);
+  runUntil(&loop, [&onceResults] { return allDone(onceResults); });
+  BOOST_CHECK_EQUAL((onceResults[0].error == TIMEOUT) + (onceResults[1].error == TIMEOUT), 1);
+  BOOST_CHECK_EQUAL(a.requests, 2);
+  BOOST_CHECK_EQUAL(b.impl.calls(), 3);
+
+  destroy(&loop, &retrying);
+  destroy(&loop, &once);
+}
+
+BOOST_AUTO_TEST_CASE(testHedge)
+{
+  EventLoop loop;
+  EchoBackend a(&loop, 300), b(&loop, 0);
+  std::unique_ptr<RpcClientPool> pool(new RpcClientPool(&loop, "pool"));
+  pool->addBackend(a.addr);
+  pool->addBackend(b.addr);
+  pool->setIdempotent(kEcho, 2, 0.03);
+  pool->start();
+  runUntil(&loop, [&pool] { return pool->connectedChannels() == 2; });
+
+  // one of the two goes to a, which is slow, then to b after 30ms
+  const Timestamp start = Timestamp::now();
+  std::vector<Result> results(2);
+  call(get_pointer(pool), "x", &results[0]);
+  call(get_pointer(pool), "y", &results[1]);
+  runUntil(&loop, [&results] { return allDone(results); });
+  for (const Result& r : results)
+  {
+    BOOST_CHECK_EQUAL(r.error, NO_ERROR);
+    BOOST_CHECK_LT(timeDifference(r.finished, start), 0.2);
+  }
+  BOOST_CHECK_EQUAL(a.impl.calls(), 1);
+  BOOST_CHECK_EQUAL(b.impl.calls(), 2);
+
+  // the late response of a is dropped
+  runUntil(&loop, [&a] { return a.impl.replied() == 1; });
+  runFor(&loop, 0.05);
+  BOOST_CHECK_EQUAL(results[0].runs, 1);
+  BOOST_CHECK_EQUAL(results[1].runs, 1);
+
+  destroy(&loop, &pool);
+}
+
+BOOST_AUTO_TEST_CASE(testHedgeAfterDestroy)
+{
+  EventLoop loop;
+  EchoBackend a(&loop, 0);
+  std::unique_ptr<RpcClientPool> pool(new RpcClientPool(&loop, "pool"));
+  pool->addBackend(a.addr);
+  pool->setIdempotent(kEcho, 2, 0.1);
+  pool->start();
+  runUntil(&loop, [&pool] { return pool->connectedChannels() == 1; });
+
+  Result result;
+  call(get_pointer(pool), "x", &result);
+  runUntil(&loop, [&result] { return result.runs == 1; });
+  BOOST_CHECK_EQUAL(result.error, NO_ERROR);
+  // the hedge timer fires after the pool is gone
+  destroy(&loop, &pool);
+  runFor(&loop, 0.1);
+  BOOST_CHECK_EQUAL(a.impl.calls(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(testFailover)
+{
+  EventLoop loop;
+  SinkBackend a(&loop, true);
+  EchoBackend b(&loop, 0);
+  std::unique_ptr<RpcClientPool> retrying(new RpcClientPool(&loop, "retrying"));
+  std::unique_ptr<RpcClientPool> once(new RpcClientPool(&loop, "once"));
+  for (RpcClientPool* pool : { get_pointer(retrying), get_pointer(once) })
+  {
+    pool->addBackend(a.addr);
+    pool->addBackend(b.addr);
+    pool->start();
+  }
+  retrying->setIdempotent(kEcho, 2);
+  runUntil(&loop, [&] { return retrying->connectedChannels() == 2
+                               && once->connectedChannels() == 2; });
+
+  // a drops the connection of the calls sent to it, which go to b then
+  std::vector<Result> results(6);
+  for (Result& r : results)
+  {
+    call(get_pointer(retrying), "x", &r);
+  }
+  runUntil(&loop, [&results] { return allDone(results); });
+  for (const Result& r : results)
+  {
+    BOOST_CHECK_EQUAL(r.error, NO_ERROR);
+  }
+  BOOST_CHECK_GE(a.requests, 1);
+  BOOST_CHECK_EQUAL(b.impl.calls(), 6);
+
+  // not idempotent, fails with the connection
+  std::vector<Result> onceResults(2);
+  call(get_pointer(once), "x", &onceResults[0]);
+  call(get_pointer(once), "y", &onceResults[1]);
+  runUntil(&loop, [&onceResults] { return allDone(onceResults); });
+  BOOST_CHECK_EQUAL((onceResults[0].error == UNAVAILABLE) + (onceResults[1].error == UNAVAILABLE), 1);
+
+  destroy(&loop, &retrying);
+  destroy(&loop, &once);
+}
+
+BOOST_AUTO_TEST_CASE(testReconnect)
+{
+  EventLoop loop;
+  // counts the buffers of live TcpConnections
+  Gauge* bytes = BufferPool::connectionBytesGauge();
+  const int64_t before = bytes->value();
+  std::unique_ptr<EchoBackend> backend(new EchoBackend(&loop, 0));
+  const InetAddress addr = backend->addr;
+  std::unique_ptr<RpcClientPool> pool(new RpcClientPool(&loop, "pool"));
+  pool->addBackend(addr);
+  pool->start();
+  runUntil(&loop, [&pool] { return pool->connectedChannels() == 1; });
+
+  // the connections of both sides are freed
+  backend.reset();
+  runUntil(&loop, [&] { return pool->connectedChannels() == 0
+                               && bytes->value() == before; });
+
+  backend.reset(new EchoBackend(&loop, 0, addr));
+  runUntil(&loop, [&pool] { return pool->connectedChannels() == 1; });
+  Result result;
+  call(get_pointer(pool), "x", &result);
+  runUntil(&loop, [&result] { return result.runs == 1; });
+  BOOST_CHECK_EQUAL(result.error, NO_ERROR);
+
+  destroy(&loop, &pool);
+  backend.reset();
+  runUntil(&loop, [&] { return bytes->value() == before; });
+}
+
+BOOST_AUTO_TEST_CASE(testDestroyThreaded)
+{
+  EventLoop loop;
+  Gauge* bytes = BufferPool::connectionBytesGauge();
+  const int64_t before = bytes->value();
+  EchoBackend backend(&loop, 0);
+  std::unique_ptr<RpcClientPool> pool(new RpcClientPool(&loop, "pool"));
+  pool->addBackend(backend.addr);
+  pool->setThreadNum(2);
+  pool->setConnectionsPerBackend(4);
+  pool->start();
+  runUntil(&loop, [&pool] { return pool->connectedChannels() == 4; });
+  Result result;
+  call(get_pointer(pool), "x", &result);
+  runUntil(&loop, [&result] { return result.runs == 1; });
+
+  // closes the connections in their loops
+  destroy(&loop, &pool);
+  runUntil(&loop, [&] { return bytes->value() == before; });
+}
+
+BOOST_AUTO_TEST_CASE(testUnavailable)
+{
+  EventLoop loop;
+  RpcClientPool pool(&loop, "pool");
+  pool.addBackend(InetAddress(freePort(), true));
+  pool.start();
+  // refused, retries later
+  runFor(&loop, 0.1);
+  Result result;
+  call(&pool, "x", &result);
+  BOOST_CHECK_EQUAL(result.runs, 1);
+  BOOST_CHECK_EQUAL(result.error, UNAVAILABLE);
+}
@@ -8,12 +8,18 @@
 
 #include <muduo/net/protorpc/RpcCodec.h>
 
+#include <muduo/base/Crc32c.h>
 #include <muduo/base/Logging.h>
 #include <muduo/net/Endian.h>
 #include <muduo/net/TcpConnection.h>
 
 #include <muduo/net/protorpc/rpc.pb.h>
 #include <muduo/net/protorpc/google-inl.h>
+#include <muduo/net/protobuf/BufferStream.h>
+
+#include <google/protobuf/io/coded_stream.h>
+
+#include <limits.h>
 
 using namespace muduo;
 using namespace muduo::net;
@@ -33,5 +39,110 @@ namespace muduo
 namespace net
 {
 const char rpctag [] = "RPC0";
+const char rawRpcTag [] = "RPC1";
+const char crcRpcTag [] = "RPC2";
+}
+}
+
+namespace
+{
+  const int kTagLen = 4;
+  // header and payload, so that the frame length still fits in int32
+  const int kMaxDataLen = INT_MAX - kTagLen - 5 - ProtobufCodecLite::kChecksumLen;
+
+  int32_t crc32c(const char* buf, int len)
+  {
+    return static_cast<int32_t>(Crc32c::value(buf, len));
+  }
+}
+
+bool RpcRawCodec::isRawFrame(StringPiece frame)
+{
+  return frame.size() >= ProtobufCodecLite::kHeaderLen + kTagLen
+      && (memcmp(frame.data() + ProtobufCodecLite::kHeaderLen, rawRpcTag, kTagLen) == 0
+          || isCrc32cFrame(frame));
+}
+
+bool RpcRawCodec::isCrc32cFrame(StringPiece frame)
+{
+  return frame.size() >= ProtobufCodecLite::kHeaderLen + kTagLen
+      && memcmp(frame.data() + ProtobufCodecLite::kHeaderLen, crcRpcTag, kTagLen) == 0;
+}
+
+bool RpcRawCodec::fillEmptyBuffer(Buffer* buf,
+                                  const RpcMessage& header,
+                                  const ::google::protobuf::Message* payload,
+                                  bool crc32c)
+{
+  assert(buf->readableBytes() == 0);
+  const size_t headerSize = header.ByteSizeLong();
+  // also caches sizes for SerializeWithCachedSizes
+  const size_t payloadSize = payload ? payload->ByteSizeLong() : 0;
+  if (headerSize + payloadSize > static_cast<size_t>(kMaxDataLen))
+  {
+    LOG_ERROR << "RpcRawCodec::fillEmptyBuffer - message of "
+              << headerSize + payloadSize << " bytes is too large";
+    return false;
+  }
+  buf->append(crc32c ? crcRpcTag : rawRpcTag, kTagLen);
+  {
+  // serializes straight into buf, no temporary string
+  BufferOutputStream os(buf);
+  google::protobuf::io::CodedOutputStream out(&os);
+  out.WriteVarint32(static_cast<uint32_t>(headerSize));
+  header.SerializeWithCachedSizes(&out);
+  if (payload)
+  {
+    payload->SerializeWithCachedSizes(&out);
+  }
+  }
+  const int dataLen = static_cast<int>(buf->readableBytes());
+  int32_t checkSum = crc32c ? ::crc32c(buf->peek(), dataLen)
+                            : ProtobufCodecLite::checksum(buf->peek(), dataLen);
+  buf->appendInt32(checkSum);
+  int32_t len = sockets::hostToNetwork32(static_cast<int32_t>(buf->readableBytes()));
+  buf->prepend(&len, sizeof len);
+  return true;
 }
+
+ProtobufCodecLite::ErrorCode RpcRawCodec::parse(StringPiece frame,
+                                                RpcMessage* header,
+                                                StringPiece* payload)
+{
+  assert(isRawFrame(frame));
+  const char* buf = frame.data() + ProtobufCodecLite::kHeaderLen;
+  const int len = frame.size() - ProtobufCodecLite::kHeaderLen;
+  if (len < kTagLen + ProtobufCodecLite::kChecksumLen)
+  {
+    return ProtobufCodecLite::kInvalidLength;
+  }
+  const bool valid = isCrc32cFrame(frame)
+      ? crc32c(buf, len - ProtobufCodecLite::kChecksumLen)
+        == ProtobufCodecLite::asInt32(buf + len - ProtobufCodecLite::kChecksumLen)
+      : ProtobufCodecLite::validateChecksum(buf, len);
+  if (!valid)
+  {
+    return ProtobufCodecLite::kCheckSumError;
+  }
+
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(buf + kTagLen);
+  const int dataLen = len - kTagLen - ProtobufCodecLite::kChecksumLen;
+  google::protobuf::io::CodedInputStream in(data, dataLen);
+  uint32_t headerSize = 0;
+  if (!in.ReadVarint32(&headerSize))
+  {
+    return ProtobufCodecLite::kParseError;
+  }
+  const int offset = in.CurrentPosition();
+  if (headerSize > static_cast<uint32_t>(dataLen - offset))
+  {
+    return ProtobufCodecLite::kInvalidLength;
+  }
+  if (!header->ParseFromArray(data + offset, static_cast<int>(headerSize)))
+  {
+    return ProtobufCodecLite::kParseError;
+  }
+  const int payloadOffset = offset + static_cast<int>(headerSize);
+  payload->set(reinterpret_cast<const char*>(data + payloadOffset), dataLen - payloadOffset);
+  return ProtobufCodecLite::kNoError;
 }
@@ -39,6 +39,49 @@ extern const char rpctag[];// = "RPC0";
 
 typedef ProtobufCodecLiteT<RpcMessage, rpctag> RpcCodec;
 
+extern const char rawRpcTag[];// = "RPC1";
+
+// raw payload wire format, saves copying request or response
+// into RpcMessage::request or RpcMessage::response
+//
+// Field     Length  Content
+//
+// size      4-byte  M+N+8+varint
+// "RPC1"    4-byte
+// hlen      varint  M
+// header    M-byte  RpcMessage, without request and response
+// payload   N-byte  request or response message
+// checksum  4-byte  adler32 of "RPC1"+hlen+header+payload
+//
+// Both peers must set RpcMessage::raw_payload before using it,
+// see RpcChannel::setRawPayload().
+//
+// "RPC2" frames are the same, but checksummed by CRC-32C,
+// which is a few times faster than adler32 with SSE 4.2.
+// Both peers must set RpcMessage::crc32c before using it.
+
+extern const char crcRpcTag[];// = "RPC2";
+
+class RpcRawCodec
+{
+ public:
+  // is a complete "RPC1" or "RPC2" frame, including the size
+  static bool isRawFrame(StringPiece frame);
+  static bool isCrc32cFrame(StringPiece frame);
+
+  // payload may be NULL
+  // returns false and leaves buf empty if the message is too large to frame
+  static bool fillEmptyBuffer(Buffer* buf,
+                              const RpcMessage& header,
+                              const ::google::protobuf::Message* payload,
+                              bool crc32c = false);
+
+  // payload points into frame
+  static ProtobufCodecLite::ErrorCode parse(StringPiece frame,
+                                            RpcMessage* header,
+                                            StringPiece* payload);
+};
+
 }  // namespace net
 }  // namespace muduo
 
@@ -77,5 +77,52 @@ int main()
   assert(g_msgptr->DebugString() == message.DebugString());
   }
 
+  {
+  RpcMessage payload;
+  payload.set_type(RESPONSE);
+  payload.set_id(3);
+  payload.set_service("raw");
+  Buffer buf;
+  RpcRawCodec::fillEmptyBuffer(&buf, message, &payload);
+  print(buf);
+  assert(RpcRawCodec::isRawFrame(buf.toStringPiece()));
+  assert(!RpcRawCodec::isRawFrame(expected));
+  RpcMessage header;
+  StringPiece raw;
+  assert(RpcRawCodec::parse(buf.toStringPiece(), &header, &raw) == ProtobufCodecLite::kNoError);
+  assert(header.DebugString() == message.DebugString());
+  assert(raw == payload.SerializeAsString());
+
+  Buffer empty;
+  RpcRawCodec::fillEmptyBuffer(&empty, message, NULL);
+  assert(RpcRawCodec::parse(empty.toStringPiece(), &header, &raw) == ProtobufCodecLite::kNoError);
+  assert(raw.empty());
+
+  string corrupted = buf.retrieveAllAsString();
+  corrupted[10] ^= 1;
+  assert(RpcRawCodec::parse(corrupted, &header, &raw) == ProtobufCodecLite::kCheckSumError);
+  }
+
+  {
+  RpcMessage payload;
+  payload.set_type(RESPONSE);
+  payload.set_id(4);
+  payload.set_service("crc32c");
+  Buffer buf;
+  RpcRawCodec::fillEmptyBuffer(&buf, message, &payload, true);
+  print(buf);
+  assert(RpcRawCodec::isRawFrame(buf.toStringPiece()));
+  assert(RpcRawCodec::isCrc32cFrame(buf.toStringPiece()));
+  RpcMessage header;
+  StringPiece raw;
+  assert(RpcRawCodec::parse(buf.toStringPiece(), &header, &raw) == ProtobufCodecLite::kNoError);
+  assert(header.DebugString() == message.DebugString());
+  assert(raw == payload.SerializeAsString());
+
+  string corrupted = buf.retrieveAllAsString();
+  corrupted[10] ^= 1;
+  assert(RpcRawCodec::parse(corrupted, &header, &raw) == ProtobufCodecLite::kCheckSumError);
+  }
+
   google::protobuf::ShutdownProtobufLibrary();
 }
@@ -0,0 +1,60 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+#include <muduo/net/protorpc/RpcController.h>
+
+#include <assert.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+RpcController::RpcController()
+  : timeout_(0),
+    id_(0),
+    execTime_(NULL),
+    errorCode_(NO_ERROR),
+    cancelCallback_(NULL)
+{
+}
+
+RpcController::~RpcController()
+{
+  if (cancelCallback_)
+  {
+    cancelCallback_->Run();
+  }
+}
+
+void RpcController::Reset()
+{
+  timeout_ = 0;
+  deadline_ = Timestamp();
+  errorCode_ = NO_ERROR;
+  errorText_.clear();
+}
+
+void RpcController::SetFailed(const std::string& reason)
+{
+  if (errorCode_ == NO_ERROR)
+  {
+    errorCode_ = INVALID_RESPONSE;
+  }
+  errorText_ = reason;
+}
+
+bool RpcController::IsCanceled() const
+{
+  return deadline_.valid() && Timestamp::now() >= deadline_;
+}
+
+void RpcController::NotifyOnCancel(::google::protobuf::Closure* callback)
+{
+  assert(cancelCallback_ == NULL);  // may be called only once per call
+  cancelCallback_ = callback;
+}
+
+void RpcController::setErrorCode(ErrorCode code)
+{
+  errorCode_ = code;
+  errorText_ = ErrorCode_Name(code);
+}
@@ -0,0 +1,74 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_PROTORPC_RPCCONTROLLER_H
+#define MUDUO_NET_PROTORPC_RPCCONTROLLER_H
+
+#include <muduo/base/Timestamp.h>
+#include <muduo/base/Types.h>
+#include <muduo/net/protorpc/rpc.pb.h>
+
+#include <google/protobuf/service.h>
+
+namespace muduo
+{
+class Histogram;
+
+namespace net
+{
+
+///
+/// Per-call state of RpcChannel.
+///
+/// On the client side, pass one to a stub to set the timeout of the call
+/// and to learn why it failed.  On the server side, RpcChannel passes one
+/// to Service::CallMethod(), it is canceled once the client gave up.
+class RpcController : public ::google::protobuf::RpcController
+{
+ public:
+  RpcController();
+  ~RpcController() override;
+
+  // client side
+  void Reset() override;
+  bool Failed() const override { return errorCode_ != NO_ERROR; }
+  std::string ErrorText() const override { return errorText_; }
+  // not supported, the call finishes or times out.
+  void StartCancel() override { }
+
+  // server side
+  void SetFailed(const std::string& reason) override;
+  // true if the deadline set by the client has passed
+  bool IsCanceled() const override;
+  // callback runs when the call completes, as there's no early cancel.
+  void NotifyOnCancel(::google::protobuf::Closure* callback) override;
+
+  /// Client gives up after @c seconds, 0 means RpcChannel::defaultTimeout().
+  void setTimeout(double seconds) { timeout_ = seconds; }
+  double timeout() const { return timeout_; }
+
+  /// Server side, invalid if the client did not set a timeout.
+  Timestamp deadline() const { return deadline_; }
+
+  ErrorCode errorCode() const { return errorCode_; }
+  void setErrorCode(ErrorCode code);
+
+ private:
+  friend class RpcChannel;
+
+  double timeout_;
+  Timestamp deadline_;
+  int64_t id_;
+  Timestamp startTime_;  // server side, when CallMethod() begins
+  Histogram* execTime_;
+  ErrorCode errorCode_;
+  string errorText_;
+  ::google::protobuf::Closure* cancelCallback_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_PROTORPC_RPCCONTROLLER_H
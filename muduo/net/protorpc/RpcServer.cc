@@ -8,8 +8,9 @@
 
 #include <muduo/net/protorpc/RpcServer.h>
 
+#include <muduo/base/Crc32c.h>
 #include <muduo/base/Logging.h>
-#include <muduo/net/protorpc/RpcChannel.h>
+#include <muduo/base/Metrics.h>
 
 #include <google/protobuf/descriptor.h>
 #include <google/protobuf/service.h>
@@ -19,7 +20,12 @@ using namespace muduo::net;
 
 RpcServer::RpcServer(EventLoop* loop,
                      const InetAddress& listenAddr)
-  : server_(loop, listenAddr, "RpcServer")
+  : server_(loop, listenAddr, "RpcServer"),
+    maxQueueSize_(kDefaultMaxQueueSize),
+    rawPayload_(true),
+    crc32c_(Crc32c::hardwareAccelerated()),
+    encoderPool_(NULL),
+    encodeMinBytes_(0)
 {
   server_.setConnectionCallback(
       std::bind(&RpcServer::onConnection, this, _1));
@@ -33,8 +39,41 @@ void RpcServer::registerService(google::protobuf::Service* service)
   services_[desc->full_name()] = service;
 }
 
+void RpcServer::setThreadPool(const std::string& name, ThreadPool* pool)
+{
+  pools_[name] = pool;
+}
+
 void RpcServer::start()
 {
+  MetricsRegistry& registry = MetricsRegistry::instance();
+  for (const auto& it : services_)
+  {
+    const google::protobuf::ServiceDescriptor* desc = it.second->GetDescriptor();
+    for (int i = 0; i < desc->method_count(); ++i)
+    {
+      const google::protobuf::MethodDescriptor* method = desc->method(i);
+      const string labels = MetricsRegistry::label("method", method->full_name());
+      RpcMethodInfo& info = methods_[method];
+      info.pool = NULL;
+      info.maxQueueSize = maxQueueSize_;
+      std::map<std::string, ThreadPool*>::const_iterator pool = pools_.find(method->full_name());
+      if (pool == pools_.end())
+      {
+        pool = pools_.find(desc->full_name());
+      }
+      if (pool != pools_.end())
+      {
+        info.pool = pool->second;
+      }
+      info.queueTime = registry.histogram(
+          "muduo_rpc_queue_us", "Microseconds RPC calls wait for the thread pool", labels);
+      info.execTime = registry.histogram(
+          "muduo_rpc_exec_us", "Microseconds from RPC dispatch to response", labels);
+      info.rejected = registry.counter(
+          "muduo_rpc_rejected_total", "RPC calls rejected as the thread pool is full", labels);
+    }
+  }
   server_.start();
 }
 
@@ -47,6 +86,10 @@ void RpcServer::onConnection(const TcpConnectionPtr& conn)
   {
     RpcChannelPtr channel(new RpcChannel(conn));
     channel->setServices(&services_);
+    channel->setMethods(&methods_);
+    channel->setRawPayload(rawPayload_);
+    channel->setCrc32c(crc32c_);
+    channel->setEncoderPool(encoderPool_, encodeMinBytes_);
     conn->setMessageCallback(
         std::bind(&RpcChannel::onMessage, get_pointer(channel), _1, _2, _3));
     conn->setContext(channel);
@@ -12,6 +12,7 @@
 #define MUDUO_NET_PROTORPC_RPCSERVER_H
 
 #include <muduo/net/TcpServer.h>
+#include <muduo/net/protorpc/RpcChannel.h>
 
 namespace google {
 namespace protobuf {
@@ -23,6 +24,8 @@ class Service;
 
 namespace muduo
 {
+class ThreadPool;
+
 namespace net
 {
 
@@ -37,6 +40,45 @@ class RpcServer
     server_.setThreadNum(numThreads);
   }
 
+  // answers clients which ask for "RPC1" frames in kind, on by default,
+  // see RpcChannel::setRawPayload()
+  void setRawPayload(bool on)
+  {
+    rawPayload_ = on;
+  }
+
+  // see RpcChannel::setCrc32c()
+  void setCrc32c(bool on)
+  {
+    crc32c_ = on;
+  }
+
+  // Serializes responses of at least minBytes in pool, instead of the IO
+  // threads, see RpcChannel::setEncoderPool().  Must be called before start().
+  void setEncoderPool(ThreadPool* pool, size_t minBytes)
+  {
+    encoderPool_ = pool;
+    encodeMinBytes_ = minBytes;
+  }
+
+  // Runs methods of a service, or a single method, in pool instead of
+  // the IO threads, name is a full name like "echo.EchoService" or
+  // "echo.EchoService.Echo", the latter wins.  When the queue of pool is
+  // full, calls are rejected with OVERLOADED, see setMaxQueueSize().
+  // pool must outlive the server.  Must be called before start().
+  void setThreadPool(const std::string& name, ThreadPool* pool);
+
+  // Calls are rejected with OVERLOADED once maxSize tasks wait in the
+  // pool of setThreadPool(), or ThreadPool::setMaxQueueSize() of it,
+  // whichever is smaller.  kDefaultMaxQueueSize by default, 0 means no
+  // limit.  Must be called before start().
+  void setMaxQueueSize(size_t maxSize)
+  {
+    maxQueueSize_ = maxSize;
+  }
+
+  static const size_t kDefaultMaxQueueSize = 1024;
+
   void registerService(::google::protobuf::Service*);
   void start();
 
@@ -49,6 +91,13 @@ class RpcServer
 
   TcpServer server_;
   std::map<std::string, ::google::protobuf::Service*> services_;
+  std::map<std::string, ThreadPool*> pools_;
+  RpcMethodInfoMap methods_;
+  size_t maxQueueSize_;
+  bool rawPayload_;
+  bool crc32c_;
+  ThreadPool* encoderPool_;
+  size_t encodeMinBytes_;
 };
 
 }  // namespace net
@@ -0,0 +1,247 @@
+#include <muduo/net/protorpc/RpcServer.h>
+#include <muduo/net/protorpc/RpcController.h>
+#include <muduo/net/protorpc/rpctest.pb.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/base/ThreadPool.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/SocketsOps.h>
+#include <muduo/net/TcpClient.h>
+
+#include <algorithm>
+#include <atomic>
+
+//#define BOOST_TEST_MODULE RpcServerTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+
+uint16_t freePort()
+{
+  int sockfd = sockets::createNonblockingOrDie(AF_INET);
+  sockets::bindOrDie(sockfd, InetAddress(0, true).getSockAddr());
+  const uint16_t port = InetAddress(sockets::getLocalAddr(sockfd)).toPort();
+  sockets::close(sockfd);
+  return port;
+}
+
+void runUntil(EventLoop* loop, const std::function<bool()>& done)
+{
+  TimerId poll = loop->runEvery(0.01, [loop, done] { if (done()) loop->quit(); });
+  TimerId timeout = loop->runAfter(5.0, [] { LOG_FATAL << "timeout"; });
+  loop->loop();
+  loop->cancel(poll);
+  loop->cancel(timeout);
+}
+
+// runs in the pool, blocks it for delay_ms
+class EchoServiceImpl : public rpctest::EchoService
+{
+ public:
+  EchoServiceImpl() : started_(0) { }
+
+  void Echo(::google::protobuf::RpcController*,
+            const rpctest::EchoRequest* request,
+            rpctest::EchoResponse* response,
+            ::google::protobuf::Closure* done) override
+  {
+    started_.fetch_add(1);
+    {
+    MutexLockGuard lock(mutex_);
+    payloads_.push_back(request->payload());
+    }
+    CurrentThread::sleepUsec(request->delay_ms() * 1000);
+    response->set_payload(request->payload());
+    done->Run();
+  }
+
+  int started() const { return started_.load(); }
+
+  std::vector<string> payloads() const
+  {
+    MutexLockGuard lock(mutex_);
+    return payloads_;
+  }
+
+ private:
+  std::atomic<int> started_;
+  mutable MutexLock mutex_;
+  std::vector<string> payloads_ GUARDED_BY(mutex_);
+};
+
+struct Result
+{
+  Result() : runs(0), error(NO_ERROR) { }
+
+  void done(RpcController* controller, rpctest::EchoResponse* response)
+  {
+    ++runs;
+    error = controller->errorCode();
+    payload = response->payload();
+  }
+
+  int runs;
+  ErrorCode error;
+  string payload;
+};
+
+struct Fixture
+{
+  explicit Fixture(int maxQueueSize, bool rawPayload = false)
+    : addr(freePort(), true),
+      server(&loop, addr),
+      pool("RpcServerTest"),
+      client(&loop, addr, "RpcClient"),
+      channel(new RpcChannel),
+      stub(get_pointer(channel)),
+      up(false)
+  {
+    server.registerService(&impl);
+    server.setThreadPool("rpctest.EchoService", &pool);
+    if (maxQueueSize >= 0)
+    {
+      server.setMaxQueueSize(maxQueueSize);
+    }
+    pool.start(1);
+    server.start();
+
+    channel->setRawPayload(rawPayload);
+    client.setConnectionCallback([this](const TcpConnectionPtr& conn)
+                                 {
+                                   up = conn->connected();
+                                   if (up)
+                                     channel->setConnection(conn);
+                                 });
+    client.setMessageCallback(
+        std::bind(&RpcChannel::onMessage, get_pointer(channel), _1, _2, _3));
+    client.connect();
+    runUntil(&loop, [this] { return up; });
+  }
+
+  ~Fixture()
+  {
+    client.disconnect();
+    runUntil(&loop, [this] { return !up; });
+    pool.stop();
+  }
+
+  void call(const string& payload, int delayMs, double timeout,
+            RpcController* controller, Result* result)
+  {
+    rpctest::EchoRequest request;
+    request.set_payload(payload);
+    request.set_delay_ms(delayMs);
+    controller->setTimeout(timeout);
+    rpctest::EchoResponse* response = new rpctest::EchoResponse;
+    stub.Echo(controller, &request, response,
+              NewCallback(result, &Result::done, controller, response));
+  }
+
+  EventLoop loop;
+  InetAddress addr;
+  EchoServiceImpl impl;
+  RpcServer server;
+  ThreadPool pool;
+  TcpClient client;
+  RpcChannelPtr channel;
+  rpctest::EchoService::Stub stub;
+  bool up;
+};
+
+BOOST_AUTO_TEST_CASE(testOverloaded)
+{
+  Fixture f(2);
+  RpcController controllers[5];
+  Result results[5];
+  f.call("busy", 100, 0, &controllers[0], &results[0]);
+  runUntil(&f.loop, [&f] { return f.impl.started() == 1; });
+  // two are queued, the rest are shed
+  for (int i = 1; i < 5; ++i)
+  {
+    f.call(std::to_string(i), 0, 0, &controllers[i], &results[i]);
+  }
+  runUntil(&f.loop, [&results]
+           { for (const Result& r : results) if (r.runs == 0) return false; return true; });
+
+  BOOST_CHECK_EQUAL(results[0].error, NO_ERROR);
+  BOOST_CHECK_EQUAL(results[1].error, NO_ERROR);
+  BOOST_CHECK_EQUAL(results[2].error, NO_ERROR);
+  BOOST_CHECK_EQUAL(results[3].error, OVERLOADED);
+  BOOST_CHECK_EQUAL(results[4].error, OVERLOADED);
+  BOOST_CHECK_EQUAL(f.impl.started(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(testDefaultQueueSize)
+{
+  Fixture f(-1);
+  const int kCalls = static_cast<int>(RpcServer::kDefaultMaxQueueSize) + 11;
+  std::vector<RpcController> controllers(kCalls);
+  std::vector<Result> results(kCalls);
+  f.call("busy", 200, 0, &controllers[0], &results[0]);
+  runUntil(&f.loop, [&f] { return f.impl.started() == 1; });
+  for (int i = 1; i < kCalls; ++i)
+  {
+    f.call("x", 0, 0, &controllers[i], &results[i]);
+  }
+  runUntil(&f.loop, [&f] { return f.channel->outstandingCalls() == 0; });
+
+  int overloaded = 0;
+  for (const Result& r : results)
+  {
+    BOOST_CHECK_EQUAL(r.runs, 1);
+    overloaded += r.error == OVERLOADED;
+  }
+  BOOST_CHECK_EQUAL(overloaded, 10);
+}
+
+BOOST_AUTO_TEST_CASE(testQueuedTimeout)
+{
+  Fixture f(10);
+  RpcController busy, late;
+  Result busyResult, lateResult;
+  f.call("busy", 200, 0, &busy, &busyResult);
+  runUntil(&f.loop, [&f] { return f.impl.started() == 1; });
+  f.call("late", 0, 0.05, &late, &lateResult);
+  runUntil(&f.loop, [&busyResult] { return busyResult.runs == 1; });
+  // let the pool take "late" off the queue
+  RpcController after;
+  Result afterResult;
+  f.call("after", 0, 0, &after, &afterResult);
+  runUntil(&f.loop, [&afterResult] { return afterResult.runs == 1; });
+
+  BOOST_CHECK_EQUAL(lateResult.runs, 1);
+  BOOST_CHECK_EQUAL(lateResult.error, TIMEOUT);
+  BOOST_CHECK_EQUAL(afterResult.error, NO_ERROR);
+  // answered TIMEOUT without running it
+  const std::vector<string> payloads = f.impl.payloads();
+  BOOST_CHECK_EQUAL(payloads.size(), 2u);
+  BOOST_CHECK(std::find(payloads.begin(), payloads.end(), "late") == payloads.end());
+}
+
+BOOST_AUTO_TEST_CASE(testBatchedResponses)
+{
+  for (bool raw : { false, true })
+  {
+    Fixture f(0, raw);
+    // responses of a busy pool go out in batches, in order of completion
+    const int kCalls = 500;
+    std::vector<RpcController> controllers(kCalls);
+    std::vector<Result> results(kCalls);
+    for (int i = 0; i < kCalls; ++i)
+    {
+      f.call(string(i * 10, static_cast<char>('a' + i % 26)), 0, 0,
+             &controllers[i], &results[i]);
+    }
+    runUntil(&f.loop, [&f] { return f.channel->outstandingCalls() == 0; });
+    for (int i = 0; i < kCalls; ++i)
+    {
+      BOOST_CHECK_EQUAL(results[i].runs, 1);
+      BOOST_CHECK_EQUAL(results[i].error, NO_ERROR);
+      BOOST_CHECK_EQUAL(results[i].payload.size(), static_cast<size_t>(i * 10));
+    }
+    BOOST_CHECK_EQUAL(f.channel->rawPayload(), raw);
+  }
+}
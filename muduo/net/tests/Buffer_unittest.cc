@@ -1,4 +1,5 @@
 #include <muduo/net/Buffer.h>
+#include <muduo/net/BufferPool.h>
 
 //#define BOOST_TEST_MODULE BufferTest
 #define BOOST_TEST_MAIN
@@ -168,3 +169,45 @@ BOOST_AUTO_TEST_CASE(testMove)
   // printf("Buffer at %p, inner %p\n", &buf, inner);
   output(std::move(buf), inner);
 }
+
+BOOST_AUTO_TEST_CASE(testBufferPool)
+{
+  muduo::net::BufferPool pool(1);
+  const size_t kLarge = muduo::net::BufferPool::kLargeSize;
+  Buffer buf;
+  buf.append("muduo", 5);
+  pool.get(&buf);
+  BOOST_CHECK_GE(buf.writableBytes(), kLarge);
+  BOOST_CHECK_EQUAL(buf.retrieveAllAsString(), "muduo");
+  BOOST_CHECK_EQUAL(pool.size(), 0);
+
+  pool.put(&buf);
+  BOOST_CHECK_EQUAL(pool.size(), 1);
+  BOOST_CHECK_GE(pool.bytes(), kLarge);
+  BOOST_CHECK_EQUAL(buf.writableBytes(), Buffer::kInitialSize);
+
+  // taken from the pool
+  const size_t bytes = pool.bytes();
+  Buffer other;
+  pool.get(&other);
+  BOOST_CHECK_EQUAL(other.internalCapacity(), bytes);
+  BOOST_CHECK_EQUAL(pool.size(), 0);
+  BOOST_CHECK_EQUAL(pool.bytes(), 0);
+
+  // small and huge ones are not kept
+  pool.put(&buf);
+  BOOST_CHECK_EQUAL(pool.size(), 0);
+  Buffer huge;
+  huge.ensureWritableBytes(10 * kLarge);
+  pool.put(&huge);
+  BOOST_CHECK_EQUAL(pool.size(), 0);
+
+  // nor more than maxBuffers
+  pool.put(&other);
+  Buffer another;
+  pool.get(&another);
+  pool.get(&buf);
+  pool.put(&another);
+  pool.put(&buf);
+  BOOST_CHECK_EQUAL(pool.size(), 1);
+}
@@ -0,0 +1,106 @@
+#include <muduo/base/Atomic.h>
+#include <muduo/base/Logging.h>
+#include <muduo/base/Thread.h>
+#include <muduo/base/Timestamp.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/TcpServer.h>
+
+#include <memory>
+#include <vector>
+
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// Connects and closes as fast as possible, the server shuts down each
+// connection right away.  Measures the cost of setting up and tearing
+// down TcpConnection, and how often its memory comes from the pool.
+
+EventLoop* g_loop;
+AtomicInt32 g_closed;
+int g_total = 0;
+
+void onConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->shutdown();
+  }
+  else if (g_closed.incrementAndGet() == g_total)
+  {
+    g_loop->quit();
+  }
+}
+
+void churn(const InetAddress& serverAddr, int count)
+{
+  char buf[64];
+  for (int i = 0; i < count; ++i)
+  {
+    int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+    if (sockfd < 0)
+    {
+      LOG_SYSFATAL << "socket";
+    }
+    if (::connect(sockfd, serverAddr.getSockAddr(),
+                  static_cast<socklen_t>(sizeof(struct sockaddr_in))) < 0)
+    {
+      LOG_SYSFATAL << "connect";
+    }
+    // waits for the server to shutdown
+    while (::read(sockfd, buf, sizeof buf) > 0)
+    {
+    }
+    ::close(sockfd);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  Logger::setLogLevel(Logger::WARN);
+  const int connections = argc > 1 ? atoi(argv[1]) : 10000;
+  const int clients = argc > 2 ? atoi(argv[2]) : 4;
+  const int ioThreads = argc > 3 ? atoi(argv[3]) : 1;
+  g_total = connections / clients * clients;
+  printf("usage: %s [connections] [client threads] [io threads]\n", argv[0]);
+  printf("%d connections, %d client threads, %d io threads\n",
+         g_total, clients, ioThreads);
+
+  EventLoop loop;
+  g_loop = &loop;
+  InetAddress listenAddr(2034, true);
+  TcpServer server(&loop, listenAddr, "ChurnServer");
+  server.setConnectionCallback(onConnection);
+  server.setThreadNum(ioThreads);
+  server.start();  // listens right away in the loop thread
+
+  std::vector<std::unique_ptr<Thread>> threads;
+  for (int i = 0; i < clients; ++i)
+  {
+    threads.emplace_back(new Thread(
+          std::bind(churn, listenAddr, connections / clients), "client"));
+  }
+  Timestamp start(Timestamp::now());
+  for (auto& thr : threads)
+  {
+    thr->start();
+  }
+  loop.loop();
+  double seconds = timeDifference(Timestamp::now(), start);
+  for (auto& thr : threads)
+  {
+    thr->join();
+  }
+
+  const ObjectPool& pool = *loop.objectPool();
+  printf("%.3f seconds, %.0f connections/s\n", seconds, g_total / seconds);
+  printf("pool hits %lld misses %lld\n",
+         static_cast<long long>(pool.hits()),
+         static_cast<long long>(pool.misses()));
+}
@@ -0,0 +1,339 @@
+#include <muduo/net/DnsResolver.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/SocketsOps.h>
+#include <muduo/net/TcpClient.h>
+#include <muduo/net/TcpServer.h>
+#include <muduo/net/UdpSocket.h>
+
+#include <arpa/inet.h>
+
+//#define BOOST_TEST_MODULE DnsResolverTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+
+typedef std::vector<InetAddress> Addresses;
+
+// Answers queries of a few names under .test, like a recursive server.
+class StubDnsServer
+{
+ public:
+  explicit StubDnsServer(EventLoop* loop)
+    : socket_(loop, "StubDnsServer"),
+      queries_(0)
+  {
+    socket_.bindAddress(InetAddress(0, true));
+    socket_.setMessageCallback(
+        [this](UdpSocket* socket, StringPiece query, const InetAddress& peer, Timestamp)
+        { onQuery(socket, query, peer); });
+    socket_.start();
+  }
+
+  InetAddress address() const { return socket_.localAddress(); }
+  int queries() const { return queries_; }
+
+ private:
+  struct Record
+  {
+    uint16_t type;
+    uint32_t ttl;
+    string rdata;
+  };
+
+  static string ipv4(const char* ip)
+  {
+    struct in_addr addr;
+    ::inet_pton(AF_INET, ip, &addr);
+    return string(reinterpret_cast<const char*>(&addr), sizeof addr);
+  }
+
+  static string ipv6(const char* ip)
+  {
+    struct in6_addr addr;
+    ::inet_pton(AF_INET6, ip, &addr);
+    return string(reinterpret_cast<const char*>(&addr), sizeof addr);
+  }
+
+  static void append16(string* out, uint16_t v)
+  {
+    out->push_back(static_cast<char>(v >> 8));
+    out->push_back(static_cast<char>(v));
+  }
+
+  void onQuery(UdpSocket* socket, StringPiece query, const InetAddress& peer)
+  {
+    ++queries_;
+    // header and one question, names are encoded by DnsResolver
+    size_t end = 12;
+    string name;
+    while (query[static_cast<int>(end)] != 0)
+    {
+      const int len = query[static_cast<int>(end)];
+      name += (name.empty() ? "" : ".") + string(query.data() + end + 1, len);
+      end += 1 + len;
+    }
+    const uint16_t qtype = static_cast<uint16_t>(
+        (static_cast<uint8_t>(query[static_cast<int>(end) + 1]) << 8)
+        | static_cast<uint8_t>(query[static_cast<int>(end) + 2]));
+    end += 5;
+
+    int rcode = 0;
+    std::vector<Record> answers;
+    if (name == "a.test" && qtype == 1)
+    {
+      answers.push_back({1, 1, ipv4("10.0.0.1")});
+      answers.push_back({1, 60, ipv4("10.0.0.2")});
+    }
+    else if (name == "v6.test" && qtype == 28)
+    {
+      answers.push_back({28, 60, ipv6("::1")});
+    }
+    else if (name == "cname.test" && qtype == 1)
+    {
+      // a CNAME to a.test, pointing at "test" of the question
+      string target("\001a\300\023", 4);
+      answers.push_back({5, 60, target});
+      answers.push_back({1, 60, ipv4("10.0.0.3")});
+    }
+    else if (name == "server.test" && qtype == 1)
+    {
+      answers.push_back({1, 60, ipv4("127.0.0.1")});
+    }
+    else if (name == "race.test" && qtype == 1)
+    {
+      // TEST-NET-1, no one answers
+      answers.push_back({1, 60, ipv4("192.0.2.1")});
+      answers.push_back({1, 60, ipv4("127.0.0.1")});
+    }
+    else if (name == "silent.test")
+    {
+      return;
+    }
+    else if (name.find(".test") == string::npos)
+    {
+      rcode = 3;  // NXDOMAIN
+    }
+
+    string answer(query.data(), end);
+    answer[2] = static_cast<char>(0x81);
+    answer[3] = static_cast<char>(0x80 | rcode);
+    answer[6] = 0;
+    answer[7] = static_cast<char>(answers.size());
+    for (const Record& record : answers)
+    {
+      append16(&answer, 0xC00C);  // the question name
+      append16(&answer, record.type);
+      append16(&answer, 1);
+      append16(&answer, static_cast<uint16_t>(record.ttl >> 16));
+      append16(&answer, static_cast<uint16_t>(record.ttl));
+      append16(&answer, static_cast<uint16_t>(record.rdata.size()));
+      answer += record.rdata;
+    }
+    socket->sendTo(peer, answer);
+  }
+
+  UdpSocket socket_;
+  int queries_;
+};
+
+// runs the loop until cb is called, returns addresses it got
+Addresses resolve(EventLoop* loop, DnsResolver* resolver, const string& name,
+                  DnsResolver::Family family = DnsResolver::kIPv4)
+{
+  Addresses result;
+  bool done = false;
+  resolver->resolve(name, 80, [&](const Addresses& addresses)
+                    {
+                      result = addresses;
+                      done = true;
+                      loop->quit();
+                    }, family);
+  if (!done)
+  {
+    TimerId timeout = loop->runAfter(5.0, [] { LOG_FATAL << "timeout"; });
+    loop->loop();
+    loop->cancel(timeout);
+  }
+  return result;
+}
+
+BOOST_AUTO_TEST_CASE(testResolveAndCache)
+{
+  EventLoop loop;
+  StubDnsServer server(&loop);
+  DnsResolver resolver(&loop, {server.address()});
+
+  Addresses addresses = resolve(&loop, &resolver, "a.test");
+  BOOST_REQUIRE_EQUAL(addresses.size(), 2u);
+  BOOST_CHECK_EQUAL(addresses[0].toIpPort(), string("10.0.0.1:80"));
+  BOOST_CHECK_EQUAL(addresses[1].toIpPort(), string("10.0.0.2:80"));
+  BOOST_CHECK_EQUAL(server.queries(), 1);
+
+  addresses = resolve(&loop, &resolver, "A.Test.");
+  BOOST_CHECK_EQUAL(addresses.size(), 2u);
+  BOOST_CHECK_EQUAL(server.queries(), 1);
+  BOOST_CHECK_EQUAL(resolver.cacheHits(), 1);
+
+  // the smaller TTL of the two
+  loop.runAfter(1.2, [&loop] { loop.quit(); });
+  loop.loop();
+  addresses = resolve(&loop, &resolver, "a.test");
+  BOOST_CHECK_EQUAL(addresses.size(), 2u);
+  BOOST_CHECK_EQUAL(server.queries(), 2);
+
+  addresses = resolve(&loop, &resolver, "cname.test");
+  BOOST_REQUIRE_EQUAL(addresses.size(), 1u);
+  BOOST_CHECK_EQUAL(addresses[0].toIp(), string("10.0.0.3"));
+}
+
+BOOST_AUTO_TEST_CASE(testIPv6)
+{
+  EventLoop loop;
+  StubDnsServer server(&loop);
+  DnsResolver resolver(&loop, {server.address()});
+
+  Addresses addresses = resolve(&loop, &resolver, "v6.test", DnsResolver::kIPv6);
+  BOOST_REQUIRE_EQUAL(addresses.size(), 1u);
+  BOOST_CHECK_EQUAL(addresses[0].family(), AF_INET6);
+  BOOST_CHECK_EQUAL(addresses[0].toIp(), string("::1"));
+  BOOST_CHECK_EQUAL(addresses[0].toPort(), 80);
+
+  // no A record
+  addresses = resolve(&loop, &resolver, "v6.test", DnsResolver::kAny);
+  BOOST_REQUIRE_EQUAL(addresses.size(), 1u);
+  BOOST_CHECK_EQUAL(addresses[0].family(), AF_INET6);
+  BOOST_CHECK_EQUAL(server.queries(), 2);
+
+  addresses = resolve(&loop, &resolver, "a.test", DnsResolver::kAny);
+  BOOST_CHECK_EQUAL(addresses.size(), 2u);
+
+  // numeric, no query
+  addresses = resolve(&loop, &resolver, "::1", DnsResolver::kIPv6);
+  BOOST_REQUIRE_EQUAL(addresses.size(), 1u);
+  BOOST_CHECK_EQUAL(addresses[0].toIp(), string("::1"));
+  BOOST_CHECK_EQUAL(addresses[0].toPort(), 80);
+  addresses = resolve(&loop, &resolver, "10.1.2.3");
+  BOOST_REQUIRE_EQUAL(addresses.size(), 1u);
+  BOOST_CHECK_EQUAL(addresses[0].toIpPort(), string("10.1.2.3:80"));
+  BOOST_CHECK_EQUAL(server.queries(), 4);
+}
+
+BOOST_AUTO_TEST_CASE(testFailures)
+{
+  EventLoop loop;
+  StubDnsServer server(&loop);
+  DnsResolver resolver(&loop, {server.address()});
+  resolver.setTimeout(0.1);
+  resolver.setAttempts(2);
+
+  BOOST_CHECK(resolve(&loop, &resolver, "nonexistent.invalid").empty());
+  BOOST_CHECK(resolve(&loop, &resolver, "nonexistent.invalid").empty());
+  BOOST_CHECK_EQUAL(server.queries(), 1);
+
+  BOOST_CHECK(resolve(&loop, &resolver, "silent.test").empty());
+  BOOST_CHECK_EQUAL(server.queries(), 3);
+
+  BOOST_CHECK(resolve(&loop, &resolver, "bad..name").empty());
+  BOOST_CHECK_EQUAL(server.queries(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(testFailoverAndCoalesce)
+{
+  EventLoop loop;
+  StubDnsServer server(&loop);
+  // never answers
+  UdpSocket dead(&loop, "dead");
+  dead.bindAddress(InetAddress(0, true));
+  DnsResolver resolver(&loop, {dead.localAddress(), server.address()});
+  resolver.setTimeout(0.1);
+
+  int answers = 0;
+  resolver.resolve("a.test", 80, [&answers](const Addresses& addresses)
+                   { BOOST_CHECK_EQUAL(addresses.size(), 2u); ++answers; });
+  Addresses addresses = resolve(&loop, &resolver, "a.test");
+  BOOST_CHECK_EQUAL(addresses.size(), 2u);
+  BOOST_CHECK_EQUAL(answers, 1);
+  BOOST_CHECK_EQUAL(server.queries(), 1);
+  BOOST_CHECK_EQUAL(resolver.queriesSent(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(testTcpClient)
+{
+  EventLoop loop;
+  StubDnsServer dnsServer(&loop);
+  DnsResolver resolver(&loop, {dnsServer.address()});
+
+  // a free port
+  int sockfd = sockets::createNonblockingOrDie(AF_INET);
+  sockets::bindOrDie(sockfd, InetAddress(0, true).getSockAddr());
+  const uint16_t port = InetAddress(sockets::getLocalAddr(sockfd)).toPort();
+  sockets::close(sockfd);
+
+  TcpServer server(&loop, InetAddress(port, true), "DnsResolverTest");
+  server.start();
+
+  TcpClient client(&loop, &resolver, "server.test", port, "DnsResolverTest");
+  string peer;
+  // disconnects while the loop runs, quits once both ends are closed
+  client.setConnectionCallback([&loop, &client, &peer](const TcpConnectionPtr& conn)
+                               {
+                                 if (conn->connected())
+                                 {
+                                   peer = conn->peerAddress().toIpPort();
+                                   client.disconnect();
+                                 }
+                                 else
+                                 {
+                                   loop.quit();
+                                 }
+                               });
+  client.connect();
+  TimerId timeout = loop.runAfter(5.0, [] { LOG_FATAL << "timeout"; });
+  loop.loop();
+  loop.cancel(timeout);
+  BOOST_CHECK_EQUAL(peer, InetAddress(port, true).toIpPort());
+  BOOST_CHECK_EQUAL(dnsServer.queries(), 2);  // A and AAAA
+}
+
+BOOST_AUTO_TEST_CASE(testRacingConnects)
+{
+  EventLoop loop;
+  StubDnsServer dnsServer(&loop);
+  DnsResolver resolver(&loop, {dnsServer.address()});
+
+  int sockfd = sockets::createNonblockingOrDie(AF_INET);
+  sockets::bindOrDie(sockfd, InetAddress(0, true).getSockAddr());
+  const uint16_t port = InetAddress(sockets::getLocalAddr(sockfd)).toPort();
+  sockets::close(sockfd);
+  TcpServer server(&loop, InetAddress(port, true), "DnsResolverTest");
+  server.start();
+
+  // the connect to 192.0.2.1 hangs or fails, 127.0.0.1 wins
+  TcpClient client(&loop, &resolver, "race.test", port, "DnsResolverTest");
+  string peer;
+  // disconnects while the loop runs, quits once both ends are closed
+  client.setConnectionCallback([&loop, &client, &peer](const TcpConnectionPtr& conn)
+                               {
+                                 if (conn->connected())
+                                 {
+                                   peer = conn->peerAddress().toIpPort();
+                                   client.disconnect();
+                                 }
+                                 else
+                                 {
+                                   loop.quit();
+                                 }
+                               });
+  const Timestamp start = Timestamp::now();
+  client.connect();
+  TimerId timeout = loop.runAfter(5.0, [] { LOG_FATAL << "timeout"; });
+  loop.loop();
+  loop.cancel(timeout);
+  BOOST_CHECK_EQUAL(peer, InetAddress(port, true).toIpPort());
+  BOOST_CHECK_LT(timeDifference(Timestamp::now(), start), 1.0);
+}
@@ -0,0 +1,83 @@
+#include <muduo/net/EventLoopStats.h>
+
+#include <muduo/base/CurrentThread.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/inspect/LoopInspector.h>
+
+//#define BOOST_TEST_MODULE EventLoopStatsTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+
+BOOST_AUTO_TEST_CASE(testEventLoopStats)
+{
+  EventLoop loop;
+  const int kFunctors = 10;
+  for (int i = 0; i < kFunctors; ++i)
+  {
+    loop.queueInLoop([] {});
+  }
+  loop.runAfter(0.01, [] {});
+  loop.runAfter(0.02, [&loop] { loop.quit(); });
+  loop.loop();
+
+  const EventLoopStats& stats = loop.stats();
+  BOOST_CHECK_GE(stats.iterations(), 2);
+  BOOST_CHECK_GT(stats.busyUs() + stats.idleUs(), 0);
+  BOOST_CHECK_EQUAL(stats.slowCallbacks(), 0);
+  // the wakeup and the timerfd
+  BOOST_CHECK_GE(stats.callbackUs().snapshot().count(), 2);
+  BOOST_CHECK_EQUAL(stats.functorUs().snapshot().count(), kFunctors);
+  BOOST_CHECK_EQUAL(stats.queueDepth().snapshot().max(), kFunctors);
+  BOOST_CHECK_EQUAL(stats.activeChannels().snapshot().count(), stats.iterations());
+
+  const string text = stats.toString();
+  BOOST_CHECK(text.find("iterations ") == 0);
+  BOOST_CHECK(text.find("\ncallback_us count ") != string::npos);
+  BOOST_CHECK(text.find("\nfunctor_us count 10 ") != string::npos);
+  BOOST_CHECK(text.find("\npending_functors count 1 ") != string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(testSlowCallback)
+{
+  EventLoop loop;
+  loop.setSlowCallbackThreshold(0.005);
+  loop.queueInLoop([] { CurrentThread::sleepUsec(10 * 1000); });
+  loop.runAfter(0.01, [] { CurrentThread::sleepUsec(10 * 1000); });
+  loop.runAfter(0.02, [&loop] { loop.quit(); });
+  loop.loop();
+
+  const EventLoopStats& stats = loop.stats();
+  BOOST_CHECK_GE(stats.slowCallbacks(), 2);
+  BOOST_CHECK_GE(stats.functorUs().snapshot().max(), 10 * 1000);
+  BOOST_CHECK_GE(stats.callbackUs().snapshot().max(), 10 * 1000);
+}
+
+BOOST_AUTO_TEST_CASE(testLoopInspector)
+{
+  EventLoop loop;
+  loop.runAfter(0.01, [&loop] { loop.quit(); });
+  loop.loop();
+
+  const string stats = LoopInspector::stats(HttpRequest::kGet, Inspector::ArgList());
+  char tid[32];
+  snprintf(tid, sizeof tid, " tid %d\n", CurrentThread::tid());
+  BOOST_CHECK(stats.find("loop ") == 0);
+  BOOST_CHECK(stats.find(tid) != string::npos);
+  BOOST_CHECK(stats.find("\nutilization ") != string::npos);
+  BOOST_CHECK(stats.find("\ncallback_us count ") != string::npos);
+
+  BOOST_CHECK_EQUAL(LoopInspector::slowCallback(HttpRequest::kGet, Inspector::ArgList()),
+                    "usage: /loops/slowcallback/<ms>\n");
+  BOOST_CHECK_EQUAL(LoopInspector::slowCallback(HttpRequest::kGet, Inspector::ArgList(1, "5")),
+                    "slow callback threshold set to 5ms\n");
+  // applies to every loop
+  const int64_t slow = loop.stats().slowCallbacks();
+  loop.queueInLoop([] { CurrentThread::sleepUsec(10 * 1000); });
+  loop.runAfter(0.01, [&loop] { loop.quit(); });
+  loop.loop();
+  BOOST_CHECK_GE(loop.stats().slowCallbacks(), slow + 1);
+}
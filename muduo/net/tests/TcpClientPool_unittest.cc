@@ -0,0 +1,189 @@
+#include <muduo/net/TcpClientPool.h>
+
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/SocketsOps.h>
+#include <muduo/net/TcpServer.h>
+
+#include <set>
+
+//#define BOOST_TEST_MODULE TcpClientPoolTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using namespace muduo;
+using namespace muduo::net;
+
+uint16_t freePort()
+{
+  int sockfd = sockets::createNonblockingOrDie(AF_INET);
+  sockets::bindOrDie(sockfd, InetAddress(0, true).getSockAddr());
+  const uint16_t port = InetAddress(sockets::getLocalAddr(sockfd)).toPort();
+  sockets::close(sockfd);
+  return port;
+}
+
+void runUntil(EventLoop* loop, const std::function<bool()>& done)
+{
+  TimerId poll = loop->runEvery(0.01, [loop, done] { if (done()) loop->quit(); });
+  TimerId timeout = loop->runAfter(5.0, [] { LOG_FATAL << "timeout"; });
+  loop->loop();
+  loop->cancel(poll);
+  loop->cancel(timeout);
+}
+
+struct Fixture
+{
+  Fixture()
+    : port(freePort()),
+      server(&loop, InetAddress(port, true), "TcpClientPoolTest"),
+      accepted(0),
+      live(0)
+  {
+    server.setConnectionCallback([this](const TcpConnectionPtr& conn)
+                                 {
+                                   accepted += conn->connected() ? 1 : 0;
+                                   live += conn->connected() ? 1 : -1;
+                                 });
+    server.start();
+  }
+
+  EventLoop loop;
+  uint16_t port;
+  TcpServer server;
+  int accepted;
+  int live;
+};
+
+BOOST_AUTO_TEST_CASE(testLeases)
+{
+  Fixture f;
+  std::unique_ptr<TcpClientPool> owner(new TcpClientPool(&f.loop, InetAddress(f.port, true), "pool"));
+  TcpClientPool& pool = *owner;
+  pool.setMinConnections(3);
+  pool.setMaxConnections(4);
+  pool.setIdleTimeout(0.2);
+  pool.start();
+  runUntil(&f.loop, [&pool] { return pool.connectedConnections() == 3; });
+  BOOST_CHECK_EQUAL(f.accepted, 3);
+
+  std::vector<TcpConnectionPtr> leased;
+  int timedOut = 0;
+  auto lease = [&leased, &timedOut](const TcpConnectionPtr& conn)
+  {
+    if (conn)
+      leased.push_back(conn);
+    else
+      ++timedOut;
+  };
+  for (int i = 0; i < 5; ++i)
+  {
+    pool.acquire(lease, 2.0);
+  }
+  BOOST_CHECK_EQUAL(leased.size(), 3u);
+  BOOST_CHECK_EQUAL(pool.connections(), 4);
+  runUntil(&f.loop, [&leased] { return leased.size() == 4; });
+  BOOST_CHECK_EQUAL(pool.waiters(), 1u);
+  BOOST_CHECK_EQUAL(pool.idleConnections(), 0);
+
+  pool.release(leased[0]);
+  BOOST_CHECK_EQUAL(leased.size(), 5u);
+  BOOST_CHECK(leased[4] == leased[0]);
+  BOOST_CHECK_EQUAL(pool.waiters(), 0u);
+
+  pool.acquire(lease, 0.05);
+  runUntil(&f.loop, [&timedOut] { return timedOut == 1; });
+  BOOST_CHECK_EQUAL(leased.size(), 5u);
+  BOOST_CHECK_EQUAL(pool.connections(), 4);
+
+  // back to the minimum when idle
+  for (size_t i = 1; i < leased.size(); ++i)
+  {
+    pool.release(leased[i]);
+  }
+  BOOST_CHECK_EQUAL(pool.idleConnections(), 4);
+  // the socket is closed with the last reference
+  leased.clear();
+  runUntil(&f.loop, [&pool] { return pool.connections() == 3; });
+  runUntil(&f.loop, [&f] { return f.live == 3; });
+
+  // closes the connections while the loop runs
+  owner.reset();
+  runUntil(&f.loop, [&f] { return f.live == 0; });
+}
+
+BOOST_AUTO_TEST_CASE(testAcquireInCallback)
+{
+  Fixture f;
+  std::unique_ptr<TcpClientPool> owner(new TcpClientPool(&f.loop, InetAddress(f.port, true), "pool"));
+  TcpClientPool& pool = *owner;
+  const int kMax = 16;
+  pool.setMinConnections(1);
+  pool.setMaxConnections(kMax);
+  pool.start();
+  runUntil(&f.loop, [&pool] { return pool.connectedConnections() == 1; });
+
+  // each lease acquires another, while the pool grows
+  std::vector<TcpConnectionPtr> leased;
+  std::function<void (const TcpConnectionPtr&)> lease;
+  lease = [&pool, &leased, &lease](const TcpConnectionPtr& conn)
+  {
+    BOOST_REQUIRE(conn);
+    leased.push_back(conn);
+    if (leased.size() < kMax)
+    {
+      pool.acquire(lease, 2.0);
+    }
+  };
+  pool.acquire(lease, 2.0);
+  runUntil(&f.loop, [&leased] { return leased.size() == kMax; });
+  BOOST_CHECK_EQUAL(pool.connections(), kMax);
+  BOOST_CHECK_EQUAL(pool.waiters(), 0u);
+  BOOST_CHECK_EQUAL(std::set<TcpConnectionPtr>(leased.begin(), leased.end()).size(),
+                    static_cast<size_t>(kMax));
+
+  // a waiter acquiring again when served by release()
+  int served = 0;
+  std::function<void (const TcpConnectionPtr&)> again =
+      [&pool, &served, &again](const TcpConnectionPtr& conn)
+      {
+        BOOST_REQUIRE(conn);
+        if (++served < 3)
+          pool.acquire(again, 2.0);
+        pool.release(conn);
+      };
+  pool.acquire(again, 2.0);
+  pool.acquire(again, 2.0);
+  BOOST_CHECK_EQUAL(pool.waiters(), 2u);
+  pool.release(leased[0]);
+  BOOST_CHECK_GE(served, 3);
+  BOOST_CHECK_EQUAL(pool.waiters(), 0u);
+
+  for (size_t i = 1; i < leased.size(); ++i)
+  {
+    pool.release(leased[i]);
+  }
+  leased.clear();
+  owner.reset();
+  runUntil(&f.loop, [&f] { return f.live == 0; });
+}
+
+BOOST_AUTO_TEST_CASE(testHealthCheck)
+{
+  Fixture f;
+  std::unique_ptr<TcpClientPool> owner(new TcpClientPool(&f.loop, InetAddress(f.port, true), "pool"));
+  TcpClientPool& pool = *owner;
+  pool.setMinConnections(2);
+  std::set<string> checked;
+  // each connection fails its first check
+  pool.setHealthCheck(0.05, [&checked](const TcpConnectionPtr& conn)
+                      { return !checked.insert(conn->name()).second; });
+  pool.start();
+  runUntil(&f.loop, [&f, &pool]
+           { return f.accepted >= 4 && pool.connectedConnections() == 2; });
+  BOOST_CHECK_EQUAL(pool.connections(), 2);
+
+  owner.reset();
+  runUntil(&f.loop, [&f] { return f.live == 0; });
+}
@@ -0,0 +1,210 @@
+#include <muduo/base/Logging.h>
+#include <muduo/base/Metrics.h>
+#include <muduo/net/BufferPool.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/SocketsOps.h>
+#include <muduo/net/TcpClient.h>
+#include <muduo/net/TcpServer.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// Sends a burst, then checks that both ends release their grown buffers
+// after going quiet, the large input buffer of the server into the pool.
+// Then sends 6-byte frames to a server in shared input buffer mode,
+// which keeps only partial frames in its own input buffer.
+
+const size_t kBurst = 4 * 1024 * 1024;
+const double kIdleTimeout = 0.2;
+
+EventLoop* g_loop;
+std::unique_ptr<TcpClient> g_client;
+int g_live = 0;
+bool g_done = false;
+size_t g_received = 0;
+int64_t g_peakBytes = 0;
+
+const int32_t kFrames = 200 * 1000;
+const int16_t kMarker = 0x1234;
+std::unique_ptr<TcpServer> g_sharedServer;
+std::unique_ptr<TcpClient> g_sharedClient;
+int32_t g_frames = 0;
+int g_sharedReads = 0;
+int g_leftovers = 0;
+
+uint16_t freePort()
+{
+  int sockfd = sockets::createNonblockingOrDie(AF_INET);
+  sockets::bindOrDie(sockfd, InetAddress(0, true).getSockAddr());
+  const uint16_t port = InetAddress(sockets::getLocalAddr(sockfd)).toPort();
+  sockets::close(sockfd);
+  return port;
+}
+
+// quits once both sides of both connections are down, so that the servers
+// and clients are destroyed without connections
+void countConnection(const TcpConnectionPtr& conn)
+{
+  g_live += conn->connected() ? 1 : -1;
+  if (g_done && g_live == 0)
+  {
+    g_loop->quit();
+  }
+}
+
+void serverConnection(const TcpConnectionPtr& conn)
+{
+  countConnection(conn);
+  if (conn->connected())
+  {
+    conn->setBufferIdleTimeout(kIdleTimeout);
+  }
+}
+
+void serverMessage(const TcpConnectionPtr&, Buffer* buf, Timestamp)
+{
+  for (const char* p = buf->peek(); p != buf->beginWrite(); ++p)
+  {
+    if (*p != static_cast<char>((g_received++) % 251))
+    {
+      LOG_FATAL << "corrupted at " << g_received;
+    }
+  }
+  buf->retrieveAll();
+  g_peakBytes = std::max(g_peakBytes, BufferPool::connectionBytesGauge()->value());
+}
+
+void clientConnection(const TcpConnectionPtr& conn)
+{
+  countConnection(conn);
+  if (conn->connected())
+  {
+    conn->setBufferIdleTimeout(kIdleTimeout);
+    string burst(kBurst, '\0');
+    for (size_t i = 0; i < kBurst; ++i)
+    {
+      burst[i] = static_cast<char>(i % 251);
+    }
+    conn->send(burst);
+  }
+}
+
+void sharedServerConnection(const TcpConnectionPtr& conn)
+{
+  countConnection(conn);
+  if (conn->connected())
+  {
+    conn->setSharedInputBuffer(true);
+  }
+}
+
+void checkShared()
+{
+  // a large buffer lent for the leftovers went back to the pool
+  printf("pooled %zd\n", g_loop->bufferPool().size());
+  if (g_loop->bufferPool().size() != 1)
+  {
+    LOG_FATAL << "failed";
+  }
+  g_done = true;
+  g_client->disconnect();
+  g_sharedClient->disconnect();
+}
+
+void sharedServerMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  if (buf != conn->inputBuffer())
+  {
+    ++g_sharedReads;
+    if (conn->inputBuffer()->internalCapacity() != Buffer::kCheapPrepend)
+    {
+      LOG_FATAL << "input buffer not released";
+    }
+  }
+  while (buf->readableBytes() >= 6)
+  {
+    if (buf->readInt32() != g_frames++ || buf->readInt16() != kMarker)
+    {
+      LOG_FATAL << "corrupted frame " << g_frames;
+    }
+  }
+  if (buf->readableBytes() > 0)
+  {
+    ++g_leftovers;
+  }
+  if (g_frames == kFrames)
+  {
+    printf("%d frames, %d shared reads, %d with leftovers\n",
+           g_frames, g_sharedReads, g_leftovers);
+    if (g_sharedReads == 0 || g_leftovers == 0)
+    {
+      LOG_FATAL << "failed";
+    }
+    g_loop->queueInLoop(checkShared);
+  }
+}
+
+void sharedClientConnection(const TcpConnectionPtr& conn)
+{
+  countConnection(conn);
+  if (conn->connected())
+  {
+    Buffer frames;
+    for (int32_t i = 0; i < kFrames; ++i)
+    {
+      frames.appendInt32(i);
+      frames.appendInt16(kMarker);
+    }
+    conn->send(&frames);
+  }
+}
+
+void check()
+{
+  const int64_t smallBytes = 4 * (Buffer::kCheapPrepend + Buffer::kInitialSize);
+  const int64_t bytes = BufferPool::connectionBytesGauge()->value();
+  printf("received %zd, peak %" PRId64 " bytes, now %" PRId64 " bytes, pooled %zd\n",
+         g_received, g_peakBytes, bytes, g_loop->bufferPool().size());
+  if (g_received != kBurst
+      || g_peakBytes <= smallBytes
+      || bytes != smallBytes
+      || g_loop->bufferPool().size() != 1)
+  {
+    LOG_FATAL << "failed";
+  }
+
+  InetAddress listenAddr(freePort(), true);
+  g_sharedServer.reset(new TcpServer(g_loop, listenAddr, "SharedServer"));
+  g_sharedServer->setConnectionCallback(sharedServerConnection);
+  g_sharedServer->setMessageCallback(sharedServerMessage);
+  g_sharedServer->start();
+  g_sharedClient.reset(new TcpClient(g_loop, listenAddr, "SharedClient"));
+  g_sharedClient->setConnectionCallback(sharedClientConnection);
+  g_sharedClient->connect();
+  g_loop->runAfter(10, [] { LOG_FATAL << "timeout"; });
+}
+
+int main()
+{
+  EventLoop loop;
+  g_loop = &loop;
+  InetAddress listenAddr(freePort(), true);
+  TcpServer server(&loop, listenAddr, "BufferServer");
+  server.setConnectionCallback(serverConnection);
+  server.setMessageCallback(serverMessage);
+  server.start();
+
+  g_client.reset(new TcpClient(&loop, listenAddr, "BufferClient"));
+  g_client->setConnectionCallback(clientConnection);
+  g_client->connect();
+
+  loop.runAfter(1.0 + 3 * kIdleTimeout, check);
+  loop.loop();
+  g_client.reset();
+  g_sharedClient.reset();
+  g_sharedServer.reset();
+}
@@ -0,0 +1,122 @@
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/SocketsOps.h>
+#include <muduo/net/TcpClient.h>
+#include <muduo/net/TcpServer.h>
+
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// A server in deferred flush mode sends a few small pieces and a large
+// one in the same callback, then shuts down.  Checks that the client gets
+// all of it in order followed by EOF, and that the write completes once.
+
+const size_t kPieces[] = { 1, 10, 100, 1000, 10000, 4 * 1024 * 1024 };
+
+EventLoop* g_loop;
+size_t g_sent = 0;
+size_t g_received = 0;
+int g_writeCompletes = 0;
+bool g_serverDown = false;
+bool g_clientDown = false;
+
+uint16_t freePort()
+{
+  int sockfd = sockets::createNonblockingOrDie(AF_INET);
+  sockets::bindOrDie(sockfd, InetAddress(0, true).getSockAddr());
+  const uint16_t port = InetAddress(sockets::getLocalAddr(sockfd)).toPort();
+  sockets::close(sockfd);
+  return port;
+}
+
+// the server side closes after the client, quits once both are down so
+// that ~TcpServer finds no connection half way
+void quitIfDone()
+{
+  if (g_serverDown && g_clientDown)
+  {
+    g_loop->quit();
+  }
+}
+
+string makePiece(size_t len)
+{
+  string piece(len, '\0');
+  for (size_t i = 0; i < len; ++i)
+  {
+    piece[i] = static_cast<char>((g_sent++) % 251);
+  }
+  return piece;
+}
+
+void serverConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    conn->setDeferredFlush(true);
+    for (size_t len : kPieces)
+    {
+      conn->send(makePiece(len));
+    }
+    conn->shutdown();
+  }
+  else
+  {
+    g_serverDown = true;
+    quitIfDone();
+  }
+}
+
+void serverWriteComplete(const TcpConnectionPtr&)
+{
+  ++g_writeCompletes;
+}
+
+void clientConnection(const TcpConnectionPtr& conn)
+{
+  if (!conn->connected())
+  {
+    printf("sent %zd, received %zd, %d write completes\n",
+           g_sent, g_received, g_writeCompletes);
+    if (g_received != g_sent || g_writeCompletes != 1)
+    {
+      LOG_FATAL << "failed";
+    }
+    g_clientDown = true;
+    quitIfDone();
+  }
+}
+
+void clientMessage(const TcpConnectionPtr&, Buffer* buf, Timestamp)
+{
+  for (const char* p = buf->peek(); p != buf->beginWrite(); ++p)
+  {
+    if (*p != static_cast<char>((g_received++) % 251))
+    {
+      LOG_FATAL << "corrupted at " << g_received;
+    }
+  }
+  buf->retrieveAll();
+}
+
+int main()
+{
+  EventLoop loop;
+  g_loop = &loop;
+  InetAddress listenAddr(freePort(), true);
+  TcpServer server(&loop, listenAddr, "FlushServer");
+  server.setConnectionCallback(serverConnection);
+  server.setWriteCompleteCallback(serverWriteComplete);
+  server.start();
+
+  TcpClient client(&loop, listenAddr, "FlushClient");
+  client.setConnectionCallback(clientConnection);
+  client.setMessageCallback(clientMessage);
+  client.connect();
+
+  loop.runAfter(10, [] { LOG_FATAL << "timeout"; });
+  loop.loop();
+}
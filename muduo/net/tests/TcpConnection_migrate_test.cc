@@ -0,0 +1,334 @@
+#include <muduo/base/Logging.h>
+#include <muduo/base/ObjectPool.h>
+#include <muduo/base/Thread.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/EventLoopThreadPool.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/SocketsOps.h>
+#include <muduo/net/TcpClient.h>
+#include <muduo/net/TcpServer.h>
+
+#include <memory>
+#include <vector>
+
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// Moves the server side connection back and forth between two loops,
+// while both peers are streaming sequence numbers to each other,
+// one of them from a non-loop thread.
+// Then lets TcpServer::rebalance() even out connections left on one loop.
+// Last checks connections are made and freed in their own loop's pool.
+
+const int32_t kCount = 200 * 1000;
+
+EventLoop* g_loop;
+TcpServer* g_server;
+MutexLock g_mutex;
+TcpConnectionPtr g_serverConn GUARDED_BY(g_mutex);
+TimerId g_migrateTimer;
+AtomicInt32 g_migrated;
+int32_t g_serverReceived = 0;  // in server conn's loop, which changes
+int32_t g_clientReceived = 0;  // in g_loop
+int32_t g_clientSent = 0;      // in g_loop
+
+uint16_t freePort()
+{
+  int sockfd = sockets::createNonblockingOrDie(AF_INET);
+  sockets::bindOrDie(sockfd, InetAddress(0, true).getSockAddr());
+  const uint16_t port = InetAddress(sockets::getLocalAddr(sockfd)).toPort();
+  sockets::close(sockfd);
+  return port;
+}
+
+void runUntil(const std::function<bool()>& done)
+{
+  TimerId poll = g_loop->runEvery(0.01, [done] { if (done()) g_loop->quit(); });
+  TimerId timeout = g_loop->runAfter(30, [] { LOG_FATAL << "timeout"; });
+  g_loop->loop();
+  g_loop->cancel(poll);
+  g_loop->cancel(timeout);
+}
+
+void checkSequence(Buffer* buf, int32_t* expected)
+{
+  while (buf->readableBytes() >= sizeof(int32_t))
+  {
+    int32_t n = buf->readInt32();
+    if (n != *expected)
+    {
+      LOG_FATAL << "expect " << *expected << " got " << n;
+    }
+    ++*expected;
+  }
+}
+
+void serverConnection(const TcpConnectionPtr& conn)
+{
+  MutexLockGuard lock(g_mutex);
+  g_serverConn = conn->connected() ? conn : TcpConnectionPtr();
+}
+
+void serverMessage(const TcpConnectionPtr&, Buffer* buf, Timestamp)
+{
+  checkSequence(buf, &g_serverReceived);
+}
+
+void onMigrated(const TcpConnectionPtr& conn)
+{
+  conn->getLoop()->assertInLoopThread();
+  g_migrated.increment();
+}
+
+void migrate()
+{
+  TcpConnectionPtr conn;
+  {
+  MutexLockGuard lock(g_mutex);
+  conn = g_serverConn;
+  }
+  if (conn)
+  {
+    std::vector<EventLoop*> loops = g_server->threadPool()->getAllLoops();
+    EventLoop* next = conn->getLoop() == loops[0] ? loops[1] : loops[0];
+    conn->migrateTo(next, onMigrated);
+  }
+}
+
+void produce()
+{
+  TcpConnectionPtr conn;
+  while (!conn)
+  {
+    CurrentThread::sleepUsec(1000);
+    MutexLockGuard lock(g_mutex);
+    conn = g_serverConn;
+  }
+  for (int32_t i = 0; i < kCount; ++i)
+  {
+    Buffer buf;
+    buf.appendInt32(i);
+    conn->send(&buf);
+    if (i % 1000 == 0)
+    {
+      CurrentThread::sleepUsec(100);
+    }
+  }
+}
+
+void clientSend(const TcpConnectionPtr& conn)
+{
+  Buffer buf;
+  for (int i = 0; i < 1000 && g_clientSent < kCount; ++i)
+  {
+    buf.appendInt32(g_clientSent++);
+  }
+  conn->send(&buf);
+}
+
+void clientConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    clientSend(conn);
+  }
+  else
+  {
+    // the server side is gone, see clientMessage()
+    g_loop->quit();
+  }
+}
+
+void clientWriteComplete(const TcpConnectionPtr& conn)
+{
+  if (g_clientSent < kCount)
+  {
+    clientSend(conn);
+  }
+}
+
+void clientMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+  checkSequence(buf, &g_clientReceived);
+  if (g_clientReceived == kCount && g_clientSent == kCount)
+  {
+    g_loop->cancel(g_migrateTimer);
+    // the server closes in turn, then we quit
+    conn->shutdown();
+  }
+}
+
+void testMigrate()
+{
+  InetAddress listenAddr(freePort());
+  TcpServer server(g_loop, listenAddr, "MigrateServer");
+  g_server = &server;
+  server.setThreadNum(2);
+  server.setConnectionCallback(serverConnection);
+  server.setMessageCallback(serverMessage);
+  server.start();
+
+  TcpClient client(g_loop, listenAddr, "MigrateClient");
+  client.setConnectionCallback(clientConnection);
+  client.setMessageCallback(clientMessage);
+  client.setWriteCompleteCallback(clientWriteComplete);
+  client.connect();
+
+  Thread producer(produce, "producer");
+  producer.start();
+  g_migrateTimer = g_loop->runEvery(0.001, migrate);
+  TimerId timeout = g_loop->runAfter(30, [] { LOG_FATAL << "timeout"; });
+  g_loop->loop();
+  g_loop->cancel(timeout);
+  producer.join();
+
+  if (g_serverReceived != kCount || g_migrated.get() == 0)
+  {
+    LOG_FATAL << "server received " << g_serverReceived
+              << ", migrated " << g_migrated.get();
+  }
+  printf("%d migrations\n", g_migrated.get());
+}
+
+void testRebalance()
+{
+  const int kClients = 8;
+  InetAddress listenAddr(freePort());
+  TcpServer server(g_loop, listenAddr, "RebalanceServer");
+  server.setThreadNum(2);
+  server.enableRebalance(0.05, 0.0);
+  AtomicInt32 rebalanced;
+  server.setMigrationCallback([&rebalanced](const TcpConnectionPtr& conn)
+                              {
+                                conn->getLoop()->assertInLoopThread();
+                                rebalanced.increment();
+                              });
+  // echo
+  server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+                            { conn->send(buf); });
+  server.start();
+  std::vector<EventLoop*> loops = server.threadPool()->getAllLoops();
+
+  int up = 0;
+  int echoed = 0;
+  std::vector<std::unique_ptr<TcpClient>> clients;
+  for (int i = 0; i < kClients; ++i)
+  {
+    clients.emplace_back(new TcpClient(g_loop, listenAddr, "RebalanceClient"));
+    clients.back()->setConnectionCallback([&up](const TcpConnectionPtr& conn)
+                                          { up += conn->connected() ? 1 : -1; });
+    clients.back()->setMessageCallback([&echoed](const TcpConnectionPtr&, Buffer* buf, Timestamp)
+                                       { echoed += static_cast<int>(buf->readableBytes()); buf->retrieveAll(); });
+    clients.back()->connect();
+  }
+  runUntil([&] { return up == kClients && server.numConnections() == kClients; });
+
+  // round robin placed half of them on each loop, closes those on the second
+  server.forEachConnection([&loops](const TcpConnectionPtr& conn)
+                           {
+                             if (conn->getLoop() == loops[1])
+                             {
+                               conn->shutdown();
+                             }
+                           });
+  runUntil([&] { return up == kClients / 2 && server.numConnections() == kClients / 2; });
+  auto onSecond = [&server, &loops]
+  {
+    int n = 0;
+    server.forEachConnection([&loops, &n](const TcpConnectionPtr& conn)
+                             { n += conn->getLoop() == loops[1] ? 1 : 0; });
+    return n;
+  };
+  // may take more than one round if it ran while closing
+  runUntil([&] { return onSecond() == kClients / 4 && rebalanced.get() >= kClients / 4; });
+
+  // moved connections still work
+  for (auto& client : clients)
+  {
+    if (TcpConnectionPtr conn = client->connection())
+    {
+      if (conn->connected())
+      {
+        conn->send("ping");
+      }
+    }
+  }
+  runUntil([&] { return echoed == 4 * kClients / 2; });
+  printf("%d rebalanced\n", rebalanced.get());
+
+  for (auto& client : clients)
+  {
+    client->disconnect();
+  }
+  runUntil([&] { return up == 0 && server.numConnections() == 0; });
+}
+
+void testObjectPools()
+{
+  const int kConnections = 200;
+  InetAddress listenAddr(freePort());
+  TcpServer server(g_loop, listenAddr, "PoolServer");
+  server.setThreadNum(2);
+  AtomicInt32 closed;
+  server.setConnectionCallback([&closed](const TcpConnectionPtr& conn)
+                               {
+                                 if (!conn->connected())
+                                 {
+                                   closed.increment();
+                                 }
+                               });
+  server.start();
+  std::vector<EventLoop*> loops = server.threadPool()->getAllLoops();
+  const ObjectPool& acceptorPool = *g_loop->objectPool();
+  const int64_t acceptorAllocs = acceptorPool.hits() + acceptorPool.misses();
+
+  Thread churn([&listenAddr]
+               {
+                 for (int i = 0; i < kConnections; ++i)
+                 {
+                   int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+                   if (::connect(sockfd, listenAddr.getSockAddr(),
+                                 static_cast<socklen_t>(sizeof(struct sockaddr_in))) < 0)
+                   {
+                     LOG_SYSFATAL << "connect";
+                   }
+                   ::close(sockfd);
+                 }
+               }, "churn");
+  churn.start();
+  runUntil([&] { return closed.get() == kConnections && server.numConnections() == 0; });
+  churn.join();
+
+  if (acceptorPool.hits() + acceptorPool.misses() != acceptorAllocs)
+  {
+    LOG_FATAL << "allocated from the acceptor loop's pool";
+  }
+  for (EventLoop* ioLoop : loops)
+  {
+    const ObjectPool& pool = *ioLoop->objectPool();
+    // TcpConnection, Socket and Channel of each connection placed there,
+    // freed in the same loop, so taken again from the free lists
+    const int64_t allocs = pool.hits() + pool.misses();
+    if (allocs < 3 * kConnections / static_cast<int>(loops.size()) || pool.hits() == 0)
+    {
+      LOG_FATAL << "io loop " << ioLoop << " pool hits " << pool.hits()
+                << " misses " << pool.misses();
+    }
+    printf("io loop pool hits %lld misses %lld\n",
+           static_cast<long long>(pool.hits()),
+           static_cast<long long>(pool.misses()));
+  }
+}
+
+int main()
+{
+  EventLoop loop;
+  g_loop = &loop;
+  testMigrate();
+  testRebalance();
+  testObjectPools();
+}
@@ -0,0 +1,193 @@
+#include <muduo/base/Logging.h>
+#include <muduo/net/EventLoop.h>
+#include <muduo/net/InetAddress.h>
+#include <muduo/net/UdpServer.h>
+#include <muduo/net/UdpSocket.h>
+
+#include <memory>
+#include <vector>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// Echoes datagrams of several clients through a sharded UdpServer, each
+// client keeping a few datagrams in flight, then again with GSO
+// and GRO if the kernel supports them.
+
+const int kClients = 4;
+const int kDatagrams = 20 * 1000;
+const int kWindow = 8;  // fits in the default SO_RCVBUF, from all clients
+const size_t kPayload = 200;
+
+EventLoop* g_loop;
+int g_finished = 0;
+
+struct Client
+{
+  std::unique_ptr<UdpSocket> socket;
+  int id;
+  int sent;
+  int received;
+};
+
+void sendNext(Client* client, const InetAddress& serverAddr)
+{
+  char buf[kPayload];
+  memset(buf, 'a' + client->id, sizeof buf);
+  memcpy(buf, &client->sent, sizeof client->sent);
+  client->socket->sendTo(serverAddr, buf, sizeof buf);
+  ++client->sent;
+}
+
+void onReply(Client* client, const InetAddress& serverAddr, StringPiece datagram)
+{
+  if (datagram.size() != static_cast<int>(kPayload) || datagram[kPayload-1] != 'a' + client->id)
+  {
+    LOG_FATAL << "client " << client->id << " got bad datagram of " << datagram.size();
+  }
+  if (++client->received == kDatagrams)
+  {
+    if (++g_finished == kClients)
+    {
+      g_loop->quit();
+    }
+  }
+  else if (client->sent < kDatagrams)
+  {
+    sendNext(client, serverAddr);
+  }
+}
+
+void echo(UdpSocket* socket, StringPiece datagram, const InetAddress& peer, Timestamp)
+{
+  socket->sendTo(peer, datagram);
+}
+
+// binds port 0 and gives it back, for the sockets of the server
+InetAddress freeAddress()
+{
+  EventLoop loop;
+  UdpSocket probe(&loop, "probe");
+  probe.bindAddress(InetAddress(0, true));
+  return probe.localAddress();
+}
+
+bool offloadSupported()
+{
+  EventLoop loop;
+  UdpSocket probe(&loop, "probe");
+  return probe.setGso(true) && probe.setGro(true);
+}
+
+void run(bool offload)
+{
+  const InetAddress serverAddr = freeAddress();
+  EventLoop loop;
+  g_loop = &loop;
+  g_finished = 0;
+
+  UdpServer server(&loop, serverAddr, "UdpServer_test");
+  server.setThreadNum(2);
+  server.setMessageCallback(echo);
+  server.setGso(offload);
+  server.setGro(offload);
+  server.start();
+
+  std::vector<Client> clients(kClients);
+  for (int i = 0; i < kClients; ++i)
+  {
+    Client* client = &clients[i];
+    client->id = i;
+    client->sent = 0;
+    client->received = 0;
+    client->socket.reset(new UdpSocket(&loop, "client"));
+    client->socket->setGso(offload);
+    client->socket->setGro(offload);
+    client->socket->bindAddress(InetAddress(0, true));
+    client->socket->setMessageCallback(
+        [client, serverAddr](UdpSocket*, StringPiece datagram, const InetAddress&, Timestamp)
+        { onReply(client, serverAddr, datagram); });
+    client->socket->start();
+    for (int j = 0; j < kWindow; ++j)
+    {
+      sendNext(client, serverAddr);
+    }
+  }
+  TimerId timeout = loop.runAfter(30.0, [&clients] {
+    for (const Client& c : clients)
+    {
+      printf("client %d sent %d received %d\n", c.id, c.sent, c.received);
+    }
+    LOG_FATAL << "timeout";
+  });
+  loop.loop();
+  loop.cancel(timeout);
+
+  for (const auto& socket : server.sockets())
+  {
+    printf("%s received %" PRId64 "\n", socket->name().c_str(), socket->receivedDatagrams());
+  }
+  for (const Client& c : clients)
+  {
+    if (c.socket->droppedDatagrams() != 0)
+    {
+      LOG_FATAL << "client " << c.id << " dropped " << c.socket->droppedDatagrams();
+    }
+  }
+  printf("offload %d, %d datagrams echoed\n", offload, kClients * kDatagrams);
+}
+
+// one sendmmsg() of a GSO message, split by the kernel for a plain receiver
+void checkGsoBurst()
+{
+  EventLoop loop;
+  UdpSocket receiver(&loop, "receiver");
+  receiver.bindAddress(InetAddress(0, true));
+  const InetAddress receiverAddr = receiver.localAddress();
+  int datagrams = 0;
+  size_t bytes = 0;
+  receiver.setMessageCallback(
+      [&](UdpSocket*, StringPiece datagram, const InetAddress&, Timestamp)
+      {
+        ++datagrams;
+        bytes += datagram.size();
+        if (datagrams == 41)
+        {
+          loop.quit();
+        }
+      });
+  receiver.start();
+
+  UdpSocket sender(&loop, "sender");
+  sender.setGso(true);
+  string datagram(1000, 'x');
+  for (int i = 0; i < 40; ++i)
+  {
+    sender.sendTo(receiverAddr, datagram);
+  }
+  sender.sendTo(receiverAddr, datagram.data(), 300);
+  loop.runAfter(10.0, [] { LOG_FATAL << "timeout"; });
+  loop.loop();
+  if (bytes != 40 * 1000 + 300 || sender.sentDatagrams() != 41)
+  {
+    LOG_FATAL << "GSO burst " << datagrams << " datagrams " << bytes << " bytes";
+  }
+}
+
+int main()
+{
+  run(false);
+  if (offloadSupported())
+  {
+    checkGsoBurst();
+    run(true);
+  }
+  else
+  {
+    printf("GSO/GRO not supported\n");
+  }
+}